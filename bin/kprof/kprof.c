@@ -0,0 +1,97 @@
+#include <err.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/kprof.h>
+
+/*
+ * Control kernel sampling profiler and print recorded samples.
+ *
+ * kprof -e     start taking samples
+ * kprof -d     stop taking samples
+ * kprof -s     print profiler statistics
+ * kprof [-r]   print recorded samples as text (or copy them verbatim)
+ *
+ * Raw samples can be turned into folded stacks on the host with
+ * sys/debug/kprof_fold.py.
+ */
+
+static void print_sample(const kprof_sample_t *ks) {
+  unsigned sec = ks->ks_time >> 32;
+  unsigned usec = ((ks->ks_time & 0xffffffff) * 1000000) >> 32;
+
+  printf("%u.%06u cpu%u pid %u tid %u", sec, usec, ks->ks_cpu, ks->ks_pid,
+         ks->ks_tid);
+  if (ks->ks_upc)
+    printf(" user %llx", (unsigned long long)ks->ks_upc);
+  for (unsigned i = 0; i < ks->ks_depth && i < KPROF_MAXDEPTH; i++)
+    printf(" %llx", (unsigned long long)ks->ks_kpc[i]);
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  bool raw = false, stat = false;
+  u_long cmd = 0;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "ders")) != -1) {
+    switch (ch) {
+      case 'd':
+        cmd = KPROFIOC_STOP;
+        break;
+      case 'e':
+        cmd = KPROFIOC_START;
+        break;
+      case 'r':
+        raw = true;
+        break;
+      case 's':
+        stat = true;
+        break;
+      default:
+        fprintf(stderr, "usage: kprof [-d | -e | -r | -s]\n");
+        return EXIT_FAILURE;
+    }
+  }
+
+  int fd = open("/dev/kprof", O_RDONLY);
+  if (fd < 0)
+    err(EXIT_FAILURE, "open /dev/kprof");
+
+  if (cmd) {
+    if (ioctl(fd, cmd) < 0)
+      err(EXIT_FAILURE, "ioctl");
+    return EXIT_SUCCESS;
+  }
+
+  if (stat) {
+    kprof_stat_t kst;
+    if (ioctl(fd, KPROFIOC_GETSTAT, &kst) < 0)
+      err(EXIT_FAILURE, "ioctl");
+    printf("running %u samples %u dropped %u\n", kst.kst_running,
+           kst.kst_samples, kst.kst_dropped);
+    return EXIT_SUCCESS;
+  }
+
+  kprof_sample_t buf[16];
+  ssize_t n;
+
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    if (raw) {
+      if (write(STDOUT_FILENO, buf, n) != n)
+        err(EXIT_FAILURE, "write");
+      continue;
+    }
+    for (size_t i = 0; i < n / sizeof(kprof_sample_t); i++)
+      print_sample(&buf[i]);
+  }
+
+  if (n < 0)
+    err(EXIT_FAILURE, "read");
+
+  return EXIT_SUCCESS;
+}
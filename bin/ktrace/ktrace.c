@@ -0,0 +1,98 @@
+#include <err.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/ktrace.h>
+
+/*
+ * Control kernel event tracing and print recorded events.
+ *
+ * ktrace -e [mask]  enable tracepoints given by mask (all by default)
+ * ktrace -d         disable all tracepoints
+ * ktrace [-r]       print recorded events as text (or copy them verbatim)
+ *
+ * Raw records can be decoded on the host with sys/debug/ktrace_decode.py.
+ */
+
+static const char *ktrace_name[KTR_NTYPES] = {
+  [KTR_LOST] = "lost",
+  [KTR_CTXSW] = "ctxsw",
+  [KTR_SYSCALL_ENTER] = "syscall-enter",
+  [KTR_SYSCALL_EXIT] = "syscall-exit",
+  [KTR_PGFAULT] = "pgfault",
+  [KTR_INTR] = "intr",
+  [KTR_SLEEP] = "sleep",
+  [KTR_WAKEUP] = "wakeup",
+  [KTR_LOCK] = "lock",
+};
+
+static void print_event(const ktrace_event_t *ke) {
+  unsigned sec = ke->ke_time >> 32;
+  unsigned usec = ((ke->ke_time & 0xffffffff) * 1000000) >> 32;
+  const char *name =
+    ke->ke_type < KTR_NTYPES ? ktrace_name[ke->ke_type] : "unknown";
+
+  printf("%u.%06u cpu%u tid %u %s %llx %llx\n", sec, usec, ke->ke_cpu,
+         ke->ke_tid, name, (unsigned long long)ke->ke_arg[0],
+         (unsigned long long)ke->ke_arg[1]);
+}
+
+int main(int argc, char **argv) {
+  bool raw = false, setmask = false;
+  unsigned mask = 0;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "der")) != -1) {
+    switch (ch) {
+      case 'd':
+        setmask = true;
+        mask = 0;
+        break;
+      case 'e':
+        setmask = true;
+        mask = KTR_ALL;
+        break;
+      case 'r':
+        raw = true;
+        break;
+      default:
+        fprintf(stderr, "usage: ktrace [-d | -e [mask] | -r]\n");
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (setmask && optind < argc)
+    mask = strtoul(argv[optind], NULL, 0);
+
+  int fd = open("/dev/ktrace", O_RDONLY);
+  if (fd < 0)
+    err(EXIT_FAILURE, "open /dev/ktrace");
+
+  if (setmask) {
+    if (ioctl(fd, KTRACEIOC_SETMASK, &mask) < 0)
+      err(EXIT_FAILURE, "ioctl");
+    return EXIT_SUCCESS;
+  }
+
+  ktrace_event_t buf[64];
+  ssize_t n;
+
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    if (raw) {
+      if (write(STDOUT_FILENO, buf, n) != n)
+        err(EXIT_FAILURE, "write");
+      continue;
+    }
+    for (size_t i = 0; i < n / sizeof(ktrace_event_t); i++)
+      print_event(&buf[i]);
+  }
+
+  if (n < 0)
+    err(EXIT_FAILURE, "read");
+
+  return EXIT_SUCCESS;
+}
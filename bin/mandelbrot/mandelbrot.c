@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <sys/fb.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 
 #define WIDTH 640
 #define HEIGHT 480
@@ -13,7 +14,6 @@
 
 #define STR(x) #x
 
-static uint8_t image[WIDTH * HEIGHT];
 static uint8_t palette_buff[PALETTE_LEN * 3];
 
 static void prepare_videomode(int vgafd) {
@@ -45,8 +45,17 @@ static void prepare_palette(int vgafd) {
   ioctl(vgafd, FBIOCSET_PALETTE, &palette);
 }
 
+/* Returns hidden buffer, so the image can be drawn without flickering. */
+static uint8_t *map_framebuffer(int vgafd) {
+  uint8_t *fb = mmap(NULL, WIDTH * HEIGHT * FB_NBUFFERS,
+                     PROT_READ | PROT_WRITE, MAP_SHARED, vgafd, 0);
+  assert(fb != MAP_FAILED);
+  return fb + WIDTH * HEIGHT;
+}
+
 static void display_image(int vgafd) {
-  write(vgafd, image, WIDTH * HEIGHT);
+  uint32_t buffer = 1;
+  ioctl(vgafd, FBIOCFLIP, &buffer);
 }
 
 static int fun(float re, float im) {
@@ -72,6 +81,8 @@ int main(void) {
   prepare_videomode(vgafd);
   prepare_palette(vgafd);
 
+  uint8_t *image = map_framebuffer(vgafd);
+
   for (unsigned int y = 0; y < HEIGHT; y++) {
     for (unsigned int x = 0; x < WIDTH; x++) {
       float re = (x / (float)WIDTH) * 2.0f - 1.0f;
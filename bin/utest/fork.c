@@ -1,7 +1,13 @@
+#include "utest.h"
+#include "util.h"
+
 #include <assert.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <sched.h>
@@ -60,3 +66,52 @@ int test_fork_sigchld_ignored(void) {
   assert(wait(NULL) == -1);
   return 0;
 }
+
+#define COW_NPAGES 64
+#define COW_NFORKS 50
+
+int test_fork_cow(void) {
+  size_t pgsz = getpagesize();
+  size_t size = COW_NPAGES * pgsz;
+  char *buf =
+    mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+  assert(buf != (char *)MAP_FAILED);
+
+  for (int i = 0; i < COW_NPAGES; i++)
+    memset(buf + i * pgsz, i, pgsz);
+
+  timespec_t start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int n = 0; n < COW_NFORKS; n++) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+      /* Child touches a single page, the rest should remain shared. */
+      int i = n % COW_NPAGES;
+      assert(buf[i * pgsz] == i);
+      buf[i * pgsz] = -1;
+      exit(0);
+    }
+
+    /* Parent writes to one page while the child may still be running. */
+    int i = (n + 1) % COW_NPAGES;
+    buf[i * pgsz + 1] = i;
+    wait_for_child_exit(pid, 0);
+  }
+
+  long long usecs = elapsed_usecs(&start, NULL);
+
+  /* Writes of children must not be visible in the parent. */
+  for (int i = 0; i < COW_NPAGES; i++) {
+    assert(buf[i * pgsz] == i);
+    assert(buf[i * pgsz + pgsz - 1] == i);
+  }
+
+  printf("fork of %d page mapping took %lld us on average\n", COW_NPAGES,
+         usecs / COW_NFORKS);
+
+  assert(munmap(buf, size) == 0);
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include "utest.h"
+#include "util.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/futex.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+int test_futex_timedwait(void) {
+  static int word;
+  timespec_t timeout = {.tv_sec = 0, .tv_nsec = 10000000};
+
+  /* Word has different value than expected. */
+  assert(futex(&word, FUTEX_WAIT, 1, NULL) == -EAGAIN);
+
+  /* Nobody is going to wake us up. */
+  assert(futex(&word, FUTEX_WAIT, 0, &timeout) == -ETIMEDOUT);
+
+  assert(futex(&word, FUTEX_WAKE, 1, NULL) == 0);
+
+  /* Misaligned word. */
+  assert(futex((int *)((char *)&word + 1), FUTEX_WAKE, 1, NULL) == -EINVAL);
+  return 0;
+}
+
+int test_futex_shared(void) {
+  int *word = mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANON, -1, 0);
+  assert(word != MAP_FAILED);
+  *word = 0;
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    while (*word == 0)
+      futex(word, FUTEX_WAIT, 0, NULL);
+    exit(*word);
+  }
+
+  /* Child sleeps on the same word, though it's mapped by another process. */
+  while (futex(word, FUTEX_WAKE, 1, NULL) == 0)
+    sched_yield();
+
+  *word = 42;
+  assert(futex(word, FUTEX_WAKE, 1, NULL) >= 0);
+  wait_for_child_exit(pid, 42);
+
+  assert(munmap(word, getpagesize()) == 0);
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/kprof.h>
+#include <sys/time.h>
+
+#include "util.h"
+
+#define BUSY_MS 200
+
+int test_kprof(void) {
+  kprof_sample_t buf[16];
+  kprof_stat_t before, after;
+  timespec_t start, now, diff;
+  pid_t pid = getpid();
+  ssize_t n;
+  int mine = 0;
+
+  int fd = open("/dev/kprof", O_RDONLY);
+  assert(fd >= 0);
+
+  drain_fd(fd);
+
+  assert(ioctl(fd, KPROFIOC_GETSTAT, &before) == 0);
+  assert(ioctl(fd, KPROFIOC_START) == 0);
+
+  /* Keep the processor busy, partly in user mode and partly in the kernel. */
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    (void)getppid();
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    timespecsub(&now, &start, &diff);
+  } while (diff.tv_sec * 1000 + diff.tv_nsec / 1000000 < BUSY_MS);
+
+  assert(ioctl(fd, KPROFIOC_STOP) == 0);
+  assert(ioctl(fd, KPROFIOC_GETSTAT, &after) == 0);
+  assert(!after.kst_running);
+  assert(after.kst_samples > before.kst_samples);
+
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    assert(n % sizeof(kprof_sample_t) == 0);
+    for (size_t i = 0; i < n / sizeof(kprof_sample_t); i++) {
+      assert(buf[i].ks_depth <= KPROF_MAXDEPTH);
+      if (buf[i].ks_pid != (uint32_t)pid)
+        continue;
+      /* Samples of a user process always carry user program counter. */
+      assert(buf[i].ks_upc != 0);
+      mine++;
+    }
+  }
+  assert(n == 0);
+  assert(mine > 0);
+
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,217 @@
+#include "utest.h"
+#include "util.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const timespec_t zero_timeout = {.tv_sec = 0, .tv_nsec = 0};
+
+int test_kqueue_pipe(void) {
+  int kq = kqueue();
+  assert(kq >= 0);
+
+  int fds[2];
+  assert(pipe(fds) == 0);
+
+  struct kevent kev[2];
+  EV_SET(&kev[0], fds[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+  EV_SET(&kev[1], fds[1], EVFILT_WRITE, EV_ADD, 0, 0, NULL);
+  assert(kevent(kq, kev, 2, NULL, 0, NULL) == 0);
+
+  /* Only the write end is ready right now. */
+  struct kevent ev;
+  assert(kevent(kq, NULL, 0, &ev, 1, &zero_timeout) == 1);
+  assert(ev.ident == (uintptr_t)fds[1] && ev.filter == EVFILT_WRITE);
+  assert(ev.data > 0);
+
+  /* Disable write filter to see the read end only. */
+  EV_SET(&kev[0], fds[1], EVFILT_WRITE, EV_DISABLE, 0, 0, NULL);
+  assert(kevent(kq, kev, 1, NULL, 0, NULL) == 0);
+  assert(kevent(kq, NULL, 0, &ev, 1, &zero_timeout) == 0);
+
+  assert(write(fds[1], "hello", 5) == 5);
+  assert(kevent(kq, NULL, 0, &ev, 1, &zero_timeout) == 1);
+  assert(ev.ident == (uintptr_t)fds[0] && ev.filter == EVFILT_READ);
+  assert(ev.data == 5);
+
+  /* Closing the write end sets EOF, even though it's monitored by a knote,
+   * which goes away together with the descriptor. */
+  char buf[5];
+  assert(read(fds[0], buf, 5) == 5);
+  close(fds[1]);
+  assert(kevent(kq, NULL, 0, &ev, 1, &zero_timeout) == 1);
+  assert(ev.ident == (uintptr_t)fds[0] && (ev.flags & EV_EOF));
+  EV_SET(&kev[0], fds[1], EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+  assert(kevent(kq, kev, 1, NULL, 0, NULL) == -1);
+  assert(errno == ENOENT);
+
+  /* Deleting a knote that does not exist is an error. */
+  EV_SET(&kev[0], fds[0], EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+  assert(kevent(kq, kev, 1, NULL, 0, NULL) == -1);
+  assert(errno == ENOENT);
+
+  close(fds[0]);
+  close(kq);
+  return 0;
+}
+
+int test_kqueue_timer(void) {
+  int kq = kqueue();
+  assert(kq >= 0);
+
+  struct kevent kev, ev;
+  EV_SET(&kev, 1, EVFILT_TIMER, EV_ADD, 0, 10, NULL);
+  assert(kevent(kq, &kev, 1, NULL, 0, NULL) == 0);
+
+  timespec_t start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < 5; i++) {
+    assert(kevent(kq, NULL, 0, &ev, 1, NULL) == 1);
+    assert(ev.ident == 1 && ev.filter == EVFILT_TIMER);
+    assert(ev.data >= 1);
+  }
+  assert(elapsed_usecs(&start, NULL) >= 40 * 1000);
+
+  /* A one-shot timer is removed after it fires. */
+  EV_SET(&kev, 2, EVFILT_TIMER, EV_ADD | EV_ONESHOT, 0, 1, NULL);
+  EV_SET(&ev, 1, EVFILT_TIMER, EV_DELETE, 0, 0, NULL);
+  assert(kevent(kq, &ev, 1, NULL, 0, NULL) == 0);
+  assert(kevent(kq, &kev, 1, NULL, 0, NULL) == 0);
+  assert(kevent(kq, NULL, 0, &ev, 1, NULL) == 1);
+  assert(ev.ident == 2 && ev.filter == EVFILT_TIMER);
+
+  timespec_t timeout = {.tv_sec = 0, .tv_nsec = 20 * 1000000};
+  assert(kevent(kq, NULL, 0, &ev, 1, &timeout) == 0);
+
+  close(kq);
+  return 0;
+}
+
+int test_kqueue_proc(void) {
+  int kq = kqueue();
+  assert(kq >= 0);
+
+  int fds[2];
+  assert(pipe(fds) == 0);
+
+  pid_t pid = fork();
+  assert(pid >= 0);
+
+  if (pid == 0) {
+    /* Wait until parent registers the knote. */
+    char c;
+    close(fds[1]);
+    assert(read(fds[0], &c, 1) == 1);
+    exit(42);
+  }
+
+  close(fds[0]);
+
+  struct kevent kev, ev;
+  EV_SET(&kev, pid, EVFILT_PROC, EV_ADD, NOTE_EXIT, 0, NULL);
+  assert(kevent(kq, &kev, 1, NULL, 0, NULL) == 0);
+  assert(write(fds[1], "x", 1) == 1);
+
+  assert(kevent(kq, NULL, 0, &ev, 1, NULL) == 1);
+  assert(ev.ident == (uintptr_t)pid && ev.filter == EVFILT_PROC);
+  assert(ev.fflags & NOTE_EXIT);
+  assert(WIFEXITED(ev.data) && WEXITSTATUS(ev.data) == 42);
+
+  wait_for_child_exit(pid, 42);
+  close(fds[1]);
+  close(kq);
+  return 0;
+}
+
+int test_kqueue_signal(void) {
+  int kq = kqueue();
+  assert(kq >= 0);
+
+  /* Signals are counted even if they are ignored. */
+  signal(SIGUSR1, SIG_IGN);
+
+  struct kevent kev, ev;
+  EV_SET(&kev, SIGUSR1, EVFILT_SIGNAL, EV_ADD, 0, 0, NULL);
+  assert(kevent(kq, &kev, 1, NULL, 0, NULL) == 0);
+  assert(kevent(kq, NULL, 0, &ev, 1, &zero_timeout) == 0);
+
+  kill(getpid(), SIGUSR1);
+  kill(getpid(), SIGUSR1);
+
+  assert(kevent(kq, NULL, 0, &ev, 1, &zero_timeout) == 1);
+  assert(ev.ident == SIGUSR1 && ev.filter == EVFILT_SIGNAL);
+  assert(ev.data == 2);
+
+  /* The counter is reset after the event was reported. */
+  assert(kevent(kq, NULL, 0, &ev, 1, &zero_timeout) == 0);
+
+  signal(SIGUSR1, SIG_DFL);
+  close(kq);
+  return 0;
+}
+
+#define LATENCY_NROUNDS 1000
+
+/* Measure time between a write to a pipe and return from kevent in reader. */
+int test_kqueue_latency(void) {
+  int data[2], ack[2];
+  assert(pipe(data) == 0);
+  assert(pipe(ack) == 0);
+
+  pid_t pid = fork();
+  assert(pid >= 0);
+
+  if (pid == 0) {
+    close(data[0]);
+    close(ack[1]);
+    for (int i = 0; i < LATENCY_NROUNDS; i++) {
+      timespec_t now;
+      char c;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      assert(write(data[1], &now, sizeof(now)) == sizeof(now));
+      assert(read(ack[0], &c, 1) == 1);
+    }
+    exit(0);
+  }
+
+  close(data[1]);
+  close(ack[0]);
+
+  int kq = kqueue();
+  assert(kq >= 0);
+
+  struct kevent kev, ev;
+  EV_SET(&kev, data[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+  assert(kevent(kq, &kev, 1, NULL, 0, NULL) == 0);
+
+  long long total = 0, worst = 0;
+  for (int i = 0; i < LATENCY_NROUNDS; i++) {
+    timespec_t sent, now;
+    assert(kevent(kq, NULL, 0, &ev, 1, NULL) == 1);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    assert(ev.data >= (int64_t)sizeof(sent));
+    assert(read(data[0], &sent, sizeof(sent)) == sizeof(sent));
+    assert(write(ack[1], "x", 1) == 1);
+
+    long long usecs = elapsed_usecs(&sent, &now);
+    total += usecs;
+    if (usecs > worst)
+      worst = usecs;
+  }
+
+  printf("kevent wakeup latency: %lld us on average, %lld us at worst\n",
+         total / LATENCY_NROUNDS, worst);
+
+  wait_for_child_exit(pid, 0);
+  close(kq);
+  close(data[0]);
+  close(ack[1]);
+  return 0;
+}
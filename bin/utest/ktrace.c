@@ -0,0 +1,48 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/ktrace.h>
+#include <sys/syscall.h>
+
+#include "util.h"
+
+#define NCALLS 10
+
+int test_ktrace(void) {
+  ktrace_event_t buf[32];
+  unsigned mask, oldmask;
+  ssize_t n;
+  int enter = 0, leave = 0;
+
+  int fd = open("/dev/ktrace", O_RDONLY);
+  assert(fd >= 0);
+  assert(ioctl(fd, KTRACEIOC_GETMASK, &oldmask) == 0);
+
+  drain_fd(fd);
+
+  mask = KTR_MASK(KTR_SYSCALL_ENTER) | KTR_MASK(KTR_SYSCALL_EXIT);
+  assert(ioctl(fd, KTRACEIOC_SETMASK, &mask) == 0);
+  for (int i = 0; i < NCALLS; i++)
+    (void)getppid();
+  assert(ioctl(fd, KTRACEIOC_SETMASK, &oldmask) == 0);
+
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    assert(n % sizeof(ktrace_event_t) == 0);
+    for (size_t i = 0; i < n / sizeof(ktrace_event_t); i++) {
+      if (buf[i].ke_arg[0] != SYS_getppid)
+        continue;
+      if (buf[i].ke_type == KTR_SYSCALL_ENTER)
+        enter++;
+      if (buf[i].ke_type == KTR_SYSCALL_EXIT)
+        leave++;
+    }
+  }
+  assert(n == 0);
+
+  assert(enter >= NCALLS);
+  assert(leave >= NCALLS);
+
+  close(fd);
+  return 0;
+}
@@ -22,6 +22,11 @@ int main(int argc, char **argv) {
   CHECKRUN_TEST(munmap_sigsegv);
   CHECKRUN_TEST(mmap_prot_none);
   CHECKRUN_TEST(mmap_prot_read);
+  CHECKRUN_TEST(mmap_file_private);
+  CHECKRUN_TEST(mmap_file_shared);
+  CHECKRUN_TEST(mmap_file_self);
+  CHECKRUN_TEST(mmap_file_throughput);
+  CHECKRUN_TEST(mprotect);
   CHECKRUN_TEST(sbrk);
   CHECKRUN_TEST(sbrk_sigsegv);
   CHECKRUN_TEST(misbehave);
@@ -51,6 +56,7 @@ int main(int argc, char **argv) {
   CHECKRUN_TEST(fork_wait);
   CHECKRUN_TEST(fork_signal);
   CHECKRUN_TEST(fork_sigchld_ignored);
+  CHECKRUN_TEST(fork_cow);
   CHECKRUN_TEST(lseek_basic);
   CHECKRUN_TEST(lseek_errors);
   CHECKRUN_TEST(access_basic);
@@ -85,6 +91,7 @@ int main(int argc, char **argv) {
   CHECKRUN_TEST(vfs_symlink);
   CHECKRUN_TEST(vfs_link);
   CHECKRUN_TEST(vfs_chmod);
+  CHECKRUN_TEST(vfs_bigdir);
   CHECKRUN_TEST(wait_basic);
   CHECKRUN_TEST(wait_nohang);
 
@@ -126,8 +133,25 @@ int main(int argc, char **argv) {
 
   CHECKRUN_TEST(procstat);
 
+  CHECKRUN_TEST(ktrace);
+  CHECKRUN_TEST(kprof);
+
   CHECKRUN_TEST(pipe_parent_signaled);
   CHECKRUN_TEST(pipe_child_signaled);
+  CHECKRUN_TEST(pipe_throughput);
+
+  CHECKRUN_TEST(kqueue_pipe);
+  CHECKRUN_TEST(kqueue_timer);
+  CHECKRUN_TEST(kqueue_proc);
+  CHECKRUN_TEST(kqueue_signal);
+  CHECKRUN_TEST(kqueue_latency);
+
+  CHECKRUN_TEST(pthread_mutex);
+  CHECKRUN_TEST(pthread_cond);
+  CHECKRUN_TEST(pthread_exit);
+
+  CHECKRUN_TEST(futex_timedwait);
+  CHECKRUN_TEST(futex_shared);
 
   printf("No user test \"%s\" available.\n", test_name);
   return 1;
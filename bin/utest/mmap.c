@@ -2,6 +2,7 @@
 #include "util.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -11,6 +12,8 @@
 #include <setjmp.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
 
 #ifdef __mips__
 #define BAD_ADDR_SPAN 0x7fff0000
@@ -68,6 +71,10 @@ static void mmap_bad(void) {
   addr = mmap_anon_prw((void *)0x12345678, 0x1000);
   assert(addr == MAP_FAILED);
   assert(errno == EINVAL);
+  /* Protection has unknown bits set. */
+  addr = mmap(NULL, 0x1000, PROT_READ | 0x8, MAP_ANON | MAP_PRIVATE, -1, 0);
+  assert(addr == MAP_FAILED);
+  assert(errno == EINVAL);
 }
 
 static void munmap_good(void) {
@@ -211,3 +218,291 @@ int test_mmap_prot_read(void) {
 
   return 0;
 }
+
+#define FILE_PATH "/tmp/mmap-file"
+#define FILE_NPAGES 4
+
+/* Creates a file of `size` bytes filled with a simple pattern. */
+static int make_file(size_t size, int flags) {
+  int fd = open(FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  assert(fd >= 0);
+
+  unsigned char *buf = malloc(size);
+  for (size_t i = 0; i < size; i++)
+    buf[i] = i % 251;
+  assert(write(fd, buf, size) == (ssize_t)size);
+  free(buf);
+
+  close(fd);
+  fd = open(FILE_PATH, flags);
+  assert(fd >= 0);
+  return fd;
+}
+
+/* Reads `size` bytes at `pos` of `fd` into a newly allocated buffer. */
+static unsigned char *read_file(int fd, off_t pos, size_t size) {
+  unsigned char *buf = malloc(size);
+  assert(lseek(fd, pos, SEEK_SET) == pos);
+  assert(read(fd, buf, size) == (ssize_t)size);
+  return buf;
+}
+
+int test_mmap_file_private(void) {
+  size_t pgsz = getpagesize();
+  size_t size = FILE_NPAGES * pgsz + 123;
+  int fd = make_file(size, O_RDONLY);
+
+  /* Offset must be page aligned. */
+  void *addr = mmap(NULL, pgsz, PROT_READ, MAP_PRIVATE, fd, 1);
+  assert(addr == MAP_FAILED);
+  assert(errno == EINVAL);
+
+  /* Read-only file can still be modified privately. */
+  unsigned char *map =
+    mmap(NULL, size - pgsz, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, pgsz);
+  assert(map != MAP_FAILED);
+
+  for (size_t i = 0; i < size - pgsz; i++)
+    assert(map[i] == (pgsz + i) % 251);
+  /* Rest of the last page reads as zeros. */
+  assert(map[size - pgsz] == 0);
+
+  memset(map, 0, pgsz);
+  unsigned char *buf = read_file(fd, pgsz, pgsz);
+  for (size_t i = 0; i < pgsz; i++)
+    assert(buf[i] == (pgsz + i) % 251);
+  free(buf);
+
+  assert(munmap(map, size - pgsz) == 0);
+  close(fd);
+  unlink(FILE_PATH);
+
+  /* Files of initial ramdisk can be mapped as well. */
+  fd = open("/bin/utest", O_RDONLY);
+  assert(fd >= 0);
+  map = mmap(NULL, FILE_NPAGES * pgsz, PROT_READ, MAP_PRIVATE, fd, 0);
+  assert(map != MAP_FAILED);
+  buf = read_file(fd, 0, FILE_NPAGES * pgsz);
+  assert(memcmp(map, buf, FILE_NPAGES * pgsz) == 0);
+  free(buf);
+  assert(munmap(map, FILE_NPAGES * pgsz) == 0);
+  close(fd);
+
+  return 0;
+}
+
+int test_mmap_file_shared(void) {
+  size_t pgsz = getpagesize();
+  size_t size = FILE_NPAGES * pgsz;
+  int fd = make_file(size, O_RDONLY);
+
+  /* Shared writable mapping requires file opened for writing. */
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  assert(addr == MAP_FAILED);
+  assert(errno == EACCES);
+  close(fd);
+
+  /* Pipes cannot be mapped. */
+  int fds[2];
+  assert(pipe(fds) == 0);
+  addr = mmap(NULL, pgsz, PROT_READ, MAP_SHARED, fds[0], 0);
+  assert(addr == MAP_FAILED);
+  assert(errno == ENODEV);
+  close(fds[0]);
+  close(fds[1]);
+
+  fd = open(FILE_PATH, O_RDWR);
+  assert(fd >= 0);
+  char *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  assert(map != MAP_FAILED);
+
+  /* Modifications made through the mapping are visible to read. */
+  strcpy(map + pgsz, "parent");
+  char *buf = (char *)read_file(fd, pgsz, 7);
+  assert(strcmp(buf, "parent") == 0);
+  free(buf);
+
+  /* ... including those made by other processes. */
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    strcpy(map + 2 * pgsz, "child");
+    exit(0);
+  }
+  wait_for_child_exit(pid, 0);
+  buf = (char *)read_file(fd, 2 * pgsz, 6);
+  assert(strcmp(buf, "child") == 0);
+  free(buf);
+
+  /* Writes to the file are visible through the mapping. */
+  assert(lseek(fd, 3 * pgsz, SEEK_SET) == (off_t)(3 * pgsz));
+  assert(write(fd, "write", 6) == 6);
+  assert(strcmp(map + 3 * pgsz, "write") == 0);
+
+  /* Modifications are written back when the mapping goes away. */
+  strcpy(map, "unmapped");
+  assert(munmap(map, size) == 0);
+  close(fd);
+
+  fd = open(FILE_PATH, O_RDONLY);
+  assert(fd >= 0);
+  buf = (char *)read_file(fd, 0, 9);
+  assert(strcmp(buf, "unmapped") == 0);
+  free(buf);
+  close(fd);
+  unlink(FILE_PATH);
+
+  return 0;
+}
+
+/* Transfers data between a file and its own mapping, which is not faulted in
+ * yet, so the pager has to read pages of the file that is being accessed. */
+int test_mmap_file_self(void) {
+  size_t pgsz = getpagesize();
+  size_t size = FILE_NPAGES * pgsz;
+  int fd = make_file(size, O_RDWR);
+
+  unsigned char *map =
+    mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  assert(map != MAP_FAILED);
+
+  /* Read first two pages of the file into its pages 1 and 2. */
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  assert(read(fd, map + pgsz, 2 * pgsz) == (ssize_t)(2 * pgsz));
+  for (size_t i = 0; i < 2 * pgsz; i++)
+    assert(map[pgsz + i] == i % 251);
+  assert(munmap(map, size) == 0);
+
+  /* Write the last page of the file from a fresh mapping of its first one. */
+  map = mmap(NULL, pgsz, PROT_READ, MAP_SHARED, fd, 0);
+  assert(map != MAP_FAILED);
+  assert(lseek(fd, 3 * pgsz, SEEK_SET) == (off_t)(3 * pgsz));
+  assert(write(fd, map, pgsz) == (ssize_t)pgsz);
+  assert(munmap(map, pgsz) == 0);
+
+  unsigned char *buf = read_file(fd, 3 * pgsz, pgsz);
+  for (size_t i = 0; i < pgsz; i++)
+    assert(buf[i] == i % 251);
+  free(buf);
+
+  /* Private mappings are paged in from the file as well. */
+  map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  assert(map != MAP_FAILED);
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  assert(read(fd, map + 2 * pgsz, pgsz) == (ssize_t)pgsz);
+  for (size_t i = 0; i < pgsz; i++)
+    assert(map[2 * pgsz + i] == i % 251);
+  assert(munmap(map, size) == 0);
+
+  close(fd);
+  unlink(FILE_PATH);
+  return 0;
+}
+
+#define SCAN_SIZE (1024 * 1024)
+#define SCAN_CHUNK (16 * 1024)
+
+/* Compares scanning a file read into a buffer with scanning its mapping. */
+int test_mmap_file_throughput(void) {
+  int fd = make_file(SCAN_SIZE, O_RDONLY);
+  timespec_t start;
+  unsigned read_sum = 0, mmap_sum = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  unsigned char *buf = malloc(SCAN_CHUNK);
+  for (size_t off = 0; off < SCAN_SIZE; off += SCAN_CHUNK) {
+    assert(read(fd, buf, SCAN_CHUNK) == SCAN_CHUNK);
+    for (size_t i = 0; i < SCAN_CHUNK; i++)
+      read_sum += buf[i];
+  }
+  free(buf);
+  long long read_usecs = elapsed_usecs(&start, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  unsigned char *map = mmap(NULL, SCAN_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  assert(map != MAP_FAILED);
+  for (size_t i = 0; i < SCAN_SIZE; i++)
+    mmap_sum += map[i];
+  assert(munmap(map, SCAN_SIZE) == 0);
+  long long mmap_usecs = elapsed_usecs(&start, NULL);
+
+  assert(read_sum == mmap_sum);
+
+  printf("read+scan throughput: %lld KiB/s\n",
+         SCAN_SIZE * 1000000LL / 1024 / read_usecs);
+  printf("mmap+scan throughput: %lld KiB/s\n",
+         SCAN_SIZE * 1000000LL / 1024 / mmap_usecs);
+
+  close(fd);
+  unlink(FILE_PATH);
+  return 0;
+}
+
+int test_mprotect(void) {
+  signal(SIGSEGV, sigsegv_handler);
+
+  size_t pgsz = getpagesize();
+  size_t size = pgsz * NPAGES;
+  volatile uint8_t *addr = mmap_anon_priv(NULL, size, PROT_READ | PROT_WRITE);
+  assert(addr != MAP_FAILED);
+
+  for (int i = 0; i < NPAGES; i++)
+    addr[i * pgsz] = i;
+
+  /* Write-protect pages in the middle, which splits the mapping. */
+  assert(mprotect((void *)addr + 2 * pgsz, 4 * pgsz, PROT_READ) == 0);
+
+  sigsegv_handled = 0;
+
+  for (int i = 0; i < NPAGES; i++) {
+    volatile uint8_t *ptr = addr + i * pgsz;
+    if (sigsetjmp(return_to, 1) == 0) {
+      *ptr = 42;
+    }
+    assert(*ptr == ((i >= 2 && i < 6) ? i : 42));
+  }
+
+  assert(sigsegv_handled == 4);
+
+  /* Write access is granted back with contents preserved. */
+  assert(mprotect((void *)addr, size, PROT_READ | PROT_WRITE) == 0);
+  for (int i = 0; i < NPAGES; i++) {
+    addr[i * pgsz + 1] = i;
+    assert(addr[i * pgsz] == ((i >= 2 && i < 6) ? i : 42));
+  }
+
+  /* No access at all. */
+  assert(mprotect((void *)addr, size, PROT_NONE) == 0);
+
+  sigsegv_handled = 0;
+
+  for (int i = 0; i < NPAGES; i++) {
+    volatile uint8_t *ptr = addr + i * pgsz;
+    if (sigsetjmp(return_to, 1) == 0) {
+      assert(*ptr == 0);
+    }
+  }
+
+  assert(sigsegv_handled == NPAGES);
+
+  /* restore original behavior */
+  signal(SIGSEGV, SIG_DFL);
+
+  /* Range must be entirely mapped. */
+  assert(munmap((void *)addr + pgsz, pgsz) == 0);
+  assert(mprotect((void *)addr, size, PROT_READ) == -1);
+  assert(errno == ENOMEM);
+  assert(munmap((void *)addr, size) == 0);
+
+  /* Shared mapping of read-only file cannot be made writable. */
+  int fd = make_file(pgsz, O_RDONLY);
+  void *map = mmap(NULL, pgsz, PROT_READ, MAP_SHARED, fd, 0);
+  assert(map != MAP_FAILED);
+  assert(mprotect(map, pgsz, PROT_READ | PROT_WRITE) == -1);
+  assert(errno == EACCES);
+  assert(munmap(map, pgsz) == 0);
+  close(fd);
+  unlink(FILE_PATH);
+
+  return 0;
+}
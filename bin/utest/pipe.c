@@ -7,6 +7,7 @@
 #include <signal.h>
 #include <string.h>
 
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -104,3 +105,78 @@ int test_pipe_child_signaled(void) {
 
   return 0;
 }
+
+#define THROUGHPUT_TOTAL (4 << 20)
+#define THROUGHPUT_BUFSIZE (64 << 10)
+
+/* Reads byte counters of the page loan and ring buffer paths of pipes. */
+static void pipe_stats(unsigned *lent, unsigned *copied) {
+  FILE *f = fopen("/dev/pipestat", "r");
+  assert(f != NULL);
+  assert(fscanf(f, "lent %u copied %u", lent, copied) == 2);
+  fclose(f);
+}
+
+/* Sends THROUGHPUT_TOTAL bytes in chunks of `chunk` bytes through a pipe and
+ * reports the rate. Large chunks are transferred from writer's pages directly,
+ * small ones go through the pipe buffer. */
+static void pipe_throughput(size_t chunk) {
+  unsigned lent0, copied0, lent1, copied1;
+  int fds[2];
+  assert(THROUGHPUT_BUFSIZE % chunk == 0);
+  assert(pipe(fds) == 0);
+  pipe_stats(&lent0, &copied0);
+
+  pid_t pid = fork();
+  assert(pid >= 0);
+
+  if (pid == 0) {
+    close(fds[0]);
+    unsigned char *buf = malloc(THROUGHPUT_BUFSIZE);
+    for (size_t i = 0; i < THROUGHPUT_BUFSIZE; i++)
+      buf[i] = i % 251;
+    for (size_t sent = 0; sent < THROUGHPUT_TOTAL; sent += chunk) {
+      size_t off = sent % THROUGHPUT_BUFSIZE;
+      assert(write(fds[1], buf + off, chunk) == (ssize_t)chunk);
+    }
+    exit(0);
+  }
+
+  close(fds[1]);
+  unsigned char *buf = malloc(THROUGHPUT_BUFSIZE);
+  size_t received = 0;
+  ssize_t n;
+
+  timespec_t start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while ((n = read(fds[0], buf, THROUGHPUT_BUFSIZE)) > 0) {
+    for (ssize_t i = 0; i < n; i++)
+      assert(buf[i] == (received + i) % THROUGHPUT_BUFSIZE % 251);
+    received += n;
+  }
+  long long usecs = elapsed_usecs(&start, NULL);
+
+  assert(n == 0);
+  assert(received == THROUGHPUT_TOTAL);
+
+  printf("pipe throughput with %zu byte writes: %lld KiB/s\n", chunk,
+         (long long)THROUGHPUT_TOTAL * 1000000LL / 1024 / usecs);
+
+  wait_for_child_exit(pid, 0);
+  close(fds[0]);
+  free(buf);
+
+  /* Large writes must be lent, save for the unaligned head or tail of each
+   * chunk, while small ones must go through the ring buffer. */
+  pipe_stats(&lent1, &copied1);
+  if (chunk >= THROUGHPUT_BUFSIZE)
+    assert(lent1 - lent0 >= THROUGHPUT_TOTAL / 2);
+  else
+    assert(copied1 - copied0 >= THROUGHPUT_TOTAL);
+}
+
+int test_pipe_throughput(void) {
+  pipe_throughput(512);
+  pipe_throughput(THROUGHPUT_BUFSIZE);
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "utest.h"
+
+#define NTHREADS 4
+
+/* ======= pthread_mutex ======= */
+#define NINCREMENTS 1000
+
+static pthread_mutex_t counter_mtx = PTHREAD_MUTEX_INITIALIZER;
+static volatile int counter;
+
+static void *counter_routine(void *arg) {
+  for (int i = 0; i < NINCREMENTS; i++) {
+    pthread_mutex_lock(&counter_mtx);
+    int v = counter;
+    /* Let other threads try to get in. */
+    if (i % 64 == 0)
+      sched_yield();
+    counter = v + 1;
+    pthread_mutex_unlock(&counter_mtx);
+  }
+  return arg;
+}
+
+int test_pthread_mutex(void) {
+  pthread_t td[NTHREADS];
+
+  for (long i = 0; i < NTHREADS; i++)
+    assert(pthread_create(&td[i], NULL, counter_routine, (void *)i) == 0);
+
+  for (long i = 0; i < NTHREADS; i++) {
+    void *retval;
+    assert(pthread_join(td[i], &retval) == 0);
+    assert(retval == (void *)i);
+  }
+
+  assert(counter == NTHREADS * NINCREMENTS);
+  return 0;
+}
+
+/* ======= pthread_cond ======= */
+#define NITEMS 500
+#define QUEUE_SIZE 8
+
+static pthread_mutex_t queue_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_nonempty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_nonfull = PTHREAD_COND_INITIALIZER;
+static int queue[QUEUE_SIZE];
+static unsigned queue_head, queue_tail;
+
+static void *producer_routine(void *arg) {
+  for (int i = 1; i <= NITEMS; i++) {
+    pthread_mutex_lock(&queue_mtx);
+    while (queue_tail - queue_head == QUEUE_SIZE)
+      pthread_cond_wait(&queue_nonfull, &queue_mtx);
+    queue[queue_tail++ % QUEUE_SIZE] = i;
+    pthread_cond_signal(&queue_nonempty);
+    pthread_mutex_unlock(&queue_mtx);
+  }
+  return NULL;
+}
+
+static void *consumer_routine(void *arg) {
+  long sum = 0;
+  for (int i = 0; i < NITEMS; i++) {
+    pthread_mutex_lock(&queue_mtx);
+    while (queue_tail == queue_head)
+      pthread_cond_wait(&queue_nonempty, &queue_mtx);
+    sum += queue[queue_head++ % QUEUE_SIZE];
+    pthread_cond_signal(&queue_nonfull);
+    pthread_mutex_unlock(&queue_mtx);
+  }
+  return (void *)sum;
+}
+
+int test_pthread_cond(void) {
+  pthread_t producer, consumer;
+  void *sum;
+
+  assert(pthread_create(&consumer, NULL, consumer_routine, NULL) == 0);
+  assert(pthread_create(&producer, NULL, producer_routine, NULL) == 0);
+  assert(pthread_join(producer, NULL) == 0);
+  assert(pthread_join(consumer, &sum) == 0);
+  assert((long)sum == NITEMS * (NITEMS + 1) / 2);
+
+  /* Nobody is going to signal the condition. */
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_nsec += 10000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  pthread_mutex_lock(&queue_mtx);
+  int error = pthread_cond_timedwait(&queue_nonempty, &queue_mtx, &ts);
+  assert(error == ETIMEDOUT);
+  pthread_mutex_unlock(&queue_mtx);
+  return 0;
+}
+
+/* ======= pthread_exit ======= */
+static int exit_pipe[2];
+
+static void *spinner_routine(void *arg) {
+  for (;;)
+    sched_yield();
+  return NULL;
+}
+
+static void *sleeper_routine(void *arg) {
+  char c;
+  /* Never returns, as nobody writes to the pipe. */
+  read(exit_pipe[0], &c, 1);
+  return NULL;
+}
+
+static void *last_routine(void *arg) {
+  sched_yield();
+  write(exit_pipe[1], "x", 1);
+  return NULL;
+}
+
+int test_pthread_exit(void) {
+  int status;
+  pthread_t td;
+  char c;
+
+  /* Process exits even though some of its threads are running or sleeping. */
+  assert(pipe(exit_pipe) == 0);
+  pid_t pid = fork();
+  if (pid == 0) {
+    for (int i = 0; i < NTHREADS; i++) {
+      void *(*fn)(void *) = (i & 1) ? sleeper_routine : spinner_routine;
+      assert(pthread_create(&td, NULL, fn, NULL) == 0);
+    }
+    sched_yield();
+    exit(42);
+  }
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 42);
+
+  /* Process keeps running after the main thread is gone. */
+  pid = fork();
+  if (pid == 0) {
+    assert(pthread_create(&td, NULL, last_routine, NULL) == 0);
+    pthread_exit(NULL);
+  }
+  assert(read(exit_pipe[0], &c, 1) == 1);
+  assert(waitpid(pid, &status, 0) == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  close(exit_pipe[0]);
+  close(exit_pipe[1]);
+  return 0;
+}
@@ -12,6 +12,11 @@ int test_munmap(void);
 int test_munmap_sigsegv(void);
 int test_mmap_prot_none(void);
 int test_mmap_prot_read(void);
+int test_mmap_file_private(void);
+int test_mmap_file_shared(void);
+int test_mmap_file_self(void);
+int test_mmap_file_throughput(void);
+int test_mprotect(void);
 int test_sbrk(void);
 int test_sbrk_sigsegv(void);
 int test_misbehave(void);
@@ -44,6 +49,7 @@ int test_signal_handler_mask(void);
 int test_fork_wait(void);
 int test_fork_signal(void);
 int test_fork_sigchld_ignored(void);
+int test_fork_cow(void);
 
 int test_lseek_basic(void);
 int test_lseek_errors(void);
@@ -87,6 +93,7 @@ int test_vfs_trunc(void);
 int test_vfs_symlink(void);
 int test_vfs_link(void);
 int test_vfs_chmod(void);
+int test_vfs_bigdir(void);
 
 int test_wait_basic(void);
 int test_wait_nohang(void);
@@ -120,7 +127,25 @@ int test_tty_signals(void);
 
 int test_procstat(void);
 
+int test_ktrace(void);
+
+int test_kprof(void);
+
 int test_pipe_parent_signaled(void);
 int test_pipe_child_signaled(void);
+int test_pipe_throughput(void);
+
+int test_kqueue_pipe(void);
+int test_kqueue_timer(void);
+int test_kqueue_proc(void);
+int test_kqueue_signal(void);
+int test_kqueue_latency(void);
+
+int test_pthread_mutex(void);
+int test_pthread_cond(void);
+int test_pthread_exit(void);
+
+int test_futex_timedwait(void);
+int test_futex_shared(void);
 
 #endif /* __UTEST_H__ */
@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <sys/wait.h>
 #include <sys/fcntl.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 void wait_for_child_exit(int pid, int exit_code) {
   int status;
@@ -12,6 +15,25 @@ void wait_for_child_exit(int pid, int exit_code) {
   assert(WEXITSTATUS(status) == exit_code);
 }
 
+long long elapsed_usecs(const timespec_t *start, const timespec_t *end) {
+  timespec_t now, diff;
+  if (end == NULL) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    end = &now;
+  }
+  timespecsub(end, start, &diff);
+  long long usecs = diff.tv_sec * 1000000LL + diff.tv_nsec / 1000;
+  return usecs ? usecs : 1;
+}
+
+void drain_fd(int fd) {
+  char buf[1024];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    continue;
+  assert(n == 0);
+}
+
 static void noop_handler(int signo) {
 }
 
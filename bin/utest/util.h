@@ -1,4 +1,6 @@
 
+#include <sys/time.h>
+
 /* Wait for a single child process with process id `pid` to exit,
  * and check that its exit code matches the expected value. */
 void wait_for_child_exit(int pid, int exit_code);
@@ -11,6 +13,16 @@ void signal_setup(int signo);
 /* Wait for the delivery of a signal. */
 void wait_for_signal(int signo);
 
+/* Returns number of microseconds between CLOCK_MONOTONIC readings `start` and
+ * `end`, or between `start` and now if `end` is NULL. The result is at least
+ * one, so that rates can be computed by dividing by it. */
+long long elapsed_usecs(const timespec_t *start, const timespec_t *end);
+
+/* Read and discard all data that is available from `fd`, e.g. left in a
+ * kernel buffer by previous users of a device. Device records must not be
+ * larger than 1KiB. */
+void drain_fd(int fd);
+
 /* Create a new pseudoterminal and return file descriptors to the master and
  * slave side. */
 void open_pty(int *master_fd, int *slave_fd);
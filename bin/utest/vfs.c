@@ -1,6 +1,9 @@
 #include "utest.h"
+#include "util.h"
 
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -396,3 +399,65 @@ int test_vfs_chmod(void) {
 
   return 0;
 }
+
+#define BIGDIR TESTDIR "/bigdir"
+#define BIGDIR_NFILES 50000
+
+static void bigdir_path(char *buf, size_t len, int i) {
+  snprintf(buf, len, BIGDIR "/f%05d", i);
+}
+
+static void report_rate(const char *what, timespec_t *start) {
+  long long usecs = elapsed_usecs(start, NULL);
+  printf("%s: %lld ops/sec\n", what, BIGDIR_NFILES * 1000000LL / usecs);
+}
+
+int test_vfs_bigdir(void) {
+  char path[64];
+  timespec_t start;
+  struct stat sb;
+
+  assert_ok(mkdir(BIGDIR, 0));
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < BIGDIR_NFILES; i++) {
+    bigdir_path(path, sizeof(path), i);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0);
+    assert(fd >= 0);
+    assert_ok(close(fd));
+  }
+  report_rate("create", &start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < BIGDIR_NFILES; i++) {
+    bigdir_path(path, sizeof(path), i);
+    assert_ok(stat(path, &sb));
+  }
+  report_rate("lookup", &start);
+
+  /* Entries must be listed in order of creation. */
+  DIR *dirp = opendir(BIGDIR);
+  assert(dirp != NULL);
+  struct dirent *dp;
+  int n = 0;
+  while ((dp = readdir(dirp))) {
+    if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
+      continue;
+    bigdir_path(path, sizeof(path), n++);
+    assert(!strcmp(dp->d_name, strrchr(path, '/') + 1));
+  }
+  assert(n == BIGDIR_NFILES);
+  closedir(dirp);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < BIGDIR_NFILES; i++) {
+    bigdir_path(path, sizeof(path), i);
+    assert_ok(unlink(path));
+  }
+  report_rate("unlink", &start);
+
+  bigdir_path(path, sizeof(path), 0);
+  assert_fail(stat(path, &sb), ENOENT);
+  assert_ok(rmdir(BIGDIR));
+  return 0;
+}
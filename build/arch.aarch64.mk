@@ -20,6 +20,8 @@ CPPFLAGS += -DSTRICT_ALIGNMENT=1
 
 ifeq ($(KERNEL), 1)
 	CFLAGS += -mcpu=cortex-a53+nofp -march=armv8-a+nofp -mgeneral-regs-only
+	# Frame records are used to unwind kernel stack (see ctx_backtrace).
+	CFLAGS += -fno-omit-frame-pointer
 	ifeq ($(KASAN), 1)
 	# Added to files that are sanitized
 	CFLAGS_KASAN = -fsanitize=kernel-address \
@@ -9,6 +9,7 @@ include $(TOPDIR)/build/flags.mk
 CFLAGS   += -fno-builtin -nostdinc -nostdlib -ffreestanding
 CPPFLAGS += -I$(TOPDIR)/include -D_KERNEL
 CPPFLAGS += -DLOCKDEP=$(LOCKDEP) -DKASAN=$(KASAN) -DKGPROF=$(KGPROF) -DKCSAN=$(KCSAN)
+CPPFLAGS += -DLOCKPROF=$(LOCKPROF) -DSMP=$(SMP)
 LDFLAGS  += -nostdlib
 
 ifeq ($(KCSAN), 1)
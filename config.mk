@@ -4,7 +4,7 @@
 # build system for given platform.
 #
 
-CONFIG_OPTS := KASAN LOCKDEP KGPROF MIPS AARCH64 KCSAN
+CONFIG_OPTS := KASAN LOCKDEP LOCKPROF KGPROF MIPS AARCH64 KCSAN SMP
 
 BOARD ?= malta
 
@@ -24,6 +24,8 @@ endif
 VERBOSE ?= 0
 CLANG ?= 0
 LOCKDEP ?= 0
+LOCKPROF ?= 0
 KASAN ?= 0
 KGPROF ?= 0
 KCSAN ?= 0
+SMP ?= 0
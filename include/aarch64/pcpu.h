@@ -4,4 +4,16 @@
 #define PCPU_MD_FIELDS                                                         \
   struct {}
 
+#ifndef __ASSEMBLER__
+
+/* Each processor keeps the address of its `pcpu_t` in TPIDR_EL1. */
+#define _PCPU_SELF()                                                           \
+  ({                                                                           \
+    struct pcpu *__pc;                                                         \
+    __asm__ volatile("mrs %0, tpidr_el1" : "=r"(__pc));                        \
+    __pc;                                                                      \
+  })
+
+#endif /* !__ASSEMBLER__ */
+
 #endif /* !_AARCH64_PCPU_H_ */
@@ -23,13 +23,12 @@ typedef struct pmap pmap_t;
 
 #define PHYS_TO_DMAP(x) ((uintptr_t)(x) + DMAP_BASE)
 
-#define DMAP_L3_ENTRIES max(1, DMAP_SIZE / PAGESIZE)
-#define DMAP_L2_ENTRIES max(1, DMAP_L3_ENTRIES / PT_ENTRIES)
+/* Direct map is built of level 2 blocks (2MB each). */
+#define DMAP_L2_ENTRIES max(1, DMAP_SIZE / L2_SIZE)
 #define DMAP_L1_ENTRIES max(1, DMAP_L2_ENTRIES / PT_ENTRIES)
 
 #define DMAP_L1_SIZE roundup(DMAP_L1_ENTRIES * sizeof(pde_t), PAGESIZE)
 #define DMAP_L2_SIZE roundup(DMAP_L2_ENTRIES * sizeof(pde_t), PAGESIZE)
-#define DMAP_L3_SIZE roundup(DMAP_L3_ENTRIES * sizeof(pte_t), PAGESIZE)
 
 #define PA_MASK 0xfffffffff000
 #define PTE_FRAME_ADDR(pte) ((pte)&PA_MASK)
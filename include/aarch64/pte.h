@@ -75,6 +75,9 @@ typedef uint64_t pde_t;
 #define ATTR_NORMAL_MEM_WB 2
 #define ATTR_NORMAL_MEM_WT 3
 
+/* Descriptor type (bits 1:0) tells blocks apart from tables and pages */
+#define ATTR_DESCR_MASK 3
+
 #define ATTR_S2_S2AP_MASK (3 << 6)
 #define ATTR_S2_S2AP_READ (1 << 6)
 #define ATTR_S2_S2AP_WRITE (2 << 6)
@@ -0,0 +1,22 @@
+#ifndef _LWP_H_
+#define _LWP_H_
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*
+ * Light-weight processes are kernel threads of a single user process.
+ * These are meant to be used only by thread libraries, e.g. libpthread.
+ *
+ * _lwp_create and _lwp_wait return an error number instead of setting errno,
+ * which is shared by all threads of the process.
+ */
+
+__BEGIN_DECLS
+int _lwp_create(void (*)(void *), void *, void *, tid_t *);
+__noreturn void _lwp_exit(void);
+int _lwp_wait(tid_t, tid_t *);
+tid_t _lwp_self(void);
+__END_DECLS
+
+#endif /* !_LWP_H_ */
@@ -9,6 +9,9 @@
     register_t status, sp, cause, epc, badvaddr;                               \
   }
 
+/* Secondary processors are not supported, so there's only one `pcpu_t`. */
+#define _PCPU_SELF() (&_pcpu_data[0])
+
 #ifdef _MACHDEP
 #ifdef __ASSEMBLER__
 
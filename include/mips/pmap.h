@@ -22,6 +22,14 @@ typedef uint32_t pde_t;
 #define PDE_INDEX_MASK 0xffc00000
 #define PDE_INDEX_SHIFT 22
 
+/* Page directory entry of a superpage maps whole 4MiB aligned frame instead
+ * of pointing to a page table. It has the same format as PTE except the mark.
+ * TLB refill handler loads half of the superpage at once, as pair of 1MiB
+ * pages, hence PageMask that covers 256 pages. */
+#define PDE_SUPERPAGE_SHIFT 28
+#define PDE_SUPERPAGE (1 << PDE_SUPERPAGE_SHIFT)
+#define SUPERPAGE_PAGEMASK 0x001fe000
+
 #define PTE_INDEX(x) ((((vaddr_t)(x)) & PTE_INDEX_MASK) >> PTE_INDEX_SHIFT)
 #define PDE_INDEX(x) ((((vaddr_t)(x)) & PDE_INDEX_MASK) >> PDE_INDEX_SHIFT)
 
@@ -78,11 +78,13 @@ void init_mips_tlb(void);
 
 /*
  * Note that MIPS implements variable page size by specifying PageMask register,
- * so intuitively these functions shall specify PageMask. However in current
- * implementation we aren't going to use other page size than 4KiB.
+ * so intuitively these functions shall specify PageMask. However only TLB
+ * refill handler inserts larger pages (halves of superpages), and these
+ * functions always write entries of 4KiB pages.
  */
 
-/* Probes the TLB for an entry matching hi, and if present invalidates it. */
+/* Probes the TLB for an entry matching hi, and if present invalidates it.
+ * Probe matches superpage entries that cover hi as well. */
 void tlb_invalidate(tlbhi_t hi);
 
 /* Invalidate all TLB entries with given ASID (save wired). */
@@ -0,0 +1,86 @@
+#ifndef _PTHREAD_H_
+#define _PTHREAD_H_
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+#include <sys/sigtypes.h>
+#include <time.h>
+
+typedef struct __pthread_st *pthread_t;
+
+typedef struct {
+  size_t pta_stacksize;
+  int pta_detachstate;
+} pthread_attr_t;
+
+typedef struct {
+  volatile unsigned int ptm_lock;
+} pthread_mutex_t;
+
+typedef struct {
+  int ptma_type;
+} pthread_mutexattr_t;
+
+typedef struct {
+  volatile unsigned int ptc_seq;
+} pthread_cond_t;
+
+typedef struct {
+  int ptca_clock;
+} pthread_condattr_t;
+
+typedef struct {
+  volatile unsigned int pto_done;
+  pthread_mutex_t pto_mutex;
+} pthread_once_t;
+
+#define PTHREAD_CREATE_JOINABLE 0
+#define PTHREAD_CREATE_DETACHED 1
+
+#define PTHREAD_STACK_MIN 16384
+
+#define PTHREAD_MUTEX_INITIALIZER                                              \
+  { 0 }
+#define PTHREAD_COND_INITIALIZER                                               \
+  { 0 }
+#define PTHREAD_ONCE_INIT                                                      \
+  { 0, PTHREAD_MUTEX_INITIALIZER }
+
+__BEGIN_DECLS
+int pthread_create(pthread_t *, const pthread_attr_t *, void *(*)(void *),
+                   void *);
+__noreturn void pthread_exit(void *);
+int pthread_join(pthread_t, void **);
+int pthread_detach(pthread_t);
+pthread_t pthread_self(void);
+int pthread_equal(pthread_t, pthread_t);
+int pthread_once(pthread_once_t *, void (*)(void));
+int pthread_sigmask(int, const sigset_t *, sigset_t *);
+
+int pthread_attr_init(pthread_attr_t *);
+int pthread_attr_destroy(pthread_attr_t *);
+int pthread_attr_getstacksize(const pthread_attr_t *, size_t *);
+int pthread_attr_setstacksize(pthread_attr_t *, size_t);
+int pthread_attr_getdetachstate(const pthread_attr_t *, int *);
+int pthread_attr_setdetachstate(pthread_attr_t *, int);
+
+int pthread_mutex_init(pthread_mutex_t *, const pthread_mutexattr_t *);
+int pthread_mutex_destroy(pthread_mutex_t *);
+int pthread_mutex_lock(pthread_mutex_t *);
+int pthread_mutex_trylock(pthread_mutex_t *);
+int pthread_mutex_unlock(pthread_mutex_t *);
+int pthread_mutexattr_init(pthread_mutexattr_t *);
+int pthread_mutexattr_destroy(pthread_mutexattr_t *);
+
+int pthread_cond_init(pthread_cond_t *, const pthread_condattr_t *);
+int pthread_cond_destroy(pthread_cond_t *);
+int pthread_cond_wait(pthread_cond_t *, pthread_mutex_t *);
+int pthread_cond_timedwait(pthread_cond_t *, pthread_mutex_t *,
+                           const struct timespec *);
+int pthread_cond_signal(pthread_cond_t *);
+int pthread_cond_broadcast(pthread_cond_t *);
+int pthread_condattr_init(pthread_condattr_t *);
+int pthread_condattr_destroy(pthread_condattr_t *);
+__END_DECLS
+
+#endif /* !_PTHREAD_H_ */
@@ -6,14 +6,16 @@
 #include <sys/queue.h>
 
 typedef void (*timeout_t)(void *);
+typedef struct bintime bintime_t;
 
 typedef struct callout {
   TAILQ_ENTRY(callout) c_link;
-  systime_t c_time; /* absolute time of the event */
+  uint64_t c_time;  /* absolute uptime of the event (32.32 fixed point) */
   timeout_t c_func; /* function to call */
   void *c_arg;      /* function argument */
   uint32_t c_flags;
-  unsigned c_index; /* index of bucket this callout is assigned to */
+  uint8_t c_level;  /* timing wheel level this callout is assigned to */
+  uint8_t c_index;  /* index of slot within the level */
 } callout_t;
 
 /* callout has been delegated to callout thread and will be executed soon */
@@ -40,6 +42,11 @@ void callout_schedule(callout_t *co, systime_t tm);
  */
 void callout_schedule_abs(callout_t *co, systime_t tm);
 
+/*
+ * Same as callout_schedule_abs(), but @bt is uptime with sub-tick resolution.
+ */
+void callout_schedule_bt(callout_t *co, bintime_t bt);
+
 /*
  * Reschedule a running callout.
  * This function is intended to be called from the callout's function.
@@ -49,6 +56,9 @@ void callout_schedule_abs(callout_t *co, systime_t tm);
  */
 bool callout_reschedule(callout_t *co, systime_t tm);
 
+/* Same as callout_reschedule(), but @bt is uptime with sub-tick resolution. */
+bool callout_reschedule_bt(callout_t *co, bintime_t bt);
+
 /*
  * Cancel a callout if it is currently pending.
  *
@@ -67,7 +77,13 @@ bool callout_stop(callout_t *handle);
  * Process all callouts that happened since last time and delegate them to
  * callout thread.
  */
-void callout_process(systime_t now);
+void callout_process(bintime_t now);
+
+/*
+ * Return uptime at which callout_process() has to be called next, or \a limit
+ * if there is nothing to be done before that time.
+ */
+bintime_t callout_next(bintime_t limit);
 
 /*
  * Wait until a callout ends its execution or return immediately if the
@@ -6,7 +6,8 @@
 
 typedef struct condvar {
   const char *name;     /*!< name for debugging purpose */
-  volatile int waiters; /*!< # of threads sleeping in associated sleep queue */
+  int waiters;          /*!< # of threads sleeping in associated sleep queue,
+                         *   protected by lock of its sleep queue chain */
 } condvar_t;
 
 /*! \brief Initialize a conditional variable.
@@ -25,12 +25,30 @@ void ctx_set_retval(ctx_t *ctx, long value);
 /*! \brief Gets program counter from context. */
 register_t ctx_get_pc(ctx_t *ctx);
 
+/*! \brief Walks kernel stack of \a td starting from trap frame \a ctx.
+ *
+ * Stores program counter of interrupted code followed by return addresses
+ * of its callers in \a pcs. Unwinding is best-effort and stops at the first
+ * frame that cannot be decoded, or after \a n entries.
+ *
+ * \returns number of entries stored in \a pcs */
+unsigned ctx_backtrace(thread_t *td, ctx_t *ctx, uintptr_t *pcs, unsigned n);
+
 /*! \brief Copy user exception ctx. */
 void mcontext_copy(mcontext_t *to, mcontext_t *from);
 
+/*! \brief Gets program counter from user exception ctx. */
+register_t mcontext_get_pc(mcontext_t *ctx);
+
 /*! \brief Prepare ctx to jump into a user-space program. */
 void mcontext_init(mcontext_t *ctx, void *pc, void *sp);
 
+/*! \brief Modify user ctx so that it calls a function on a given stack.
+ *
+ * The function at \a pc gets \a arg as its only argument and must never
+ * return. Other registers are left intact. */
+void mcontext_setup_call(mcontext_t *ctx, void *pc, void *sp, register_t arg);
+
 /*! \brief Set a return value within the ctx and advance the program counter.
  *
  * Useful for returning values from syscalls. */
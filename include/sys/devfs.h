@@ -3,6 +3,7 @@
 
 #include <sys/types.h>
 #include <sys/refcnt.h>
+#include <sys/vm.h>
 
 typedef struct vnode vnode_t;
 typedef struct devfs_node devfs_node_t;
@@ -82,6 +83,25 @@ typedef int (*dev_write_t)(devnode_t *dev, uio_t *uio);
  */
 typedef int (*dev_ioctl_t)(devnode_t *dev, u_long cmd, void *data, int fflags);
 
+/*
+ * Translates `offset` within device memory to physical address of a page that
+ * should be mapped there by mmap(2).
+ *
+ * Called for every page of a new mapping with protection `prot` requested by
+ * the user, so the driver can refuse the mapping. Later it is called on page
+ * faults with `prot` set to VM_PROT_NONE and must give the same answer.
+ * Device memory that is not a part of RAM must be registered with
+ * `vm_physseg_plug_device` beforehand.
+ *
+ * Mappings may outlive the file they were created with, but hold a reference
+ * to the device node.
+ *
+ * Returns `EINVAL` if `offset` lies beyond device memory, `EACCES` if `prot`
+ * is not permitted.
+ */
+typedef int (*dev_mmap_t)(devnode_t *dev, off_t offset, vm_prot_t prot,
+                          paddr_t *pa_p);
+
 typedef enum {
   DT_OTHER = 0,    /* other non-seekable device file */
   DT_SEEKABLE = 1, /* other seekable device file (also a flag) */
@@ -99,6 +119,7 @@ typedef struct devops {
   dev_read_t d_read;   /* read bytes form a device file */
   dev_write_t d_write; /* write bytes to a device file */
   dev_ioctl_t d_ioctl; /* read or modify device properties */
+  dev_mmap_t d_mmap;   /* map device memory into user space */
 } devops_t;
 
 typedef struct devnode {
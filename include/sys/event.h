@@ -15,12 +15,18 @@
  *    this does not apply to issuing events. In other words, any thread can
  *    report an event to the kqueue.
  *  - The queue is not inherited by a child created with fork.
+ *  - Like in *BSDs, a knote for EVFILT_READ or EVFILT_WRITE does not hold
+ *    a reference to the file it monitors. The knote is deleted when its file
+ *    descriptor gets closed.
  */
 
-/* Filter types */
+/* Filter types (numbers match NetBSD, hence the gaps) */
 #define EVFILT_READ 0U
 #define EVFILT_WRITE 1U
-#define EVFILT_SYSCOUNT 2U /* number of filters */
+#define EVFILT_PROC 4U     /* attached to struct proc */
+#define EVFILT_SIGNAL 5U   /* attached to struct proc */
+#define EVFILT_TIMER 6U    /* arbitrary timer (in ms) */
+#define EVFILT_SYSCOUNT 7U /* number of filters */
 
 struct kevent {
   uintptr_t ident; /* identifier for this event */
@@ -42,12 +48,27 @@ struct kevent {
   };
 
 /* actions */
-#define EV_ADD 0x0001U    /* add event to kq */
-#define EV_DELETE 0x0002U /* delete event from kq */
+#define EV_ADD 0x0001U     /* add event to kq */
+#define EV_DELETE 0x0002U  /* delete event from kq */
+#define EV_ENABLE 0x0004U  /* enable event */
+#define EV_DISABLE 0x0008U /* disable event (not reported) */
+
+/* flags */
+#define EV_ONESHOT 0x0010U /* only report one occurrence */
+#define EV_CLEAR 0x0020U   /* clear event state after reporting */
 
 /* returned values */
+#define EV_EOF 0x8000U   /* EOF detected */
 #define EV_ERROR 0x4000U /* error, data contains errno */
 
+/* data/hint fflags for EVFILT_PROC */
+#define NOTE_EXIT 0x80000000U      /* process exited */
+#define NOTE_PCTRLMASK 0xf0000000U /* mask for hint bits */
+#define NOTE_PDATAMASK 0x000fffffU /* mask for pid/signal */
+
+/* hint for EVFILT_SIGNAL, used only internally */
+#define NOTE_SIGNAL 0x08000000U
+
 #ifdef _KERNEL
 
 #include <sys/queue.h>
@@ -57,6 +78,8 @@ typedef struct knote knote_t;
 typedef struct kevent kevent_t;
 typedef struct kqueue kqueue_t;
 typedef struct mtx mtx_t;
+typedef struct proc proc_t;
+typedef struct fdtab fdtab_t;
 
 typedef int filt_attach_t(knote_t *kn);
 typedef void filt_detach_t(knote_t *kn);
@@ -74,7 +97,10 @@ typedef struct filterops {
 typedef SLIST_HEAD(, knote) knlist_t;
 
 /* Status of knote. */
-#define KN_QUEUED 0x01U /* event is on queue */
+#define KN_QUEUED 0x01U   /* event is on queue */
+#define KN_DISABLED 0x02U /* event is disabled */
+#define KN_INFLUX 0x04U   /* knote is in use by a thread, others must wait */
+#define KN_DROPPING 0x08U /* knote is being dropped */
 
 /*
  * Field locking:
@@ -95,6 +121,8 @@ typedef struct knote {
   /* (o) only applies to `fflags`, `data`, `udata`. The rest should remain
    * unmodified. */
   kevent_t kn_kevent;
+  uint32_t kn_sfflags; /* (!) saved filter flags */
+  int64_t kn_sdata;    /* (!) saved data field */
 
   /* Following fields should be only set in the filt_attach function and aren't
    * protected by any lock. */
@@ -103,6 +131,18 @@ typedef struct knote {
   mtx_t *kn_objlock;       /* Lock protecting the object */
 } knote_t;
 
+#define kn_id kn_kevent.ident
+#define kn_filter kn_kevent.filter
+#define kn_flags kn_kevent.flags
+#define kn_fflags kn_kevent.fflags
+#define kn_data kn_kevent.data
+
+/*
+ * If a filter does not set `kn_objlock` in `filt_attach`, then `filt_event`
+ * with hint equal to 0 is called with `kn_kq->kq_lock` held, and the filter is
+ * responsible for synchronizing access to fields marked with (o) on its own.
+ */
+
 /*
  * Walk down a list of knotes, activating them if their event has
  * triggered.  The caller's object lock (e.g. device driver lock)
@@ -110,8 +150,22 @@ typedef struct knote {
  */
 void knote(knlist_t *knlist, long hint);
 
+/*
+ * Report exit of process `p` to knotes on its list and detach them all,
+ * as `p` is about to become a zombie. Both `all_proc_mtx` and `p->p_lock`
+ * must be held.
+ */
+void knote_proc_exit(proc_t *p);
+
+/*
+ * Drop knotes monitoring descriptor `fd` of table `fdt`, which has just been
+ * closed. Must be called before the file reference held by the descriptor is
+ * released.
+ */
+void knote_fdclose(fdtab_t *fdt, int fd);
+
 int do_kqueue1(proc_t *p, int flags, int *fd);
-int do_kevent(proc_t *p, int kq, kevent_t *changelist, size_t nchanges,
+int do_kevent(proc_t *p, int fd, kevent_t *changelist, size_t nchanges,
               kevent_t *eventlist, size_t nevents, timespec_t *timeout,
               int *retval);
 
@@ -8,6 +8,15 @@
 #define FBIOCGET_FBINFO _IOR(FB_IOC_MAGIC, 1, struct fb_info)
 #define FBIOCSET_FBINFO _IOW(FB_IOC_MAGIC, 1, struct fb_info)
 #define FBIOCSET_PALETTE _IOW(FB_IOC_MAGIC, 2, struct fb_palette)
+#define FBIOCFLIP _IOW(FB_IOC_MAGIC, 3, uint32_t)
+
+/*
+ * Framebuffer memory, that can be written to or mapped with mmap(2), holds
+ * FB_NBUFFERS buffers of width * height * bpp / 8 bytes each, one right after
+ * another. FBIOCFLIP makes the buffer with given index visible, so that
+ * programs may draw the next frame without tearing the current one.
+ */
+#define FB_NBUFFERS 2
 
 struct fb_color {
   uint8_t r, g, b;
@@ -7,6 +7,7 @@
 #ifdef _KERNEL
 #include <sys/mutex.h>
 #include <sys/refcnt.h>
+#include <sys/vm.h>
 
 typedef struct file file_t;
 typedef struct vnode vnode_t;
@@ -22,6 +23,8 @@ typedef int fo_seek_t(file_t *f, off_t offset, int whence, off_t *newoffp);
 typedef int fo_stat_t(file_t *f, stat_t *sb);
 typedef int fo_ioctl_t(file_t *f, u_long cmd, void *data);
 typedef int fo_kqfilter_t(file_t *f, knote_t *kn);
+typedef int fo_mmap_t(file_t *f, off_t offset, size_t length, vm_prot_t prot,
+                      vm_object_t **obj_p);
 
 typedef struct {
   fo_read_t *fo_read;
@@ -31,6 +34,7 @@ typedef struct {
   fo_stat_t *fo_stat;
   fo_ioctl_t *fo_ioctl;
   fo_kqfilter_t *fo_kqfilter;
+  fo_mmap_t *fo_mmap; /* NULL if the file cannot be memory mapped */
 } fileops_t;
 
 /* Put `nowrite` into `fo_write` if a file doesn't support writes. */
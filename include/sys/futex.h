@@ -0,0 +1,42 @@
+#ifndef _SYS_FUTEX_H_
+#define _SYS_FUTEX_H_
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/* Operations of futex system call. */
+#define FUTEX_WAIT 0 /* sleep as long as the word holds expected value */
+#define FUTEX_WAKE 1 /* wake up at most given number of waiters */
+
+#ifdef _KERNEL
+
+/*! \brief Sleeps on user word \a uaddr if it's still equal to \a val.
+ *
+ * Checking the word and going to sleep is atomic with respect to
+ * \a do_futex_wake called on the same word. Words in memory mapped shared are
+ * identified by object and offset, hence processes can use them to
+ * synchronize with each other.
+ *
+ * \param timeout in system ticks, if 0 waits indefinitely
+ * \returns EAGAIN if the word has different value, ETIMEDOUT if the timeout
+ * has passed, EINTR if the sleep was interrupted by a signal */
+int do_futex_wait(int *uaddr, int val, systime_t timeout);
+
+/*! \brief Wakes up at most \a nwake threads sleeping on user word \a uaddr.
+ *
+ * Number of threads woken up is stored under \a nwokenp. */
+int do_futex_wake(int *uaddr, int nwake, int *nwokenp);
+
+#else /* !_KERNEL */
+
+struct timespec;
+
+/* Returns the number of threads woken up by FUTEX_WAKE, 0 after FUTEX_WAIT,
+ * or a negated error number, as errno is shared by all threads. */
+__BEGIN_DECLS
+int futex(int *, int, int, const struct timespec *);
+__END_DECLS
+
+#endif /* !_KERNEL */
+
+#endif /* !_SYS_FUTEX_H_ */
@@ -0,0 +1,61 @@
+#ifndef _SYS_KPROF_H_
+#define _SYS_KPROF_H_
+
+#include <sys/ioccom.h>
+#include <sys/types.h>
+#include <stdbool.h>
+
+/*
+ * Statistical sampling profiler.
+ *
+ * When started, system clock interrupt takes a sample of the thread it
+ * interrupted: kernel call stack (if the thread was running in the kernel) and
+ * user program counter (if the thread belongs to a user process). Samples are
+ * stored in a ring buffer read through /dev/kprof.
+ */
+
+#define KPROF_MAXDEPTH 16 /* maximum number of kernel stack frames */
+
+/* Program counters are stored as 64-bit values even on MIPS, so that tools
+ * decoding /dev/kprof output need not know which kernel produced it. */
+typedef struct kprof_sample {
+  uint64_t ks_time;                /* uptime in 1/2^32 s units */
+  uint64_t ks_upc;                 /* user program counter or 0 */
+  uint64_t ks_kpc[KPROF_MAXDEPTH]; /* kernel pc followed by return addresses */
+  uint32_t ks_tid;                 /* sampled thread */
+  uint32_t ks_pid;                 /* its process or 0 for kernel threads */
+  uint16_t ks_cpu;                 /* processor the sample was taken on */
+  uint16_t ks_depth;               /* number of valid entries in ks_kpc */
+  uint32_t ks_pad;
+} kprof_sample_t;
+
+typedef struct kprof_stat {
+  uint32_t kst_running; /* nonzero if profiler is taking samples */
+  uint32_t kst_samples; /* samples taken since boot */
+  uint32_t kst_dropped; /* samples dropped because ring buffer was full */
+} kprof_stat_t;
+
+/* Start & stop taking samples (requires root), get profiler statistics. */
+#define KPROF_IOC_MAGIC 'p'
+#define KPROFIOC_START _IO(KPROF_IOC_MAGIC, 1)
+#define KPROFIOC_STOP _IO(KPROF_IOC_MAGIC, 2)
+#define KPROFIOC_GETSTAT _IOR(KPROF_IOC_MAGIC, 3, kprof_stat_t)
+
+#ifdef _KERNEL
+
+#include <sys/cdefs.h>
+
+extern bool kprof_running;
+
+/* Do not call directly, use kprof_tick instead. */
+void kprof_sample(void);
+
+/* Called from system clock interrupt handler. */
+static inline void kprof_tick(void) {
+  if (__unlikely(kprof_running))
+    kprof_sample();
+}
+
+#endif /* !_KERNEL */
+
+#endif /* !_SYS_KPROF_H_ */
@@ -0,0 +1,67 @@
+#ifndef _SYS_KTRACE_H_
+#define _SYS_KTRACE_H_
+
+#include <sys/ioccom.h>
+#include <sys/types.h>
+
+/*
+ * Kernel event tracing.
+ *
+ * Tracepoints are compiled into the kernel and disabled by default. When
+ * enabled, each of them appends a fixed-size binary record to a ring buffer
+ * of the processor it was hit on. Records are read from /dev/ktrace.
+ */
+
+/* Tracepoint identifiers. Meaning of arguments is given in parentheses. */
+typedef enum {
+  KTR_LOST,          /* records were overwritten (count of lost records) */
+  KTR_CTXSW,         /* context switch (old thread id, new thread id) */
+  KTR_SYSCALL_ENTER, /* system call entry (syscall number) */
+  KTR_SYSCALL_EXIT,  /* system call exit (syscall number, error) */
+  KTR_PGFAULT,       /* page fault (faulting address, access type) */
+  KTR_INTR,          /* interrupt (irq number, handler status) */
+  KTR_SLEEP,         /* thread goes to sleep (wait channel, wait point) */
+  KTR_WAKEUP,        /* thread is woken up (wait channel, thread id) */
+  KTR_LOCK,          /* lock is contested (lock address, wait point) */
+  KTR_NTYPES
+} ktrace_type_t;
+
+#define KTR_MASK(type) (1U << (type))
+#define KTR_ALL (KTR_MASK(KTR_NTYPES) - 1)
+
+/* Records are read from /dev/ktrace as they are stored in the ring. Explicit
+ * padding keeps the record 40 bytes long on both MIPS and AArch64. */
+typedef struct ktrace_event {
+  uint64_t ke_time;   /* uptime in 1/2^32 s units */
+  uint64_t ke_arg[2]; /* tracepoint specific arguments */
+  uint32_t ke_seq;    /* record sequence number on its processor */
+  uint32_t ke_tid;    /* thread that hit the tracepoint */
+  uint16_t ke_type;   /* KTR_* */
+  uint16_t ke_cpu;    /* processor the tracepoint was hit on */
+  uint32_t ke_pad;
+} ktrace_event_t;
+
+/* Get & set mask of enabled tracepoints. Setting it requires root. */
+#define KTRACE_IOC_MAGIC 'k'
+#define KTRACEIOC_GETMASK _IOR(KTRACE_IOC_MAGIC, 1, unsigned)
+#define KTRACEIOC_SETMASK _IOW(KTRACE_IOC_MAGIC, 2, unsigned)
+
+#ifdef _KERNEL
+
+#include <sys/cdefs.h>
+
+extern unsigned ktrace_mask;
+
+/* Do not call directly, use KTRACE macro instead. */
+void ktrace_record(ktrace_type_t type, uintptr_t arg0, uintptr_t arg1);
+
+/* Record an event if tracepoint `type` is enabled. */
+#define KTRACE(type, arg0, arg1)                                               \
+  ({                                                                           \
+    if (__unlikely(ktrace_mask & KTR_MASK(type)))                              \
+      ktrace_record((type), (uintptr_t)(arg0), (uintptr_t)(arg1));             \
+  })
+
+#endif /* !_KERNEL */
+
+#endif /* !_SYS_KTRACE_H_ */
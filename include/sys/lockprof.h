@@ -0,0 +1,42 @@
+#ifndef _SYS_LOCKPROF_H_
+#define _SYS_LOCKPROF_H_
+
+#include <sys/_lock.h>
+#include <sys/types.h>
+
+/*
+ * Lock profiler gathers statistics of lock usage for each pair of lock class
+ * and acquisition site: how many times locks were acquired and contested, how
+ * long threads waited for them and how long they held them. Lock classes are
+ * identified the same way as in lock dependency validator (see lockdep.h).
+ *
+ * Statistics are kept in pre-allocated global memory and reported as text by
+ * /dev/lockprof. Writing anything to that file resets them.
+ *
+ * To enable, compile the kernel with LOCKPROF=1 flag.
+ */
+
+#define LOCKPROF_MAX_RECORDS 1024 /* must be a power of 2 */
+
+typedef struct lock_class_mapping lock_class_mapping_t;
+typedef struct lock_prof lock_prof_t;
+
+#if LOCKPROF
+/*! \brief Returns current uptime in 1/2^32 s units. */
+uint64_t lockprof_now(void);
+
+/*! \brief Records acquisition of \a lock at \a site.
+ *
+ * \a waitstart is the moment the thread started to wait for the lock or 0 if
+ * the lock was acquired without contention.
+ *
+ * \returns record that must be passed to \a lockprof_release */
+lock_prof_t *lockprof_acquire(lock_t lock, lock_class_mapping_t *map,
+                              const void *site, uint64_t waitstart,
+                              uint64_t now);
+
+/*! \brief Records that lock acquired at \a locktime is being released. */
+void lockprof_release(lock_prof_t *lp, uint64_t locktime);
+#endif
+
+#endif /* !_SYS_LOCKPROF_H_ */
@@ -2,6 +2,8 @@
 #define _SYS_MALLOC_H_
 
 #include <sys/types.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <sys/linker_set.h>
 #include <sys/kmem_flags.h>
 #include <machine/vm_param.h>
@@ -11,11 +13,11 @@
  */
 
 typedef struct kmalloc_pool {
-  const char *desc; /* Printable type name. */
-  size_t nrequests; /* Number of allocation requests. */
-  size_t active;    /* Numer of active blocks. */
-  size_t used;      /* Bytes currently used. */
-  size_t maxused;   /* Peak usage of memory. */
+  const char *desc;        /* Printable type name. */
+  atomic_size_t nrequests; /* Number of allocation requests. */
+  atomic_size_t active;    /* Numer of active blocks. */
+  atomic_size_t used;      /* Bytes currently used. */
+  atomic_size_t maxused;   /* Peak usage of memory. */
 } kmalloc_pool_t;
 
 /* Defines a local pool of memory for use by a subsystem. */
@@ -30,9 +32,21 @@ typedef struct kmalloc_pool {
 /*! \brief Called during kernel initialization. */
 void init_kmalloc(void);
 
+/*! \brief Called during kernel initialization, when kmem is ready.
+ *
+ * From now on small requests are served by size class pools. */
+void init_kmalloc_classes(void);
+
+/*! \brief Whether small requests are served by size class pools.
+ *
+ * \note Exposed only for the sake of benchmarking. */
+extern bool kmalloc_use_classes;
+
 void *kmalloc(kmalloc_pool_t *mp, size_t size,
               kmem_flags_t flags) __warn_unused;
 void kfree(kmalloc_pool_t *mp, void *addr);
+void *krealloc(kmalloc_pool_t *mp, void *old_ptr, size_t size,
+               kmem_flags_t flags) __warn_unused;
 char *kstrndup(kmalloc_pool_t *mp, const char *s, size_t maxlen);
 
 void kmcheck(void);
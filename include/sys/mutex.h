@@ -5,6 +5,7 @@
 #include <sys/mimiker.h>
 #include <sys/_lock.h>
 #include <sys/lockdep.h>
+#include <sys/lockprof.h>
 
 typedef struct thread thread_t;
 
@@ -22,16 +23,20 @@ typedef struct mtx {
   volatile unsigned m_count; /*!< counter for recursive mutexes */
   atomic_intptr_t m_owner;   /*!< stores address of the owner */
 
-#if LOCKDEP
+#if LOCKDEP || LOCKPROF
   lock_class_mapping_t m_lockmap;
 #endif
+#if LOCKPROF
+  lock_prof_t *m_lockprof; /*!< statistics of current acquisition site */
+  uint64_t m_locktime;     /*!< when the mutex was acquired */
+#endif
 } mtx_t;
 
 /* Flags stored in lower 3 bits of m_owner. */
 #define MTX_CONTESTED 1
 #define MTX_FLAGMASK 7
 
-#if LOCKDEP
+#if LOCKDEP || LOCKPROF
 #define MTX_INITIALIZER(mutexname, recursive)                                  \
   (mtx_t) {                                                                    \
     .m_attr = (recursive) | LK_TYPE_BLOCK,                                     \
@@ -87,6 +92,19 @@ static inline void mtx_lock(mtx_t *m) {
 /*! \brief Unlocks sleep mutex */
 void mtx_unlock(mtx_t *m);
 
+/*! \brief Statistics of contested mutex acquisitions.
+ *
+ * With SMP enabled a thread spins while mutex owner is running on another
+ * processor, and blocks only if it is not or the owner takes too long. */
+typedef struct mtx_stats {
+  unsigned ms_spins;    /*!< times a thread spun waiting for mutex owner */
+  unsigned ms_acquired; /*!< spins that ended with mutex acquired */
+  unsigned ms_blocks;   /*!< times a thread blocked on a turnstile */
+} mtx_stats_t;
+
+/*! \brief Copies statistics of contested mutexes into \a ms. */
+void mtx_stats(mtx_stats_t *ms);
+
 DEFINE_CLEANUP_FUNCTION(mtx_t *, mtx_unlock);
 
 /*! \brief Locks sleep mutex and unlocks it when leaving current scope.
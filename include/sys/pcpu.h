@@ -3,6 +3,9 @@
 
 #include <machine/types.h>
 #include <machine/pcpu.h>
+#include <sys/runq.h>
+#include <sys/smp.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 
 typedef struct thread thread_t;
@@ -11,21 +14,25 @@ typedef struct vm_map vm_map_t;
 
 /*! \brief Private per-cpu structure. */
 typedef struct pcpu {
-  bool no_switch;        /*!< executing code that must not switch out */
-  thread_t *curthread;   /*!< thread running on this CPU */
-  thread_t *idle_thread; /*!< idle thread executed on this CPU */
-  pmap_t *curpmap;       /*!< current page table */
-  vm_map_t *uspace;      /*!< user space virtual memory map */
+  unsigned cpuid;          /*!< processor number (0 is the boot processor) */
+  bool no_switch;          /*!< executing code that must not switch out */
+  thread_t *curthread;     /*!< thread running on this CPU */
+  thread_t *idle_thread;   /*!< idle thread executed on this CPU */
+  pmap_t *curpmap;         /*!< current page table */
+  vm_map_t *uspace;        /*!< user space virtual memory map */
+  runq_t runq;             /*!< threads ready to run on this CPU */
+  atomic_uint ipi_pending; /*!< IPI_* requests posted by other CPUs */
 
   /* Machine-dependent part */
   PCPU_MD_FIELDS;
 } pcpu_t;
 
-extern pcpu_t _pcpu_data[1];
+extern pcpu_t _pcpu_data[MAXCPU];
 
 /* Read pcpu.h from FreeBSD for API reference */
-#define PCPU_GET(member) (_pcpu_data->member)
-#define PCPU_PTR(member) (&_pcpu_data->member)
-#define PCPU_SET(member, value) (_pcpu_data->member = (value))
+#define PCPU_SELF() (_PCPU_SELF())
+#define PCPU_GET(member) (PCPU_SELF()->member)
+#define PCPU_PTR(member) (&PCPU_SELF()->member)
+#define PCPU_SET(member, value) (PCPU_SELF()->member = (value))
 
 #endif /* !_SYS_PCPU_H_ */
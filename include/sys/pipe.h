@@ -5,8 +5,14 @@
 
 #include <machine/vm_param.h>
 
-/* size of pipe buffer */
+/* initial size of pipe buffer */
 #define PIPE_SIZE PAGESIZE
+/* size the buffer may grow to when writers keep filling it up */
+#define PIPE_MAX_SIZE (16 * PAGESIZE)
+/* writes of at least that many bytes lend user pages to the reader */
+#define PIPE_DIRECT_MIN (2 * PAGESIZE)
+/* maximum number of pages lent to the reader at once */
+#define PIPE_DIRECT_MAXPAGES 16
 
 typedef struct proc proc_t;
 
@@ -1,6 +1,7 @@
 #ifndef _SYS_PMAP_H_
 #define _SYS_PMAP_H_
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <sys/vm.h>
 
@@ -37,6 +38,13 @@ void init_pmap(void);
 pmap_t *pmap_new(void);
 void pmap_delete(pmap_t *pmap);
 
+/*
+ * If all pages of a user pmap in an aligned range of SUPERPAGESIZE bytes are
+ * physically contiguous and have the same attributes, pmap_enter replaces
+ * their mappings with a single large mapping (promotion). The large mapping is
+ * broken back into pages (demotion) as soon as any of them gets remapped,
+ * unmapped or has its protection or referenced & modified bits changed.
+ */
 void pmap_enter(pmap_t *pmap, vaddr_t va, vm_page_t *pg, vm_prot_t prot,
                 unsigned flags);
 bool pmap_extract(pmap_t *pmap, vaddr_t va, paddr_t *pap);
@@ -46,6 +54,8 @@ void pmap_kenter(vaddr_t va, paddr_t pa, vm_prot_t prot, unsigned flags);
 bool pmap_kextract(vaddr_t va, paddr_t *pap);
 void pmap_kremove(vaddr_t va, size_t size);
 
+/*! \brief Takes away permissions other than \a prot from pages mapped in
+ * range [\a start, \a end). Never grants any permissions. */
 void pmap_protect(pmap_t *pmap, vaddr_t start, vaddr_t end, vm_prot_t prot);
 void pmap_page_remove(vm_page_t *pg);
 
@@ -79,4 +89,8 @@ pmap_t *pmap_user(void);
 
 void pmap_growkernel(vaddr_t maxkvaddr);
 
+/*! \brief Number of large mappings created & broken up since boot. */
+extern atomic_uint pmap_promotions;
+extern atomic_uint pmap_demotions;
+
 #endif /* !_SYS_PMAP_H_ */
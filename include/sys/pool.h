@@ -8,10 +8,13 @@
 /*! \file pool.h
  *
  * Pooled allocator manages fixed-size object. Implementation is based on idea
- * of the slab allocator, however object caching facility is not available
- * (though the actual implementation is capable of supporting it).
+ * of the slab allocator. Freed objects are kept in per-CPU magazines and in
+ * a depot of magazines shared by all processors, so most requests are served
+ * without taking the pool lock. Slabs that became empty are returned to the
+ * kernel memory allocator.
  *
- * Pooled allocator idea is loosely based on NetBSD's pool(9).
+ * Pooled allocator idea is loosely based on NetBSD's pool(9), magazine layer
+ * follows Bonwick & Adams "Magazines and Vmem" paper.
  */
 
 typedef struct pool pool_t;
@@ -19,11 +22,16 @@ typedef struct pool pool_t;
 /*! \brief Called during kernel initialization. */
 void init_pool(void);
 
+/* Pool flags. */
+#define PF_NOCACHE 0x1   /* don't put freed objects into magazines */
+#define PF_NORECLAIM 0x2 /* never return empty slabs to kernel memory */
+
 /*! \brief Pool constructor parameters. */
 typedef struct pool_init {
   const char *desc;
   size_t size;
   size_t alignment;
+  unsigned flags;
 } pool_init_t;
 
 /*! \brief Creates a pool of objects of given size. */
@@ -36,7 +44,8 @@ pool_t *_pool_create(pool_init_t *args);
  * The page may be bigger than the standard page. Argument @size has to be a
  * multiple of PAGESIZE.
  *
- * \note Use only during memory system bootstrap!
+ * \note Use only during memory system bootstrap! The pool must be created
+ * with PF_NORECLAIM flag, since the page does not come from kmem_alloc.
  */
 void pool_add_page(pool_t *pool, void *page, size_t size);
 
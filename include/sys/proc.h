@@ -11,6 +11,8 @@
 #include <sys/syslimits.h>
 #include <sys/uio.h>
 #include <sys/time.h>
+#include <sys/event.h>
+#include <sys/thread.h>
 
 typedef struct thread thread_t;
 typedef struct proc proc_t;
@@ -21,6 +23,7 @@ typedef struct tty tty_t;
 typedef TAILQ_HEAD(, proc) proc_list_t;
 typedef TAILQ_HEAD(, pgrp) pgrp_list_t;
 typedef TAILQ_HEAD(, session) session_list_t;
+typedef TAILQ_HEAD(, deadthread) deadthread_list_t;
 
 extern mtx_t all_proc_mtx;
 extern proc_list_t proc_list, zombie_list;
@@ -97,7 +100,8 @@ struct proc {
   TAILQ_ENTRY(proc) p_zombie; /* (a) link on zombie process list */
   TAILQ_ENTRY(proc) p_child;  /* (a) link on parent's children list */
   TAILQ_ENTRY(proc) p_hash;   /* (a) link on pid hash chain */
-  thread_t *p_thread;         /* (@) the only thread running in this process */
+  thread_list_t p_threads;    /* (@) threads running in this process */
+  unsigned p_nthreads;        /* (@) number of threads on p_threads */
   pid_t p_pid;                /* (!) Process ID */
   cred_t p_cred;              /* (@, *) Process credentials */
   char *p_elfpath;            /* (!) path of loaded elf file */
@@ -112,11 +116,14 @@ struct proc {
   sigaction_t p_sigactions[NSIG]; /* (@) description of signal actions */
   signo_t p_stopsig;              /* (@) signal that stopped the process */
   condvar_t p_waitcv;             /* (a) processes waiting for this one */
+  condvar_t p_lwpcv;              /* (@) threads waiting for others to exit */
+  deadthread_list_t p_deadtds;    /* (@) exited threads not waited for */
   int p_exitstatus;               /* (@) exit code to be returned to parent */
   volatile proc_flags_t p_flags;  /* (@) PF_* flags */
   vnode_t *p_cwd;                 /* ($) current working directory */
   mode_t p_cmask;                 /* ($) mask for file creation */
   kitimer_t p_itimer;             /* (@) interval timer state  */
+  knlist_t p_klist;               /* (@) knotes attached to this process */
   /* program segments */
   vm_map_entry_t *p_sbrk; /* ($) The entry where brk segment resides in. */
   vaddr_t p_sbrk_end;     /* ($) Current end of brk segment. */
@@ -161,9 +168,33 @@ int proc_sendsig(pid_t pid, signo_t sig);
 int proc_getpgid(pid_t pid, pgid_t *pgidp);
 
 /*! \brief Called by a processes that wishes to terminate its life.
+ *
+ * All other threads of the process are terminated first. If another thread is
+ * already terminating the process, only the calling thread exits.
  * \note Exit status shoud be created using MAKE_STATUS macros from wait.h */
 __noreturn void proc_exit(int exitstatus);
 
+/*! \brief Terminates the calling thread, but not the rest of its process.
+ *
+ * If the thread is the last one in the process, the process exits with status
+ * 0. Must be called with the current process's p_lock held. */
+__noreturn void proc_thread_exit(void);
+
+/*! \brief Makes all threads of the current process but the calling one exit.
+ *
+ * Waits until other threads are gone. Must be called with the current
+ * process's p_lock held, which is released while waiting.
+ *
+ * \returns EINTR if another thread has just requested the calling one to exit
+ */
+int proc_single_thread(void);
+
+/*! \brief Waits for a thread of the current process to exit.
+ *
+ * If \a tid is 0, waits for any thread. The identifier of thread that exited is
+ * stored in \a departedp. */
+int do_lwp_wait(tid_t tid, tid_t *departedp);
+
 /*! \brief Moves process with pid target to the process group with ID specified
  * by pgid. If such process group does not exist then it creates one. */
 int pgrp_enter(proc_t *curp, pid_t target, pgid_t pgid);
@@ -194,6 +225,12 @@ void proc_wakeup_parent(proc_t *parent);
  * Must be called with the current process's p_lock held. */
 void proc_stop(signo_t sig);
 
+/*! \brief Stop the calling thread if its process has been stopped.
+ *
+ * Must be called with the current process's p_lock held, which is released
+ * while the thread is stopped. */
+void proc_thread_stop(void);
+
 /*! \brief Continue a stopped process.
  *
  * Must be called with p::p_lock held. */
@@ -201,6 +238,12 @@ void proc_continue(proc_t *p);
 
 int do_fork(void (*start)(void *), void *arg, pid_t *cldpidp);
 
+/*! \brief Creates a new thread in the current process.
+ *
+ * The thread starts by calling \a func with argument \a arg on the user stack
+ * pointed by \a stack. Its signal mask is copied from the calling thread. */
+int do_lwp_create(void *func, void *arg, void *stack, tid_t *tidp);
+
 /*! \brief Set login name associated with current session. */
 int do_setlogin(const char *name);
 
@@ -5,6 +5,8 @@
 
 #include <sys/cdefs.h>
 #include <sys/queue.h>
+#include <sys/types.h>
+#include <sys/spinlock.h>
 
 typedef struct thread thread_t;
 
@@ -12,9 +14,18 @@ typedef struct thread thread_t;
 #define RQ_NQS 64 /* Number of run queues. */
 #define RQ_PPQ 4  /* Priorities per queue. */
 
+/* Status bitmap of non-empty run queues. */
+typedef unsigned long rqb_word_t;
+
+#define RQB_BPW (sizeof(rqb_word_t) * NBBY) /* Bits per status word. */
+#define RQB_LEN (RQ_NQS / RQB_BPW)          /* Number of status words. */
+
 TAILQ_HEAD(rq_head, thread);
 
-typedef struct {
+typedef struct runq {
+  spin_t rq_lock;                /* other processors may wake up threads here */
+  unsigned rq_count;             /* number of threads on the queues */
+  rqb_word_t rq_status[RQB_LEN]; /* bit i set iff rq_queues[i] not empty */
   struct rq_head rq_queues[RQ_NQS];
 } runq_t;
 
@@ -24,7 +35,8 @@ void runq_init(runq_t *);
 /* Add the thread to the queue specified by its priority */
 void runq_add(runq_t *, thread_t *);
 
-/* Find the highest priority process on the run queue. */
+/* Find the highest priority process on the run queue.
+ * Takes constant time thanks to the status bitmap. */
 thread_t *runq_choose(runq_t *);
 
 /* Remove the thread from the queue specified by its priority. */
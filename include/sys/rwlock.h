@@ -0,0 +1,143 @@
+#ifndef _SYS_RWLOCK_H_
+#define _SYS_RWLOCK_H_
+
+#include <stdbool.h>
+#include <sys/mimiker.h>
+#include <sys/_lock.h>
+#include <sys/lockdep.h>
+
+typedef struct thread thread_t;
+
+/*! \file rwlock.h */
+
+/*! \brief Reader-writer lock.
+ *
+ * Many readers may hold the lock at once, or a single writer. Threads that
+ * cannot get the lock block on a turnstile. When the lock is held by a writer,
+ * blocked threads lend it their priority just like owner of a mutex.
+ * Readers are not tracked, so they do not get their priority raised.
+ *
+ * New readers do not get the lock once another thread is blocked on it,
+ * so writers cannot be starved.
+ *
+ * \warning You must never access lock fields directly outside of its
+ * implementation!
+ *
+ * \warning Read lock must not be taken recursively, since the thread would
+ * deadlock once a writer got blocked in between.
+ *
+ * \note Write lock must be released by its owner!
+ */
+typedef struct rwlock {
+  lk_attr_t rw_attr;        /*!< lock attributes */
+  atomic_intptr_t rw_state; /*!< owner of write lock or number of readers */
+
+#if LOCKDEP
+  lock_class_mapping_t rw_lockmap;
+#endif
+} rwlock_t;
+
+/* Flags stored in lower 3 bits of rw_state. If RW_WRITER is set then the rest
+ * of rw_state stores address of the owner, otherwise it's number of readers
+ * multiplied by RW_ONE_READER. */
+#define RW_WRITER 1
+#define RW_CONTESTED 2
+#define RW_FLAGMASK 7
+#define RW_ONE_READER 8
+
+#if LOCKDEP
+#define RW_INITIALIZER(rwname)                                                 \
+  (rwlock_t) {                                                                 \
+    .rw_attr = LK_TYPE_BLOCK,                                                  \
+    .rw_lockmap = LOCKDEP_MAPPING_INITIALIZER(rwname)                          \
+  }
+#else
+#define RW_INITIALIZER(rwname)                                                 \
+  (rwlock_t) {                                                                 \
+    .rw_attr = LK_TYPE_BLOCK                                                   \
+  }
+#endif
+
+#define RW_DEFINE(rwname) rwlock_t rwname = RW_INITIALIZER(rwname)
+
+/*! \brief Initializes reader-writer lock.
+ *
+ * \note Every lock has to be initialized before it is used. */
+void _rw_init(rwlock_t *rw, lk_attr_t attr, const char *name,
+              lock_class_key_t *key);
+
+#define rw_init(lock, attr)                                                    \
+  {                                                                            \
+    static lock_class_key_t __key;                                             \
+    _rw_init(lock, attr, #lock, &__key);                                       \
+  }
+
+/*! \brief Makes reader-writer lock unusable for further locking.
+ *
+ * \todo Not implemented yet. */
+#define rw_destroy(rw)
+
+/*! \brief Check if calling thread holds write lock on \a rw. */
+bool rw_wowned(rwlock_t *rw);
+
+/*! \brief Check if \a rw is held by anyone in any mode.
+ *
+ * \note Intended for assertions, since readers are not tracked. */
+static inline bool rw_locked(rwlock_t *rw) {
+  return (rw->rw_state & ~RW_FLAGMASK) != 0;
+}
+
+/*! \brief Acquires read lock (with custom \a waitpt). */
+void _rw_rlock(rwlock_t *rw, const void *waitpt);
+
+/*! \brief Acquires write lock (with custom \a waitpt). */
+void _rw_wlock(rwlock_t *rw, const void *waitpt);
+
+/*! \brief Acquires read lock.
+ *
+ * Blocks while the lock is held by a writer or somebody waits for it. */
+static inline void rw_rlock(rwlock_t *rw) {
+  _rw_rlock(rw, __caller(0));
+}
+
+/*! \brief Acquires write lock.
+ *
+ * Blocks while the lock is held by anybody else. */
+static inline void rw_wlock(rwlock_t *rw) {
+  _rw_wlock(rw, __caller(0));
+}
+
+/*! \brief Releases read or write lock. */
+void rw_unlock(rwlock_t *rw);
+
+DEFINE_CLEANUP_FUNCTION(rwlock_t *, rw_unlock);
+
+/*! \brief Acquires read lock and releases it when leaving current scope.
+ *
+ * \sa SCOPED_MTX_LOCK
+ */
+#define SCOPED_RW_RLOCK(rw_p)                                                  \
+  SCOPED_STMT(rwlock_t, rw_rlock, CLEANUP_FUNCTION(rw_unlock), rw_p)
+
+/*! \brief Acquires write lock and releases it when leaving current scope.
+ *
+ * \sa SCOPED_MTX_LOCK
+ */
+#define SCOPED_RW_WLOCK(rw_p)                                                  \
+  SCOPED_STMT(rwlock_t, rw_wlock, CLEANUP_FUNCTION(rw_unlock), rw_p)
+
+/*! \brief Enter scope with read lock acquired.
+ *
+ * \sa WITH_MTX_LOCK
+ */
+#define WITH_RW_RLOCK(rw_p)                                                    \
+  WITH_STMT(rwlock_t, rw_rlock, CLEANUP_FUNCTION(rw_unlock), rw_p)
+
+/*! \brief Enter scope with write lock acquired.
+ *
+ * \sa WITH_MTX_LOCK
+ */
+#define WITH_RW_WLOCK(rw_p)                                                    \
+  WITH_STMT(rwlock_t, rw_wlock, CLEANUP_FUNCTION(rw_unlock), rw_p)
+
+#endif /* !_SYS_RWLOCK_H_ */
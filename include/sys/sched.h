@@ -84,10 +84,12 @@ void sched_unlend_prio(thread_t *td, prio_t prio);
 void sched_set_prio(thread_t *td, prio_t prio);
 
 /*! \brief Takes care of run-time accounting for current thread.
+ *
+ * \arg ticks number of clock ticks that elapsed since last call
  *
  * \note Must be called from interrupt context.
  */
-void sched_clock(void);
+void sched_clock(systime_t ticks);
 
 /*! \brief Switch out to another thread.
  *
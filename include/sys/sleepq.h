@@ -7,6 +7,7 @@
 
 typedef struct thread thread_t;
 typedef struct sleepq sleepq_t;
+typedef struct bintime bintime_t;
 
 /*! \file sleepq.h */
 
@@ -19,6 +20,17 @@ sleepq_t *sleepq_alloc(void);
 /*! \brief Deallocates sleep queue entry. */
 void sleepq_destroy(sleepq_t *sq);
 
+/*! \brief Locks sleep queue chain of \a wchan.
+ *
+ * Lets the caller release another lock and go to sleep on \a wchan with no
+ * window in which a wakeup from another processor or an interrupt could get
+ * lost. The chain lock is a spin lock, so it must be handed over to one of
+ * the \a sleepq_wait*_locked functions or dropped with \a sleepq_unlock. */
+void sleepq_lock(void *wchan);
+
+/*! \brief Unlocks sleep queue chain of \a wchan locked by \a sleepq_lock. */
+void sleepq_unlock(void *wchan);
+
 /*! \brief Blocks the current thread until it is awakened from its sleep queue.
  *
  * \param wchan unique sleep queue identifier
@@ -26,6 +38,10 @@ void sleepq_destroy(sleepq_t *sq);
  */
 void sleepq_wait(void *wchan, const void *waitpt);
 
+/*! \brief Same as \a sleepq_wait but with sleep queue chain of \a wchan
+ * already locked by \a sleepq_lock. The lock is released on return. */
+void sleepq_wait_locked(void *wchan, const void *waitpt);
+
 /*! \brief Same as \a sleepq_wait but allows the sleep to be interrupted. */
 #define sleepq_wait_intr(wchan, waitpt) sleepq_wait_timed((wchan), (waitpt), 0)
 
@@ -39,6 +55,16 @@ void sleepq_wait(void *wchan, const void *waitpt);
  * \returns how the thread was actually woken up */
 int sleepq_wait_timed(void *wchan, const void *waitpt, systime_t timeout);
 
+/*! \brief Same as \a sleepq_wait_timed but with sleep queue chain of \a wchan
+ * already locked by \a sleepq_lock. The lock is released on return. */
+int sleepq_wait_timed_locked(void *wchan, const void *waitpt,
+                             systime_t timeout);
+
+/*! \brief Same as \a sleepq_wait_timed but sleeps until uptime \a deadline.
+ *
+ * Unlike the timeout in ticks, \a deadline has sub-tick resolution. */
+int sleepq_wait_until(void *wchan, const void *waitpt, bintime_t deadline);
+
 /*! \brief Wakes up highest priority thread waiting on \a wchan.
  *
  * \param wchan unique sleep queue identifier
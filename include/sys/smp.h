@@ -0,0 +1,62 @@
+#ifndef _SYS_SMP_H_
+#define _SYS_SMP_H_
+
+#include <sys/cdefs.h>
+
+/*! \file smp.h */
+
+/* Maximum number of processors supported by the kernel. */
+#if SMP
+#define MAXCPU 4
+#else
+#define MAXCPU 1
+#endif
+
+/* Inter-processor interrupt requests, delivered as a bit mask. */
+#define IPI_RESCHED 0x1U /* target CPU should look for a better thread */
+
+#ifdef _KERNEL
+
+/*! \brief Number of processors that are up and running threads.
+ *
+ * Processors are numbered from 0 (the boot processor) to `ncpus - 1`. */
+extern volatile unsigned ncpus;
+
+/*! \brief Start secondary processors.
+ *
+ * Called by the boot processor, when the scheduler and interrupt controller
+ * are ready. Each started processor runs its own idle thread. */
+void init_smp(void);
+
+/*! \brief Entry point of a secondary processor.
+ *
+ * Called by machine-dependent code on the stack of the processor's idle
+ * thread, with MMU, exception vectors and per-CPU pointer set up. */
+__noreturn void smp_ap_main(void);
+
+/*! \brief Post IPI_* requests to processor \a cpuid and interrupt it. */
+void smp_ipi_send(unsigned cpuid, unsigned ipis);
+
+/*! \brief Handle pending IPI_* requests for current processor.
+ *
+ * Called by machine-dependent code from interrupt context. */
+void smp_ipi_handler(void);
+
+/*
+ * Machine-dependent part.
+ */
+
+/*! \brief Release processor \a cpuid to run `smp_ap_main`.
+ *
+ * \returns 0 on success, ENODEV if the platform can't start it. */
+int cpu_start_secondary(unsigned cpuid);
+
+/*! \brief Raise inter-processor interrupt on processor \a cpuid. */
+void cpu_send_ipi(unsigned cpuid);
+
+/*! \brief Hint the processor that it is busy-waiting for another one. */
+void cpu_spinwait(void);
+
+#endif /* !_KERNEL */
+
+#endif /* !_SYS_SMP_H_ */
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <sys/mimiker.h>
 #include <sys/_lock.h>
+#include <sys/lockdep.h>
+#include <sys/lockprof.h>
 
 typedef struct thread thread_t;
 
@@ -20,20 +22,35 @@ typedef struct thread thread_t;
  * \todo How to enforce the condition given above?
  *
  * \note Spin lock must be released by its owner!
- * \todo During transition from single-core to multi-core architecture spin lock
- *       will be used for interprocessor synchronization as well.
+ *
+ * With SMP enabled spin lock is used for interprocessor synchronization as
+ * well, i.e. a thread busy-waits until owner on another processor releases it.
  */
 typedef struct spin {
-  lk_attr_t s_attr;           /*!< lock attributes */
-  volatile unsigned s_count;  /*!< counter for recursive spinlock */
-  volatile thread_t *s_owner; /*!< stores address of the owner */
-  const void *s_lockpt;       /*!< place where the lock was acquired */
+  lk_attr_t s_attr;          /*!< lock attributes */
+  volatile unsigned s_count; /*!< counter for recursive spinlock */
+  atomic_intptr_t s_owner;   /*!< stores address of the owner */
+  const void *s_lockpt;      /*!< place where the lock was acquired */
+
+#if LOCKPROF
+  lock_class_mapping_t s_lockmap;
+  lock_prof_t *s_lockprof; /*!< statistics of current acquisition site */
+  uint64_t s_locktime;     /*!< when the lock was acquired */
+#endif
 } spin_t;
 
+#if LOCKPROF
+#define SPIN_INITIALIZER(spinname, recursive)                                  \
+  (spin_t) {                                                                   \
+    .s_attr = (recursive) | LK_TYPE_SPIN,                                      \
+    .s_lockmap = LOCKDEP_MAPPING_INITIALIZER(spinname)                         \
+  }
+#else
 #define SPIN_INITIALIZER(spinname, recursive)                                  \
   (spin_t) {                                                                   \
     .s_attr = (recursive) | LK_TYPE_SPIN                                       \
   }
+#endif
 
 #define SPIN_DEFINE(spinname, recursive)                                       \
   spin_t spinname = SPIN_INITIALIZER(spinname, recursive);
@@ -41,7 +58,14 @@ typedef struct spin {
 /*! \brief Initializes spin lock.
  *
  * \note Every spin lock has to be initialized before it is used. */
-void spin_init(spin_t *s, lk_attr_t attr);
+void _spin_init(spin_t *s, lk_attr_t attr, const char *name,
+                lock_class_key_t *key);
+
+#define spin_init(lock, attr)                                                  \
+  {                                                                            \
+    static lock_class_key_t __key;                                             \
+    _spin_init(lock, attr, #lock, &__key);                                     \
+  }
 
 /*! \brief Makes spin lock unusable for further locking.
  *
@@ -57,6 +81,7 @@ void _spin_lock(spin_t *s, const void *waitpt) __no_profile;
 /*! \brief Acquire the spin lock.
  *
  * \note On single core architecture it impossible to block on spinlock.
+ * With SMP enabled it will busy-wait until the lock is released.
  */
 static inline void spin_lock(spin_t *s) {
   _spin_lock(s, __caller(0));
@@ -0,0 +1,63 @@
+#ifndef _SYS_SX_H_
+#define _SYS_SX_H_
+
+#include <stdbool.h>
+#include <sys/_lock.h>
+#include <sys/condvar.h>
+#include <sys/lockdep.h>
+#include <sys/spinlock.h>
+
+typedef struct thread thread_t;
+
+/*! \file sx.h */
+
+/*! \brief Shared-exclusive lock.
+ *
+ * Like reader-writer lock, but waiting threads go to sleep on a condition
+ * variable, so the lock may be held while sleeping (e.g. doing I/O). There's
+ * no priority propagation.
+ *
+ * As with `rwlock_t` new shared owners yield to threads waiting for exclusive
+ * access and shared lock must not be taken recursively.
+ *
+ * \warning You must never access lock fields directly outside of its
+ * implementation!
+ */
+typedef struct sx {
+  lk_attr_t sx_attr;    /*!< lock attributes */
+  spin_t sx_interlock;  /*!< protects fields below */
+  condvar_t sx_cv;      /*!< threads waiting for the lock */
+  thread_t *sx_owner;   /*!< exclusive owner or NULL */
+  unsigned sx_shared;   /*!< number of shared owners */
+  unsigned sx_xwaiters; /*!< threads waiting for exclusive access */
+
+#if LOCKDEP
+  lock_class_mapping_t sx_lockmap;
+#endif
+} sx_t;
+
+/*! \brief Initializes shared-exclusive lock.
+ *
+ * \note Every lock has to be initialized before it is used. */
+void _sx_init(sx_t *sx, lk_attr_t attr, const char *name,
+              lock_class_key_t *key);
+
+#define sx_init(lock, attr)                                                    \
+  {                                                                            \
+    static lock_class_key_t __key;                                             \
+    _sx_init(lock, attr, #lock, &__key);                                       \
+  }
+
+/*! \brief Check if calling thread holds \a sx exclusively. */
+bool sx_xlocked(sx_t *sx);
+
+/*! \brief Acquires shared lock. */
+void sx_slock(sx_t *sx);
+
+/*! \brief Acquires exclusive lock. */
+void sx_xlock(sx_t *sx);
+
+/*! \brief Releases shared or exclusive lock. */
+void sx_unlock(sx_t *sx);
+
+#endif /* !_SYS_SX_H_ */
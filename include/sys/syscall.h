@@ -91,6 +91,11 @@
 #define SYS_fsync 83
 #define SYS_kqueue1 84
 #define SYS_kevent 85
-#define SYS_MAXSYSCALL 86
+#define SYS_lwp_create 86
+#define SYS_lwp_exit 87
+#define SYS_lwp_wait 88
+#define SYS_lwp_self 89
+#define SYS_futex 90
+#define SYS_MAXSYSCALL 91
 
 #define SYS_MAXSYSARGS 6
@@ -435,3 +435,22 @@ typedef struct {
   SYSCALLARG(size_t) nevents;
   SYSCALLARG(const struct timespec *) timeout;
 } kevent_args_t;
+
+typedef struct {
+  SYSCALLARG(void *) func;
+  SYSCALLARG(void *) arg;
+  SYSCALLARG(void *) stack;
+  SYSCALLARG(tid_t *) tidp;
+} lwp_create_args_t;
+
+typedef struct {
+  SYSCALLARG(tid_t) tid;
+  SYSCALLARG(tid_t *) departedp;
+} lwp_wait_args_t;
+
+typedef struct {
+  SYSCALLARG(int *) uaddr;
+  SYSCALLARG(int) op;
+  SYSCALLARG(int) val;
+  SYSCALLARG(const struct timespec *) timeout;
+} futex_args_t;
@@ -25,7 +25,9 @@ typedef struct vm_page vm_page_t;
 typedef struct vm_map vm_map_t;
 typedef struct fdtab fdtab_t;
 typedef struct proc proc_t;
+typedef struct runq runq_t;
 typedef void (*entry_fn_t)(void *);
+typedef TAILQ_HEAD(, thread) thread_list_t;
 
 #define TD_NAME_MAX 32
 
@@ -65,6 +67,7 @@ typedef enum {
 #define TDF_NEEDSIGCHK 0x00000004 /* signals were posted for delivery */
 #define TDF_STOPPING 0x00000008   /* thread is about to stop */
 #define TDF_BORROWING 0x00000010  /* priority propagation */
+#define TDF_EXITING 0x00000020    /* thread must exit as soon as it can */
 /* TDF_SLP* flags are used internally by sleep queue */
 #define TDF_SLPINTR 0x00000040  /* sleep is interruptible */
 #define TDF_SLPTIMED 0x00000080 /* sleep with timeout */
@@ -72,8 +75,10 @@ typedef enum {
 typedef enum {
   TDP_OLDSIGMASK = 0x01,  /* Pass td_oldsigmask as return mask to send_sig(). */
   TDP_FPUCTXSAVED = 0x02, /* FPU context was saved by `ctx_switch`. */
-  TDP_FPUINUSE = 0x04     /* FPU is in use and its context should be saved &
+  TDP_FPUINUSE = 0x04,    /* FPU is in use and its context should be saved &
                               restored on demand. */
+  TDP_NOPAGEIN = 0x08,    /* Page faults must not read pages in from files. */
+  TDP_PAGEINFAILED = 0x10 /* Page fault failed due to TDP_NOPAGEIN. */
 } tdp_flags_t;
 
 /*! \brief Thread structure
@@ -104,6 +109,7 @@ typedef struct thread {
   TAILQ_ENTRY(thread) td_sleepq;   /* ($) link on sleep queue */
   TAILQ_ENTRY(thread) td_blockedq; /* (#) link on turnstile blocked queue */
   TAILQ_ENTRY(thread) td_zombieq;  /* (a) link on zombie queue */
+  TAILQ_ENTRY(thread) td_procq;    /* (p) link on process threads list */
   /* Properties */
   proc_t *td_proc; /*!< (t) parent process (NULL for kernel threads) */
   char *td_name;   /*!< (@) name of thread */
@@ -129,9 +135,11 @@ typedef struct thread {
   turnstile_t *td_turnstile; /*!< (#) thread's turnstile */
   LIST_HEAD(, turnstile) td_contested; /* (#) turnstiles of locks that we own */
   /* scheduler part */
-  prio_t td_base_prio; /*!< ($) base priority */
-  prio_t td_prio;      /*!< ($) active priority */
-  int td_slice;        /*!< ($) time slice length in system ticks */
+  prio_t td_base_prio;    /*!< ($) base priority */
+  prio_t td_prio;         /*!< ($) active priority */
+  int td_slice;           /*!< ($) time slice length in system ticks */
+  runq_t *td_rq;          /*!< ($) run queue the thread is on when ready */
+  volatile bool td_oncpu; /*!< (~) context is in use by some processor */
   /* thread statistics */
   bintime_t td_rtime;        /*!< (*) time spent running */
   bintime_t td_last_rtime;   /*!< (*) time of last switch to running state */
@@ -95,6 +95,18 @@ static inline void tv2ts(const timeval_t *tv, timespec_t *ts) {
   ts->tv_nsec = tv->tv_usec * 1000;
 }
 
+/* 18446744073 = int(2^64 / 1000000000) */
+static inline void ts2bt(const timespec_t *ts, bintime_t *bt) {
+  bt->sec = ts->tv_sec;
+  bt->frac = ts->tv_nsec * (uint64_t)18446744073LL;
+}
+
+/* 18446744073709 = int(2^64 / 1000000) */
+static inline void tv2bt(const timeval_t *tv, bintime_t *bt) {
+  bt->sec = tv->tv_sec;
+  bt->frac = tv->tv_usec * (uint64_t)18446744073709LL;
+}
+
 /* Operations on bintime. */
 #define bintime_cmp(a, b, cmp)                                                 \
   (((a)->sec == (b)->sec) ? (((a)->frac)cmp((b)->frac))                        \
@@ -205,6 +217,14 @@ bintime_t bintime(void);
  * and is maintained by system clock. */
 systime_t getsystime(void);
 
+/* Makes sure system clock interrupt fires no later than at uptime \a when.
+ * Does nothing unless system clock works in tickless mode. */
+void clock_deadline(bintime_t when);
+
+/* Called by scheduler when a thread with \a slice ticks left starts running
+ * (0 for idle thread). Time that passed so far is not charged to the thread. */
+void clock_slice(int slice);
+
 timespec_t nanotime(void);
 
 systime_t ts2hz(const timespec_t *ts);
@@ -73,7 +73,11 @@ int tm_release(timer_t *tm);
 
 /*! \brief Prepares timer to call event trigger callback. */
 int tm_init(timer_t *tm, tm_event_cb_t event, void *arg);
-/*! \brief Configures timer to trigger callback(s). */
+/*! \brief Configures timer to trigger callback(s).
+ *
+ * With TMF_ONESHOT the callback is triggered once after \a start elapses and
+ * \a period is ignored. A one-shot timer that has not fired yet may be started
+ * again to move its deadline. */
 int tm_start(timer_t *tm, unsigned flags, const bintime_t start,
              const bintime_t period);
 /*! \brief Stops timer from triggering a callback. */
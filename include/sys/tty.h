@@ -8,6 +8,7 @@
 #include <sys/mutex.h>
 #include <sys/proc.h>
 #include <sys/devfs.h>
+#include <sys/event.h>
 
 #define TTY_QUEUE_SIZE 0x400
 #define TTY_OUT_LOW_WATER (TTY_QUEUE_SIZE / 4)
@@ -78,6 +79,7 @@ typedef struct tty {
   vnode_t *t_vnode;         /* Device vnode */
   uint32_t t_opencount;     /* Incremented on open(), decremented on close(). */
   void *t_data;             /* Serial device driver's private data */
+  knlist_t t_klist;         /* Knotes monitoring the slave device */
 } tty_t;
 
 /*
@@ -28,18 +28,36 @@ void turnstile_destroy(turnstile_t *ts);
  * \note Requires td_spin acquired. */
 void turnstile_adjust(thread_t *td, prio_t oldprio);
 
-/* Provide turnstile that we're going to block on. */
+/* Lock turnstile chain of given channel. The lock orders all changes of
+ * a lock's waiters with respect to each other, hence the lock's owner must be
+ * released with the chain locked if any thread may be blocked on it.
+ *
+ * Turnstile chain locks are acquired before thread_t::td_lock. */
+void turnstile_chain_lock(void *wchan);
+
+/* Unlock turnstile chain of given channel. */
+void turnstile_chain_unlock(void *wchan);
+
+/* Provide turnstile that we're going to block on. Locks turnstile chain of
+ * given channel, so the caller should recheck whether the lock is still busy
+ * before it decides to block. */
 turnstile_t *turnstile_take(void *wchan);
 
-/* Release turnstile in case we decided not to block on it. */
+/* Release turnstile in case we decided not to block on it and unlock its
+ * turnstile chain. */
 void turnstile_give(turnstile_t *ts);
 
-/* Block the current thread on given turnstile. This function will perform
- * context switch and release turnstile when woken up. */
+/* Block the current thread on given turnstile. This function will unlock
+ * turnstile chain, perform context switch and release turnstile when woken up.
+ *
+ * The priority of the current thread is lent to `owner` of the lock. If the
+ * lock is held by readers, `owner` is NULL and no priority is lent. */
 void turnstile_wait(turnstile_t *ts, thread_t *owner, const void *waitpt);
 
 /* Wakeup all threads waiting on given channel and adjust the priority of the
- * current thread appropriately. */
+ * current thread appropriately. Must be called by the owner of the lock, or
+ * by any of its readers if the turnstile has no owner, with turnstile chain
+ * of the channel locked. */
 void turnstile_broadcast(void *wchan);
 
 #endif /* !_SYS_TURNSTILE_H_ */
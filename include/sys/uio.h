@@ -70,6 +70,14 @@ void uio_restore(uio_t *uio, const uiostate_t *save);
 int uiomove_frombuf(void *buf, size_t buflen, struct uio *uio);
 int iovec_length(const iovec_t *iov, int iovcnt, size_t *lengthp);
 
+/*! \brief Faults in user pages that remain to be transferred by \a uio.
+ *
+ * Used to page in file-backed buffers before retrying an operation that
+ * couldn't do it itself, because it was holding a vnode lock.
+ *
+ * \returns EFAULT if some page could not be faulted in */
+int uio_prefault(uio_t *uio);
+
 #endif /* _KERNEL */
 
 #endif /* !_SYS_UIO_H_ */
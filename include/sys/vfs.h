@@ -123,17 +123,52 @@ int vfs_nameresolve(vnrstate_t *vs);
 int vfs_namelookup(const char *path, vnode_t **vp, cred_t *cred);
 
 /* Uncovers mountpoint if node is mounted.
- * Given vnode should be locked. The returned vnode is also locked. */
+ * Given vnode should be locked. The returned vnode is also locked in the same
+ * mode (shared or exclusive). */
 void vfs_maybe_ascend(vnode_t **vp);
 
 /* Get the root of filesystem if node is a mountpoint.
- * Given vnode should be locked. The returned vnode is locked on success
- * and released on error.*/
+ * Given vnode should be locked. The returned vnode is locked in the same mode
+ * on success and released on error.*/
 int vfs_maybe_descend(vnode_t **vp);
 
 /* Finds name of v-node in given directory. */
 int vfs_name_in_dir(vnode_t *dv, vnode_t *v, char *buf, size_t *lastp);
 
+/*
+ * Name cache maps (directory vnode, component name) pairs to vnodes found by
+ * VOP_LOOKUP. Negative entries remember names that do not exist. Entries do
+ * not hold references to vnodes, they are purged when a vnode is freed.
+ */
+
+typedef struct nchstats {
+  unsigned ncs_hits;    /* positive hits */
+  unsigned ncs_neghits; /* negative hits */
+  unsigned ncs_misses;  /* lookups that had to call VOP_LOOKUP */
+  unsigned ncs_entries; /* current number of entries */
+} nchstats_t;
+
+/* Looks up \a cn in directory \a dv. On a hit returns true and sets `*vp_p`
+ * to referenced vnode, or NULL for a negative entry. On a miss stores cache
+ * generation in `*gen_p`, which must be passed to `vfs_cache_enter`. */
+bool vfs_cache_lookup(vnode_t *dv, const componentname_t *cn, vnode_t **vp_p,
+                      unsigned *gen_p);
+
+/* Adds result of VOP_LOOKUP to the cache (negative entry if \a vp is NULL).
+ * Nothing is added if the cache was invalidated since lookup at \a gen. */
+void vfs_cache_enter(vnode_t *dv, const componentname_t *cn, vnode_t *vp,
+                     unsigned gen);
+
+/* Removes entry for \a cn in directory \a dv. Must be called whenever a name
+ * is added to or removed from a directory. */
+void vfs_cache_remove(vnode_t *dv, const componentname_t *cn);
+
+/* Removes all entries referring to \a v either as directory or as target. */
+void vfs_cache_purge(vnode_t *v);
+
+/* Copies name cache statistics into \a ncs. */
+void vfs_cache_stats(nchstats_t *ncs);
+
 #endif /* !_KERNEL */
 
 #endif /* !_SYS_VFS_H_ */
@@ -55,9 +55,8 @@ typedef uintptr_t vm_offset_t;
 
 struct vm_page {
   union {
-    TAILQ_ENTRY(vm_page) freeq;    /* (P) list of free pages for buddy system */
-    TAILQ_ENTRY(vm_page) pageq;    /* used to group allocated pages */
-    TAILQ_ENTRY(vm_page) objpages; /* (O) list of pages in vm_object */
+    TAILQ_ENTRY(vm_page) freeq; /* (P) list of free pages for buddy system */
+    TAILQ_ENTRY(vm_page) pageq; /* used to group allocated pages */
     slab_t *slab; /* active when page is used by pool allocator */
   };
   TAILQ_HEAD(, pv_entry) pv_list; /* (@) where this page is mapped? */
@@ -68,8 +67,10 @@ struct vm_page {
   uint32_t size;                  /* (P) size of page in PAGESIZE units */
 };
 
-int do_mmap(vaddr_t *addr_p, size_t length, int u_prot, int u_flags);
+int do_mmap(vaddr_t *addr_p, size_t length, int u_prot, int u_flags, int fd,
+            off_t pos);
 int do_munmap(vaddr_t addr, size_t length);
+int do_mprotect(vaddr_t addr, size_t length, int u_prot);
 
 #endif /* !_KERNEL */
 
@@ -5,6 +5,7 @@
 #include <sys/pmap.h>
 #include <sys/vm.h>
 #include <sys/mutex.h>
+#include <sys/rwlock.h>
 
 typedef struct vm_map vm_map_t;
 typedef struct vm_map_entry vm_map_entry_t;
@@ -14,13 +15,24 @@ typedef enum {
   VM_ENT_PRIVATE = 2, /* private memory (default) */
 } vm_entry_flags_t;
 
+/*! \brief Default size of fault-around window in pages (64KiB). */
+#define VM_FAULT_AROUND 16
+
 /*! \brief Called during kernel initialization. */
 void init_vm_map(void);
 
-/*! \brief Acquire vm_map non-recursive mutex. */
+/*! \brief Acquire vm_map non-recursive lock for modification. */
 void vm_map_lock(vm_map_t *map);
 
-/*! \brief Release vm_map non-recursive mutex. */
+/*! \brief Acquire vm_map non-recursive lock for reading only.
+ *
+ * Many threads may hold it at once, e.g. to handle page faults. */
+void vm_map_lock_read(vm_map_t *map);
+
+/*! \brief Release vm_map lock acquired in either mode.
+ *
+ * Objects of entries destroyed while the lock was held are released after
+ * the lock is dropped, as releasing a file object may write back its pages. */
 void vm_map_unlock(vm_map_t *map);
 
 DEFINE_CLEANUP_FUNCTION(vm_map_t *, vm_map_unlock);
@@ -31,6 +43,12 @@ DEFINE_CLEANUP_FUNCTION(vm_map_t *, vm_map_unlock);
 #define SCOPED_VM_MAP_LOCK(map)                                                \
   SCOPED_STMT(vm_map_t, vm_map_lock, CLEANUP_FUNCTION(vm_map_unlock), map)
 
+#define WITH_VM_MAP_LOCK_READ(map)                                             \
+  WITH_STMT(vm_map_t, vm_map_lock_read, CLEANUP_FUNCTION(vm_map_unlock), map)
+
+#define SCOPED_VM_MAP_LOCK_READ(map)                                           \
+  SCOPED_STMT(vm_map_t, vm_map_lock_read, CLEANUP_FUNCTION(vm_map_unlock), map)
+
 void vm_map_activate(vm_map_t *map);
 void vm_map_switch(thread_t *td);
 
@@ -41,15 +59,54 @@ vm_map_t *vm_map_lookup(vaddr_t addr);
 vm_map_t *vm_map_new(void);
 void vm_map_delete(vm_map_t *vm_map);
 
+/*! \brief Sets size of fault-around window of \a map.
+ *
+ * On a page fault resident pages of the same entry that fall into an aligned
+ * window of \a npages pages get mapped as well. If the fault zero-filled
+ * anonymous memory, missing pages of the window are zero-filled too.
+ * \a npages must be a power of 2, values less than 2 disable fault-around. */
+void vm_map_set_fault_around(vm_map_t *map, unsigned npages);
+
+/*! \brief Reports number of page faults handled for \a map and number of
+ * pages it mapped in advance with fault-around. */
+void vm_map_fault_stats(vm_map_t *map, unsigned *faults_p,
+                        unsigned *prefaulted_p);
+
 vm_map_entry_t *vm_map_entry_alloc(vm_object_t *obj, vaddr_t start, vaddr_t end,
                                    vm_prot_t prot, vm_entry_flags_t flags);
+
+/*! \brief Sets offset within object of \a ent that is mapped at its start. */
+void vm_map_entry_set_offset(vm_map_entry_t *ent, vm_offset_t offset);
+
 void vm_map_entry_destroy(vm_map_t *map, vm_map_entry_t *ent);
 void vm_map_entry_destroy_range(vm_map_t *map, vm_map_entry_t *ent,
                                 vaddr_t start, vaddr_t end);
 
 vm_map_entry_t *vm_map_find_entry(vm_map_t *vm_map, vaddr_t vaddr);
 
-void vm_map_protect(vm_map_t *map, vaddr_t start, vaddr_t end, vm_prot_t prot);
+/*! \brief Finds object that backs \a vaddr in \a map if it's mapped shared.
+ *
+ * On success \a obj_p is set to referenced object and \a offset_p to offset of
+ * \a vaddr within it. For private mappings \a obj_p is set to NULL.
+ *
+ * \returns EFAULT if \a vaddr is not mapped */
+int vm_map_shared_object(vm_map_t *map, vaddr_t vaddr, vm_object_t **obj_p,
+                         vm_offset_t *offset_p);
+
+/*! \brief Checks whether range [\a start, \a end) is entirely mapped with
+ * anonymous memory.
+ *
+ * Pages of such memory are freed only once all mappings of their objects are
+ * gone, unlike file pages, which are freed when the file gets modified. */
+bool vm_map_anonymous_p(vm_map_t *map, vaddr_t start, vaddr_t end);
+
+/*! \brief Changes protection of pages in range [\a start, \a end) to \a prot.
+ *
+ * Entries that cross range boundaries get split.
+ *
+ * \returns ENOMEM if part of the range is not mapped, EACCES if \a prot
+ * exceeds maximum protection of some entry. Nothing is changed on failure. */
+int vm_map_protect(vm_map_t *map, vaddr_t start, vaddr_t end, vm_prot_t prot);
 
 /*! \brief Insert given \a entry into the \a map. */
 int vm_map_insert(vm_map_t *map, vm_map_entry_t *entry, vm_flags_t flags);
@@ -76,9 +133,15 @@ vm_map_entry_t *vm_map_entry_next(vm_map_entry_t *ent);
  */
 int vm_map_findspace(vm_map_t *map, vaddr_t /*inout*/ *start_p, size_t length);
 
-/*! \brief Allocates entry and associate anonymous memory object with it. */
-int vm_map_alloc_entry(vm_map_t *map, vaddr_t addr, size_t length,
-                       vm_prot_t prot, vm_flags_t flags,
+/*! \brief Allocates entry that maps \a obj starting at \a offset.
+ *
+ * If \a obj is NULL, anonymous memory object is associated with the entry.
+ * Otherwise the entry takes over caller's reference to \a obj, which gets
+ * dropped on failure. Protection of the entry can never be raised above
+ * \a max_prot. */
+int vm_map_alloc_entry(vm_map_t *map, vm_object_t *obj, vm_offset_t offset,
+                       vaddr_t addr, size_t length, vm_prot_t prot,
+                       vm_prot_t max_prot, vm_flags_t flags,
                        vm_map_entry_t **ent_p);
 
 /* Tries to resize an entry, by moving its end if there
@@ -87,8 +150,16 @@ int vm_map_entry_resize(vm_map_t *map, vm_map_entry_t *ent, vaddr_t new_end);
 
 void vm_map_dump(vm_map_t *vm_map);
 
+/*! \brief Creates a copy of \a map for a forked process.
+ *
+ * Shared entries refer to the same objects in both maps. Private entries are
+ * copied lazily: both maps get shadow objects on top of the original one and
+ * pages are copied on first write fault. */
 vm_map_t *vm_map_clone(vm_map_t *map);
 
+/*! \brief Number of pages copied on write fault since boot. */
+extern atomic_uint vm_cow_copies;
+
 int vm_page_fault(vm_map_t *map, vaddr_t fault_addr, vm_prot_t fault_type);
 
 #endif /* !_SYS_VM_MAP_H_ */
@@ -3,6 +3,7 @@
 
 #include <sys/vm.h>
 #include <sys/vm_pager.h>
+#include <sys/vm_radix.h>
 #include <sys/mutex.h>
 #include <sys/refcnt.h>
 
@@ -15,10 +16,13 @@
 
 typedef struct vm_object {
   mtx_t vo_lock;
-  vm_pagelist_t vo_pages; /* (@) List of pages */
-  size_t vo_npages;       /* (@) Number of pages */
-  vm_pager_t *vo_pager;   /* Pager type and page fault function for object */
-  refcnt_t vo_refs;       /* (a) How many objects refer to this object? */
+  vm_radix_t vo_pages;     /* (@) Pages indexed by offset */
+  vm_radix_t vo_dirty;     /* (@) Pages modified through shared mappings */
+  size_t vo_npages;        /* (@) Number of pages */
+  vm_pager_t *vo_pager;    /* Pager type and page fault function for object */
+  refcnt_t vo_refs;        /* (a) How many objects refer to this object? */
+  vm_object_t *vo_backing; /* (@) Object shadowed by this one (or NULL) */
+  void *vo_handle;         /* Pager private data (e.g. backing vnode) */
 } vm_object_t;
 
 vm_object_t *vm_object_alloc(vm_pgr_type_t type);
@@ -27,7 +31,57 @@ void vm_object_drop(vm_object_t *obj);
 void vm_object_add_page(vm_object_t *obj, vm_offset_t off, vm_page_t *pg);
 void vm_object_remove_pages(vm_object_t *obj, vm_offset_t off, size_t len);
 vm_page_t *vm_object_find_page(vm_object_t *obj, vm_offset_t off);
-vm_object_t *vm_object_clone(vm_object_t *obj);
+
+/*! \brief Same as vm_object_find_page, but with vo_lock held by the caller. */
+vm_page_t *vm_object_find_page_nolock(vm_object_t *obj, vm_offset_t off);
+
+/*! \brief Checks if \a obj contains any page in range [off, off + len). */
+bool vm_object_has_pages(vm_object_t *obj, vm_offset_t off, size_t len);
+
+/*! \brief Inserts \a n consecutive pages starting with \a pg at \a off.
+ *
+ * Pages must come from a single block split with vm_page_split.
+ *
+ * \returns false without inserting anything if the range is not empty */
+bool vm_object_add_pages(vm_object_t *obj, vm_offset_t off, vm_page_t *pg,
+                         size_t n);
+
+/*! \brief Marks \a pg at \a off as modified, so the pager writes it back.
+ *
+ * Must be called with vo_lock held, which is also required to enter a writable
+ * mapping of the page. Pager unmaps dirty pages under the same lock, before
+ * it starts writing them back.
+ *
+ * \returns false if \a pg is no longer present in \a obj */
+bool vm_object_set_dirty(vm_object_t *obj, vm_offset_t off, vm_page_t *pg);
+
+/*! \brief Creates an anonymous object that shadows \a obj.
+ *
+ * Pages not present in the new object are looked up in \a obj, which should
+ * not be modified from now on. The new object holds a reference to \a obj. */
+vm_object_t *vm_object_shadow(vm_object_t *obj);
+
+/*! \brief Looks up a page at \a off in \a obj and the objects it shadows.
+ *
+ * \param owner_p if not NULL, is set to the object the page was found in
+ * \returns the page or NULL if none of the objects contains it */
+vm_page_t *vm_object_lookup_page(vm_object_t *obj, vm_offset_t off,
+                                 vm_object_t **owner_p);
+
+/*! \brief Returns the deepest object in a shadow chain starting at \a obj. */
+vm_object_t *vm_object_bottom(vm_object_t *obj);
+
+/*! \brief Merges backing objects referenced only by \a obj into \a obj.
+ *
+ * Keeps shadow chains short when processes that shared memory with \a obj
+ * through copy-on-write have exited. */
+void vm_object_collapse(vm_object_t *obj);
+
+/*! \brief Hides pages of backing objects in range [off, off + len).
+ *
+ * Each such page gets covered by a zeroed page in \a obj. */
+void vm_object_cover_backing(vm_object_t *obj, vm_offset_t off, size_t len);
+
 void vm_object_dump(vm_object_t *obj);
 
 #endif /* !_SYS_VM_OBJECT_H_ */
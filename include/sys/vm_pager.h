@@ -3,18 +3,51 @@
 
 #include <sys/vm.h>
 
+typedef struct vnode vnode_t;
+typedef struct devnode devnode_t;
+
 typedef enum {
   VM_DUMMY,
   VM_ANONYMOUS,
+  VM_VNODE,
+  VM_DEVICE,
 } vm_pgr_type_t;
 
 typedef vm_page_t *vm_pgr_fault_t(vm_object_t *obj, off_t offset);
+typedef void vm_pgr_free_t(vm_object_t *obj);
 
 typedef struct vm_pager {
   vm_pgr_type_t pgr_type;
   vm_pgr_fault_t *pgr_fault;
+  vm_pgr_free_t *pgr_free; /* Called when last reference to object is gone */
 } vm_pager_t;
 
 extern vm_pager_t pagers[];
 
+/*! \brief Returns the object caching pages of regular file \a vn.
+ *
+ * Every caller gets the same object as long as it is referenced by anyone,
+ * hence clean pages of the file are shared by all its mappings. The object is
+ * returned with reference count incremented and holds a reference to \a vn. */
+vm_object_t *vnode_pager_object(vnode_t *vn);
+
+/*! \brief Discards cached pages of \a vn in range [off, off + len).
+ *
+ * Must be called whenever contents of the file change, so that subsequent
+ * page faults read in fresh data. */
+void vnode_pager_invalidate(vnode_t *vn, off_t off, size_t len);
+
+/*! \brief Writes back pages of \a vn modified through shared mappings.
+ *
+ * Must be called with \a vn locked exclusively before the file is accessed
+ * with VOP_READ or VOP_WRITE. Pages that were written back get unmapped, so
+ * that subsequent modifications are noticed as well. */
+void vnode_pager_flush(vnode_t *vn);
+
+/*! \brief Returns an object mapping memory exposed by \a dev.
+ *
+ * Page faults ask the driver for physical addresses with `d_mmap`. The pages
+ * are never owned by the object and get mapped uncached. */
+vm_object_t *dev_pager_object(devnode_t *dev);
+
 #endif /* !_SYS_VM_PAGER_H_ */
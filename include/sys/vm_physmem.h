@@ -13,9 +13,19 @@ void init_vm_page(void);
 #define vm_physseg_plug_used(start, end) _vm_physseg_plug((start), (end), true)
 void _vm_physseg_plug(paddr_t start, paddr_t end, bool used);
 
+/* \brief Creates vm_page structures for device memory (e.g. a framebuffer).
+ *
+ * Range [start, end) must not overlap with RAM. The pages are never allocated
+ * nor freed, but can be mapped into user space (see `d_mmap` in devfs.h). */
+void vm_physseg_plug_device(paddr_t start, paddr_t end);
+
 /* Allocates contiguous big page that consists of n machine pages. */
 vm_page_t *vm_page_alloc(size_t n);
 
+/* Breaks big page returned by vm_page_alloc into pages of size 1, so that each
+ * of them can be freed on its own. */
+void vm_page_split(vm_page_t *pg);
+
 /* Allocates `n` pages in various sizes and puts them on `pglist`. Always
  * initializes `pglist`. Returns ENOMEM if the request cannot be satisfied. */
 int vm_pagelist_alloc(size_t n, vm_pagelist_t *pglist);
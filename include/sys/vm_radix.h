@@ -0,0 +1,49 @@
+#ifndef _SYS_VM_RADIX_H_
+#define _SYS_VM_RADIX_H_
+
+#include <sys/vm.h>
+
+/*! \brief Radix tree of pages indexed by their offset in vm_object.
+ *
+ * Each node resolves 4 bits of page index, so the tree is only as high as
+ * needed to cover the greatest offset stored in it. Lookups and insertions
+ * take time proportional to the height instead of the number of pages.
+ *
+ * The tree is not synchronized, it's protected by the lock of the object that
+ * owns it. */
+typedef struct vm_radix {
+  void *rt_root;      /* root node or NULL if the tree is empty */
+  unsigned rt_height; /* number of node levels below (and including) root */
+} vm_radix_t;
+
+void vm_radix_init(vm_radix_t *rt);
+
+/*! \brief Inserts \a pg at the position given by its offset.
+ *
+ * There must be no page with the same offset in the tree. */
+void vm_radix_insert(vm_radix_t *rt, vm_page_t *pg);
+
+/*! \brief Returns the page at offset \a off or NULL. */
+vm_page_t *vm_radix_lookup(vm_radix_t *rt, vm_offset_t off);
+
+/*! \brief Returns the page with the lowest offset not less than \a off.
+ *
+ * Used to iterate over pages in ascending order of offsets. */
+vm_page_t *vm_radix_lookup_ge(vm_radix_t *rt, vm_offset_t off);
+
+/*! \brief Removes the page at offset \a off from the tree.
+ *
+ * \returns the page that was removed or NULL if there was none */
+vm_page_t *vm_radix_remove(vm_radix_t *rt, vm_offset_t off);
+
+static inline bool vm_radix_empty(vm_radix_t *rt) {
+  return rt->rt_root == NULL;
+}
+
+/* Iterates over pages in range [start, end). The loop body must not remove
+ * current page from the tree. */
+#define VM_RADIX_FOREACH(pg, rt, start, end)                                   \
+  for ((pg) = vm_radix_lookup_ge((rt), (start)); (pg) && (pg)->offset < (end); \
+       (pg) = vm_radix_lookup_ge((rt), (pg)->offset + PAGESIZE))
+
+#endif /* !_SYS_VM_RADIX_H_ */
@@ -7,6 +7,7 @@
 #include <sys/refcnt.h>
 #include <sys/spinlock.h>
 #include <sys/condvar.h>
+#include <sys/sx.h>
 #include <sys/file.h>
 #include <sys/time.h>
 
@@ -19,6 +20,7 @@ typedef struct dirent dirent_t;
 typedef struct stat stat_t;
 typedef struct componentname componentname_t;
 typedef struct cred cred_t;
+typedef struct vm_object vm_object_t;
 
 /* Indicates that given field of vattr structure does not hold a value.
  * vnodeops should not modify attributes set to VNOVAL. */
@@ -83,12 +85,6 @@ typedef struct vnodeops {
 /* Fill missing entries with default vnode operation. */
 void vnodeops_init(vnodeops_t *vops);
 
-typedef struct {
-  bool vl_locked;
-  condvar_t vl_cv;
-  spin_t vl_interlock;
-} vnlock_t;
-
 typedef struct vnode {
   vnodetype_t v_type;        /* Vnode type, see above */
   TAILQ_ENTRY(vnode) v_list; /* Entry on the mount vnodes list */
@@ -104,7 +100,13 @@ typedef struct vnode {
   };
 
   refcnt_t v_usecnt;
-  vnlock_t v_lock;
+  sx_t v_lock;
+
+  vm_object_t *v_object; /* Pages of regular file cached by vnode pager */
+
+  /* Name cache entries, protected by name cache lock */
+  LIST_HEAD(, ncentry) v_ncsrc; /* Entries for names in this directory */
+  LIST_HEAD(, ncentry) v_ncdst; /* Entries resolving to this vnode */
 } vnode_t;
 
 static inline bool is_mountpoint(vnode_t *v) {
@@ -215,16 +217,26 @@ static inline int VOP_LINK(vnode_t *dv, vnode_t *v, componentname_t *cn) {
 /* Allocates and initializes a new vnode */
 vnode_t *vnode_new(vnodetype_t type, vnodeops_t *ops, void *data);
 
-/* Lock and unlock vnode's mutex.
- * Call vnode_lock whenever you're about to use vnode's contents. */
+/* Lock and unlock vnode. The lock may be held while sleeping.
+ * Call vnode_lock whenever you're about to use vnode's contents. Shared lock
+ * is enough if you only read them, e.g. to look up a name in a directory.
+ * vnode_unlock releases the lock in either mode. */
 void vnode_lock(vnode_t *v);
+void vnode_lock_shared(vnode_t *v);
 void vnode_unlock(vnode_t *v);
 
+/* Check if calling thread holds exclusive lock on the vnode. */
+bool vnode_xlocked(vnode_t *v);
+
 /* Increase and decrease the use counter.
  * Call vnode_ref if you don't want the vnode to be recycled. */
 void vnode_hold(vnode_t *v);
 void vnode_drop(vnode_t *v);
 
+/* Increase the use counter unless the vnode is already being reclaimed.
+ * Lets file systems and name cache reuse vnodes they keep pointers to. */
+bool vnode_tryhold(vnode_t *v);
+
 /* Increment reference counter and lock the vnode. */
 void vnode_get(vnode_t *v);
 
@@ -247,6 +259,8 @@ int default_vnclose(file_t *f);
 int default_vnstat(file_t *f, stat_t *sb);
 int default_vnseek(file_t *f, off_t offset, int whence, off_t *newoffp);
 int default_vnioctl(file_t *f, u_long cmd, void *data);
+int default_vnmmap(file_t *f, off_t offset, size_t length, vm_prot_t prot,
+                   vm_object_t **obj_p);
 
 uint8_t vt2dt(vnodetype_t v_type);
 
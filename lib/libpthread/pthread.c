@@ -0,0 +1,229 @@
+#include <sys/mman.h>
+#include <errno.h>
+#include <lwp.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pthread_int.h"
+
+pthread_mutex_t pthread__lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* All threads created with pthread_create and the main thread. */
+static TAILQ_HEAD(, __pthread_st) pthread__threads =
+  TAILQ_HEAD_INITIALIZER(pthread__threads);
+static struct __pthread_st pthread__main;
+/* Threads that haven't called pthread_exit yet. */
+static unsigned pthread__nthreads = 1;
+
+/* Main thread is added to the list once the first thread gets created. */
+static void pthread__init(void) {
+  if (pthread__main.pt_lid)
+    return;
+  pthread__main.pt_lid = _lwp_self();
+  TAILQ_INSERT_HEAD(&pthread__threads, &pthread__main, pt_link);
+}
+
+static void pthread__free(pthread_t t) {
+  /* Wait until the thread leaves its stack for good. */
+  while (_lwp_wait(t->pt_lid, NULL) == EINTR)
+    continue;
+  if (t->pt_stack)
+    munmap(t->pt_stack, t->pt_stacksize);
+}
+
+/* Releases stacks of detached threads that have already exited, unless
+ * pthread_join is going to do it. */
+static void pthread__reap(void) {
+  TAILQ_HEAD(, __pthread_st) dead = TAILQ_HEAD_INITIALIZER(dead);
+  pthread_t t, next;
+
+  pthread_mutex_lock(&pthread__lock);
+  TAILQ_FOREACH_SAFE (t, &pthread__threads, pt_link, next) {
+    if ((t->pt_flags & (PT_DETACHED | PT_EXITED | PT_JOINING)) ==
+        (PT_DETACHED | PT_EXITED)) {
+      TAILQ_REMOVE(&pthread__threads, t, pt_link);
+      TAILQ_INSERT_TAIL(&dead, t, pt_link);
+    }
+  }
+  pthread_mutex_unlock(&pthread__lock);
+
+  while ((t = TAILQ_FIRST(&dead))) {
+    TAILQ_REMOVE(&dead, t, pt_link);
+    pthread__free(t);
+  }
+}
+
+static void pthread__start(void *arg) {
+  pthread_t self = arg;
+  /* The creator may not have stored the identifier yet. */
+  self->pt_lid = _lwp_self();
+  pthread_exit(self->pt_func(self->pt_arg));
+}
+
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                   void *(*func)(void *), void *arg) {
+  size_t pagesize = getpagesize();
+  size_t stacksize = PT_STACKSIZE_DEFAULT;
+  int detachstate = PTHREAD_CREATE_JOINABLE;
+  int error;
+
+  if (attr) {
+    stacksize = attr->pta_stacksize;
+    detachstate = attr->pta_detachstate;
+  }
+
+  stacksize = (stacksize + pagesize - 1) & ~(pagesize - 1);
+
+  pthread__init();
+  pthread__reap();
+
+  void *stack = mmap(NULL, stacksize, PROT_READ | PROT_WRITE,
+                     MAP_ANON | MAP_PRIVATE, -1, 0);
+  if (stack == MAP_FAILED)
+    return EAGAIN;
+
+  /* Stack overflow should end up with SIGSEGV rather than silent corruption
+   * of adjacent mapping. */
+  (void)mprotect(stack, pagesize, PROT_NONE);
+
+  /* Thread structure is placed at the top of the stack. */
+  uintptr_t top = (uintptr_t)stack + stacksize - sizeof(struct __pthread_st);
+  pthread_t t = (pthread_t)(top & ~(uintptr_t)15);
+  memset(t, 0, sizeof(struct __pthread_st));
+  t->pt_func = func;
+  t->pt_arg = arg;
+  t->pt_stack = stack;
+  t->pt_stacksize = stacksize;
+  if (detachstate == PTHREAD_CREATE_DETACHED)
+    t->pt_flags = PT_DETACHED;
+
+  pthread_mutex_lock(&pthread__lock);
+  TAILQ_INSERT_TAIL(&pthread__threads, t, pt_link);
+  pthread__nthreads++;
+  pthread_mutex_unlock(&pthread__lock);
+
+  /* Leave some room above stack pointer, as MIPS callees may store their
+   * arguments there. */
+  void *sp = (void *)((uintptr_t)t - 32);
+
+  if ((error = _lwp_create(pthread__start, t, sp, &t->pt_lid))) {
+    pthread_mutex_lock(&pthread__lock);
+    TAILQ_REMOVE(&pthread__threads, t, pt_link);
+    pthread__nthreads--;
+    pthread_mutex_unlock(&pthread__lock);
+    munmap(stack, stacksize);
+    return error;
+  }
+
+  *thread = t;
+  return 0;
+}
+
+pthread_t pthread_self(void) {
+  tid_t lid = _lwp_self();
+  pthread_t t;
+
+  pthread_mutex_lock(&pthread__lock);
+  TAILQ_FOREACH (t, &pthread__threads, pt_link) {
+    if (t->pt_lid == lid)
+      break;
+  }
+  pthread_mutex_unlock(&pthread__lock);
+
+  /* Until the first thread is created the main thread is not on the list. */
+  return t ? t : &pthread__main;
+}
+
+int pthread_equal(pthread_t t1, pthread_t t2) {
+  return t1 == t2;
+}
+
+__noreturn void pthread_exit(void *retval) {
+  pthread_t self = pthread_self();
+  bool last;
+
+  pthread_mutex_lock(&pthread__lock);
+  self->pt_retval = retval;
+  self->pt_flags |= PT_EXITED;
+  last = (--pthread__nthreads == 0);
+  pthread_mutex_unlock(&pthread__lock);
+
+  /* Process terminates as if exit was called by the last thread. */
+  if (last)
+    exit(0);
+
+  _lwp_exit();
+}
+
+int pthread_join(pthread_t t, void **retvalp) {
+  int error;
+
+  if (t == pthread_self())
+    return EDEADLK;
+
+  pthread_mutex_lock(&pthread__lock);
+  if (t->pt_flags & (PT_DETACHED | PT_JOINING)) {
+    pthread_mutex_unlock(&pthread__lock);
+    return EINVAL;
+  }
+  /* Nobody else may join or detach the thread from now on. */
+  t->pt_flags |= PT_JOINING;
+  pthread_mutex_unlock(&pthread__lock);
+
+  while ((error = _lwp_wait(t->pt_lid, NULL))) {
+    if (error != EINTR) {
+      pthread_mutex_lock(&pthread__lock);
+      t->pt_flags &= ~PT_JOINING;
+      pthread_mutex_unlock(&pthread__lock);
+      return error;
+    }
+  }
+
+  pthread_mutex_lock(&pthread__lock);
+  TAILQ_REMOVE(&pthread__threads, t, pt_link);
+  pthread_mutex_unlock(&pthread__lock);
+
+  if (retvalp)
+    *retvalp = t->pt_retval;
+
+  if (t->pt_stack)
+    munmap(t->pt_stack, t->pt_stacksize);
+  return 0;
+}
+
+int pthread_detach(pthread_t t) {
+  int error = 0;
+
+  pthread_mutex_lock(&pthread__lock);
+  if (t->pt_flags & (PT_DETACHED | PT_JOINING))
+    error = EINVAL;
+  else
+    t->pt_flags |= PT_DETACHED;
+  pthread_mutex_unlock(&pthread__lock);
+
+  /* If the thread has already exited it will be reaped by pthread_create. */
+  return error;
+}
+
+int pthread_once(pthread_once_t *once, void (*func)(void)) {
+  if (atomic_load(PT_ATOMIC(&once->pto_done)))
+    return 0;
+
+  pthread_mutex_lock(&once->pto_mutex);
+  if (!once->pto_done) {
+    func();
+    atomic_store(PT_ATOMIC(&once->pto_done), 1);
+  }
+  pthread_mutex_unlock(&once->pto_mutex);
+  return 0;
+}
+
+int pthread_sigmask(int how, const sigset_t *set, sigset_t *oset) {
+  /* Signal mask is kept by the kernel for each thread separately. */
+  if (sigprocmask(how, set, oset))
+    return errno;
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <sys/futex.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+#include "pthread_int.h"
+
+/*
+ * Each signal or broadcast bumps the sequence number. A waiter sleeps on it
+ * with futex, as long as it's equal to the one read while holding the mutex,
+ * so a signal sent after the mutex was released cannot get lost. Waiters may
+ * return without being signaled, which is allowed as a spurious wakeup.
+ */
+
+int pthread_cond_init(pthread_cond_t *c, const pthread_condattr_t *attr) {
+  c->ptc_seq = 0;
+  return 0;
+}
+
+int pthread_cond_destroy(pthread_cond_t *c) {
+  return 0;
+}
+
+int pthread_cond_timedwait(pthread_cond_t *c, pthread_mutex_t *m,
+                           const struct timespec *abstime) {
+  unsigned seq = atomic_load(PT_ATOMIC(&c->ptc_seq));
+  struct timespec now, timeout;
+  int error = 0;
+
+  pthread_mutex_unlock(m);
+
+  if (abstime) {
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (timespeccmp(&now, abstime, >=)) {
+      error = ETIMEDOUT;
+    } else {
+      timespecsub(abstime, &now, &timeout);
+    }
+  }
+
+  if (!error && futex(PT_FUTEX(&c->ptc_seq), FUTEX_WAIT, seq,
+                      abstime ? &timeout : NULL) == -ETIMEDOUT)
+    error = ETIMEDOUT;
+
+  pthread_mutex_lock(m);
+  return error;
+}
+
+int pthread_cond_wait(pthread_cond_t *c, pthread_mutex_t *m) {
+  return pthread_cond_timedwait(c, m, NULL);
+}
+
+int pthread_cond_signal(pthread_cond_t *c) {
+  atomic_fetch_add(PT_ATOMIC(&c->ptc_seq), 1);
+  futex(PT_FUTEX(&c->ptc_seq), FUTEX_WAKE, 1, NULL);
+  return 0;
+}
+
+int pthread_cond_broadcast(pthread_cond_t *c) {
+  atomic_fetch_add(PT_ATOMIC(&c->ptc_seq), 1);
+  futex(PT_FUTEX(&c->ptc_seq), FUTEX_WAKE, INT_MAX, NULL);
+  return 0;
+}
+
+int pthread_condattr_init(pthread_condattr_t *attr) {
+  attr->ptca_clock = CLOCK_REALTIME;
+  return 0;
+}
+
+int pthread_condattr_destroy(pthread_condattr_t *attr) {
+  return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef _PTHREAD_INT_H_
+#define _PTHREAD_INT_H_
+
+#include <sys/queue.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define PT_STACKSIZE_DEFAULT (256 * 1024)
+
+/* Fields of public types are plain integers, so treat them as atomic here. */
+#define PT_ATOMIC(p) ((atomic_uint *)(p))
+/* ... and pass them to futex system call as words to sleep on. */
+#define PT_FUTEX(p) ((int *)(p))
+
+typedef enum {
+  PT_DETACHED = 0x1, /* nobody is going to join the thread */
+  PT_EXITED = 0x2,   /* thread called pthread_exit */
+  PT_JOINING = 0x4,  /* some thread waits in pthread_join for the thread */
+} pt_flags_t;
+
+/* Threads other than the main one keep this structure at the top of their
+ * stack, which is released once the thread is joined. Fields are protected by
+ * `pthread__lock` unless marked otherwise. */
+struct __pthread_st {
+  TAILQ_ENTRY(__pthread_st) pt_link; /* link on list of all threads */
+  tid_t pt_lid;                      /* kernel thread identifier */
+  pt_flags_t pt_flags;               /* PT_* flags */
+  void *(*pt_func)(void *);          /* (!) start routine */
+  void *pt_arg;                      /* (!) start routine argument */
+  void *pt_retval;                   /* value passed to pthread_exit */
+  void *pt_stack;                    /* (!) mapped stack or NULL for main */
+  size_t pt_stacksize;               /* (!) size of the mapping */
+};
+
+extern pthread_mutex_t pthread__lock;
+
+#endif /* !_PTHREAD_INT_H_ */
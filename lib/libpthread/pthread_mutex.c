@@ -0,0 +1,67 @@
+#include <sys/futex.h>
+#include <errno.h>
+
+#include "pthread_int.h"
+
+/*
+ * Lock word is 0 if the mutex is free, 1 if it's taken and 2 if it's taken
+ * and some threads may sleep on it in the kernel. Locking a free mutex and
+ * unlocking one that nobody waits for do not enter the kernel.
+ */
+
+#define PTM_UNLOCKED 0
+#define PTM_LOCKED 1
+#define PTM_CONTESTED 2
+
+int pthread_mutex_init(pthread_mutex_t *m, const pthread_mutexattr_t *attr) {
+  m->ptm_lock = PTM_UNLOCKED;
+  return 0;
+}
+
+int pthread_mutex_destroy(pthread_mutex_t *m) {
+  if (m->ptm_lock != PTM_UNLOCKED)
+    return EBUSY;
+  return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t *m) {
+  unsigned v = PTM_UNLOCKED;
+
+  if (atomic_compare_exchange_strong(PT_ATOMIC(&m->ptm_lock), &v, PTM_LOCKED))
+    return 0;
+
+  /* We cannot tell whether there are other waiters, so once we get the mutex
+   * it stays contested and unlocking it will wake somebody up. */
+  if (v != PTM_CONTESTED)
+    v = atomic_exchange(PT_ATOMIC(&m->ptm_lock), PTM_CONTESTED);
+
+  while (v != PTM_UNLOCKED) {
+    futex(PT_FUTEX(&m->ptm_lock), FUTEX_WAIT, PTM_CONTESTED, NULL);
+    v = atomic_exchange(PT_ATOMIC(&m->ptm_lock), PTM_CONTESTED);
+  }
+
+  return 0;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t *m) {
+  unsigned v = PTM_UNLOCKED;
+
+  if (!atomic_compare_exchange_strong(PT_ATOMIC(&m->ptm_lock), &v, PTM_LOCKED))
+    return EBUSY;
+  return 0;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *m) {
+  if (atomic_exchange(PT_ATOMIC(&m->ptm_lock), PTM_UNLOCKED) == PTM_CONTESTED)
+    futex(PT_FUTEX(&m->ptm_lock), FUTEX_WAKE, 1, NULL);
+  return 0;
+}
+
+int pthread_mutexattr_init(pthread_mutexattr_t *attr) {
+  attr->ptma_type = 0;
+  return 0;
+}
+
+int pthread_mutexattr_destroy(pthread_mutexattr_t *attr) {
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include <sys/mimiker.h>
 #include <sys/pcpu.h>
 #include <sys/kasan.h>
+#include <sys/thread.h>
 #include <aarch64/armreg.h>
 #include <aarch64/vm_param.h>
 #include <aarch64/pmap.h>
@@ -41,7 +42,7 @@ static __boot_text void *bootmem_alloc(size_t bytes) {
   return addr;
 }
 
-__boot_text static void configure_cpu(void) {
+__boot_text static void configure_cpu(unsigned cpuid) {
   /* Enable hw management of data coherency with other cores in the cluster. */
   WRITE_SPECIALREG(S3_1_C15_c2_1, READ_SPECIALREG(S3_1_C15_C2_1) | SMPEN);
   __dsb("sy");
@@ -55,7 +56,7 @@ __boot_text static void configure_cpu(void) {
     halt();
 #endif
 
-  WRITE_SPECIALREG(tpidr_el1, _pcpu_data);
+  WRITE_SPECIALREG(tpidr_el1, &_pcpu_data[cpuid]);
 }
 
 __boot_text static void drop_to_el1(void) {
@@ -172,16 +173,14 @@ __boot_text static paddr_t build_page_table(void) {
   for (; pa < ebss; pa += PAGESIZE, va += PAGESIZE)
     l3[L3_INDEX(va)] = pa | ATTR_AP_RW | ATTR_XN | pte_default;
 
-  /* direct map construction */
+  /* direct map construction, 2MB blocks save TLB entries & page tables */
   volatile pde_t *l1d = bootmem_alloc(DMAP_L1_SIZE);
   volatile pde_t *l2d = bootmem_alloc(DMAP_L2_SIZE);
-  volatile pde_t *l3d = bootmem_alloc(DMAP_L3_SIZE);
 
-  for (intptr_t i = 0; i < DMAP_L3_ENTRIES; i++)
-    l3d[i] = (i * PAGESIZE) | ATTR_AP_RW | ATTR_XN | pte_default;
+  const pde_t pde_block = (pte_default & ~ATTR_DESCR_MASK) | L2_BLOCK;
 
   for (intptr_t i = 0; i < DMAP_L2_ENTRIES; i++)
-    l2d[i] = (pde_t)&l3d[i * PT_ENTRIES] | L2_TABLE;
+    l2d[i] = (i * L2_SIZE) | ATTR_AP_RW | ATTR_XN | pde_block;
 
   for (intptr_t i = 0; i < DMAP_L1_ENTRIES; i++)
     l1d[i] = (pde_t)&l2d[i * PT_ENTRIES] | L1_TABLE;
@@ -299,7 +298,7 @@ __boot_text static void enable_mmu(paddr_t pde) {
 
 __boot_text void *aarch64_init(void) {
   drop_to_el1();
-  configure_cpu();
+  configure_cpu(0);
   clear_bss();
 
   /* Set end address of kernel for boot allocation purposes. */
@@ -309,6 +308,20 @@ __boot_text void *aarch64_init(void) {
   return &_boot_stack[PAGESIZE];
 }
 
+/* Entered by secondary processors released by `cpu_start_secondary`.
+ * Returns the top of the kernel stack of processor's idle thread. */
+__boot_text void *aarch64_init_ap(unsigned cpuid) {
+  drop_to_el1();
+  configure_cpu(cpuid);
+
+  /* Caches are still off, the boot processor has cleaned this variable to the
+   * point of coherency before releasing us. */
+  enable_mmu(*(paddr_t *)AARCH64_PHYSADDR(&_kernel_pmap_pde));
+
+  kstack_t *stk = &_pcpu_data[cpuid].curthread->td_kstack;
+  return stk->stk_base + stk->stk_size;
+}
+
 /* TODO(pj) Remove those after architecture split of gdb debug scripts. */
 typedef struct {
 } tlbentry_t;
@@ -30,10 +30,45 @@ register_t ctx_get_pc(ctx_t *ctx) {
   return _REG(ctx, PC);
 }
 
+/*
+ * Kernel is compiled with frame pointers, so x29 points at a frame record
+ * that holds frame pointer and return address of the caller. Frame records
+ * are linked towards the bottom of the stack.
+ */
+unsigned ctx_backtrace(thread_t *td, ctx_t *ctx, uintptr_t *pcs, unsigned n) {
+  vaddr_t stk_lo = (vaddr_t)td->td_kstack.stk_base;
+  vaddr_t stk_hi = stk_lo + td->td_kstack.stk_size;
+  vaddr_t pc = _REG(ctx, PC);
+  vaddr_t fp = _REG(ctx, FP);
+  unsigned depth = 0;
+
+  while (depth < n) {
+    if (pc < (vaddr_t)__text || pc >= (vaddr_t)__etext || (pc & 3))
+      break;
+
+    pcs[depth++] = pc;
+
+    if (fp < stk_lo || fp + 2 * sizeof(vaddr_t) > stk_hi ||
+        !is_aligned(fp, sizeof(vaddr_t)))
+      break;
+
+    vaddr_t *frame = (vaddr_t *)fp;
+    pc = frame[1];
+    /* Stop at next iteration unless the chain moves towards stack bottom. */
+    fp = frame[0] > fp ? frame[0] : 0;
+  }
+
+  return depth;
+}
+
 void mcontext_copy(mcontext_t *to, mcontext_t *from) {
   memcpy(to, from, sizeof(mcontext_t));
 }
 
+register_t mcontext_get_pc(mcontext_t *ctx) {
+  return _REG(ctx, PC);
+}
+
 void mcontext_init(mcontext_t *ctx, void *pc, void *sp) {
   bzero(ctx, sizeof(mcontext_t));
 
@@ -41,6 +76,13 @@ void mcontext_init(mcontext_t *ctx, void *pc, void *sp) {
   _REG(ctx, SP) = (register_t)sp;
 }
 
+void mcontext_setup_call(mcontext_t *ctx, void *pc, void *sp, register_t arg) {
+  _REG(ctx, PC) = (register_t)pc;
+  _REG(ctx, SP) = (register_t)sp;
+  _REG(ctx, X0) = arg;
+  _REG(ctx, LR) = 0;
+}
+
 void mcontext_set_retval(mcontext_t *ctx, register_t value, register_t error) {
   _REG(ctx, X0) = value;
   _REG(ctx, X1) = error;
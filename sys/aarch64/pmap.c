@@ -78,6 +78,8 @@ static const pte_t vm_prot_map[] = {
 
 static pmap_t kernel_pmap;
 paddr_t _kernel_pmap_pde;
+atomic_uint pmap_promotions;
+atomic_uint pmap_demotions;
 static bitstr_t asid_used[bitstr_size(MAX_ASID)] = {0};
 static SPIN_DEFINE(asid_lock, 0);
 
@@ -87,6 +89,7 @@ static SPIN_DEFINE(asid_lock, 0);
 static MTX_DEFINE(pv_list_lock, 0);
 
 #define PAGE_OFFSET(x) ((x) & (PAGESIZE - 1))
+#define L2_BLOCK_P(pde) (((pde)&ATTR_DESCR_MASK) == L2_BLOCK)
 #define PG_DMAP_ADDR(pg) ((void *)((intptr_t)(pg)->paddr + DMAP_BASE))
 
 /*
@@ -197,7 +200,7 @@ static vm_page_t *pmap_pagealloc(void) {
   return pg;
 }
 
-static pte_t *pmap_lookup_pte(pmap_t *pmap, vaddr_t va) {
+static pde_t *pmap_lookup_l2(pmap_t *pmap, vaddr_t va) {
   pde_t *pdep;
   paddr_t pa = pmap->pde;
 
@@ -212,8 +215,22 @@ static pte_t *pmap_lookup_pte(pmap_t *pmap, vaddr_t va) {
     return NULL;
 
   /* Level 2 */
-  pdep = (pde_t *)PHYS_TO_DMAP(pa) + L2_INDEX(va);
-  if (!(pa = PTE_FRAME_ADDR(*pdep)))
+  return (pde_t *)PHYS_TO_DMAP(pa) + L2_INDEX(va);
+}
+
+static void pmap_demote(pmap_t *pmap, pde_t *pdep, vaddr_t va);
+
+static pte_t *pmap_lookup_pte(pmap_t *pmap, vaddr_t va) {
+  pde_t *pdep = pmap_lookup_l2(pmap, va);
+  if (pdep == NULL)
+    return NULL;
+
+  /* Block mapping must be broken up before a single page is changed. */
+  if (L2_BLOCK_P(*pdep))
+    pmap_demote(pmap, pdep, va);
+
+  paddr_t pa = PTE_FRAME_ADDR(*pdep);
+  if (!pa)
     return NULL;
 
   /* Level 3 */
@@ -272,6 +289,8 @@ static pte_t *pmap_ensure_pte(pmap_t *pmap, vaddr_t va) {
 
   /* Level 2 */
   pdep = (pde_t *)PHYS_TO_DMAP(pa) + L2_INDEX(va);
+  if (L2_BLOCK_P(*pdep))
+    pmap_demote(pmap, pdep, va);
   if (!(pa = PTE_FRAME_ADDR(*pdep))) {
     pa = pmap_alloc_pde(pmap, va);
     *pdep = pa | L2_TABLE;
@@ -281,6 +300,78 @@ static pte_t *pmap_ensure_pte(pmap_t *pmap, vaddr_t va) {
   return (pde_t *)PHYS_TO_DMAP(pa) + L3_INDEX(va);
 }
 
+/*
+ * Superpage (level 2 block) mappings.
+ *
+ * Level 3 table is released when its entries get replaced by a block, and a
+ * new one is allocated when the block is broken up.
+ */
+
+static void pmap_demote(pmap_t *pmap, pde_t *pdep, vaddr_t va) {
+  assert(mtx_owned(&pmap->mtx));
+  assert(pmap != pmap_kernel());
+
+  va = rounddown(va, L2_SIZE);
+
+  pde_t pde = *pdep;
+  paddr_t pa = PTE_FRAME_ADDR(pde);
+  pte_t attr = (pde & ATTR_MASK & ~ATTR_DESCR_MASK) | L3_PAGE;
+
+  paddr_t ptp = pmap_alloc_pde(pmap, va);
+  pte_t *l3 = (pte_t *)PHYS_TO_DMAP(ptp);
+  for (int i = 0; i < PT_ENTRIES; i++)
+    l3[i] = (pa + i * PAGESIZE) | attr;
+
+  /* Break-before-make: TLB must never hold both translations of an address,
+   * and a single invalidation removes the whole block. */
+  *pdep = 0;
+  tlb_invalidate(va, pmap->asid);
+  *pdep = ptp | L2_TABLE;
+
+  atomic_fetch_add(&pmap_demotions, 1);
+
+  klog("Demoted superpage at 0x%016lx", va);
+}
+
+/*
+ * Replaces level 3 table covering `va` with a block if all its entries are
+ * valid, have the same attributes and map consecutive frames of a physically
+ * aligned superpage.
+ */
+static void pmap_promote(pmap_t *pmap, vaddr_t va) {
+  assert(mtx_owned(&pmap->mtx));
+
+  va = rounddown(va, L2_SIZE);
+
+  pde_t *pdep = pmap_lookup_l2(pmap, va);
+  paddr_t ptp = PTE_FRAME_ADDR(*pdep);
+  pte_t *l3 = (pte_t *)PHYS_TO_DMAP(ptp);
+
+  /* Pages that were not referenced yet need separate access flag faults. */
+  pte_t pte = l3[0];
+  if ((pte & ATTR_DESCR_MASK) != L3_PAGE || !(pte & ATTR_AF))
+    return;
+  if (!is_aligned(PTE_FRAME_ADDR(pte), L2_SIZE))
+    return;
+
+  /* Frame addresses of an aligned block never carry into attribute bits. */
+  for (int i = 1; i < PT_ENTRIES; i++)
+    if (l3[i] != pte + i * PAGESIZE)
+      return;
+
+  *pdep = 0;
+  tlb_invalidate_asid(pmap->asid);
+  *pdep = (pte & ~ATTR_DESCR_MASK) | L2_BLOCK;
+
+  vm_page_t *pg = vm_page_find(ptp);
+  TAILQ_REMOVE(&pmap->pte_pages, pg, pageq);
+  vm_page_free(pg);
+
+  atomic_fetch_add(&pmap_promotions, 1);
+
+  klog("Promoted superpage at 0x%016lx", va);
+}
+
 void pmap_activate(pmap_t *umap) {
   SCOPED_NO_PREEMPTION();
 
@@ -348,6 +439,15 @@ static bool pmap_extract_nolock(pmap_t *pmap, vaddr_t va, paddr_t *pap) {
   if (!pmap_address_p(pmap, va))
     return false;
 
+  pde_t *pdep = pmap_lookup_l2(pmap, va);
+  if (pdep == NULL)
+    return false;
+
+  if (L2_BLOCK_P(*pdep)) {
+    *pap = PTE_FRAME_ADDR(*pdep) | (va & L2_OFFSET);
+    return true;
+  }
+
   pte_t *ptep = pmap_lookup_pte(pmap, va);
   if (ptep == NULL)
     return false;
@@ -369,8 +469,10 @@ void pmap_enter(pmap_t *pmap, vaddr_t va, vm_page_t *pg, vm_prot_t prot,
 
   bool kern_mapping = (pmap == pmap_kernel());
 
-  /* Mark user pages as non-referenced & non-modified. */
-  pte_t mask = kern_mapping ? 0UL : (ATTR_AF);
+  /* Mark user pages as non-referenced & non-modified, unless `flags` tell
+   * which access is going to happen right away. */
+  bool accessed = kern_mapping || (flags & PMAP_PROT_MASK);
+  pte_t mask = accessed ? 0UL : (ATTR_AF);
   pte_t pte = make_pte(pa, vm_prot_map[prot] & ~mask, flags);
 
   WITH_MTX_LOCK (&pv_list_lock) {
@@ -378,12 +480,20 @@ void pmap_enter(pmap_t *pmap, vaddr_t va, vm_page_t *pg, vm_prot_t prot,
       pv_entry_t *pv = pv_find(pmap, va, pg);
       if (pv == NULL)
         pv_add(pmap, va, pg);
-      if (kern_mapping)
+      if (kern_mapping) {
         pg->flags |= PG_MODIFIED | PG_REFERENCED;
-      else
+      } else {
         pg->flags &= ~(PG_MODIFIED | PG_REFERENCED);
+        if (accessed)
+          pg->flags |= PG_REFERENCED;
+        if (flags & VM_PROT_WRITE)
+          pg->flags |= PG_MODIFIED;
+      }
       pte_t *ptep = pmap_ensure_pte(pmap, va);
       pmap_write_pte(pmap, ptep, pte, va);
+      /* Frame and page offsets within a superpage have to match. */
+      if (!kern_mapping && (pa & L2_OFFSET) == (va & L2_OFFSET))
+        pmap_promote(pmap, va);
     }
   }
 }
@@ -411,6 +521,18 @@ void pmap_remove(pmap_t *pmap, vaddr_t start, vaddr_t end) {
   }
 }
 
+/* Protection that was requested when the page got entered. */
+static vm_prot_t pte_prot(pte_t pte) {
+  vm_prot_t prot = VM_PROT_NONE;
+  if (pte & ATTR_SW_READ)
+    prot |= VM_PROT_READ;
+  if (pte & ATTR_SW_WRITE)
+    prot |= VM_PROT_WRITE;
+  if (!(pte & ATTR_SW_NOEXEC))
+    prot |= VM_PROT_EXEC;
+  return prot;
+}
+
 void pmap_protect(pmap_t *pmap, vaddr_t start, vaddr_t end, vm_prot_t prot) {
   assert(page_aligned_p(start) && page_aligned_p(end) && start < end);
   assert(pmap_contains_p(pmap, start, end));
@@ -418,14 +540,41 @@ void pmap_protect(pmap_t *pmap, vaddr_t start, vaddr_t end, vm_prot_t prot) {
   klog("Change protection bits to %x for address range %p-%p", prot, start,
        end);
 
+  bool changed = false;
+
   WITH_MTX_LOCK (&pmap->mtx) {
     for (vaddr_t va = start; va < end; va += PAGESIZE) {
       pte_t *ptep = pmap_lookup_pte(pmap, va);
-      if (ptep == NULL)
+      if (ptep == NULL || PTE_FRAME_ADDR(*ptep) == 0)
         continue;
-      pte_t pte = vm_prot_map[prot] | (*ptep & (~ATTR_AP_MASK & ~ATTR_XN));
-      pmap_write_pte(pmap, ptep, pte, va);
+
+      pte_t pte = *ptep;
+
+      /* Permissions can only be taken away, as some pages are mapped with
+       * fewer of them than their entry has (e.g. for copy-on-write). Access
+       * flag stays set only if the page has been referenced, and the page
+       * stays read-only if it hasn't been modified yet. */
+      pte_t prot_bits = vm_prot_map[pte_prot(pte) & prot];
+      if (!(pte & ATTR_AF))
+        prot_bits &= ~ATTR_AF;
+      prot_bits |= pte & ATTR_AP_RO;
+
+      pte_t new_pte =
+        (pte & ~(ATTR_AP_RO | ATTR_XN | ATTR_SW_FLAGS | ATTR_AF)) | prot_bits;
+      if (new_pte == pte)
+        continue;
+
+      *ptep = new_pte;
+      changed = true;
+
+      if (pmap == pmap_kernel())
+        tlb_invalidate(va, pmap->asid);
     }
+
+    /* Rather than invalidating each page, drop all translations of the address
+     * space at once. Kernel mappings are global, so they were flushed above. */
+    if (changed && pmap != pmap_kernel())
+      tlb_invalidate_asid(pmap->asid);
   }
 }
 
@@ -472,6 +621,9 @@ static void pmap_modify_flags(vm_page_t *pg, pte_t set, pte_t clr) {
       pte_t pte = *ptep;
       pte |= set;
       pte &= ~clr;
+      /* Page may be mapped read-only elsewhere, e.g. for copy-on-write. */
+      if (!(pte & ATTR_SW_WRITE))
+        pte |= ATTR_AP_RO;
       *ptep = pte;
       tlb_invalidate(va, pmap->asid);
     }
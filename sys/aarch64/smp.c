@@ -0,0 +1,38 @@
+#include <sys/mimiker.h>
+#include <sys/errno.h>
+#include <sys/smp.h>
+#include <aarch64/pmap.h>
+
+/* Raspberry Pi firmware parks secondary processors in a loop waiting for an
+ * entry point to be written at their spin table slot. */
+#define SPIN_TABLE_BASE 0xd8
+
+extern char _start_ap[];
+extern paddr_t _kernel_pmap_pde;
+
+#define __dc(op, va) __asm__ volatile("DC " op ", %0" : : "r"(va) : "memory")
+#define __dsb(x) __asm__ volatile("DSB " x)
+#define __sev() __asm__ volatile("SEV")
+#define __yield() __asm__ volatile("YIELD" ::: "memory")
+
+int cpu_start_secondary(unsigned cpuid) {
+  if (cpuid > 3)
+    return ENODEV;
+
+  /* Secondary processor reads it with caches disabled. */
+  __dc("civac", &_kernel_pmap_pde);
+
+  volatile uint64_t *slot =
+    (uint64_t *)PHYS_TO_DMAP(SPIN_TABLE_BASE + cpuid * sizeof(uint64_t));
+  /* Code in .boot section is linked at its physical address. */
+  *slot = (paddr_t)_start_ap;
+  __dc("civac", slot);
+  __dsb("sy");
+  __sev();
+
+  return 0;
+}
+
+void cpu_spinwait(void) {
+  __yield();
+}
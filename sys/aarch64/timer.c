@@ -13,17 +13,26 @@ typedef struct arm_timer_state {
   resource_t *irq_res;
   timer_t timer;
   uint64_t step;
+  bool oneshot;
 } arm_timer_state_t;
 
-static int arm_timer_start(timer_t *tm, unsigned flags __unused,
-                           const bintime_t start __unused,
+static int arm_timer_start(timer_t *tm, unsigned flags, const bintime_t start,
                            const bintime_t period) {
   arm_timer_state_t *state = ((device_t *)tm->tm_priv)->state;
-  state->step = bintime_mul(period, tm->tm_frequency).sec;
+  uint64_t delta;
+
+  if (flags & TMF_ONESHOT) {
+    state->oneshot = true;
+    delta = max(bintime_mul(start, tm->tm_frequency).sec, (uint64_t)1);
+  } else {
+    state->oneshot = false;
+    state->step = bintime_mul(period, tm->tm_frequency).sec;
+    delta = state->step;
+  }
 
   WITH_INTR_DISABLED {
     uint64_t count = READ_SPECIALREG(cntpct_el0);
-    WRITE_SPECIALREG(cntp_cval_el0, count + state->step);
+    WRITE_SPECIALREG(cntp_cval_el0, count + delta);
     WRITE_SPECIALREG(cntp_ctl_el0, CNTCTL_ENABLE);
   }
 
@@ -47,6 +56,13 @@ static bintime_t arm_timer_gettime(timer_t *tm) {
 static intr_filter_t arm_timer_intr(void *data /* device_t* */) {
   arm_timer_state_t *state = ((device_t *)data)->state;
 
+  if (state->oneshot) {
+    /* Keep the timer quiet until callback sets the next deadline. */
+    WRITE_SPECIALREG(cntp_ctl_el0, CNTCTL_DISABLE);
+    tm_trigger(&state->timer);
+    return IF_FILTERED;
+  }
+
   tm_trigger(&state->timer);
 
   /*
@@ -72,7 +88,7 @@ static int arm_timer_attach(device_t *dev) {
   /* Save link to timer device. */
   state->timer = (timer_t){
     .tm_name = "arm-cpu-timer",
-    .tm_flags = TMF_PERIODIC,
+    .tm_flags = TMF_PERIODIC | TMF_ONESHOT,
     .tm_quality = 0,
     .tm_start = arm_timer_start,
     .tm_stop = arm_timer_stop,
@@ -6,6 +6,12 @@
 #define __dsb(x) __asm__ volatile("DSB " x)
 #define __isb() __asm__ volatile("ISB")
 
+/*
+ * All operations below use Inner Shareable variants of TLBI, which hardware
+ * broadcasts to every processor in the cluster. Thus with SMP enabled they
+ * double as TLB shootdown and no interprocessor interrupts are needed.
+ */
+
 void tlb_invalidate(vaddr_t va, asid_t asid) {
   __dsb("ishst");
 
@@ -7,6 +7,7 @@
 #include <sys/vm_map.h>
 #include <sys/syscall.h>
 #include <sys/sysent.h>
+#include <sys/ktrace.h>
 #include <sys/errno.h>
 #include <sys/context.h>
 #include <sys/cpu.h>
@@ -40,8 +41,12 @@ static void syscall_handler(register_t code, ctx_t *ctx,
 
   assert(td->td_proc != NULL);
 
+  KTRACE(KTR_SYSCALL_ENTER, code, 0);
+
   int error = se->call(td->td_proc, (void *)args, &retval);
 
+  KTRACE(KTR_SYSCALL_EXIT, code, error);
+
   result->retval = error ? -1 : retval;
   result->error = error;
 }
@@ -71,7 +76,9 @@ static void abort_handler(ctx_t *ctx, register_t esr, vaddr_t vaddr,
   if (error == 0)
     return;
 
-  if (error == EACCES || error == EINVAL)
+  /* Insufficient permissions may mean copy-on-write, let vm_page_fault
+   * decide whether the access is legal. */
+  if (error == EINVAL)
     goto fault;
 
   vm_map_t *vmap = vm_map_lookup(vaddr);
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+#
+# Turn samples copied out of /dev/kprof with `kprof -r` into folded stacks,
+# which are accepted by flamegraph.pl and compatible tools. Sample layout is
+# described by `kprof_sample_t` in include/sys/kprof.h.
+#
+import argparse
+import bisect
+import collections
+import struct
+import subprocess
+
+MAXDEPTH = 16
+SAMPLE = struct.Struct('<QQ%dQIIHHI' % MAXDEPTH)
+
+
+class Symbols():
+    def __init__(self, nm, elf):
+        self.addrs = []
+        self.names = []
+        out = subprocess.check_output([nm, '-n', '--defined-only', elf])
+        for line in out.decode().splitlines():
+            fields = line.split()
+            if len(fields) != 3 or fields[1] not in 'tTwW':
+                continue
+            self.addrs.append(int(fields[0], 16))
+            self.names.append(fields[2])
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        return self.names[i] if i >= 0 else '0x%x' % addr
+
+
+def samples(data):
+    for off in range(0, len(data) - SAMPLE.size + 1, SAMPLE.size):
+        fields = SAMPLE.unpack_from(data, off)
+        upc = fields[1]
+        kpc = fields[2:2 + MAXDEPTH]
+        tid, pid, cpu, depth = fields[2 + MAXDEPTH:6 + MAXDEPTH]
+        yield pid, tid, upc, kpc[:min(depth, MAXDEPTH)]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert kernel profiler samples into folded stacks.')
+    parser.add_argument('samples', type=argparse.FileType('rb'),
+                        help='file with samples read from /dev/kprof')
+    parser.add_argument('kernel', help='kernel image with symbols')
+    parser.add_argument('--nm', default='nm',
+                        help='nm tool that understands kernel image format')
+    parser.add_argument('--tid', action='store_true',
+                        help='make separate stacks for each thread')
+    args = parser.parse_args()
+
+    syms = Symbols(args.nm, args.kernel)
+    stacks = collections.Counter()
+
+    for pid, tid, upc, kpc in samples(args.samples.read()):
+        frames = ['pid %d' % pid if pid else 'kernel']
+        if args.tid:
+            frames.append('tid %d' % tid)
+        if upc:
+            frames.append('[user]')
+        # Return addresses may point just past the calling function.
+        for i, pc in reversed(list(enumerate(kpc))):
+            frames.append(syms.lookup(pc - 1 if i else pc))
+        stacks[';'.join(frames)] += 1
+
+    for stack, count in sorted(stacks.items()):
+        print(stack, count)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+#
+# Decode kernel event trace records copied out of /dev/ktrace with `ktrace -r`.
+# Record layout is described by `ktrace_event_t` in include/sys/ktrace.h.
+#
+import argparse
+import struct
+import sys
+
+EVENT = struct.Struct('<QQQIIHHI')
+
+NAMES = ['lost', 'ctxsw', 'syscall-enter', 'syscall-exit', 'pgfault', 'intr',
+         'sleep', 'wakeup', 'lock']
+
+
+def events(data):
+    for off in range(0, len(data) - EVENT.size + 1, EVENT.size):
+        time, arg0, arg1, seq, tid, typ, cpu, _ = EVENT.unpack_from(data, off)
+        yield time / 2**32, cpu, tid, typ, arg0, arg1
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Decode binary kernel event trace.')
+    parser.add_argument('trace', type=argparse.FileType('rb'),
+                        help='file with records read from /dev/ktrace')
+    parser.add_argument('--type', action='append', choices=NAMES,
+                        help='only print events of given type')
+    args = parser.parse_args()
+
+    # Records are grouped by processor, so merge them by timestamp.
+    for time, cpu, tid, typ, arg0, arg1 in sorted(events(args.trace.read())):
+        name = NAMES[typ] if typ < len(NAMES) else 'unknown(%d)' % typ
+        if args.type and name not in args.type:
+            continue
+        print('%.6f cpu%d tid %d %s %x %x' % (time, cpu, tid, name, arg0, arg1))
+
+
+if __name__ == '__main__':
+    main()
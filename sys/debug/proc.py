@@ -8,7 +8,7 @@ from .thread import Thread
 
 class Process(metaclass=GdbStructMeta):
     __ctype__ = 'struct proc'
-    __cast__ = {'p_pid': int, 'p_thread': Thread, 'p_state': enum}
+    __cast__ = {'p_pid': int, 'p_state': enum}
 
     @staticmethod
     def current():
@@ -28,6 +28,9 @@ class Process(metaclass=GdbStructMeta):
         dead = TailQueue(global_var('zombie_list'), 'p_all')
         return map(cls, list(alive) + list(dead))
 
+    def threads(self):
+        return map(Thread, TailQueue(self.p_threads, 'td_procq'))
+
     def __repr__(self):
         return 'proc{pid=%d}' % self.p_pid
 
@@ -40,10 +43,10 @@ class Kprocess(SimpleCommand):
 
     def __call__(self, args):
         table = TextTable(align='rll')
-        table.header(['Pid', 'Tid', 'State'])
+        table.header(['Pid', 'Threads', 'State'])
         for p in Process.list_all():
-            thread = None if p.p_state == 'PS_ZOMBIE' else p.p_thread
-            table.add_row([p.p_pid, thread, p.p_state])
+            threads = [] if p.p_state == 'PS_ZOMBIE' else list(p.threads())
+            table.add_row([p.p_pid, ', '.join(map(str, threads)), p.p_state])
         print(table)
 
 
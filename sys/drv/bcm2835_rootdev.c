@@ -6,10 +6,12 @@
 #include <dev/bcm2835reg.h>
 #include <sys/kmem.h>
 #include <sys/pmap.h>
+#include <sys/pcpu.h>
+#include <sys/smp.h>
 
 /*
  * located at BCM2836_ARM_LOCAL_BASE
- * 32 local interrupts -- one per CPU but now we only support 1 CPU
+ * 32 local interrupts -- one per CPU, mailbox 0 of each CPU is used for IPIs
  *
  * located at BCM2835_ARMICU_BASE
  * accessed by BCM2835_PERIPHERALS_BASE NOT by BCM2835_PERIPHERALS_BASE_BUS
@@ -168,13 +170,40 @@ static void bcm2835_intr_handle(bus_space_handle_t irq_base, bus_size_t offset,
   }
 }
 
+void cpu_send_ipi(unsigned cpuid) {
+  bus_space_write_4(rootdev_bus_space, rootdev_local_handle,
+                    BCM2836_LOCAL_MAILBOX0_SETN(cpuid), 1);
+}
+
+/* Acknowledge interprocessor interrupt (if any) and handle IPI requests. */
+static void rootdev_ipi_handle(unsigned cpuid) {
+  uint32_t pending = bus_space_read_4(rootdev_bus_space, rootdev_local_handle,
+                                      BCM2836_LOCAL_INTC_IRQPENDINGN(cpuid));
+  if (!(pending & (1 << BCM2836_INT_MAILBOX0)))
+    return;
+
+  uint32_t mbox = bus_space_read_4(rootdev_bus_space, rootdev_local_handle,
+                                   BCM2836_LOCAL_MAILBOX0_CLRN(cpuid));
+  bus_space_write_4(rootdev_bus_space, rootdev_local_handle,
+                    BCM2836_LOCAL_MAILBOX0_CLRN(cpuid), mbox);
+  smp_ipi_handler();
+}
+
 static void rootdev_intr_handler(ctx_t *ctx, device_t *dev, void *arg) {
   assert(dev != NULL);
   rootdev_t *rd = dev->state;
+  unsigned cpuid = PCPU_GET(cpuid);
+
+  rootdev_ipi_handle(cpuid);
 
   /* Handle local interrupts. */
-  bcm2835_intr_handle(rootdev_local_handle, BCM2836_LOCAL_INTC_IRQPENDINGN(0),
-                      &rd->intr_event[BCM2836_INT_BASECPUN(0)]);
+  bcm2835_intr_handle(rootdev_local_handle,
+                      BCM2836_LOCAL_INTC_IRQPENDINGN(cpuid),
+                      &rd->intr_event[BCM2836_INT_BASECPUN(cpuid)]);
+
+  /* GPU interrupts are routed to the boot processor only. */
+  if (cpuid != 0)
+    return;
 
   /* Handle GPU0 interrupts. */
   bcm2835_intr_handle(rootdev_arm_base,
@@ -215,6 +244,12 @@ static int rootdev_attach(device_t *bus) {
     kmem_map_contig(BCM2835_PERIPHERALS_BUS_TO_PHYS(BCM2835_ARM_BASE),
                     BCM2835_ARM_SIZE, PMAP_NOCACHE);
 
+  /* Let mailbox 0 of each processor raise interprocessor interrupts
+   * (bit 0 of control register enables IRQ for mailbox 0). */
+  for (unsigned i = 0; i < MAXCPU; i++)
+    bus_space_write_4(rootdev_bus_space, rootdev_local_handle,
+                      BCM2836_LOCAL_MAILBOX_IRQ_CONTROLN(i), 1);
+
   intr_root_claim(rootdev_intr_handler, bus, NULL);
 
   device_t *dev;
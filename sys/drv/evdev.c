@@ -12,6 +12,7 @@
 #include <sys/vnode.h>
 #include <sys/malloc.h>
 #include <sys/device.h>
+#include <sys/event.h>
 #include <bitstring.h>
 #include <sys/libkern.h>
 
@@ -95,6 +96,7 @@ typedef struct evdev_client {
   mtx_t ec_lock;                /* serializes access to ring buffer data */
   evdev_clock_id_t ec_clock_id; /* (c) clock used to timestamp events */
   condvar_t ec_buffer_cv;       /* (c) wait here for state change to happen */
+  knlist_t ec_klist;            /* (c) knotes waiting for events */
   size_t ec_buffer_size;        /* (c) ring buffer capacity */
   size_t ec_buffer_ready;       /* (c) read limit (see note above) */
   size_t ec_buffer_head;        /* (c) read end */
@@ -175,6 +177,7 @@ static void evdev_client_notify(evdev_client_t *client) {
   /* move `ready` pointer and notify readers */
   client->ec_buffer_ready = client->ec_buffer_tail;
   cv_broadcast(&client->ec_buffer_cv);
+  knote(&client->ec_klist, 0);
 }
 
 /* Pop one event from the client's queue. Assumes the queue is nonempty! */
@@ -440,6 +443,44 @@ static int evdev_ioctl(file_t *f, u_long cmd, void *data) {
   return EINVAL;
 }
 
+static void filt_evdevdetach(knote_t *kn) {
+  evdev_client_t *client = kn->kn_hook;
+
+  WITH_MTX_LOCK (&client->ec_lock)
+    SLIST_REMOVE(&client->ec_klist, kn, knote, kn_objlink);
+}
+
+static int filt_evdevread(knote_t *kn, long hint) {
+  evdev_client_t *client = kn->kn_hook;
+  size_t head = client->ec_buffer_head;
+  size_t ready = client->ec_buffer_ready;
+
+  if (ready < head)
+    ready += client->ec_buffer_size;
+  kn->kn_data = (ready - head) * sizeof(input_event_t);
+  return !evdev_client_empty(client);
+}
+
+static filterops_t evdev_read_filtops = {
+  .filt_detach = filt_evdevdetach,
+  .filt_event = filt_evdevread,
+};
+
+static int evdev_kqfilter(file_t *f, knote_t *kn) {
+  evdev_client_t *client = f->f_data;
+
+  if (kn->kn_filter != EVFILT_READ)
+    return EINVAL;
+
+  kn->kn_filtops = &evdev_read_filtops;
+  kn->kn_hook = client;
+  kn->kn_objlock = &client->ec_lock;
+
+  WITH_MTX_LOCK (&client->ec_lock)
+    SLIST_INSERT_HEAD(&client->ec_klist, kn, kn_objlink);
+  return 0;
+}
+
 static fileops_t evdev_fileops = {
   .fo_read = evdev_read,
   .fo_write = nowrite,
@@ -447,6 +488,7 @@ static fileops_t evdev_fileops = {
   .fo_seek = noseek,
   .fo_stat = default_vnstat,
   .fo_ioctl = evdev_ioctl,
+  .fo_kqfilter = evdev_kqfilter,
 };
 
 static int evdev_open(vnode_t *v, int mode, file_t *fp) {
@@ -465,6 +507,7 @@ static int evdev_open(vnode_t *v, int mode, file_t *fp) {
   client->ec_evdev = evdev;
   mtx_init(&client->ec_lock, 0);
   cv_init(&client->ec_buffer_cv, "ec_buffer_cv");
+  SLIST_INIT(&client->ec_klist);
 
   WITH_MTX_LOCK (&evdev->ev_lock)
     LIST_INSERT_HEAD(&evdev->ev_clients, client, ec_link);
@@ -8,7 +8,8 @@
 #include <sys/fb.h>
 #include <sys/devfs.h>
 #include <sys/devclass.h>
-#include <sys/vnode.h>
+#include <sys/vm_physmem.h>
+#include <sys/uio.h>
 #include <stdatomic.h>
 
 typedef struct fb_color fb_color_t;
@@ -22,6 +23,7 @@ typedef struct fb_info fb_info_t;
 typedef struct stdvga_state {
   resource_t *mem;
   resource_t *io;
+  devnode_t *dev;
 
   atomic_int usecnt;
   fb_info_t fb_info;
@@ -41,6 +43,7 @@ typedef struct stdvga_state {
 #define VBE_DISPI_INDEX_YRES 0x02
 #define VBE_DISPI_INDEX_BPP 0x03
 #define VBE_DISPI_INDEX_ENABLE 0x04
+#define VBE_DISPI_INDEX_Y_OFFSET 0x09
 #define VBE_DISPI_ENABLED 0x01 /* VBE Enabled bit */
 
 /* Offsets for accessing ioports via PCI BAR1 (MMIO) */
@@ -113,17 +116,37 @@ static int stdvga_set_fbinfo(stdvga_state_t *vga, fb_info_t *fb_info) {
   if (fb_info->bpp != 8 && fb_info->bpp != 16 && fb_info->bpp != 24)
     return EINVAL;
 
+  /* All buffers must fit into video memory. */
+  if (FB_SIZE(fb_info) * FB_NBUFFERS > resource_size(vga->mem))
+    return EINVAL;
+
   memcpy(&vga->fb_info, fb_info, sizeof(fb_info_t));
 
   /* Apply resolution & bits per pixel. */
   stdvga_vbe_write(vga, VBE_DISPI_INDEX_XRES, vga->fb_info.width);
   stdvga_vbe_write(vga, VBE_DISPI_INDEX_YRES, vga->fb_info.height);
   stdvga_vbe_write(vga, VBE_DISPI_INDEX_BPP, vga->fb_info.bpp);
+
+  /* Display the first buffer. */
+  stdvga_vbe_write(vga, VBE_DISPI_INDEX_Y_OFFSET, 0);
+
+  vga->dev->size = FB_SIZE(&vga->fb_info) * FB_NBUFFERS;
   return 0;
 }
 
-static int stdvga_open(vnode_t *v, int mode, file_t *fp) {
-  stdvga_state_t *vga = devfs_node_data(v);
+/* Buffers are stored one after another, so making n-th buffer visible means
+ * that the display starts n * height lines below video memory start. */
+static int stdvga_flip(stdvga_state_t *vga, uint32_t *buffer) {
+  if (*buffer >= FB_NBUFFERS)
+    return EINVAL;
+
+  stdvga_vbe_write(vga, VBE_DISPI_INDEX_Y_OFFSET,
+                   *buffer * vga->fb_info.height);
+  return 0;
+}
+
+static int stdvga_open(devnode_t *dev, file_t *fp, int oflags) {
+  stdvga_state_t *vga = dev->data;
   int error;
 
   /* Disallow opening the file more than once. */
@@ -132,37 +155,28 @@ static int stdvga_open(vnode_t *v, int mode, file_t *fp) {
     return EBUSY;
 
   /* On error, decrease the use count. */
-  if ((error = vnode_open_generic(v, mode, fp)))
-    goto fail;
-
   if ((error = stdvga_set_fbinfo(vga, &vga->fb_info)))
-    goto fail;
+    atomic_store(&vga->usecnt, 0);
 
-  return 0;
-
-fail:
-  atomic_store(&vga->usecnt, 0);
   return error;
 }
 
-static int stdvga_close(vnode_t *v, file_t *fp) {
-  stdvga_state_t *vga = devfs_node_data(v);
+static int stdvga_close(devnode_t *dev, file_t *fp) {
+  stdvga_state_t *vga = dev->data;
   atomic_store(&vga->usecnt, 0);
   return 0;
 }
 
-static int stdvga_write(vnode_t *v, uio_t *uio) {
-  stdvga_state_t *vga = devfs_node_data(v);
-  size_t size = FB_SIZE(&vga->fb_info);
-
-  /* This device does not support offsets. */
-  uio->uio_offset = 0;
+/* Writes to any part of the buffers, e.g. just the lines that have changed. */
+static int stdvga_write(devnode_t *dev, uio_t *uio) {
+  stdvga_state_t *vga = dev->data;
+  size_t size = FB_SIZE(&vga->fb_info) * FB_NBUFFERS;
 
   return uiomove_frombuf((void *)vga->mem->r_bus_handle, size, uio);
 }
 
-static int stdvga_ioctl(vnode_t *v, u_long cmd, void *data, file_t *fp) {
-  stdvga_state_t *vga = devfs_node_data(v);
+static int stdvga_ioctl(devnode_t *dev, u_long cmd, void *data, int fflags) {
+  stdvga_state_t *vga = dev->data;
 
   if (cmd == FBIOCGET_FBINFO) {
     memcpy(data, &vga->fb_info, sizeof(fb_info_t));
@@ -172,14 +186,33 @@ static int stdvga_ioctl(vnode_t *v, u_long cmd, void *data, file_t *fp) {
     return stdvga_set_fbinfo(vga, data);
   if (cmd == FBIOCSET_PALETTE)
     return stdvga_set_palette(vga, data);
+  if (cmd == FBIOCFLIP)
+    return stdvga_flip(vga, data);
   return EINVAL;
 }
 
-static vnodeops_t stdvga_vnodeops = {
-  .v_open = stdvga_open,
-  .v_close = stdvga_close,
-  .v_write = stdvga_write,
-  .v_ioctl = stdvga_ioctl,
+/* Whole video memory may be mapped, as the resolution can change later. */
+static int stdvga_mmap(devnode_t *dev, off_t offset, vm_prot_t prot,
+                       paddr_t *pa_p) {
+  stdvga_state_t *vga = dev->data;
+
+  if (offset < 0 || (bus_size_t)offset >= resource_size(vga->mem))
+    return EINVAL;
+
+  if (prot & VM_PROT_EXEC)
+    return EACCES;
+
+  *pa_p = resource_start(vga->mem) + offset;
+  return 0;
+}
+
+static devops_t stdvga_devops = {
+  .d_type = DT_SEEKABLE,
+  .d_open = stdvga_open,
+  .d_close = stdvga_close,
+  .d_write = stdvga_write,
+  .d_ioctl = stdvga_ioctl,
+  .d_mmap = stdvga_mmap,
 };
 
 static int stdvga_probe(device_t *dev) {
@@ -205,6 +238,10 @@ static int stdvga_attach(device_t *dev) {
 
   vga->usecnt = 0;
 
+  /* Let user processes map video memory directly. */
+  paddr_t start = resource_start(vga->mem);
+  vm_physseg_plug_device(start, start + resource_size(vga->mem));
+
   /* Enable palette access */
   stdvga_io_write(vga, VGA_AR_ADDR, VGA_AR_PAS);
 
@@ -215,7 +252,7 @@ static int stdvga_attach(device_t *dev) {
   stdvga_vbe_set(vga, VBE_DISPI_INDEX_ENABLE, VBE_DISPI_ENABLED);
 
   /* Install /dev/vga device file. */
-  devfs_makedev(NULL, "vga", &stdvga_vnodeops, vga, NULL);
+  devfs_makedev_new(NULL, "vga", &stdvga_devops, vga, &vga->dev);
 
   return 0;
 }
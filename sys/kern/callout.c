@@ -10,9 +10,23 @@
 #include <sys/interrupt.h>
 #include <sys/time.h>
 
-/* Note: If the difference in time between ticks is greater than the number of
-   buckets, some callouts may be called out-of-order! */
-#define CALLOUT_BUCKETS 64
+/*
+ * Pending callouts are kept in a hierarchical timing wheel. Time is measured
+ * in wheel units of 2^-20 seconds. Level L consists of WHEEL_SLOTS slots, each
+ * covering 2^(WHEEL_BITS * L) units. A callout is put into the lowest level
+ * whose span reaches its deadline. When time reaches the beginning of a slot
+ * at level L > 0, callouts from that slot are cascaded to lower levels. Each
+ * level keeps a bitmap of non-empty slots, so periods of time with nothing
+ * scheduled are skipped without visiting empty slots.
+ *
+ * Callouts further away than the top level spans are put into the last slot
+ * of the top level and rescheduled when it gets cascaded.
+ */
+#define WHEEL_SHIFT 12 /* converts c_time into wheel units */
+#define WHEEL_BITS 5
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 7
 
 #define callout_is_active(c) ((c)->c_flags & CALLOUT_ACTIVE)
 #define callout_set_active(c) ((c)->c_flags |= CALLOUT_ACTIVE)
@@ -26,25 +40,101 @@
 #define callout_set_stopped(c) ((c)->c_flags |= CALLOUT_STOPPED)
 #define callout_clear_stopped(c) ((c)->c_flags &= ~CALLOUT_STOPPED)
 
-/*
-  Every event is inside one of CALLOUT_BUCKETS buckets.
-  The buckets is a cyclic list, but we implement it as an array,
-  allowing us to access random elements in constant time.
-*/
-
 typedef TAILQ_HEAD(callout_list, callout) callout_list_t;
 
 static struct {
-  callout_list_t heads[CALLOUT_BUCKETS];
-  /* Stores the value of the argument callout_process was previously
-     called with. All callouts up to this timestamp have already been
-     processed. */
-  systime_t last;
+  callout_list_t wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+  uint32_t pending[WHEEL_LEVELS]; /* bitmaps of non-empty slots */
+  /* All callouts due before this wheel unit have already been processed. */
+  uint64_t cur;
   spin_t lock;
 } ci;
 
-static inline callout_list_t *ci_list(int i) {
-  return &ci.heads[i];
+static inline uint64_t bt2ct(bintime_t bt) {
+  return ((uint64_t)bt.sec << 32) | (bt.frac >> 32);
+}
+
+static inline bintime_t ct2bt(uint64_t ct) {
+  return (bintime_t){.sec = ct >> 32, .frac = ct << 32};
+}
+
+static inline unsigned ct2nsec(uint64_t ct) {
+  return ((ct & 0xffffffff) * 1000000000) >> 32;
+}
+
+static inline uint64_t st2ct(systime_t st) {
+  /* Round up, so that callouts are never run too early. */
+  return (((uint64_t)st << 32) + CLK_TCK - 1) / CLK_TCK;
+}
+
+static inline uint64_t ct2unit(uint64_t ct) {
+  return (ct + (1 << WHEEL_SHIFT) - 1) >> WHEEL_SHIFT;
+}
+
+static inline unsigned wheel_shift(int level) {
+  return WHEEL_BITS * level;
+}
+
+static void wheel_insert(callout_t *co) {
+  uint64_t unit = max(ct2unit(co->c_time), ci.cur);
+  uint64_t delta = unit - ci.cur;
+  unsigned level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (1ULL << wheel_shift(level + 1)))
+      break;
+
+  if (delta < (1ULL << wheel_shift(level + 1)))
+    slot = (unit >> wheel_shift(level)) & WHEEL_MASK;
+  else
+    slot = ((ci.cur >> wheel_shift(level)) - 1) & WHEEL_MASK;
+
+  co->c_level = level;
+  co->c_index = slot;
+  TAILQ_INSERT_TAIL(&ci.wheel[level][slot], co, c_link);
+  ci.pending[level] |= 1U << slot;
+}
+
+static void wheel_remove(callout_t *co) {
+  callout_list_t *head = &ci.wheel[co->c_level][co->c_index];
+
+  TAILQ_REMOVE(head, co, c_link);
+  if (TAILQ_EMPTY(head))
+    ci.pending[co->c_level] &= ~(1U << co->c_index);
+}
+
+/* Returns the first wheel unit, not before `ci.cur`, at which a non-empty slot
+ * has to be visited, either to run or to cascade its callouts. */
+static uint64_t wheel_next(void) {
+  uint64_t next = UINT64_MAX;
+
+  for (int level = 0; level < WHEEL_LEVELS; level++) {
+    uint32_t bits = ci.pending[level];
+    if (bits == 0)
+      continue;
+    unsigned shift = wheel_shift(level);
+    uint64_t base = (ci.cur + (1ULL << shift) - 1) >> shift;
+    unsigned first = base & WHEEL_MASK;
+    if (first)
+      bits = (bits >> first) | (bits << (WHEEL_SLOTS - first));
+    next = min(next, (base + ctz(bits)) << shift);
+  }
+
+  return next;
+}
+
+static void wheel_cascade(int level, unsigned slot) {
+  callout_list_t head;
+  callout_t *co;
+
+  TAILQ_INIT(&head);
+  TAILQ_CONCAT(&head, &ci.wheel[level][slot], c_link);
+  ci.pending[level] &= ~(1U << slot);
+
+  while ((co = TAILQ_FIRST(&head))) {
+    TAILQ_REMOVE(&head, co, c_link);
+    wheel_insert(co);
+  }
 }
 
 static callout_list_t delegated;
@@ -83,8 +173,9 @@ void init_callout(void) {
 
   spin_init(&ci.lock, 0);
 
-  for (int i = 0; i < CALLOUT_BUCKETS; i++)
-    TAILQ_INIT(ci_list(i));
+  for (int i = 0; i < WHEEL_LEVELS; i++)
+    for (int j = 0; j < WHEEL_SLOTS; j++)
+      TAILQ_INIT(&ci.wheel[i][j]);
 
   TAILQ_INIT(&delegated);
 
@@ -99,19 +190,19 @@ void callout_setup(callout_t *co, timeout_t fn, void *arg) {
   co->c_arg = arg;
 }
 
-static void _callout_schedule(callout_t *co, systime_t tm) {
+static void _callout_schedule(callout_t *co, uint64_t ct) {
   assert(spin_owned(&ci.lock));
   assert(!callout_is_pending(co));
 
   callout_set_pending(co);
 
-  int idx = tm % CALLOUT_BUCKETS;
+  co->c_time = ct;
 
-  co->c_time = tm;
-  co->c_index = idx;
+  klog("Add callout {%p} with wakeup at %u.%09u.", co, (unsigned)(ct >> 32),
+       ct2nsec(ct));
+  wheel_insert(co);
 
-  klog("Add callout {%p} with wakeup at %ld.", co, tm);
-  TAILQ_INSERT_TAIL(ci_list(idx), co, c_link);
+  clock_deadline(ct2bt(ct2unit(ct) << WHEEL_SHIFT));
 }
 
 void callout_schedule_abs(callout_t *co, systime_t tm) {
@@ -119,7 +210,15 @@ void callout_schedule_abs(callout_t *co, systime_t tm) {
   assert(!callout_is_active(co));
   callout_clear_stopped(co);
 
-  _callout_schedule(co, tm);
+  _callout_schedule(co, st2ct(tm));
+}
+
+void callout_schedule_bt(callout_t *co, bintime_t bt) {
+  SCOPED_SPIN_LOCK(&ci.lock);
+  assert(!callout_is_active(co));
+  callout_clear_stopped(co);
+
+  _callout_schedule(co, bt2ct(bt));
 }
 
 void callout_schedule(callout_t *co, systime_t tm) {
@@ -127,7 +226,7 @@ void callout_schedule(callout_t *co, systime_t tm) {
   assert(!callout_is_active(co));
   callout_clear_stopped(co);
 
-  _callout_schedule(co, getsystime() + tm);
+  _callout_schedule(co, bt2ct(binuptime()) + st2ct(tm));
 }
 
 bool callout_reschedule(callout_t *c, systime_t tm) {
@@ -135,20 +234,30 @@ bool callout_reschedule(callout_t *c, systime_t tm) {
   assert(callout_is_active(c));
   if (callout_is_stopped(c))
     return false;
-  _callout_schedule(c, tm);
+  _callout_schedule(c, st2ct(tm));
+  return true;
+}
+
+bool callout_reschedule_bt(callout_t *c, bintime_t bt) {
+  SCOPED_SPIN_LOCK(&ci.lock);
+  assert(callout_is_active(c));
+  if (callout_is_stopped(c))
+    return false;
+  _callout_schedule(c, bt2ct(bt));
   return true;
 }
 
 bool callout_stop(callout_t *handle) {
   SCOPED_SPIN_LOCK(&ci.lock);
 
-  klog("Remove callout {%p} at %ld.", handle, handle->c_time);
+  klog("Remove callout {%p} at %u.%09u.", handle,
+       (unsigned)(handle->c_time >> 32), ct2nsec(handle->c_time));
 
   callout_set_stopped(handle);
 
   if (callout_is_pending(handle)) {
     callout_clear_pending(handle);
-    TAILQ_REMOVE(ci_list(handle->c_index), handle, c_link);
+    wheel_remove(handle);
     /* A callout may be observed to be both active and pending if it rescheduled
      * itself but hasn't finished executing yet.
      * If that's the case, we must make the caller wait for its completion in
@@ -159,53 +268,65 @@ bool callout_stop(callout_t *handle) {
 }
 
 /*
- * Process all timeouted callouts from queues between last position and
- * current position and delegate them to callout thread.
+ * Visit all slots of the timing wheel due before \a time: cascade callouts
+ * from higher levels and delegate expired callouts to callout thread.
  */
-void callout_process(systime_t time) {
-  unsigned int last_bucket;
-  unsigned int current_bucket = ci.last % CALLOUT_BUCKETS;
-
-  if (time - ci.last > CALLOUT_BUCKETS) {
-    /* Process all buckets */
-    last_bucket = (ci.last - 1) % CALLOUT_BUCKETS;
-  } else {
-    /* Process only buckets in time range ci.last to time */
-    last_bucket = time % CALLOUT_BUCKETS;
-  }
+void callout_process(bintime_t time) {
+  uint64_t last = bt2ct(time) >> WHEEL_SHIFT;
+  uint64_t next;
 
   /* We are in kernel's bottom half. */
   assert(intr_disabled());
 
-  while (true) {
-    callout_list_t *head = ci_list(current_bucket);
-    callout_t *elem, *next;
+  WITH_SPIN_LOCK (&ci.lock) {
+    while ((next = wheel_next()) <= last) {
+      ci.cur = next;
+
+      /* Cascade from the top, so that callouts fall down to level 0 slot
+       * that is about to be visited if they are due now. */
+      for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+        unsigned shift = wheel_shift(level);
+        unsigned slot = (ci.cur >> shift) & WHEEL_MASK;
+        if ((ci.cur & ((1ULL << shift) - 1)) == 0 &&
+            (ci.pending[level] & (1U << slot)))
+          wheel_cascade(level, slot);
+      }
+
+      unsigned slot = ci.cur & WHEEL_MASK;
+      callout_list_t *head = &ci.wheel[0][slot];
+      callout_t *elem;
 
-    /* Detach triggered callouts from ci_list queue. */
-    TAILQ_FOREACH_SAFE (elem, head, c_link, next) {
-      if (elem->c_time <= time) {
+      while ((elem = TAILQ_FIRST(head))) {
         callout_set_active(elem);
         callout_clear_pending(elem);
         TAILQ_REMOVE(head, elem, c_link);
         /* Attach elem to callout thread's queue. */
         TAILQ_INSERT_TAIL(&delegated, elem, c_link);
       }
+      ci.pending[0] &= ~(1U << slot);
+      ci.cur++;
     }
 
-    if (current_bucket == last_bucket)
-      break;
-
-    current_bucket = (current_bucket + 1) % CALLOUT_BUCKETS;
+    ci.cur = max(ci.cur, last + 1);
   }
 
-  ci.last = time;
-
   /* Wake callout thread. */
   if (!TAILQ_EMPTY(&delegated)) {
     sleepq_signal(&delegated);
   }
 }
 
+bintime_t callout_next(bintime_t limit) {
+  SCOPED_SPIN_LOCK(&ci.lock);
+
+  uint64_t next = wheel_next();
+  if (next == UINT64_MAX)
+    return limit;
+
+  bintime_t bt = ct2bt(next << WHEEL_SHIFT);
+  return bintime_cmp(&bt, &limit, <) ? bt : limit;
+}
+
 bool callout_drain(callout_t *handle) {
   SCOPED_INTR_DISABLED();
   if (!callout_is_pending(handle) && !callout_is_active(handle))
@@ -4,25 +4,115 @@
 #include <sys/mimiker.h>
 #include <sys/klog.h>
 #include <sys/timer.h>
+#include <sys/thread.h>
+#include <sys/pcpu.h>
+#include <sys/interrupt.h>
 #include <sys/kgprof.h>
+#include <sys/kprof.h>
+
+/*
+ * System clock can work in one of two modes:
+ *
+ * - periodic: timer interrupt fires every tick, callouts are processed and
+ *   time slice of running thread is decremented on each of them,
+ * - tickless: timer interrupt is programmed in one-shot mode for the nearest
+ *   moment something has to be done, i.e. a callout expires or running thread
+ *   runs out of its time slice.
+ *
+ * Tickless mode is used if the timer supports it. Profiling depends on regular
+ * sampling and other processors do not get timer interrupts of their own, so
+ * periodic mode is used with KGPROF or SMP enabled. While sampling profiler
+ * is running, tickless clock fires at least every tick.
+ */
+
+/* Maximum time between interrupts when nothing is scheduled. Time source
+ * drivers fold elapsed counts into seconds when they get read, so the interval
+ * is kept well below a second, leaving headroom for interrupt latency. */
+#define CLK_IDLE HZ2BT(4)
 
 static systime_t now = 0;
 static timer_t *clock = NULL;
+static bool tickless = false;
+static bintime_t deadline; /* when the next interrupt is programmed for */
+static systime_t last;     /* ticks up to this time were charged to threads */
 
 systime_t getsystime(void) {
+  if (tickless) {
+    bintime_t bin = binuptime();
+    return bt2st(&bin);
+  }
   return now;
 }
 
 static void stat_clock(void) {
   kgprof_tick();
+  kprof_tick();
+}
+
+static void clock_arm(bintime_t when) {
+  assert(intr_disabled());
+
+  bintime_t delay = when;
+  bintime_t cur = binuptime();
+  deadline = when;
+
+  /* Timer driver makes sure that deadline in the past fires immediately. */
+  if (bintime_cmp(&when, &cur, <))
+    delay = (bintime_t){};
+  else
+    bintime_sub(&delay, &cur);
+
+  if (tm_start(clock, TMF_ONESHOT, delay, BINTIME(0)))
+    panic("Failed to program system clock!");
+}
+
+void clock_deadline(bintime_t when) {
+  if (!tickless)
+    return;
+
+  SCOPED_INTR_DISABLED();
+  if (bintime_cmp(&when, &deadline, <))
+    clock_arm(when);
+}
+
+void clock_slice(int slice) {
+  if (!tickless)
+    return;
+
+  SCOPED_INTR_DISABLED();
+  bintime_t when = binuptime();
+  last = bt2st(&when);
+  if (slice > 0) {
+    bintime_t len = bintime_mul(HZ2BT(CLK_TCK), slice);
+    bintime_add(&when, &len);
+    clock_deadline(when);
+  }
 }
 
 static void clock_cb(timer_t *tm, void *arg) {
   bintime_t bin = binuptime();
   now = bt2st(&bin);
+
+  if (!tickless) {
+    stat_clock();
+    callout_process(bin);
+    sched_clock(1);
+    return;
+  }
+
   stat_clock();
-  callout_process(now);
-  sched_clock();
+  callout_process(bin);
+  sched_clock(now - last);
+  last = now;
+
+  bintime_t when = bin, len = CLK_IDLE;
+  thread_t *td = thread_self();
+  if (kprof_running)
+    len = HZ2BT(CLK_TCK);
+  else if (td != PCPU_GET(idle_thread))
+    len = bintime_mul(HZ2BT(CLK_TCK), max(td->td_slice, 1));
+  bintime_add(&when, &len);
+  clock_arm(callout_next(when));
 }
 
 void init_clock(void) {
@@ -30,6 +120,23 @@ void init_clock(void) {
   if (clock == NULL)
     panic("Missing suitable timer for maintenance of system clock!");
   tm_init(clock, clock_cb, NULL);
+
+  if (!KGPROF && !SMP && (clock->tm_flags & TMF_ONESHOT)) {
+    WITH_INTR_DISABLED {
+      if (tm_start(clock, TMF_ONESHOT | TMF_TIMESOURCE, HZ2BT(CLK_TCK),
+                   BINTIME(0)))
+        panic("Failed to start system clock!");
+      tickless = true;
+      deadline = binuptime();
+      last = bt2st(&deadline);
+      bintime_t len = HZ2BT(CLK_TCK);
+      bintime_add(&deadline, &len);
+    }
+    klog("System clock uses \'%s\' hardware timer in tickless mode.",
+         clock->tm_name);
+    return;
+  }
+
   if (tm_start(clock, TMF_PERIODIC | TMF_TIMESOURCE, (bintime_t){},
                HZ2BT(CLK_TCK)))
     panic("Failed to start system clock!");
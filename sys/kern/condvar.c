@@ -1,7 +1,6 @@
 #include <sys/condvar.h>
 #include <sys/sleepq.h>
 #include <sys/sched.h>
-#include <sys/interrupt.h>
 #include <sys/lock.h>
 
 void cv_init(condvar_t *cv, const char *name) {
@@ -9,41 +8,52 @@ void cv_init(condvar_t *cv, const char *name) {
   cv->waiters = 0;
 }
 
+/* Waiters are counted with sleep queue chain of the condition variable locked
+ * and keep holding that lock until they get onto the sleep queue. Thus
+ * cv_signal, even if called on another processor or by an interrupt filter
+ * right after the waiter released \a m, always finds the waiter asleep. */
+
 void cv_wait(condvar_t *cv, lock_t m) {
-  WITH_INTR_DISABLED {
-    cv->waiters++;
-    lk_release(m);
-    /* If we got interrupted here and an interrupt filter called
-     * cv_signal, we would have a lost wakeup, so we need interrupts
-     * to be disabled. Same goes for cv_wait_timed. */
-    sleepq_wait(cv, __caller(0));
-  }
+  sleepq_lock(cv);
+  cv->waiters++;
+  lk_release(m);
+  sleepq_wait_locked(cv, __caller(0));
   lk_acquire(m, __caller(0));
 }
 
 int cv_wait_timed(condvar_t *cv, lock_t m, systime_t timeout) {
-  int status;
-  WITH_INTR_DISABLED {
-    cv->waiters++;
-    lk_release(m);
-    status = sleepq_wait_timed(cv, __caller(0), timeout);
-  }
+  sleepq_lock(cv);
+  cv->waiters++;
+  lk_release(m);
+  int status = sleepq_wait_timed_locked(cv, __caller(0), timeout);
   lk_acquire(m, __caller(0));
   return status;
 }
 
 void cv_signal(condvar_t *cv) {
-  SCOPED_NO_PREEMPTION();
+  bool wakeup = false;
+
+  sleepq_lock(cv);
   if (cv->waiters > 0) {
     cv->waiters--;
-    sleepq_signal(cv);
+    wakeup = true;
   }
+  sleepq_unlock(cv);
+
+  if (wakeup)
+    sleepq_signal(cv);
 }
 
 void cv_broadcast(condvar_t *cv) {
-  SCOPED_NO_PREEMPTION();
+  bool wakeup = false;
+
+  sleepq_lock(cv);
   if (cv->waiters > 0) {
     cv->waiters = 0;
-    sleepq_broadcast(cv);
+    wakeup = true;
   }
+  sleepq_unlock(cv);
+
+  if (wakeup)
+    sleepq_broadcast(cv);
 }
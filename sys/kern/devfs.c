@@ -11,6 +11,7 @@
 #include <sys/vfs.h>
 #include <sys/queue.h>
 #include <sys/stat.h>
+#include <sys/vm_pager.h>
 
 static KMALLOC_DEFINE(M_DEVFS, "devfs");
 
@@ -123,6 +124,7 @@ static int devfs_add_entry(devfs_node_t *parent, const char *name, int mode,
   TAILQ_INSERT_TAIL(&parent->dn_children, dn, dn_link);
   if (mode & S_IFDIR)
     parent->dn_nlinks++;
+  vfs_cache_remove(parent->dn_vnode, &COMPONENTNAME(name));
   *dnp = dn;
 
   return 0;
@@ -140,12 +142,28 @@ void devfs_free(devfs_node_t *dn) {
 
 static int devfs_fop_read(file_t *fp, uio_t *uio) {
   devnode_t *dev = fp->f_data;
-  return dev->ops->d_read(dev, uio);
+  bool seekable = dev->ops->d_type & DT_SEEKABLE;
+  int error;
+
+  if (seekable)
+    uio->uio_offset = fp->f_offset;
+  error = dev->ops->d_read(dev, uio);
+  if (seekable)
+    fp->f_offset = uio->uio_offset;
+  return error;
 }
 
 static int devfs_fop_write(file_t *fp, uio_t *uio) {
   devnode_t *dev = fp->f_data;
-  return dev->ops->d_write(dev, uio);
+  bool seekable = dev->ops->d_type & DT_SEEKABLE;
+  int error;
+
+  if (seekable)
+    uio->uio_offset = fp->f_offset;
+  error = dev->ops->d_write(dev, uio);
+  if (seekable)
+    fp->f_offset = uio->uio_offset;
+  return error;
 }
 
 static int devfs_fop_close(file_t *fp) {
@@ -201,6 +219,22 @@ static int devfs_fop_ioctl(file_t *fp, u_long cmd, void *data) {
   return dev->ops->d_ioctl(dev, cmd, data, fp->f_flags);
 }
 
+static int devfs_fop_mmap(file_t *fp, off_t offset, size_t length,
+                          vm_prot_t prot, vm_object_t **obj_p) {
+  devnode_t *dev = fp->f_data;
+  int error;
+
+  /* Let the driver check whole range before anything gets mapped. */
+  for (size_t off = 0; off < length; off += PAGESIZE) {
+    paddr_t pa;
+    if ((error = dev->ops->d_mmap(dev, offset + off, prot, &pa)))
+      return error;
+  }
+
+  *obj_p = dev_pager_object(dev);
+  return 0;
+}
+
 static fileops_t devfs_fileops = {
   .fo_read = devfs_fop_read,
   .fo_write = devfs_fop_write,
@@ -208,6 +242,7 @@ static fileops_t devfs_fileops = {
   .fo_seek = devfs_fop_seek,
   .fo_stat = devfs_fop_stat,
   .fo_ioctl = devfs_fop_ioctl,
+  .fo_mmap = devfs_fop_mmap,
 };
 
 /*
@@ -414,6 +449,11 @@ static int dev_noioctl(devnode_t *dev, u_long cmd, void *data, int flags) {
   return EOPNOTSUPP;
 }
 
+static int dev_nommap(devnode_t *dev, off_t offset, vm_prot_t prot,
+                      paddr_t *pa_p) {
+  return ENODEV;
+}
+
 static int _devfs_makedev(devfs_node_t *parent, const char *name, void *data,
                           devfs_node_t **dn_p) {
   int error;
@@ -446,6 +486,8 @@ int devfs_makedev_new(devfs_node_t *parent, const char *name, devops_t *devops,
       devops->d_write = dev_nowrite;
     if (devops->d_ioctl == NULL)
       devops->d_ioctl = dev_noioctl;
+    if (devops->d_mmap == NULL)
+      devops->d_mmap = dev_nommap;
 
     dn->dn_device.ops = devops;
   }
@@ -526,6 +568,7 @@ int devfs_unlink(devfs_node_t *dn) {
   TAILQ_REMOVE(&parent->dn_children, dn, dn_link);
   if (dn->dn_device.mode & S_IFDIR)
     parent->dn_nlinks--;
+  vfs_cache_purge(dn->dn_vnode);
   vnode_drop(dn->dn_vnode);
   return 0;
 }
@@ -1,15 +1,738 @@
+#define KL_LOG KL_FILE
+#include <sys/klog.h>
 #include <sys/event.h>
 #include <sys/errno.h>
+#include <sys/callout.h>
+#include <sys/condvar.h>
+#include <sys/fcntl.h>
+#include <sys/file.h>
+#include <sys/filedesc.h>
+#include <sys/mimiker.h>
+#include <sys/mutex.h>
+#include <sys/pool.h>
+#include <sys/proc.h>
+#include <sys/signal.h>
+#include <sys/time.h>
+
+#define KQ_NBUCKETS 32 /* must be power of 2 */
+#define KQ_FDT_NBUCKETS 16 /* must be power of 2 */
+
+/*
+ * Field locking:
+ *
+ * (q) - kqueue_t::kq_lock
+ * (k) - kqueues_lock
+ * (!) - read-only access
+ */
+struct kqueue {
+  mtx_t kq_lock;
+  condvar_t kq_cv;                 /* (q) wait here for events */
+  condvar_t kq_drain;              /* (q) wait here for knotes in flux */
+  TAILQ_HEAD(, knote) kq_pending;  /* (q) list of pending events */
+  knlist_t kq_knhash[KQ_NBUCKETS]; /* (q) registered knotes */
+  fdtab_t *kq_fdt;                 /* (!) table of monitored descriptors */
+  LIST_ENTRY(kqueue) kq_link;      /* (k) link on kqueues of `kq_fdt` */
+};
+
+static POOL_DEFINE(P_KQUEUE, "kqueue", sizeof(kqueue_t));
+static POOL_DEFINE(P_KNOTE, "knote", sizeof(knote_t));
+
+/* Used to find knotes of a descriptor that is being closed. Kqueues are
+ * hashed by their descriptor table, so that closing a descriptor only visits
+ * kqueues that may monitor it. */
+static MTX_DEFINE(kqueues_lock, 0);
+typedef LIST_HEAD(, kqueue) kqlist_t;
+static kqlist_t kqueues[KQ_FDT_NBUCKETS];
+
+static kqlist_t *kqueues_bucket(fdtab_t *fdt) {
+  uintptr_t h = (uintptr_t)fdt >> 6;
+  return &kqueues[(h ^ (h >> 4)) & (KQ_FDT_NBUCKETS - 1)];
+}
+
+/* Remembers the file of an fd-based knote. The file is not referenced by the
+ * knote, which gets dropped by knote_fdclose when the descriptor is closed. */
+#define kn_fp(kn) ((file_t *)(kn)->kn_obj)
+
+static bool filter_uses_fd(uint32_t filter) {
+  return filter == EVFILT_READ || filter == EVFILT_WRITE;
+}
+
+/*
+ * Filters for file descriptors delegate to fo_kqfilter of the file.
+ */
+
+static int filt_fileattach(knote_t *kn) {
+  file_t *fp = kn_fp(kn);
+  if (fp->f_ops->fo_kqfilter == NULL)
+    return EINVAL;
+  return fp->f_ops->fo_kqfilter(fp, kn);
+}
+
+static filterops_t file_filtops = {
+  .filt_attach = filt_fileattach,
+};
+
+/*
+ * Process and signal filters.
+ *
+ * Knotes are attached to a list in proc_t. The process may go away while
+ * knotes are still registered, so `kn_obj` is cleared when it exits and
+ * all_proc_mtx is used to synchronize with that.
+ */
+
+static int filt_procattach(knote_t *kn) {
+  SCOPED_MTX_LOCK(&all_proc_mtx);
+
+  proc_t *p = proc_find(kn->kn_id);
+  if (p == NULL)
+    return ESRCH;
+
+  kn->kn_obj = p;
+  kn->kn_flags |= EV_CLEAR; /* automatically set */
+  SLIST_INSERT_HEAD(&p->p_klist, kn, kn_objlink);
+  proc_unlock(p);
+  return 0;
+}
+
+static void filt_procdetach(knote_t *kn) {
+  SCOPED_MTX_LOCK(&all_proc_mtx);
+
+  proc_t *p = kn->kn_obj;
+  if (p == NULL)
+    return;
+
+  WITH_PROC_LOCK(p) {
+    SLIST_REMOVE(&p->p_klist, kn, knote, kn_objlink);
+  }
+}
+
+static int filt_procevent(knote_t *kn, long hint) {
+  if (hint == 0)
+    return kn->kn_fflags != 0;
+
+  /* Called from knote() with p_lock held. */
+  proc_t *p = kn->kn_obj;
+  uint32_t event = (uint32_t)hint & NOTE_PCTRLMASK;
+
+  if (!(event & NOTE_EXIT) || !(kn->kn_sfflags & NOTE_EXIT))
+    return 0;
+
+  WITH_MTX_LOCK (&kn->kn_kq->kq_lock) {
+    kn->kn_fflags |= NOTE_EXIT;
+    kn->kn_data = p->p_exitstatus;
+    kn->kn_flags |= EV_EOF | EV_ONESHOT;
+  }
+  return 1;
+}
+
+static filterops_t proc_filtops = {
+  .filt_attach = filt_procattach,
+  .filt_detach = filt_procdetach,
+  .filt_event = filt_procevent,
+};
+
+static int filt_sigattach(knote_t *kn) {
+  if (kn->kn_id == 0 || kn->kn_id >= NSIG)
+    return EINVAL;
+
+  proc_t *p = proc_self();
+
+  kn->kn_obj = p;
+  kn->kn_flags |= EV_CLEAR; /* automatically set */
+  WITH_PROC_LOCK(p) {
+    SLIST_INSERT_HEAD(&p->p_klist, kn, kn_objlink);
+  }
+  return 0;
+}
+
+static int filt_sigevent(knote_t *kn, long hint) {
+  if (hint == 0)
+    return kn->kn_data != 0;
+
+  /* Called from knote() with p_lock held. */
+  if (!((uint32_t)hint & NOTE_SIGNAL))
+    return 0;
+
+  if (((uint32_t)hint & NOTE_PDATAMASK) != kn->kn_id)
+    return 0;
+
+  /* Count the number of times the signal was sent to the process. */
+  WITH_MTX_LOCK (&kn->kn_kq->kq_lock)
+    kn->kn_data++;
+  return 1;
+}
+
+static filterops_t sig_filtops = {
+  .filt_attach = filt_sigattach,
+  .filt_detach = filt_procdetach,
+  .filt_event = filt_sigevent,
+};
+
+/*
+ * Timer filter.
+ *
+ * `kn_sdata` is the period in milliseconds and `kn_data` counts expirations
+ * since the event was last reported.
+ */
+
+typedef struct kntimer {
+  callout_t kt_callout;
+  systime_t kt_next;   /* time of the next expiration in system ticks */
+  systime_t kt_period; /* in system ticks */
+} kntimer_t;
+
+static POOL_DEFINE(P_KNTIMER, "kntimer", sizeof(kntimer_t));
+
+static void knote_activate(knote_t *kn);
+
+static void filt_timerexpire(void *arg) {
+  knote_t *kn = arg;
+  kntimer_t *kt = kn->kn_hook;
+
+  WITH_MTX_LOCK (&kn->kn_kq->kq_lock)
+    kn->kn_data++;
+  knote_activate(kn);
+
+  if (!(kn->kn_flags & EV_ONESHOT)) {
+    kt->kt_next += kt->kt_period;
+    callout_reschedule(&kt->kt_callout, kt->kt_next);
+  }
+}
+
+static int filt_timerattach(knote_t *kn) {
+  if (kn->kn_sdata <= 0)
+    return EINVAL;
+
+  /* Convert without overflow and keep the period representable in system
+   * time, which is only 32 bits wide. */
+  int64_t period = kn->kn_sdata / 1000 * CLK_TCK +
+                   kn->kn_sdata % 1000 * CLK_TCK / 1000;
+
+  kntimer_t *kt = pool_alloc(P_KNTIMER, M_ZERO);
+  kt->kt_period = min(max(period, (int64_t)1), (int64_t)INT32_MAX);
+  kn->kn_hook = kt;
+  kn->kn_flags |= EV_CLEAR; /* automatically set */
+
+  callout_setup(&kt->kt_callout, filt_timerexpire, kn);
+  kt->kt_next = getsystime() + kt->kt_period;
+  callout_schedule_abs(&kt->kt_callout, kt->kt_next);
+  return 0;
+}
+
+static void filt_timerdetach(knote_t *kn) {
+  kntimer_t *kt = kn->kn_hook;
+
+  if (!callout_stop(&kt->kt_callout))
+    callout_drain(&kt->kt_callout);
+  pool_free(P_KNTIMER, kt);
+}
+
+static int filt_timerevent(knote_t *kn, long hint) {
+  return kn->kn_data != 0;
+}
+
+static filterops_t timer_filtops = {
+  .filt_attach = filt_timerattach,
+  .filt_detach = filt_timerdetach,
+  .filt_event = filt_timerevent,
+};
+
+static filterops_t *sys_kfilters[EVFILT_SYSCOUNT] = {
+  [EVFILT_READ] = &file_filtops,   [EVFILT_WRITE] = &file_filtops,
+  [EVFILT_PROC] = &proc_filtops,   [EVFILT_SIGNAL] = &sig_filtops,
+  [EVFILT_TIMER] = &timer_filtops,
+};
+
+/*
+ * Knote management.
+ */
+
+static knlist_t *kq_bucket(kqueue_t *kq, uintptr_t ident, uint32_t filter) {
+  return &kq->kq_knhash[(ident ^ (filter << 3)) & (KQ_NBUCKETS - 1)];
+}
+
+static knote_t *kq_find(kqueue_t *kq, uintptr_t ident, uint32_t filter) {
+  assert(mtx_owned(&kq->kq_lock));
+
+  knote_t *kn;
+  SLIST_FOREACH (kn, kq_bucket(kq, ident, filter), kn_hashlink) {
+    if (kn->kn_id == ident && kn->kn_filter == filter)
+      return kn;
+  }
+  return NULL;
+}
+
+/* Looks up a knote and marks it as being in flux, so that other threads can
+ * neither modify nor drop it. Waits until others are done with the knote. */
+static knote_t *kq_acquire(kqueue_t *kq, uintptr_t ident, uint32_t filter) {
+  knote_t *kn;
+  while ((kn = kq_find(kq, ident, filter)) && (kn->kn_status & KN_INFLUX))
+    cv_wait(&kq->kq_drain, &kq->kq_lock);
+  if (kn)
+    kn->kn_status |= KN_INFLUX;
+  return kn;
+}
+
+static void knote_release(knote_t *kn) {
+  kqueue_t *kq = kn->kn_kq;
+  assert(mtx_owned(&kq->kq_lock));
+  assert(kn->kn_status & KN_INFLUX);
+
+  kn->kn_status &= ~KN_INFLUX;
+  cv_broadcast(&kq->kq_drain);
+}
+
+/* Put knote on the queue of pending events and wake up the waiter. */
+static void knote_enqueue(knote_t *kn) {
+  kqueue_t *kq = kn->kn_kq;
+  assert(mtx_owned(&kq->kq_lock));
+
+  if (kn->kn_status & (KN_QUEUED | KN_DISABLED | KN_DROPPING))
+    return;
+
+  kn->kn_status |= KN_QUEUED;
+  TAILQ_INSERT_TAIL(&kq->kq_pending, kn, kn_penlink);
+  cv_signal(&kq->kq_cv);
+}
+
+static void knote_dequeue(knote_t *kn) {
+  kqueue_t *kq = kn->kn_kq;
+  assert(mtx_owned(&kq->kq_lock));
+
+  if (kn->kn_status & KN_QUEUED) {
+    kn->kn_status &= ~KN_QUEUED;
+    TAILQ_REMOVE(&kq->kq_pending, kn, kn_penlink);
+  }
+}
+
+static void knote_activate(knote_t *kn) {
+  WITH_MTX_LOCK (&kn->kn_kq->kq_lock)
+    knote_enqueue(kn);
+}
+
+void knote(knlist_t *list, long hint) {
+  knote_t *kn;
+  SLIST_FOREACH (kn, list, kn_objlink) {
+    if (kn->kn_filtops->filt_event(kn, hint))
+      knote_activate(kn);
+  }
+}
+
+void knote_proc_exit(proc_t *p) {
+  assert(mtx_owned(&all_proc_mtx));
+  assert(mtx_owned(&p->p_lock));
+
+  knote(&p->p_klist, NOTE_EXIT);
+
+  knote_t *kn;
+  SLIST_FOREACH (kn, &p->p_klist, kn_objlink)
+    kn->kn_obj = NULL;
+  SLIST_INIT(&p->p_klist);
+}
+
+/* Check if the event has triggered and enqueue knote if so. */
+static void knote_check(knote_t *kn) {
+  kqueue_t *kq = kn->kn_kq;
+  int active;
+
+  if (kn->kn_objlock) {
+    WITH_MTX_LOCK (kn->kn_objlock)
+      active = kn->kn_filtops->filt_event(kn, 0);
+    if (active)
+      knote_activate(kn);
+  } else {
+    WITH_MTX_LOCK (&kq->kq_lock) {
+      if (kn->kn_filtops->filt_event(kn, 0))
+        knote_enqueue(kn);
+    }
+  }
+}
+
+/* Detaches and frees a knote that the caller has marked as in flux. The knote
+ * stays on the hash table until it's gone, so others wait for that. */
+static void knote_drop(knote_t *kn) {
+  kqueue_t *kq = kn->kn_kq;
+
+  WITH_MTX_LOCK (&kq->kq_lock) {
+    assert(kn->kn_status & KN_INFLUX);
+    kn->kn_status |= KN_DROPPING;
+    knote_dequeue(kn);
+  }
+
+  if (kn->kn_filtops->filt_detach)
+    kn->kn_filtops->filt_detach(kn);
+
+  WITH_MTX_LOCK (&kq->kq_lock) {
+    SLIST_REMOVE(kq_bucket(kq, kn->kn_id, kn->kn_filter), kn, knote,
+                 kn_hashlink);
+    cv_broadcast(&kq->kq_drain);
+  }
+
+  pool_free(P_KNOTE, kn);
+}
+
+void knote_fdclose(fdtab_t *fdt, int fd) {
+  SCOPED_MTX_LOCK(&kqueues_lock);
+
+  kqueue_t *kq;
+  LIST_FOREACH (kq, kqueues_bucket(fdt), kq_link) {
+    if (kq->kq_fdt != fdt)
+      continue;
+    for (uint32_t filter = 0; filter < EVFILT_SYSCOUNT; filter++) {
+      if (!filter_uses_fd(filter))
+        continue;
+      knote_t *kn;
+      WITH_MTX_LOCK (&kq->kq_lock)
+        kn = kq_acquire(kq, fd, filter);
+      if (kn)
+        knote_drop(kn);
+    }
+  }
+}
+
+/* Checks whether `fd` still refers to `fp`. */
+static bool fd_refers_to(fdtab_t *fdt, int fd, file_t *fp) {
+  file_t *cur;
+  if (fdtab_get_file(fdt, fd, 0, &cur))
+    return false;
+  file_drop(cur);
+  return cur == fp;
+}
+
+static int knote_attach(kqueue_t *kq, kevent_t *kev) {
+  knote_t *kn = pool_alloc(P_KNOTE, M_ZERO);
+  file_t *fp = NULL;
+  int error;
+
+  kn->kn_kq = kq;
+  kn->kn_kevent = *kev;
+  kn->kn_flags &= EV_ONESHOT | EV_CLEAR;
+  kn->kn_fflags = 0;
+  kn->kn_data = 0;
+  kn->kn_sfflags = kev->fflags;
+  kn->kn_sdata = kev->data;
+  kn->kn_filtops = sys_kfilters[kev->filter];
+
+  /* The file is referenced only until the knote is attached. */
+  if (filter_uses_fd(kev->filter)) {
+    if ((error = fdtab_get_file(kq->kq_fdt, kev->ident, 0, &fp)))
+      goto fail;
+    kn->kn_obj = fp;
+  }
+
+  /* Timer may fire right after it was attached. Others have to wait until the
+   * knote is fully set up. */
+  WITH_MTX_LOCK (&kq->kq_lock) {
+    kn->kn_status = KN_INFLUX;
+    SLIST_INSERT_HEAD(kq_bucket(kq, kev->ident, kev->filter), kn, kn_hashlink);
+  }
+
+  if ((error = kn->kn_filtops->filt_attach(kn))) {
+    WITH_MTX_LOCK (&kq->kq_lock) {
+      SLIST_REMOVE(kq_bucket(kq, kev->ident, kev->filter), kn, knote,
+                   kn_hashlink);
+      cv_broadcast(&kq->kq_drain);
+    }
+    goto fail;
+  }
+
+  /* If the descriptor got closed in the meantime, knote_fdclose could have
+   * missed the knote. */
+  if (fp && !fd_refers_to(kq->kq_fdt, kev->ident, fp)) {
+    knote_drop(kn);
+    file_drop(fp);
+    return EBADF;
+  }
+
+  if (kev->flags & EV_DISABLE) {
+    WITH_MTX_LOCK (&kq->kq_lock)
+      kn->kn_status |= KN_DISABLED;
+  }
+
+  knote_check(kn);
+
+  WITH_MTX_LOCK (&kq->kq_lock)
+    knote_release(kn);
+  if (fp)
+    file_drop(fp);
+  return 0;
+
+fail:
+  if (fp)
+    file_drop(fp);
+  pool_free(P_KNOTE, kn);
+  return error;
+}
+
+static int kqueue_register(proc_t *p, kqueue_t *kq, kevent_t *kev) {
+  if (kev->filter >= EVFILT_SYSCOUNT || sys_kfilters[kev->filter] == NULL)
+    return EINVAL;
+
+  knote_t *kn;
+  WITH_MTX_LOCK (&kq->kq_lock)
+    kn = kq_acquire(kq, kev->ident, kev->filter);
+
+  if (kn == NULL) {
+    if (kev->flags & EV_ADD)
+      return knote_attach(kq, kev);
+    return ENOENT;
+  }
+
+  if (kev->flags & EV_DELETE) {
+    knote_drop(kn);
+    return 0;
+  }
+
+  /* Modify an existing knote. */
+  WITH_MTX_LOCK (&kq->kq_lock) {
+    if (kev->flags & EV_ADD)
+      kn->kn_kevent.udata = kev->udata;
+
+    if (kev->flags & EV_DISABLE) {
+      kn->kn_status |= KN_DISABLED;
+      knote_dequeue(kn);
+    }
+
+    if (kev->flags & EV_ENABLE)
+      kn->kn_status &= ~KN_DISABLED;
+  }
+
+  if (kev->flags & EV_ENABLE)
+    knote_check(kn);
+
+  WITH_MTX_LOCK (&kq->kq_lock)
+    knote_release(kn);
+  return 0;
+}
+
+/*
+ * Moves events from pending queue to `eventlist`. Events that are still active
+ * after being reported (unless EV_CLEAR or EV_ONESHOT is set) are put back on
+ * the queue, as they may be still reported next time.
+ */
+static int kqueue_scan(kqueue_t *kq, kevent_t *eventlist, size_t nevents,
+                       timespec_t *timeout, int *retval) {
+  TAILQ_HEAD(, knote) requeue = TAILQ_HEAD_INITIALIZER(requeue);
+  systime_t ticks = 0;
+  size_t nret = 0;
+  int error = 0;
+
+  if (timeout) {
+    if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 ||
+        timeout->tv_nsec >= 1000000000)
+      return EINVAL;
+    if (timespecisset(timeout))
+      ticks = max(ts2hz(timeout), (systime_t)1);
+  }
+
+  SCOPED_MTX_LOCK(&kq->kq_lock);
+
+  while (nret < nevents) {
+    knote_t *kn = TAILQ_FIRST(&kq->kq_pending);
+
+    if (kn == NULL) {
+      /* Do not wait if there are events to report or polling was requested. */
+      if (nret > 0 || (timeout && ticks == 0))
+        break;
+      error = cv_wait_timed(&kq->kq_cv, &kq->kq_lock, ticks);
+      if (error == ETIMEDOUT) {
+        error = 0;
+        break;
+      }
+      if (error)
+        break;
+      continue;
+    }
+
+    /* Someone else is modifying or dropping the knote. Wait until it is done
+     * and leave the knote on the queue, so the event does not get lost.
+     * Dropped knotes are removed from the queue by knote_drop. */
+    if (kn->kn_status & KN_INFLUX) {
+      cv_wait(&kq->kq_drain, &kq->kq_lock);
+      continue;
+    }
+
+    knote_dequeue(kn);
+
+    /* The knote cannot go away while kq_lock is released. */
+    kn->kn_status |= KN_INFLUX;
+
+    /* Event state must be checked under object lock. */
+    kevent_t kev = {0};
+    int active;
+    if (kn->kn_objlock) {
+      mtx_unlock(&kq->kq_lock);
+      WITH_MTX_LOCK (kn->kn_objlock) {
+        if ((active = kn->kn_filtops->filt_event(kn, 0))) {
+          kev = kn->kn_kevent;
+          if (kn->kn_flags & EV_CLEAR)
+            kn->kn_fflags = kn->kn_data = 0;
+        }
+      }
+      mtx_lock(&kq->kq_lock);
+    } else {
+      if ((active = kn->kn_filtops->filt_event(kn, 0))) {
+        kev = kn->kn_kevent;
+        if (kn->kn_flags & EV_CLEAR)
+          kn->kn_fflags = kn->kn_data = 0;
+      }
+    }
+
+    if (active && !(kn->kn_status & KN_DISABLED)) {
+      eventlist[nret++] = kev;
+
+      if (kn->kn_flags & EV_ONESHOT) {
+        mtx_unlock(&kq->kq_lock);
+        knote_drop(kn);
+        mtx_lock(&kq->kq_lock);
+        continue;
+      }
+
+      if (!(kn->kn_flags & EV_CLEAR) && !(kn->kn_status & KN_QUEUED)) {
+        kn->kn_status |= KN_QUEUED;
+        TAILQ_INSERT_TAIL(&requeue, kn, kn_penlink);
+      }
+    }
+
+    knote_release(kn);
+  }
+
+  TAILQ_CONCAT(&kq->kq_pending, &requeue, kn_penlink);
+
+  *retval = nret;
+  return error;
+}
+
+/*
+ * Kqueue file operations.
+ */
+
+static int kqueue_read(file_t *f, uio_t *uio) {
+  return EOPNOTSUPP;
+}
+
+static int kqueue_close(file_t *f) {
+  kqueue_t *kq = f->f_data;
+
+  WITH_MTX_LOCK (&kqueues_lock)
+    LIST_REMOVE(kq, kq_link);
+
+  /* Nobody else can reach the kqueue now, so no knote is in flux. */
+  for (int i = 0; i < KQ_NBUCKETS; i++) {
+    for (;;) {
+      knote_t *kn;
+      WITH_MTX_LOCK (&kq->kq_lock) {
+        if ((kn = SLIST_FIRST(&kq->kq_knhash[i]))) {
+          assert(!(kn->kn_status & KN_INFLUX));
+          kn->kn_status |= KN_INFLUX;
+        }
+      }
+      if (kn == NULL)
+        break;
+      knote_drop(kn);
+    }
+  }
+
+  pool_free(P_KQUEUE, kq);
+  return 0;
+}
+
+static int kqueue_stat(file_t *f, stat_t *sb) {
+  return EOPNOTSUPP;
+}
+
+static int kqueue_ioctl(file_t *f, u_long cmd, void *data) {
+  return EOPNOTSUPP;
+}
+
+static fileops_t kqueueops = {
+  .fo_read = kqueue_read,
+  .fo_write = nowrite,
+  .fo_close = kqueue_close,
+  .fo_seek = noseek,
+  .fo_stat = kqueue_stat,
+  .fo_ioctl = kqueue_ioctl,
+};
 
 int do_kqueue1(proc_t *p, int flags, int *fd) {
-  return ENOTSUP;
+  int error;
+
+  if (flags & ~(O_CLOEXEC | O_NONBLOCK))
+    return EINVAL;
+
+  kqueue_t *kq = pool_alloc(P_KQUEUE, M_ZERO);
+  mtx_init(&kq->kq_lock, 0);
+  cv_init(&kq->kq_cv, "kqueue");
+  cv_init(&kq->kq_drain, "kqueue_drain");
+  TAILQ_INIT(&kq->kq_pending);
+  for (int i = 0; i < KQ_NBUCKETS; i++)
+    SLIST_INIT(&kq->kq_knhash[i]);
+  kq->kq_fdt = p->p_fdtable;
+
+  file_t *f = file_alloc();
+  f->f_data = kq;
+  f->f_ops = &kqueueops;
+  f->f_type = FT_KQUEUE;
+  f->f_flags = FF_READ | FF_WRITE;
+  if (flags & O_NONBLOCK)
+    f->f_flags |= IO_NONBLOCK;
+
+  if ((error = fdtab_install_file(p->p_fdtable, f, 0, fd))) {
+    file_destroy(f);
+    pool_free(P_KQUEUE, kq);
+    return error;
+  }
+
+  WITH_MTX_LOCK (&kqueues_lock)
+    LIST_INSERT_HEAD(kqueues_bucket(kq->kq_fdt), kq, kq_link);
+
+  if ((error = fd_set_cloexec(p->p_fdtable, *fd, flags & O_CLOEXEC))) {
+    fdtab_close_fd(p->p_fdtable, *fd);
+    return error;
+  }
+
+  return 0;
 }
 
-int do_kevent(proc_t *p, int kq, kevent_t *changelist, size_t nchanges,
+int do_kevent(proc_t *p, int fd, kevent_t *changelist, size_t nchanges,
               kevent_t *eventlist, size_t nevents, timespec_t *timeout,
               int *retval) {
-  return ENOTSUP;
-}
+  file_t *f;
+  int error;
 
-void knote(knlist_t *list, long hint) {
+  if ((error = fdtab_get_file(p->p_fdtable, fd, 0, &f)))
+    return error;
+
+  if (f->f_type != FT_KQUEUE) {
+    file_drop(f);
+    return EBADF;
+  }
+
+  kqueue_t *kq = f->f_data;
+  size_t nerrors = 0;
+
+  /* Errors are reported back in `eventlist` if there is space for them. */
+  for (size_t i = 0; i < nchanges; i++) {
+    kevent_t *kev = &changelist[i];
+    if ((error = kqueue_register(p, kq, kev))) {
+      if (nerrors == nevents)
+        goto end;
+      eventlist[nerrors] = *kev;
+      eventlist[nerrors].flags = EV_ERROR;
+      eventlist[nerrors].data = error;
+      nerrors++;
+      error = 0;
+    }
+  }
+
+  if (nerrors > 0) {
+    *retval = nerrors;
+    goto end;
+  }
+
+  error = kqueue_scan(kq, eventlist, nevents, timeout, retval);
+
+end:
+  file_drop(f);
+  return error;
 }
@@ -345,9 +345,6 @@ static char *pargs_create(exec_args_t *args) {
   return pargs;
 }
 
-/* XXX We assume process may only have a single thread. But if there were more
- * than one thread in the process that called exec, all other threads must be
- * forcefully terminated. */
 static int _do_execve(exec_args_t *args) {
   thread_t *td = thread_self();
   proc_t *p = td->td_proc;
@@ -356,6 +353,14 @@ static int _do_execve(exec_args_t *args) {
 
   assert(p != NULL);
 
+  /* Other threads must not run while the address space gets replaced, so they
+   * are terminated even though exec may still fail. */
+  WITH_PROC_LOCK(p) {
+    error = proc_single_thread();
+  }
+  if (error)
+    return error;
+
   bool use_interpreter = false;
   char *prog;
   for (;;) {
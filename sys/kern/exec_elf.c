@@ -5,6 +5,7 @@
 #include <sys/libkern.h>
 #include <sys/vm_map.h>
 #include <sys/vm_object.h>
+#include <sys/vm_pager.h>
 #include <sys/malloc.h>
 #include <sys/errno.h>
 #include <sys/vnode.h>
@@ -83,6 +84,44 @@ int exec_elf_inspect(vnode_t *vn, Elf_Ehdr *eh) {
   return 0;
 }
 
+/* Maps pages of segment that are backed by the file. They are paged in on
+ * demand from the object shared by all mappings of the file and get copied
+ * only when written to, so processes running the same program share its text.
+ * Returns address of the first page following the mapped ones. */
+static vaddr_t map_elf_file_pages(proc_t *p, vnode_t *vn, Elf_Phdr *ph,
+                                  vm_prot_t prot) {
+  vaddr_t start = ph->p_vaddr;
+  vaddr_t end = roundup(ph->p_vaddr + ph->p_filesz, PAGESIZE);
+
+  vm_object_t *file_obj = vnode_pager_object(vn);
+  vm_object_t *obj = vm_object_shadow(file_obj);
+  vm_object_drop(file_obj);
+
+  vm_map_entry_t *ent =
+    vm_map_entry_alloc(obj, start, end, prot, VM_ENT_PRIVATE);
+  vm_map_entry_set_offset(ent, ph->p_offset);
+  int error = vm_map_insert(p->p_uspace, ent, VM_FIXED);
+  /* TODO: What if segments overlap? */
+  assert(error == 0);
+
+  return end;
+}
+
+/* Copies contents of the segment from the file into anonymous memory at
+ * [start, start + filesz). Used when file offset of segment is not page
+ * aligned, hence it cannot be mapped directly. */
+static int read_elf_file_pages(vnode_t *vn, Elf_Phdr *ph) {
+  int error;
+  uio_t uio =
+    UIO_SINGLE_USER(UIO_READ, ph->p_offset, (char *)ph->p_vaddr, ph->p_filesz);
+  if ((error = VOP_READ(vn, &uio))) {
+    klog("Exec failed: Reading ELF segment failed.");
+    return error;
+  }
+  assert(uio.uio_resid == 0);
+  return 0;
+}
+
 static int load_elf_segment(proc_t *p, vnode_t *vn, Elf_Phdr *ph) {
   int error;
 
@@ -100,46 +139,58 @@ static int load_elf_segment(proc_t *p, vnode_t *vn, Elf_Phdr *ph) {
     return ENOEXEC;
   }
 
+  if (ph->p_filesz > ph->p_memsz) {
+    klog("Exec failed: Segment file size exceeds its memory size!");
+    return ENOEXEC;
+  }
+
   vaddr_t start = ph->p_vaddr;
   vaddr_t end = roundup(ph->p_vaddr + ph->p_memsz, PAGESIZE);
+  bool mapped = ph->p_filesz > 0 && page_aligned_p(ph->p_offset);
 
   /* Temporarily permissive protection. */
-  vm_object_t *obj = vm_object_alloc(VM_ANONYMOUS);
-  vm_map_entry_t *ent = vm_map_entry_alloc(
-    obj, start, end, VM_PROT_READ | VM_PROT_WRITE | VM_PROT_EXEC,
-    VM_ENT_PRIVATE);
-  error = vm_map_insert(p->p_uspace, ent, VM_FIXED);
-  /* TODO: What if segments overlap? */
-  assert(error == 0);
+  vm_prot_t tmp_prot = VM_PROT_READ | VM_PROT_WRITE | VM_PROT_EXEC;
+
+  vaddr_t anon_start = start;
+  if (mapped)
+    anon_start = map_elf_file_pages(p, vn, ph, tmp_prot);
+
+  /* Remaining part of segment is zero-filled on demand. */
+  if (anon_start < end) {
+    vm_object_t *obj = vm_object_alloc(VM_ANONYMOUS);
+    vm_map_entry_t *ent =
+      vm_map_entry_alloc(obj, anon_start, end, tmp_prot, VM_ENT_PRIVATE);
+    error = vm_map_insert(p->p_uspace, ent, VM_FIXED);
+    /* TODO: What if segments overlap? */
+    assert(error == 0);
+  }
 
-  /* Read data from file into the map entry */
-  if (ph->p_filesz > 0) {
-    /* TODO: This is a lot of copying! Ideally we would look up the
-     * vm_object associated with the elf vnode, create a shadow vm_object
-     * on top of it using correct size/offset, and we would use it to page
-     * the file contents on demand. But we don't have a vnode_pager yet.
-     */
-    uio_t uio =
-      UIO_SINGLE_USER(UIO_READ, ph->p_offset, (char *)start, ph->p_filesz);
-    if ((error = VOP_READ(vn, &uio))) {
-      klog("Exec failed: Reading ELF segment failed.");
+  if (ph->p_filesz > 0 && !mapped) {
+    if ((error = read_elf_file_pages(vn, ph)))
+      return error;
+  }
+
+  /* The last page backed by the file may contain bytes that follow the
+   * segment in the file, but belong to .bss section in memory. */
+  vaddr_t file_end = ph->p_vaddr + ph->p_filesz;
+  if (mapped && ph->p_memsz > ph->p_filesz && !page_aligned_p(file_end)) {
+    size_t len = roundup(file_end, PAGESIZE) - file_end;
+    void *zeros = kmalloc(M_TEMP, len, M_ZERO);
+    error = copyout(zeros, (void *)file_end, len);
+    kfree(M_TEMP, zeros);
+    if (error)
       return error;
-    }
-    assert(uio.uio_resid == 0);
   }
 
   /* Apply correct permissions */
   vm_prot_t prot = VM_PROT_NONE;
-  if (ph->p_flags | PF_R)
+  if (ph->p_flags & PF_R)
     prot |= VM_PROT_READ;
-  if (ph->p_flags | PF_W)
+  if (ph->p_flags & PF_W)
     prot |= VM_PROT_WRITE;
-  if (ph->p_flags | PF_X)
+  if (ph->p_flags & PF_X)
     prot |= VM_PROT_EXEC;
-  /* Note: vm_map_protect is not yet implemented, so
-   * this will have no effect as of now */
-  vm_map_protect(p->p_uspace, start, end, prot);
-  return 0;
+  return vm_map_protect(p->p_uspace, start, end, prot);
 }
 
 int exec_elf_load(proc_t *p, vnode_t *vn, Elf_Ehdr *eh) {
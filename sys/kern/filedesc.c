@@ -3,6 +3,7 @@
 #include <sys/malloc.h>
 #include <sys/libkern.h>
 #include <sys/errno.h>
+#include <sys/event.h>
 #include <sys/mutex.h>
 #include <sys/refcnt.h>
 #include <bitstring.h>
@@ -104,13 +105,22 @@ static int fd_alloc(fdtab_t *fdt, int minfd, int *fdp) {
   return 0;
 }
 
-static void fd_free(fdtab_t *fdt, int fd) {
+/* Releases descriptor and returns the file it used to refer to. */
+static file_t *fd_free(fdtab_t *fdt, int fd) {
   fdent_t *fde = &fdt->fdt_entries[fd];
-  assert(fde->fde_file != NULL);
-  file_drop(fde->fde_file);
+  file_t *f = fde->fde_file;
+  assert(f != NULL);
   fde->fde_file = NULL;
   fde->fde_cloexec = false;
   fd_mark_unused(fdt, fd);
+  return f;
+}
+
+/* Finishes closing descriptor released with fd_free. Must be called with
+ * `fdt_mtx` released, as dropping knotes or closing the file may sleep. */
+static void fd_closed(fdtab_t *fdt, int fd, file_t *f) {
+  knote_fdclose(fdt, fd);
+  file_drop(f);
 }
 
 /* Create empty file descriptor table. */
@@ -161,7 +171,7 @@ void fdtab_drop(fdtab_t *fdt) {
   /* Clean up used descriptors. This possibly closes underlying files. */
   for (int i = 0; i < fdt->fdt_nfiles; i++)
     if (fd_is_used(fdt, i))
-      fd_free(fdt, i);
+      fd_closed(fdt, i, fd_free(fdt, i));
 
   kfree(M_FD, fdt->fdt_entries);
   kfree(M_FD, fdt->fdt_map);
@@ -187,6 +197,8 @@ int fdtab_install_file_at(fdtab_t *fdt, file_t *f, int fd) {
   assert(f != NULL);
   assert(fdt != NULL);
 
+  file_t *old = NULL;
+
   WITH_MTX_LOCK (&fdt->fdt_mtx) {
     if (is_bad_fd(fdt, fd))
       return EBADF;
@@ -196,7 +208,7 @@ int fdtab_install_file_at(fdtab_t *fdt, file_t *f, int fd) {
     if (fd_is_used(fdt, fd)) {
       if (fde->fde_file == f)
         break;
-      fd_free(fdt, fd);
+      old = fd_free(fdt, fd);
     }
     fde->fde_file = f;
     fde->fde_cloexec = false;
@@ -204,6 +216,8 @@ int fdtab_install_file_at(fdtab_t *fdt, file_t *f, int fd) {
   }
 
   file_hold(f);
+  if (old)
+    fd_closed(fdt, fd, old);
   return 0;
 }
 
@@ -238,11 +252,15 @@ int fdtab_get_file(fdtab_t *fdt, int fd, int flags, file_t **fp) {
 /* Closes a file descriptor. If it was the last reference to a file, the file is
  * also closed. */
 int fdtab_close_fd(fdtab_t *fdt, int fd) {
-  SCOPED_MTX_LOCK(&fdt->fdt_mtx);
+  file_t *f;
 
-  if (is_bad_fd(fdt, fd) || !fd_is_used(fdt, fd))
-    return EBADF;
-  fd_free(fdt, fd);
+  WITH_MTX_LOCK (&fdt->fdt_mtx) {
+    if (is_bad_fd(fdt, fd) || !fd_is_used(fdt, fd))
+      return EBADF;
+    f = fd_free(fdt, fd);
+  }
+
+  fd_closed(fdt, fd, f);
   return 0;
 }
 
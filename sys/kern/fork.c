@@ -109,3 +109,57 @@ int do_fork(void (*start)(void *), void *arg, pid_t *cldpidp) {
 
   return error;
 }
+
+/* Before entering user space for the first time a new thread has to check
+ * whether it was asked to exit or stop, or has signals to handle. */
+static void lwp_start(void *arg) {
+  thread_t *td = thread_self();
+  on_user_exc_leave(td->td_uctx, NULL);
+  user_exc_leave();
+}
+
+int do_lwp_create(void *func, void *arg, void *stack, tid_t *tidp) {
+  thread_t *td = thread_self();
+  proc_t *p = td->td_proc;
+
+  /* Cannot create threads in kernel processes. */
+  assert(p);
+
+  thread_t *newtd = thread_create(td->td_name, lwp_start, NULL,
+                                  td->td_base_prio);
+
+  /* Registers the function is not going to touch are copied from the creator,
+   * which matters e.g. for the global pointer on MIPS. */
+  mcontext_copy(newtd->td_uctx, td->td_uctx);
+  mcontext_setup_call(newtd->td_uctx, func, stack, (register_t)arg);
+
+  newtd->td_kframe = NULL;
+  newtd->td_onfault = 0;
+
+  newtd->td_wchan = NULL;
+  newtd->td_waitpt = NULL;
+
+  newtd->td_prio = td->td_prio;
+
+  WITH_PROC_LOCK(p) {
+    newtd->td_sigmask = td->td_sigmask;
+
+    WITH_SPIN_LOCK (newtd->td_lock) {
+      newtd->td_proc = p;
+      /* Creator may have been asked to exit or stop together with other
+       * threads, and so has to be the new one. */
+      newtd->td_flags |= td->td_flags & (TDF_EXITING | TDF_STOPPING);
+      if (newtd->td_flags & (TDF_EXITING | TDF_STOPPING))
+        newtd->td_flags |= TDF_NEEDSIGCHK;
+    }
+
+    TAILQ_INSERT_TAIL(&p->p_threads, newtd, td_procq);
+    p->p_nthreads++;
+  }
+
+  *tidp = newtd->td_tid;
+
+  sched_add(newtd);
+
+  return 0;
+}
@@ -0,0 +1,178 @@
+#define KL_LOG KL_PROC
+#include <sys/klog.h>
+#include <sys/errno.h>
+#include <sys/futex.h>
+#include <sys/mimiker.h>
+#include <sys/mutex.h>
+#include <sys/pool.h>
+#include <sys/queue.h>
+#include <sys/sleepq.h>
+#include <sys/thread.h>
+#include <sys/vm_map.h>
+#include <sys/vm_object.h>
+
+#define FUTEX_NBUCKETS 64 /* must be power of 2 */
+
+/*
+ * Key identifies a user word regardless of the address it's mapped at. Words
+ * in shared mappings are keyed by backing object and offset within it, so all
+ * processes mapping the object agree on the key. Private memory is keyed by
+ * address space and virtual address, as its objects get replaced on fork.
+ */
+typedef struct futex_key {
+  void *fk_space;    /* vm_object_t or vm_map_t */
+  vaddr_t fk_offset; /* offset within object or virtual address */
+  bool fk_shared;    /* holds a reference to the object */
+} futex_key_t;
+
+/*
+ * Field locking:
+ *
+ * (f) - futex_lock
+ */
+typedef struct futex {
+  LIST_ENTRY(futex) f_link; /* (f) link on hash bucket */
+  futex_key_t f_key;        /* key of the word */
+  unsigned f_waiters;       /* (f) threads sleeping or going to sleep */
+} futex_t;
+
+typedef LIST_HEAD(, futex) futex_list_t;
+
+static POOL_DEFINE(P_FUTEX, "futex", sizeof(futex_t));
+
+/* Protects the hash table and all futexes. Threads sleep on a futex using its
+ * address as the waiting channel. */
+static MTX_DEFINE(futex_lock, 0);
+static futex_list_t futex_hash[FUTEX_NBUCKETS];
+
+static int futex_key_get(int *uaddr, futex_key_t *key) {
+  vm_map_t *map = vm_map_user();
+  vaddr_t va = (vaddr_t)uaddr;
+  vm_object_t *obj;
+  vm_offset_t offset;
+  int error;
+
+  if (va & (sizeof(int) - 1))
+    return EINVAL;
+
+  if ((error = vm_map_shared_object(map, va, &obj, &offset)))
+    return error;
+
+  key->fk_shared = (obj != NULL);
+  key->fk_space = obj ? (void *)obj : (void *)map;
+  key->fk_offset = obj ? offset : va;
+  return 0;
+}
+
+static void futex_key_put(futex_key_t *key) {
+  if (key->fk_shared)
+    vm_object_drop(key->fk_space);
+}
+
+static futex_list_t *futex_bucket(futex_key_t *key) {
+  uintptr_t h = (uintptr_t)key->fk_space ^ (key->fk_offset >> 2);
+  return &futex_hash[(h ^ (h >> 8)) & (FUTEX_NBUCKETS - 1)];
+}
+
+static futex_t *futex_lookup(futex_key_t *key) {
+  assert(mtx_owned(&futex_lock));
+
+  futex_t *f;
+  LIST_FOREACH (f, futex_bucket(key), f_link) {
+    if (f->f_key.fk_space == key->fk_space &&
+        f->f_key.fk_offset == key->fk_offset)
+      return f;
+  }
+  return NULL;
+}
+
+/* Reads the word with futex_lock held. The word may reside in a file mapping,
+ * whose page-in would make all futex users wait for file I/O, so page-ins are
+ * disabled. If the page is missing, it gets faulted in with the lock released
+ * and the read is retried. Nobody can wake us up until we go to sleep anyway,
+ * as waking threads need the lock. */
+static int futex_read(int *uaddr, int *curp) {
+  thread_t *td = thread_self();
+
+  for (;;) {
+    td->td_pflags |= TDP_NOPAGEIN;
+    int error = copyin_s(uaddr, *curp);
+    tdp_flags_t pflags = td->td_pflags;
+    td->td_pflags &= ~(TDP_NOPAGEIN | TDP_PAGEINFAILED);
+
+    if (error != EFAULT || !(pflags & TDP_PAGEINFAILED))
+      return error;
+
+    mtx_unlock(&futex_lock);
+    error = copyin_s(uaddr, *curp);
+    mtx_lock(&futex_lock);
+    if (error)
+      return error;
+  }
+}
+
+int do_futex_wait(int *uaddr, int val, systime_t timeout) {
+  futex_key_t key;
+  futex_t *f;
+  int error, cur;
+
+  if ((error = futex_key_get(uaddr, &key)))
+    return error;
+
+  mtx_lock(&futex_lock);
+
+  if ((error = futex_read(uaddr, &cur)))
+    goto end;
+
+  if (cur != val) {
+    error = EAGAIN;
+    goto end;
+  }
+
+  if (!(f = futex_lookup(&key))) {
+    f = pool_alloc(P_FUTEX, M_ZERO);
+    f->f_key = key;
+    LIST_INSERT_HEAD(futex_bucket(&key), f, f_link);
+  }
+  f->f_waiters++;
+
+  klog("Thread %ld waits on futex %p (%p:%lx)", thread_self()->td_tid, uaddr,
+       key.fk_space, key.fk_offset);
+
+  /* Same as for condition variables, a wakeup between releasing the lock and
+   * going to sleep would get lost, unless the sleep queue is locked first. */
+  sleepq_lock(f);
+  mtx_unlock(&futex_lock);
+  error = sleepq_wait_timed_locked(f, __caller(0), timeout);
+
+  mtx_lock(&futex_lock);
+  if (--f->f_waiters == 0) {
+    LIST_REMOVE(f, f_link);
+    pool_free(P_FUTEX, f);
+  }
+
+end:
+  mtx_unlock(&futex_lock);
+  futex_key_put(&key);
+  return error;
+}
+
+int do_futex_wake(int *uaddr, int nwake, int *nwokenp) {
+  futex_key_t key;
+  int error, nwoken = 0;
+
+  if ((error = futex_key_get(uaddr, &key)))
+    return error;
+
+  WITH_MTX_LOCK (&futex_lock) {
+    futex_t *f = futex_lookup(&key);
+    /* Waiters that timed out or got interrupted are not on the sleep queue
+     * anymore, even though they may be still counted in. */
+    while (f && nwoken < nwake && sleepq_signal(f))
+      nwoken++;
+  }
+
+  futex_key_put(&key);
+  *nwokenp = nwoken;
+  return 0;
+}
@@ -204,7 +204,12 @@ static ino_t initrd_enum_inodes(cpio_node_t *parent, ino_t ino) {
   return ino;
 }
 
+/* Lookups under shared directory lock may race to create a vnode. */
+static MTX_DEFINE(initrd_vnode_lock, 0);
+
 static vnode_t *vnode_of_cpio_node(cpio_node_t *cn) {
+  SCOPED_MTX_LOCK(&initrd_vnode_lock);
+
   if (!cn->c_vnode) {
     vnodetype_t type = ft2vt[CMTOFT(cn->c_mode)];
     cn->c_vnode = vnode_new(type, &initrd_vops, cn);
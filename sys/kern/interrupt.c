@@ -7,6 +7,7 @@
 #include <sys/pcpu.h>
 #include <sys/sleepq.h>
 #include <sys/sched.h>
+#include <sys/ktrace.h>
 
 static KMALLOC_DEFINE(M_INTR, "interrupt events & handlers");
 
@@ -218,6 +219,8 @@ void intr_event_run_handlers(intr_event_t *ie) {
     }
   }
 
+  KTRACE(KTR_INTR, ie->ie_irq, ie_status);
+
   if (ie_status & IF_DELEGATE) {
     ie_disable(ie);
     sleepq_signal(ie);
@@ -0,0 +1,152 @@
+#define KL_LOG KL_DEV
+#include <sys/klog.h>
+#include <sys/context.h>
+#include <sys/cred.h>
+#include <sys/devfs.h>
+#include <sys/errno.h>
+#include <sys/interrupt.h>
+#include <sys/kmem.h>
+#include <sys/kprof.h>
+#include <sys/libkern.h>
+#include <sys/linker_set.h>
+#include <sys/mutex.h>
+#include <sys/pcpu.h>
+#include <sys/proc.h>
+#include <sys/spinlock.h>
+#include <sys/thread.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/vnode.h>
+
+/*
+ * Samples are taken by system clock interrupt handler, so they can only be
+ * stored into ring buffer under a spin lock. The ring is allocated when the
+ * profiler is started for the first time. If the reader does not keep up,
+ * new samples are dropped and counted.
+ */
+
+#define KPROF_NSAMPLES 1024 /* must be a power of 2 */
+
+bool kprof_running;
+
+static SPIN_DEFINE(kprof_lock, 0);
+static MTX_DEFINE(kprof_ctl_lock, 0); /* serializes start & stop (c) */
+static kprof_sample_t *kprof_ring;    /* (c) never freed once allocated */
+static unsigned kprof_head;           /* (l) index of next sample to write */
+static unsigned kprof_tail;           /* (l) index of next sample to read */
+static kprof_stat_t kprof_stat;       /* (l) */
+
+void kprof_sample(void) {
+  assert(intr_disabled());
+
+  thread_t *td = thread_self();
+  proc_t *p = td->td_proc;
+  uintptr_t pcs[KPROF_MAXDEPTH];
+  unsigned depth = 0;
+
+  /* td_kframe is NULL if the thread was interrupted in user mode. */
+  if (td->td_kframe)
+    depth = ctx_backtrace(td, td->td_kframe, pcs, KPROF_MAXDEPTH);
+
+  bintime_t now = binuptime();
+
+  SCOPED_SPIN_LOCK(&kprof_lock);
+
+  kprof_stat.kst_samples++;
+
+  if (kprof_head - kprof_tail == KPROF_NSAMPLES) {
+    kprof_stat.kst_dropped++;
+    return;
+  }
+
+  kprof_sample_t *ks = &kprof_ring[kprof_head++ & (KPROF_NSAMPLES - 1)];
+  ks->ks_time = ((uint64_t)now.sec << 32) | (now.frac >> 32);
+  ks->ks_upc = p ? mcontext_get_pc(td->td_uctx) : 0;
+  for (unsigned i = 0; i < KPROF_MAXDEPTH; i++)
+    ks->ks_kpc[i] = i < depth ? pcs[i] : 0;
+  ks->ks_tid = td->td_tid;
+  ks->ks_pid = p ? p->p_pid : 0;
+  ks->ks_cpu = PCPU_GET(cpuid);
+  ks->ks_depth = depth;
+}
+
+static int kprof_start(void) {
+  SCOPED_MTX_LOCK(&kprof_ctl_lock);
+
+  if (kprof_ring == NULL) {
+    kprof_ring = kmem_alloc(KPROF_NSAMPLES * sizeof(kprof_sample_t), M_ZERO);
+    if (kprof_ring == NULL)
+      return ENOMEM;
+  }
+
+  WITH_SPIN_LOCK (&kprof_lock)
+    kprof_stat.kst_running = 1;
+  kprof_running = true;
+
+  /* In tickless mode the clock may be programmed far into the future. */
+  bintime_t when = binuptime();
+  bintime_t tick = HZ2BT(CLK_TCK);
+  bintime_add(&when, &tick);
+  clock_deadline(when);
+  return 0;
+}
+
+static void kprof_stop(void) {
+  SCOPED_MTX_LOCK(&kprof_ctl_lock);
+
+  kprof_running = false;
+  WITH_SPIN_LOCK (&kprof_lock)
+    kprof_stat.kst_running = 0;
+}
+
+/*
+ * Reading /dev/kprof returns binary `kprof_sample_t` records that have not
+ * been read yet. Use kprof(1) to control the profiler and
+ * sys/debug/kprof_fold.py to turn samples into folded stacks.
+ */
+static int dev_kprof_read(vnode_t *v, uio_t *uio) {
+  kprof_sample_t ks;
+  int error = 0;
+
+  while (uio->uio_resid >= sizeof(kprof_sample_t) && !error) {
+    WITH_SPIN_LOCK (&kprof_lock) {
+      if (kprof_ring == NULL || kprof_head == kprof_tail)
+        return 0;
+      ks = kprof_ring[kprof_tail++ & (KPROF_NSAMPLES - 1)];
+    }
+    error = uiomove(&ks, sizeof(ks), uio);
+  }
+
+  return error;
+}
+
+static int dev_kprof_ioctl(vnode_t *v, u_long cmd, void *data, file_t *fp) {
+  /* Samples reveal what other processes do, and taking them makes the clock
+   * tick all the time, so only root may control the profiler. */
+  if ((cmd == KPROFIOC_START || cmd == KPROFIOC_STOP) &&
+      cred_self()->cr_euid != 0)
+    return EPERM;
+  if (cmd == KPROFIOC_START)
+    return kprof_start();
+  if (cmd == KPROFIOC_STOP) {
+    kprof_stop();
+    return 0;
+  }
+  if (cmd == KPROFIOC_GETSTAT) {
+    WITH_SPIN_LOCK (&kprof_lock)
+      *(kprof_stat_t *)data = kprof_stat;
+    return 0;
+  }
+  return EINVAL;
+}
+
+static vnodeops_t dev_kprof_vnodeops = {
+  .v_read = dev_kprof_read,
+  .v_ioctl = dev_kprof_ioctl,
+};
+
+static void init_dev_kprof(void) {
+  devfs_makedev(NULL, "kprof", &dev_kprof_vnodeops, NULL, NULL);
+}
+
+SET_ENTRY(devfs_init, init_dev_kprof);
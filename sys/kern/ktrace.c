@@ -0,0 +1,161 @@
+#define KL_LOG KL_DEV
+#include <sys/klog.h>
+#include <sys/cred.h>
+#include <sys/devfs.h>
+#include <sys/errno.h>
+#include <sys/kmem.h>
+#include <sys/ktrace.h>
+#include <sys/linker_set.h>
+#include <sys/mutex.h>
+#include <sys/pcpu.h>
+#include <sys/thread.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/vnode.h>
+#include <stdatomic.h>
+
+/*
+ * Every processor has its own ring of trace records. A writer reserves a slot
+ * by atomically incrementing ring head, fills it in and publishes it by
+ * storing record sequence number as the last step. Old records are overwritten
+ * without waiting for the reader.
+ *
+ * The reader uses record sequence numbers to skip slots that were overwritten
+ * while it was copying them out. It reports the number of records it missed
+ * with a KTR_LOST record.
+ */
+
+#define KTRACE_NEVENTS 2048 /* must be a power of 2 */
+
+typedef struct ktrace_ring {
+  atomic_uint head;       /* sequence number of next record to be written */
+  unsigned tail;          /* (r) sequence number of next record to be read */
+  ktrace_event_t *events; /* KTRACE_NEVENTS records */
+} ktrace_ring_t;
+
+unsigned ktrace_mask;
+
+static ktrace_ring_t ktrace_ring[MAXCPU];
+static MTX_DEFINE(ktrace_lock, 0); /* serializes readers (r) */
+
+void ktrace_record(ktrace_type_t type, uintptr_t arg0, uintptr_t arg1) {
+  unsigned cpu = PCPU_GET(cpuid);
+  ktrace_ring_t *kr = &ktrace_ring[cpu];
+  bintime_t now = binuptime();
+
+  if (kr->events == NULL)
+    return;
+
+  unsigned seq = atomic_fetch_add(&kr->head, 1);
+  ktrace_event_t *ke = &kr->events[seq & (KTRACE_NEVENTS - 1)];
+
+  /* Mark the slot as being written to. */
+  ke->ke_seq = seq - 1;
+  atomic_thread_fence(memory_order_release);
+
+  ke->ke_time = ((uint64_t)now.sec << 32) | (now.frac >> 32);
+  ke->ke_arg[0] = arg0;
+  ke->ke_arg[1] = arg1;
+  ke->ke_tid = thread_self()->td_tid;
+  ke->ke_type = type;
+  ke->ke_cpu = cpu;
+
+  atomic_thread_fence(memory_order_release);
+  ke->ke_seq = seq;
+}
+
+/* Copies out records from ring `kr` as long as there is room in `uio` for
+ * a record and possibly a KTR_LOST record preceding it. */
+static int ktrace_copyout(ktrace_ring_t *kr, unsigned cpu, uio_t *uio) {
+  unsigned head = atomic_load(&kr->head);
+  unsigned lost = 0;
+  int error;
+
+  if (head - kr->tail > KTRACE_NEVENTS) {
+    lost = head - kr->tail - KTRACE_NEVENTS;
+    kr->tail = head - KTRACE_NEVENTS;
+  }
+
+  while (kr->tail != head && uio->uio_resid >= 2 * sizeof(ktrace_event_t)) {
+    ktrace_event_t *slot = &kr->events[kr->tail & (KTRACE_NEVENTS - 1)];
+    ktrace_event_t ke;
+
+    unsigned seq = slot->ke_seq;
+    atomic_thread_fence(memory_order_acquire);
+    ke = *slot;
+    atomic_thread_fence(memory_order_acquire);
+
+    /* Writer that reserved the slot has not finished yet. */
+    if ((int)(seq - kr->tail) < 0)
+      break;
+
+    /* Record got overwritten before or while we were reading it. */
+    if (seq != kr->tail || slot->ke_seq != seq) {
+      lost++;
+      kr->tail++;
+      continue;
+    }
+
+    if (lost) {
+      ktrace_event_t kl = {.ke_time = ke.ke_time,
+                           .ke_arg = {lost},
+                           .ke_seq = seq,
+                           .ke_type = KTR_LOST,
+                           .ke_cpu = cpu};
+      if ((error = uiomove(&kl, sizeof(kl), uio)))
+        return error;
+      lost = 0;
+    }
+
+    if ((error = uiomove(&ke, sizeof(ke), uio)))
+      return error;
+    kr->tail++;
+  }
+
+  return 0;
+}
+
+/*
+ * Reading /dev/ktrace returns binary `ktrace_event_t` records that have not
+ * been read yet, grouped by processor. Use ktrace(1) to decode them.
+ */
+static int dev_ktrace_read(vnode_t *v, uio_t *uio) {
+  int error = 0;
+
+  SCOPED_MTX_LOCK(&ktrace_lock);
+
+  for (unsigned cpu = 0; cpu < MAXCPU && !error; cpu++)
+    if (ktrace_ring[cpu].events)
+      error = ktrace_copyout(&ktrace_ring[cpu], cpu, uio);
+
+  return error;
+}
+
+static int dev_ktrace_ioctl(vnode_t *v, u_long cmd, void *data, file_t *fp) {
+  if (cmd == KTRACEIOC_GETMASK) {
+    *(unsigned *)data = ktrace_mask;
+    return 0;
+  }
+  if (cmd == KTRACEIOC_SETMASK) {
+    /* Tracing costs every thread in the system, so only root may enable it. */
+    if (cred_self()->cr_euid != 0)
+      return EPERM;
+    ktrace_mask = *(unsigned *)data & KTR_ALL;
+    return 0;
+  }
+  return EINVAL;
+}
+
+static vnodeops_t dev_ktrace_vnodeops = {
+  .v_read = dev_ktrace_read,
+  .v_ioctl = dev_ktrace_ioctl,
+};
+
+static void init_dev_ktrace(void) {
+  for (unsigned cpu = 0; cpu < MAXCPU; cpu++)
+    ktrace_ring[cpu].events =
+      kmem_alloc(KTRACE_NEVENTS * sizeof(ktrace_event_t), M_ZERO);
+  devfs_makedev(NULL, "ktrace", &dev_ktrace_vnodeops, NULL, NULL);
+}
+
+SET_ENTRY(devfs_init, init_dev_ktrace);
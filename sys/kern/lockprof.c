@@ -0,0 +1,200 @@
+#include <sys/devfs.h>
+#include <sys/hash.h>
+#include <sys/interrupt.h>
+#include <sys/libkern.h>
+#include <sys/linker_set.h>
+#include <sys/lockdep.h>
+#include <sys/lockprof.h>
+#include <sys/mimiker.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/vnode.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/*
+ * Records are kept in an open addressing hash table. Once the table gets
+ * full, acquisitions at new sites are accounted to the overflow record.
+ *
+ * Profiler is called from within spin lock and mutex implementation, so it
+ * cannot use them. Instead the table is protected by a bare test-and-set lock
+ * taken with interrupts disabled.
+ */
+
+typedef struct lock_prof {
+  lock_class_key_t *lp_key; /* lock class or NULL if record is unused */
+  const char *lp_name;      /* lock class name */
+  const void *lp_site;      /* where the lock was acquired */
+  unsigned lp_type;         /* LK_TYPE_* */
+  unsigned lp_acquired;     /* number of acquisitions */
+  unsigned lp_contended;    /* number of acquisitions that had to wait */
+  uint64_t lp_wait_total;   /* time spent waiting for the lock */
+  uint64_t lp_wait_max;     /* longest wait */
+  uint64_t lp_hold_total;   /* time the lock was held */
+  uint64_t lp_hold_max;     /* longest hold */
+} lock_prof_t;
+
+static lock_prof_t lp_table[LOCKPROF_MAX_RECORDS];
+static lock_prof_t lp_overflow = {.lp_name = "(overflow)"};
+static atomic_int lp_busy;
+
+static void lp_lock(void) {
+  intr_disable();
+  while (atomic_exchange_explicit(&lp_busy, 1, memory_order_acquire))
+    continue;
+}
+
+static void lp_unlock(void) {
+  atomic_store_explicit(&lp_busy, 0, memory_order_release);
+  intr_enable();
+}
+
+uint64_t lockprof_now(void) {
+  bintime_t now = binuptime();
+  return ((uint64_t)now.sec << 32) | (now.frac >> 32);
+}
+
+static lock_prof_t *lp_find(lock_class_key_t *key, const char *name,
+                            unsigned type, const void *site) {
+  uint32_t h = hash32_buf(&key, sizeof(key), HASH32_BUF_INIT);
+  h = hash32_buf(&site, sizeof(site), h);
+
+  for (unsigned i = 0; i < LOCKPROF_MAX_RECORDS; i++) {
+    lock_prof_t *lp = &lp_table[(h + i) & (LOCKPROF_MAX_RECORDS - 1)];
+    if (lp->lp_key == NULL) {
+      lp->lp_key = key;
+      lp->lp_name = name;
+      lp->lp_site = site;
+      lp->lp_type = type;
+      return lp;
+    }
+    if (lp->lp_key == key && lp->lp_site == site)
+      return lp;
+  }
+
+  return &lp_overflow;
+}
+
+lock_prof_t *lockprof_acquire(lock_t lock, lock_class_mapping_t *map,
+                              const void *site, uint64_t waitstart,
+                              uint64_t now) {
+  /* Statically allocated locks are classes of their own. */
+  lock_class_key_t *key = map->key ? map->key : (lock_class_key_t *)lock.attr;
+  lock_prof_t *lp;
+
+  lp_lock();
+  lp = lp_find(key, map->name, lk_type(lock), site);
+  lp->lp_acquired++;
+  if (waitstart) {
+    uint64_t wait = now - waitstart;
+    lp->lp_contended++;
+    lp->lp_wait_total += wait;
+    lp->lp_wait_max = max(lp->lp_wait_max, wait);
+  }
+  lp_unlock();
+
+  return lp;
+}
+
+void lockprof_release(lock_prof_t *lp, uint64_t locktime) {
+  uint64_t hold = lockprof_now() - locktime;
+
+  lp_lock();
+  lp->lp_hold_total += hold;
+  lp->lp_hold_max = max(lp->lp_hold_max, hold);
+  lp_unlock();
+}
+
+static unsigned long long lp_usec(uint64_t t) {
+  return (t >> 32) * 1000000ULL + (((t & 0xffffffff) * 1000000ULL) >> 32);
+}
+
+static const char *lp_type_name[] = {
+  [0] = "?",
+  [LK_TYPE_BLOCK] = "block",
+  [LK_TYPE_SPIN] = "spin",
+  [LK_TYPE_SLEEP] = "sleep",
+};
+
+static int lp_format(char *buf, size_t size, const lock_prof_t *lp) {
+  return snprintf(buf, size, "%s %p %s %u %u %llu %llu %llu %llu\n",
+                  lp->lp_name ? lp->lp_name : "?", lp->lp_site,
+                  lp_type_name[lp->lp_type & LK_TYPE_MASK], lp->lp_acquired,
+                  lp->lp_contended, lp_usec(lp->lp_wait_total),
+                  lp_usec(lp->lp_wait_max), lp_usec(lp->lp_hold_total),
+                  lp_usec(lp->lp_hold_max));
+}
+
+/*
+ * /dev/lockprof reports one line per lock class and acquisition site, e.g.:
+ * name site type acquired contended wait_us wait_max_us hold_us hold_max_us
+ * thread0_lock 0x80012345 spin 10234 0 0 0 5120 31
+ *
+ * Records are formatted anew on every read, so the file should be read in one
+ * go, e.g. with cat(1).
+ */
+static const char lp_header[] = "name site type acquired contended wait_us "
+                                "wait_max_us hold_us hold_max_us\n";
+
+static int dev_lockprof_read(vnode_t *v, uio_t *uio) {
+  off_t offset = uio->uio_offset;
+  off_t pos = 0;
+  char line[128];
+  int error = 0;
+
+  for (int i = -1; i <= LOCKPROF_MAX_RECORDS && uio->uio_resid > 0; i++) {
+    lock_prof_t lp;
+    int len;
+
+    if (i < 0) {
+      len = strlcpy(line, lp_header, sizeof(line));
+    } else {
+      lp_lock();
+      lp = i < LOCKPROF_MAX_RECORDS ? lp_table[i] : lp_overflow;
+      lp_unlock();
+      if (lp.lp_acquired == 0)
+        continue;
+      len = lp_format(line, sizeof(line), &lp);
+    }
+
+    len = min((size_t)len, sizeof(line) - 1);
+    if (pos + len > offset) {
+      size_t skip = max(offset - pos, (off_t)0);
+      if ((error = uiomove(line + skip, len - skip, uio)))
+        return error;
+    }
+    pos += len;
+  }
+
+  return 0;
+}
+
+/* Records are only cleared, since their addresses may be stored in locks
+ * being held right now. */
+static void lp_reset(lock_prof_t *lp) {
+  lp->lp_acquired = lp->lp_contended = 0;
+  lp->lp_wait_total = lp->lp_wait_max = 0;
+  lp->lp_hold_total = lp->lp_hold_max = 0;
+}
+
+static int dev_lockprof_write(vnode_t *v, uio_t *uio) {
+  lp_lock();
+  for (int i = 0; i < LOCKPROF_MAX_RECORDS; i++)
+    lp_reset(&lp_table[i]);
+  lp_reset(&lp_overflow);
+  lp_unlock();
+
+  uio->uio_resid = 0;
+  return 0;
+}
+
+static vnodeops_t dev_lockprof_vnodeops = {
+  .v_read = dev_lockprof_read,
+  .v_write = dev_lockprof_write,
+};
+
+static void init_dev_lockprof(void) {
+  devfs_makedev(NULL, "lockprof", &dev_lockprof_vnodeops, NULL, NULL);
+}
+
+SET_ENTRY(devfs_init, init_dev_lockprof);
@@ -9,6 +9,7 @@
 #include <sys/bus.h>
 #include <sys/kenv.h>
 #include <sys/sched.h>
+#include <sys/smp.h>
 #include <sys/interrupt.h>
 #include <sys/sleepq.h>
 #include <sys/turnstile.h>
@@ -80,6 +81,7 @@ __noreturn void kernel_init(void) {
   init_pool();
   init_vmem();
   init_kmem();
+  init_kmalloc_classes();
   init_vm_map();
 
   init_cons();
@@ -110,6 +112,10 @@ __noreturn void kernel_init(void) {
    * so it's high time to start system clock. */
   init_clock();
 
+  /* Other processors take threads from their own run queues, so they can be
+   * started now, when scheduler and interrupts are fully functional. */
+  init_smp();
+
   init_kgprof();
 
   klog("Kernel initialized!");
@@ -5,6 +5,7 @@
 #include <sys/mutex.h>
 #include <sys/malloc.h>
 #include <sys/kmem.h>
+#include <sys/pool.h>
 #include <sys/kasan.h>
 #include <sys/queue.h>
 
@@ -47,6 +48,7 @@ typedef enum {
   USED = 1,     /* this block is used */
   PREVFREE = 2, /* previous block is free */
   ISLAST = 4,   /* last block in an arena */
+  SLAB = 8,     /* block comes from a size class pool, not from an arena */
 } bt_flags;
 
 /* Stored in payload of free blocks. */
@@ -72,7 +74,7 @@ static node_t freebins[NBINS];
 /* --=[ boundary tag handling ]=-------------------------------------------- */
 
 static inline word_t bt_size(word_t *bt) {
-  return *bt & ~(USED | PREVFREE | ISLAST);
+  return *bt & ~(USED | PREVFREE | ISLAST | SLAB);
 }
 
 static inline int bt_used(word_t *bt) {
@@ -330,6 +332,75 @@ static void *realloc(void *old_ptr, size_t size) {
   return new_ptr;
 }
 
+/* --=[ size classes ]=----------------------------------------------------- */
+
+/* Small requests are served from pools (backed by per-CPU magazines) without
+ * taking `arena_lock`. Size classes are powers of two and 3/4 steps between
+ * them. Each item is preceded by ALIGNMENT bytes, which keep the payload
+ * aligned just like arena blocks are. The last word of that space is a fake
+ * boundary tag with SLAB flag set and size class index in place of size. */
+#define KMCLASS_MAXSIZE 1024
+#define KMCLASS_STEP 16
+#define NKMCLASS 12
+
+static const uint16_t kmclass_size[NKMCLASS] = {16,  32,  48,  64,  96,  128,
+                                                192, 256, 384, 512, 768, 1024};
+static pool_t *kmclass_pool[NKMCLASS];
+/* Maps (size - 1) / KMCLASS_STEP to the smallest fitting size class. */
+static uint8_t kmclass_index[KMCLASS_MAXSIZE / KMCLASS_STEP];
+
+bool kmalloc_use_classes;
+
+#define KMCLASS_TAG(c) (((c) << 4) | SLAB | USED)
+#define KMCLASS_OF(bt) (*(bt) >> 4)
+
+static inline size_t kmclass_blksz(unsigned c) {
+  return ALIGNMENT + kmclass_size[c];
+}
+
+static void kmalloc_account(kmalloc_pool_t *mp, size_t size) {
+  size_t used = atomic_fetch_add(&mp->used, size) + size;
+  size_t maxused = atomic_load(&mp->maxused);
+  while (used > maxused &&
+         !atomic_compare_exchange_weak(&mp->maxused, &maxused, used))
+    continue;
+  atomic_fetch_add(&mp->active, 1);
+  atomic_fetch_add(&mp->nrequests, 1);
+}
+
+static void kfree_account(kmalloc_pool_t *mp, size_t size) {
+  atomic_fetch_sub(&mp->used, size);
+  atomic_fetch_sub(&mp->active, 1);
+}
+
+static void *kmclass_alloc(kmalloc_pool_t *mp, size_t size, unsigned flags) {
+  unsigned c = kmclass_index[(size - 1) / KMCLASS_STEP];
+  void *item = pool_alloc(kmclass_pool[c], flags & ~M_ZERO);
+  if (item == NULL)
+    return NULL;
+
+  void *ptr = item + ALIGNMENT;
+  *bt_fromptr(ptr) = KMCLASS_TAG(c);
+  kmalloc_account(mp, kmclass_blksz(c));
+
+  if (flags & M_ZERO)
+    bzero(ptr, size);
+  return ptr;
+}
+
+static void kmclass_free(kmalloc_pool_t *mp, void *ptr) {
+  word_t *bt = bt_fromptr(ptr);
+  unsigned c = KMCLASS_OF(bt);
+
+  if (!bt_used(bt))
+    panic("Double free detected at %p!", ptr);
+  assert(c < NKMCLASS);
+
+  *bt &= ~USED;
+  kfree_account(mp, kmclass_blksz(c));
+  pool_free(kmclass_pool[c], ptr - ALIGNMENT);
+}
+
 /* --=[ kernel API ]=------------------------------------------------------- */
 
 static void arena_init(arena_t *ar) {
@@ -360,6 +431,9 @@ void *kmalloc(kmalloc_pool_t *mp, size_t size, unsigned flags) {
   if (size == 0)
     return NULL;
 
+  if (size <= KMCLASS_MAXSIZE && kmalloc_use_classes)
+    return kmclass_alloc(mp, size, flags);
+
 #if KASAN
   size_t req_size = blk_size(size + KASAN_KMALLOC_REDZONE_SIZE);
 #else /* !KASAN */
@@ -377,13 +451,10 @@ void *kmalloc(kmalloc_pool_t *mp, size_t size, unsigned flags) {
         return NULL;
       arena_add();
     }
-
-    mp->used += req_size;
-    mp->maxused = max(mp->used, mp->maxused);
-    mp->active++;
-    mp->nrequests++;
   }
 
+  kmalloc_account(mp, req_size);
+
   /* Create redzone after the buffer. */
   kasan_mark(ptr, size, req_size - USEDBLK_SZ, KASAN_CODE_KMALLOC_OVERFLOW);
   if (flags & M_ZERO)
@@ -394,8 +465,7 @@ void *kmalloc(kmalloc_pool_t *mp, size_t size, unsigned flags) {
 static void kfree_nokasan(kmalloc_pool_t *mp, void *ptr) {
   assert(mtx_owned(&arena_lock));
   word_t *bt = bt_fromptr(ptr);
-  mp->used -= bt_size(bt);
-  mp->active--;
+  kfree_account(mp, bt_size(bt));
   free(ptr);
 }
 
@@ -403,6 +473,11 @@ void kfree(kmalloc_pool_t *mp, void *ptr) {
   if (ptr == NULL)
     return;
 
+  if (*bt_fromptr(ptr) & SLAB) {
+    kmclass_free(mp, ptr);
+    return;
+  }
+
   WITH_MTX_LOCK (&arena_lock) {
 #if KASAN
     word_t *bt = bt_fromptr(ptr);
@@ -414,7 +489,8 @@ void kfree(kmalloc_pool_t *mp, void *ptr) {
   }
 }
 
-void *krealloc(kmalloc_pool_t *mp, void *old_ptr, size_t size, unsigned flags) {
+void *krealloc(kmalloc_pool_t *mp, void *old_ptr, size_t size,
+               kmem_flags_t flags) {
   void *new_ptr;
 
   if (size == 0) {
@@ -425,15 +501,25 @@ void *krealloc(kmalloc_pool_t *mp, void *old_ptr, size_t size, unsigned flags) {
   if (old_ptr == NULL)
     return kmalloc(mp, size, flags);
 
-  WITH_MTX_LOCK (&arena_lock) {
-    if ((new_ptr = realloc(old_ptr, size)))
-      return new_ptr;
+  word_t *bt = bt_fromptr(old_ptr);
+  size_t old_size;
+
+  if (*bt & SLAB) {
+    old_size = kmclass_size[KMCLASS_OF(bt)];
+    /* Block from size class pool is big enough. */
+    if (size <= old_size)
+      return old_ptr;
+  } else {
+    old_size = bt_size(bt) - sizeof(word_t);
+    WITH_MTX_LOCK (&arena_lock) {
+      if ((new_ptr = realloc(old_ptr, size)))
+        return new_ptr;
+    }
   }
 
   /* Run out of options - need to move block physically. */
   if ((new_ptr = kmalloc(mp, size, flags))) {
-    word_t *bt = bt_fromptr(old_ptr);
-    memcpy(new_ptr, old_ptr, bt_size(bt) - sizeof(word_t));
+    memcpy(new_ptr, old_ptr, min(old_size, size));
     kfree(mp, old_ptr);
     return new_ptr;
   }
@@ -502,5 +588,21 @@ void init_kmalloc(void) {
   arena_init((arena_t *)BOOT_ARENA);
 }
 
+void init_kmalloc_classes(void) {
+  static const char *desc[NKMCLASS] = {
+    "kmalloc-16",  "kmalloc-32",  "kmalloc-48",  "kmalloc-64",
+    "kmalloc-96",  "kmalloc-128", "kmalloc-192", "kmalloc-256",
+    "kmalloc-384", "kmalloc-512", "kmalloc-768", "kmalloc-1024"};
+
+  for (unsigned c = 0, i = 0; c < NKMCLASS; c++) {
+    kmclass_pool[c] = pool_create(desc[c], kmclass_blksz(c), ALIGNMENT);
+    for (; i * KMCLASS_STEP < kmclass_size[c]; i++)
+      kmclass_index[i] = c;
+  }
+
+  /* KASAN catches use-after-free of arena blocks thanks to the quarantine. */
+  kmalloc_use_classes = !KASAN;
+}
+
 KMALLOC_DEFINE(M_TEMP, "temporaries");
 KMALLOC_DEFINE(M_STR, "strings");
@@ -4,8 +4,11 @@
 #include <sys/mman.h>
 #include <sys/thread.h>
 #include <sys/errno.h>
+#include <sys/file.h>
+#include <sys/filedesc.h>
 #include <sys/vm_map.h>
 #include <sys/vm_object.h>
+#include <sys/vm_pager.h>
 #include <sys/mutex.h>
 #include <sys/proc.h>
 
@@ -22,7 +25,60 @@ static_assert(VM_PRIVATE == MAP_PRIVATE, "VM_PRIVATE != MAP_PRIVATE");
 static_assert(VM_FIXED == MAP_FIXED, "VM_FIXED != MAP_FIXED");
 static_assert(VM_STACK == MAP_STACK, "VM_STACK != MAP_STACK");
 
-int do_mmap(vaddr_t *addr_p, size_t length, int u_prot, int u_flags) {
+/* Obtains object to map `length` bytes of file `fd` starting at `pos` with.
+ * Private mappings get an anonymous object that shadows the file. Sets
+ * protection that the mapping may be later raised to with mprotect. */
+static int mmap_file_object(int fd, off_t pos, size_t length, vm_prot_t prot,
+                            vm_flags_t flags, vm_object_t **obj_p,
+                            vm_prot_t *max_prot_p) {
+  file_t *f;
+  int error;
+
+  if (pos < 0 || !page_aligned_p(pos))
+    return EINVAL;
+
+  if ((error = fdtab_get_file(proc_self()->p_fdtable, fd, 0, &f)))
+    return error;
+
+  if (!(f->f_flags & FF_READ))
+    error = EACCES;
+  else if ((flags & VM_SHARED) && (prot & VM_PROT_WRITE) &&
+           !(f->f_flags & FF_WRITE))
+    error = EACCES;
+  else if (f->f_ops->fo_mmap == NULL)
+    error = ENODEV;
+  else
+    error = f->f_ops->fo_mmap(f, pos, length, prot, obj_p);
+
+  *max_prot_p = VM_PROT_MASK;
+  if ((flags & VM_SHARED) && !(f->f_flags & FF_WRITE))
+    *max_prot_p &= ~VM_PROT_WRITE;
+
+  file_drop(f);
+
+  if (error)
+    return error;
+
+  /* Device memory was checked to be accessible with `prot` only. */
+  if ((*obj_p)->vo_pager->pgr_type == VM_DEVICE)
+    *max_prot_p = prot;
+
+  if (flags & VM_PRIVATE) {
+    vm_object_t *obj = *obj_p;
+    /* Device memory cannot be copied on write. */
+    if (obj->vo_pager->pgr_type == VM_DEVICE) {
+      vm_object_drop(obj);
+      return EINVAL;
+    }
+    *obj_p = vm_object_shadow(obj);
+    vm_object_drop(obj);
+  }
+
+  return 0;
+}
+
+int do_mmap(vaddr_t *addr_p, size_t length, int u_prot, int u_flags, int fd,
+            off_t pos) {
   thread_t *td = thread_self();
   assert(td->td_proc != NULL);
   vm_map_t *vmap = td->td_proc->p_uspace;
@@ -35,6 +91,9 @@ int do_mmap(vaddr_t *addr_p, size_t length, int u_prot, int u_flags) {
   *addr_p = (vaddr_t)MAP_FAILED;
   length = roundup(length, PAGESIZE);
 
+  if (prot & ~VM_PROT_MASK)
+    return EINVAL;
+
   vm_flags_t sharing = flags & (VM_SHARED | VM_PRIVATE);
   if (sharing == (VM_SHARED | VM_PRIVATE))
     return EINVAL;
@@ -42,13 +101,26 @@ int do_mmap(vaddr_t *addr_p, size_t length, int u_prot, int u_flags) {
     return EINVAL;
 
   int error;
+  vm_object_t *obj = NULL;
+  vm_offset_t offset = 0;
+  vm_prot_t max_prot = VM_PROT_MASK;
+
+  if (!(flags & VM_ANON)) {
+    if ((error = mmap_file_object(fd, pos, length, prot, flags, &obj,
+                                  &max_prot)))
+      return error;
+    offset = pos;
+  }
+
   vm_map_entry_t *ent;
-  if ((error = vm_map_alloc_entry(vmap, addr, length, prot, flags, &ent)))
+  if ((error = vm_map_alloc_entry(vmap, obj, offset, addr, length, prot,
+                                  max_prot, flags, &ent)))
     return error;
 
   vaddr_t start = vm_map_entry_start(ent);
 
-  klog("Created map entry at %p, length: %u", (void *)start, length);
+  klog("Created map entry at %p, length: %u, offset: %lu", (void *)start,
+       length, offset);
 
   *addr_p = start;
   return 0;
@@ -92,3 +164,27 @@ int do_munmap(vaddr_t start, size_t length) {
   }
   return 0;
 }
+
+int do_mprotect(vaddr_t start, size_t length, int u_prot) {
+  thread_t *td = thread_self();
+  assert(td && td->td_proc && td->td_proc->p_uspace);
+
+  vm_map_t *uspace = proc_self()->p_uspace;
+  vm_prot_t prot = u_prot;
+
+  if (!page_aligned_p(start))
+    return EINVAL;
+
+  if (prot & ~VM_PROT_MASK)
+    return EINVAL;
+
+  length = roundup(length, PAGESIZE);
+  if (length == 0)
+    return 0;
+
+  vaddr_t end = start + length;
+  if (end < start || !vm_map_contains_p(uspace, start, end))
+    return ENOMEM;
+
+  return vm_map_protect(uspace, start, end, prot);
+}
@@ -1,8 +1,19 @@
 #include <sys/klog.h>
+#include <sys/devfs.h>
+#include <sys/ktrace.h>
+#include <sys/linker_set.h>
 #include <sys/mutex.h>
+#include <sys/pcpu.h>
+#include <sys/smp.h>
 #include <sys/turnstile.h>
 #include <sys/sched.h>
 #include <sys/thread.h>
+#include <sys/vnode.h>
+#include <stdio.h>
+
+static atomic_uint mtx_nspins;    /* times a thread spun on a mutex */
+static atomic_uint mtx_nacquired; /* spins that ended with mutex acquired */
+static atomic_uint mtx_nblocks;   /* times a thread blocked on a mutex */
 
 bool mtx_owned(mtx_t *m) {
   return (mtx_owner(m) == thread_self());
@@ -16,12 +27,48 @@ void _mtx_init(mtx_t *m, lk_attr_t attr, const char *name,
   m->m_count = 0;
   m->m_attr = attr | LK_TYPE_BLOCK;
 
-#if LOCKDEP
+#if LOCKDEP || LOCKPROF
   m->m_lockmap =
     (lock_class_mapping_t){.key = key, .name = name, .lock_class = NULL};
 #endif
 }
 
+#if SMP
+#define MTX_SPIN_MAX 1024  /* polls of mutex owner before giving up */
+#define MTX_BACKOFF_MAX 64 /* maximum delay between polls */
+
+/* Checks if `td` is running on some processor. The thread is not dereferenced,
+ * since mutex owner may exit as soon as it releases the mutex. */
+static bool mtx_owner_running(thread_t *td) {
+  for (unsigned i = 0; i < ncpus; i++)
+    if (_pcpu_data[i].curthread == td)
+      return true;
+  return false;
+}
+
+/* Owner running on another processor is likely to release the mutex soon, so
+ * it is cheaper to wait for it to happen than to block, which costs two
+ * context switches. Returns true if the mutex got released. */
+static bool mtx_spin(mtx_t *m) {
+  unsigned backoff = 1;
+
+  atomic_fetch_add_explicit(&mtx_nspins, 1, memory_order_relaxed);
+
+  for (unsigned i = 0; i < MTX_SPIN_MAX; i++) {
+    thread_t *owner = mtx_owner(m);
+    if (owner == NULL)
+      return true;
+    if (!mtx_owner_running(owner))
+      return false;
+    for (unsigned j = 0; j < backoff; j++)
+      cpu_spinwait();
+    backoff = min(backoff * 2, MTX_BACKOFF_MAX);
+  }
+
+  return false;
+}
+#endif
+
 void _mtx_lock(mtx_t *m, const void *waitpt) {
   if (mtx_owned(m)) {
     if (!lk_recursive_p(m))
@@ -35,32 +82,57 @@ void _mtx_lock(mtx_t *m, const void *waitpt) {
 #endif
 
   thread_t *td = thread_self();
+  bool spun = false;
+#if LOCKPROF
+  uint64_t waitstart = 0;
+#endif
 
   for (;;) {
     intptr_t expected = 0;
 
     /* Fast path: if lock has no owner then take ownership. */
-    if (atomic_compare_exchange_strong(&m->m_owner, &expected, (intptr_t)td))
+    if (atomic_compare_exchange_strong(&m->m_owner, &expected, (intptr_t)td)) {
+      if (spun)
+        atomic_fetch_add_explicit(&mtx_nacquired, 1, memory_order_relaxed);
       break;
+    }
+
+#if LOCKPROF
+    if (waitstart == 0)
+      waitstart = lockprof_now();
+#endif
+
+#if SMP
+    if ((spun = mtx_spin(m)))
+      continue;
+#endif
 
-    WITH_NO_PREEMPTION {
-      /* TODO(cahir) turnstile_take / turnstile_give doesn't make much sense
-       * until tc_lock is thrown into the equation. */
-      turnstile_t *ts = turnstile_take(m);
-
-      /* Between atomic cas and turnstile_take there's a small window when
-       * preemption can take place. This can result in mutex being released. */
-      if (m->m_owner) {
-        /* we're the first thread to block, so lock is now being contested */
-        if (ts == td->td_turnstile)
-          m->m_owner |= MTX_CONTESTED;
-
-        turnstile_wait(ts, mtx_owner(m), waitpt);
-      } else {
-        turnstile_give(ts);
-      }
+    turnstile_t *ts = turnstile_take(m);
+    intptr_t owner = m->m_owner;
+
+    /* The mutex could have been released before turnstile chain got locked.
+     * Otherwise mark it contested, so that its owner cannot release it without
+     * locking turnstile chain. The owner may still release the mutex until the
+     * bit is set, so set it only if the owner did not change meanwhile. */
+    while (owner && !(owner & MTX_CONTESTED) &&
+           !atomic_compare_exchange_weak(&m->m_owner, &owner,
+                                         owner | MTX_CONTESTED))
+      continue;
+
+    if (owner) {
+      KTRACE(KTR_LOCK, m, waitpt);
+      atomic_fetch_add_explicit(&mtx_nblocks, 1, memory_order_relaxed);
+      turnstile_wait(ts, (thread_t *)(owner & ~MTX_FLAGMASK), waitpt);
+    } else {
+      turnstile_give(ts);
     }
   }
+
+#if LOCKPROF
+  m->m_locktime = lockprof_now();
+  m->m_lockprof = lockprof_acquire(m, &m->m_lockmap, __caller(0), waitstart,
+                                   m->m_locktime);
+#endif
 }
 
 void mtx_unlock(mtx_t *m) {
@@ -76,6 +148,10 @@ void mtx_unlock(mtx_t *m) {
   lockdep_release(&m->m_lockmap);
 #endif
 
+#if LOCKPROF
+  lockprof_release(m->m_lockprof, m->m_locktime);
+#endif
+
   /* Fast path: if lock is not contested then drop ownership. */
   intptr_t expected = (intptr_t)thread_self();
   if (atomic_compare_exchange_strong(&m->m_owner, &expected, 0))
@@ -88,9 +164,39 @@ void mtx_unlock(mtx_t *m) {
    * The reasoning is that the awakened threads will often be scheduled
    * sequentially and only act on empty mutex on which operations are
    * cheaper. */
-  WITH_NO_PREEMPTION {
-    uintptr_t owner = atomic_exchange(&m->m_owner, 0);
-    if (owner & MTX_CONTESTED)
-      turnstile_broadcast(m);
-  }
+  turnstile_chain_lock(m);
+  uintptr_t owner = atomic_exchange(&m->m_owner, 0);
+  if (owner & MTX_CONTESTED)
+    turnstile_broadcast(m);
+  turnstile_chain_unlock(m);
+}
+
+void mtx_stats(mtx_stats_t *ms) {
+  /* Read in this order so that acquired is never greater than spins. */
+  ms->ms_acquired = atomic_load(&mtx_nacquired);
+  ms->ms_spins = atomic_load(&mtx_nspins);
+  ms->ms_blocks = atomic_load(&mtx_nblocks);
 }
+
+/*
+ * /dev/mtxstat reports statistics of contested mutexes as text, e.g.:
+ * spins 120 acquired 113 blocks 35
+ */
+
+static int dev_mtxstat_read(vnode_t *v, uio_t *uio) {
+  mtx_stats_t ms;
+  char buf[64];
+
+  mtx_stats(&ms);
+  int len = snprintf(buf, sizeof(buf), "spins %u acquired %u blocks %u\n",
+                     ms.ms_spins, ms.ms_acquired, ms.ms_blocks);
+  return uiomove_frombuf(buf, min((size_t)len, sizeof(buf) - 1), uio);
+}
+
+static vnodeops_t dev_mtxstat_vnodeops = {.v_read = dev_mtxstat_read};
+
+static void init_dev_mtxstat(void) {
+  devfs_makedev(NULL, "mtxstat", &dev_mtxstat_vnodeops, NULL, NULL);
+}
+
+SET_ENTRY(devfs_init, init_dev_mtxstat);
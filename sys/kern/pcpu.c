@@ -1,6 +1,6 @@
 #include <sys/pcpu.h>
 #include <sys/thread.h>
 
-pcpu_t _pcpu_data[1] = {{
+pcpu_t _pcpu_data[MAXCPU] = {{
   .curthread = &thread0,
 }};
@@ -13,6 +13,28 @@
 #include <sys/proc.h>
 #include <sys/ringbuf.h>
 #include <sys/uio.h>
+#include <sys/event.h>
+#include <sys/pmap.h>
+#include <sys/vm_map.h>
+#include <sys/devfs.h>
+#include <sys/linker_set.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/*
+ * Data written to a pipe normally goes through a ring buffer owned by the
+ * writing end. The buffer starts at PIPE_SIZE bytes and is doubled (up to
+ * PIPE_MAX_SIZE) whenever a writer fills it up, so sustained streams need
+ * fewer context switches.
+ *
+ * Writes of at least PIPE_DIRECT_MIN bytes from user space skip the buffer.
+ * The writer maps pages of its user buffer into a kernel window of the pipe
+ * end (a loan) and sleeps until the reader copies the data out directly.
+ * Lent pages are not pinned, so loans are made only by single-threaded
+ * processes out of anonymous memory. Then nobody can unmap the pages while the
+ * writer is asleep, and other processes cannot free them either, as pages of
+ * anonymous objects stay around as long as our mapping refers to them.
+ */
 
 typedef struct pipe_end pipe_end_t;
 typedef struct pipe pipe_t;
@@ -25,6 +47,10 @@ struct pipe_end {
   condvar_t nonfull;  /*!< used to wait for free space in the buffer */
   ringbuf_t buf;      /*!< buffer belongs to writer end */
   pipe_end_t *other;  /*!< the other end of the pipe */
+  knlist_t knotes;    /*!< knotes interested in the buffer */
+  vaddr_t loan_kva;   /*!< kernel window for lent pages (0 if not allocated) */
+  uint8_t *loan_data; /*!< lent data not yet read or NULL if no loan */
+  size_t loan_resid;  /*!< number of lent bytes not yet read */
 };
 
 struct pipe {
@@ -35,6 +61,9 @@ struct pipe {
 
 static POOL_DEFINE(P_PIPE, "pipe", sizeof(pipe_t));
 
+static atomic_uint pipe_nlent;   /* bytes read out of lent pages */
+static atomic_uint pipe_ncopied; /* bytes written into pipe buffers */
+
 static void pipe_end_setup(pipe_end_t *end, pipe_end_t *other) {
   mtx_init(&end->mtx, 0);
   cv_init(&end->nonempty, "pipe_end_empty");
@@ -42,6 +71,7 @@ static void pipe_end_setup(pipe_end_t *end, pipe_end_t *other) {
   end->buf.data = kmem_alloc(PIPE_SIZE, M_ZERO);
   end->buf.size = PIPE_SIZE;
   end->other = other;
+  SLIST_INIT(&end->knotes);
 }
 
 static pipe_t *pipe_alloc(void) {
@@ -64,12 +94,111 @@ static void pipe_free(pipe_t *pipe) {
     refcnt = --pipe->refcnt;
 
   if (refcnt == 0) {
-    kmem_free(pipe->end[0].buf.data, PIPE_SIZE);
-    kmem_free(pipe->end[1].buf.data, PIPE_SIZE);
+    for (int i = 0; i < 2; i++) {
+      pipe_end_t *end = &pipe->end[i];
+      kmem_free(end->buf.data, end->buf.size);
+      if (end->loan_kva)
+        kva_free(end->loan_kva, PIPE_DIRECT_MAXPAGES * PAGESIZE);
+    }
     pool_free(P_PIPE, pipe);
   }
 }
 
+/* Doubles the size of producer's buffer unless it reached its maximum. */
+static bool pipe_grow(pipe_end_t *producer) {
+  ringbuf_t *old = &producer->buf;
+  if (old->size >= PIPE_MAX_SIZE)
+    return false;
+
+  size_t size = old->size * 2;
+  ringbuf_t new;
+  ringbuf_init(&new, kmem_alloc(size, 0), size);
+  ringbuf_movenb(old, &new, old->count);
+  kmem_free(old->data, old->size);
+  *old = new;
+  return true;
+}
+
+/* Checks whether the next part of `uio` should be lent to the reader. */
+static bool pipe_direct_p(uio_t *uio) {
+  if (uio->uio_vmspace != vm_map_user())
+    return false;
+  /* Other threads could unmap the pages while they're lent. */
+  if (proc_self()->p_nthreads > 1)
+    return false;
+  iovec_t *iov = uio->uio_iov;
+  size_t len = iov->iov_len - uio->uio_iovoff;
+  if (len < PIPE_DIRECT_MIN)
+    return false;
+  /* File pages can be freed at any time by truncating the file. */
+  vaddr_t va = (vaddr_t)iov->iov_base + uio->uio_iovoff;
+  len = min(len, (size_t)PIPE_DIRECT_MAXPAGES * PAGESIZE);
+  return vm_map_anonymous_p(uio->uio_vmspace, rounddown(va, PAGESIZE),
+                            roundup(va + len, PAGESIZE));
+}
+
+/* Lends pages backing the current io vector of `uio` to the reader and waits
+ * until it copies out the data. Returns with producer's mutex held. */
+static int pipe_write_direct(pipe_end_t *producer, uio_t *uio) {
+  pipe_end_t *consumer = producer->other;
+  assert(mtx_owned(&producer->mtx));
+
+  /* Let previous data and loans drain to keep them in order. */
+  while ((producer->loan_data || !ringbuf_empty(&producer->buf)) &&
+         !consumer->closed)
+    cv_wait(&producer->nonfull, &producer->mtx);
+  if (consumer->closed)
+    return EPIPE;
+
+  iovec_t *iov = uio->uio_iov;
+  vaddr_t va = (vaddr_t)iov->iov_base + uio->uio_iovoff;
+  vaddr_t start = rounddown(va, PAGESIZE);
+  size_t len = min(iov->iov_len - uio->uio_iovoff,
+                   PIPE_DIRECT_MAXPAGES * PAGESIZE - (va - start));
+  size_t npages = roundup(va + len, PAGESIZE) / PAGESIZE - start / PAGESIZE;
+
+  if (!producer->loan_kva)
+    producer->loan_kva = kva_alloc(PIPE_DIRECT_MAXPAGES * PAGESIZE);
+
+  /* Fault in the pages and map them into the kernel window. */
+  for (size_t i = 0; i < npages; i++) {
+    vaddr_t pva = start + i * PAGESIZE;
+    paddr_t pa;
+    char c;
+    int error;
+    if ((error = copyin((void *)max(pva, va), &c, 1)) ||
+        !pmap_extract(pmap_user(), pva, &pa)) {
+      if (i > 0)
+        pmap_kremove(producer->loan_kva, i * PAGESIZE);
+      return error ? error : EFAULT;
+    }
+    pmap_kenter(producer->loan_kva + i * PAGESIZE, pa, VM_PROT_READ, 0);
+  }
+
+  producer->loan_data = (uint8_t *)producer->loan_kva + (va - start);
+  producer->loan_resid = len;
+  cv_broadcast(&producer->nonempty);
+  knote(&producer->knotes, 0);
+
+  while (producer->loan_resid > 0 && !consumer->closed)
+    cv_wait(&producer->nonfull, &producer->mtx);
+
+  size_t done = len - producer->loan_resid;
+  producer->loan_data = NULL;
+  producer->loan_resid = 0;
+  pmap_kremove(producer->loan_kva, npages * PAGESIZE);
+
+  /* Account for data that was read out of the loan. */
+  atomic_fetch_add_explicit(&pipe_nlent, done, memory_order_relaxed);
+  uio->uio_iovoff += done;
+  uio->uio_resid -= done;
+  uio->uio_offset += done;
+
+  /* Let other writers waiting for the loan to be returned proceed. */
+  cv_broadcast(&producer->nonfull);
+  return 0;
+}
+
 static int pipe_read(file_t *f, uio_t *uio) {
   pipe_end_t *consumer = f->f_data;
   pipe_end_t *producer = consumer->other;
@@ -83,18 +212,34 @@ static int pipe_read(file_t *f, uio_t *uio) {
   /* no read atomicity for now! */
   WITH_MTX_LOCK (&producer->mtx) {
     /* pipe empty, no producers, return end-of-file */
-    if (ringbuf_empty(&producer->buf) && producer->closed)
+    if (ringbuf_empty(&producer->buf) && !producer->loan_data &&
+        producer->closed)
       return 0;
 
     /* pipe empty, producer exists, wait for data */
-    while (ringbuf_empty(&producer->buf) && !producer->closed)
+    while (ringbuf_empty(&producer->buf) && !producer->loan_data &&
+           !producer->closed)
       cv_wait(&producer->nonempty, &producer->mtx);
 
-    int res = ringbuf_read(&producer->buf, uio);
+    int res;
+    if (!ringbuf_empty(&producer->buf)) {
+      res = ringbuf_read(&producer->buf, uio);
+    } else if (producer->loan_data) {
+      /* copy straight out of pages lent by the writer */
+      size_t len = min(uio->uio_resid, producer->loan_resid);
+      size_t resid = uio->uio_resid;
+      res = uiomove(producer->loan_data, len, uio);
+      len = resid - uio->uio_resid;
+      producer->loan_data += len;
+      producer->loan_resid -= len;
+    } else {
+      res = 0;
+    }
     if (res)
       return res;
     /* notify producer that free space is available */
     cv_broadcast(&producer->nonfull);
+    knote(&producer->knotes, 0);
   }
 
   return 0;
@@ -113,14 +258,33 @@ static int pipe_write(file_t *f, uio_t *uio) {
   /* no write atomicity for now! */
   WITH_MTX_LOCK (&producer->mtx) {
     do {
-      int res = ringbuf_write(&producer->buf, uio);
-      if (res)
+      int res;
+      if (pipe_direct_p(uio)) {
+        if ((res = pipe_write_direct(producer, uio)))
+          return res;
+        if (uio->uio_resid == 0)
+          break;
+        continue;
+      }
+      /* wait for pending loan to be returned to keep data in order */
+      if (producer->loan_data) {
+        cv_wait(&producer->nonfull, &producer->mtx);
+        continue;
+      }
+      size_t resid = uio->uio_resid;
+      if ((res = ringbuf_write(&producer->buf, uio)))
         return res;
+      atomic_fetch_add_explicit(&pipe_ncopied, resid - uio->uio_resid,
+                                memory_order_relaxed);
       /* notify consumer that new data is available */
       cv_broadcast(&producer->nonempty);
+      knote(&producer->knotes, 0);
       /* nothing left to write? */
       if (uio->uio_resid == 0)
         break;
+      /* writer keeps filling the buffer, so try to make it bigger */
+      if (pipe_grow(producer))
+        continue;
       /* buffer is full so wait for some data to be consumed */
       cv_wait(&producer->nonfull, &producer->mtx);
     } while (!consumer->closed);
@@ -136,6 +300,13 @@ static int pipe_close(file_t *f) {
     end->closed = true;
     /* Wake up consumers to let them finish their work! */
     cv_broadcast(&end->nonempty);
+    knote(&end->knotes, 0);
+  }
+
+  /* Let writers on the other end know that no one will read data. */
+  WITH_MTX_LOCK (&end->other->mtx) {
+    cv_broadcast(&end->other->nonfull);
+    knote(&end->other->knotes, 0);
   }
 
   pipe_free(end->pipe);
@@ -150,6 +321,69 @@ static int pipe_ioctl(file_t *f, u_long cmd, void *data) {
   return EOPNOTSUPP;
 }
 
+/* Knotes of both ends are attached to the producer, as they are interested in
+ * the state of its buffer. */
+static void filt_pipedetach(knote_t *kn) {
+  pipe_end_t *producer = kn->kn_hook;
+
+  WITH_MTX_LOCK (&producer->mtx)
+    SLIST_REMOVE(&producer->knotes, kn, knote, kn_objlink);
+}
+
+static int filt_piperead(knote_t *kn, long hint) {
+  pipe_end_t *producer = kn->kn_hook;
+
+  kn->kn_data = producer->buf.count + producer->loan_resid;
+  if (producer->closed) {
+    kn->kn_flags |= EV_EOF;
+    return 1;
+  }
+  return kn->kn_data > 0;
+}
+
+static int filt_pipewrite(knote_t *kn, long hint) {
+  pipe_end_t *producer = kn->kn_hook;
+
+  kn->kn_data = producer->buf.size - producer->buf.count;
+  if (producer->other->closed) {
+    kn->kn_flags |= EV_EOF;
+    return 1;
+  }
+  return kn->kn_data > 0;
+}
+
+static filterops_t pipe_read_filtops = {
+  .filt_detach = filt_pipedetach,
+  .filt_event = filt_piperead,
+};
+
+static filterops_t pipe_write_filtops = {
+  .filt_detach = filt_pipedetach,
+  .filt_event = filt_pipewrite,
+};
+
+static int pipe_kqfilter(file_t *f, knote_t *kn) {
+  pipe_end_t *end = f->f_data;
+  pipe_end_t *producer;
+
+  if (kn->kn_filter == EVFILT_READ) {
+    producer = end->other;
+    kn->kn_filtops = &pipe_read_filtops;
+  } else if (kn->kn_filter == EVFILT_WRITE) {
+    producer = end;
+    kn->kn_filtops = &pipe_write_filtops;
+  } else {
+    return EINVAL;
+  }
+
+  kn->kn_hook = producer;
+  kn->kn_objlock = &producer->mtx;
+
+  WITH_MTX_LOCK (&producer->mtx)
+    SLIST_INSERT_HEAD(&producer->knotes, kn, kn_objlink);
+  return 0;
+}
+
 static fileops_t pipeops = {
   .fo_read = pipe_read,
   .fo_write = pipe_write,
@@ -157,6 +391,7 @@ static fileops_t pipeops = {
   .fo_seek = noseek,
   .fo_stat = pipe_stat,
   .fo_ioctl = pipe_ioctl,
+  .fo_kqfilter = pipe_kqfilter,
 };
 
 static file_t *make_pipe_file(pipe_end_t *end) {
@@ -190,3 +425,24 @@ int do_pipe(proc_t *p, int fds[2]) {
   pipe_close(file1);
   return error;
 }
+
+/*
+ * /dev/pipestat reports how many bytes went through pipes as text, e.g.:
+ * lent 4194304 copied 4194304
+ */
+
+static int dev_pipestat_read(vnode_t *v, uio_t *uio) {
+  char buf[64];
+
+  int len = snprintf(buf, sizeof(buf), "lent %u copied %u\n",
+                     atomic_load(&pipe_nlent), atomic_load(&pipe_ncopied));
+  return uiomove_frombuf(buf, min((size_t)len, sizeof(buf) - 1), uio);
+}
+
+static vnodeops_t dev_pipestat_vnodeops = {.v_read = dev_pipestat_read};
+
+static void init_dev_pipestat(void) {
+  devfs_makedev(NULL, "pipestat", &dev_pipestat_vnodeops, NULL, NULL);
+}
+
+SET_ENTRY(devfs_init, init_dev_pipestat);
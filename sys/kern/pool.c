@@ -8,6 +8,8 @@
 #include <sys/sched.h>
 #include <sys/malloc.h>
 #include <sys/pool.h>
+#include <sys/pcpu.h>
+#include <sys/smp.h>
 #include <sys/kmem.h>
 #include <sys/vm.h>
 #include <machine/vm_param.h>
@@ -24,31 +26,57 @@
 #define debug(...)
 #endif
 
+/* Number of objects that fit into a magazine. Chosen so that the magazine
+ * occupies 16 machine words. */
+#define MAGAZINE_SIZE 14
+
+typedef struct magazine {
+  SLIST_ENTRY(magazine) mag_link; /* depot list of full or empty magazines */
+  unsigned mag_nrounds;           /* number of objects in the magazine */
+  void *mag_rounds[MAGAZINE_SIZE];
+} magazine_t;
+
+typedef SLIST_HEAD(, magazine) magazine_list_t;
+
+/* Per-CPU magazine cache. Accessed only by owning processor with preemption
+ * disabled. The previous magazine is always either full or empty. */
+typedef struct pool_cache {
+  magazine_t *pc_loaded;   /* magazine to allocate from and free to */
+  magazine_t *pc_previous; /* magazine to swap with when loaded one runs out */
+  size_t pc_nhits;         /* allocations served from magazines */
+} pool_cache_t;
+
 typedef LIST_HEAD(, slab) slab_list_t;
 
 typedef struct pool {
   TAILQ_ENTRY(pool) pp_link;
   mtx_t pp_mtx;
   const char *pp_desc;
+  unsigned pp_flags;
   slab_list_t pp_empty_slabs;
   slab_list_t pp_full_slabs;
-  slab_list_t pp_part_slabs; /* partially allocated slabs */
-  size_t pp_itemsize;        /* size of item */
-  size_t pp_alignment;       /* alignment of allocated items */
+  slab_list_t pp_part_slabs;     /* partially allocated slabs */
+  magazine_list_t pp_full_mags;  /* depot of full magazines */
+  magazine_list_t pp_empty_mags; /* depot of empty magazines */
+  size_t pp_itemsize;            /* size of item */
+  size_t pp_alignment;           /* alignment of allocated items */
 #if KASAN
   size_t pp_redzone; /* size of redzone after each item */
   quar_t pp_quarantine;
 #endif
+  pool_cache_t pp_cache[MAXCPU];
   /* statistics */
   size_t pp_npages;   /* number of allocated pages (in bytes) */
-  size_t pp_nused;    /* number of used items in all slabs */
+  size_t pp_nused;    /* number of used items in all slabs (incl. magazines) */
   size_t pp_nmaxused; /* peak number of used items in all slabs */
   size_t pp_ntotal;   /* total number of items in all slabs */
+  size_t pp_nmisses;  /* allocations that could not be served from magazines */
 } pool_t;
 
 static TAILQ_HEAD(, pool) pool_list = TAILQ_HEAD_INITIALIZER(pool_list);
 static MTX_DEFINE(pool_list_lock, 0);
 static KMALLOC_DEFINE(M_POOL, "pool allocators");
+static pool_t *P_MAGAZINE;
 
 typedef struct slab {
   LIST_ENTRY(slab) ph_link; /* pool slab list */
@@ -113,45 +141,208 @@ static void add_slab(pool_t *pool, slab_t *slab, size_t slabsize) {
   }
 }
 
-void *pool_alloc(pool_t *pool, kmem_flags_t flags) {
-  void *ptr;
+static void destroy_slab(pool_t *pool, slab_t *slab) {
+  klog("destroy_slab: pool = %p, slab = %p", pool, slab);
 
-  debug("pool_alloc: pool=%p", pool);
+  pool->pp_ntotal -= slab->ph_ntotal;
+  pool->pp_npages -= slab->ph_size;
 
-  WITH_MTX_LOCK (&pool->pp_mtx) {
-    slab_t *slab;
-
-    if (!(slab = LIST_FIRST(&pool->pp_part_slabs))) {
-      if (!(slab = LIST_FIRST(&pool->pp_empty_slabs))) {
-        slab = kmem_alloc(PAGESIZE, flags);
-        assert(slab != NULL);
-        add_slab(pool, slab, PAGESIZE);
-      }
-      /* We're going to allocate from empty slab
-       * -> move it to the list of non-empty slabs. */
-      assert(slab->ph_nused == 0);
-      LIST_REMOVE(slab, ph_link);
-      LIST_INSERT_HEAD(&pool->pp_part_slabs, slab, ph_link);
-    }
+  LIST_REMOVE(slab, ph_link);
 
-    assert(slab->ph_nused < slab->ph_ntotal);
-    int i = 0;
-    bit_ffc(slab->ph_bitmap, slab->ph_ntotal, &i);
-    bit_set(slab->ph_bitmap, i);
-    ptr = slab_item_at(slab, i);
-    debug("slab_alloc: allocated item %p at slab %p, index %d", ptr, slab, i);
+  for (size_t i = 0; i < slab->ph_size; i += PAGESIZE) {
+    vm_page_t *pg = kva_find_page((vaddr_t)slab + i);
+    assert(pg != NULL);
+    assert(pg->slab == slab);
+    pg->slab = NULL;
+  }
 
-    if (++slab->ph_nused == slab->ph_ntotal) {
-      /* We've allocated last item from non-empty slab
-       * -> move it to the list of full slabs. */
-      LIST_REMOVE(slab, ph_link);
-      LIST_INSERT_HEAD(&pool->pp_full_slabs, slab, ph_link);
+  kmem_free(slab, slab->ph_size);
+}
+
+/* Take an object from the loaded magazine. If it's empty, but the previous one
+ * is full, exchange them. */
+static void *cache_pop(pool_cache_t *pc) {
+  magazine_t *mag = pc->pc_loaded;
+
+  if (mag == NULL)
+    return NULL;
+
+  if (mag->mag_nrounds == 0) {
+    magazine_t *prev = pc->pc_previous;
+    if (prev == NULL || prev->mag_nrounds == 0)
+      return NULL;
+    pc->pc_loaded = prev;
+    pc->pc_previous = mag;
+    mag = prev;
+  }
+
+  pc->pc_nhits++;
+  return mag->mag_rounds[--mag->mag_nrounds];
+}
+
+/* Put an object into the loaded magazine. If it's full, but the previous one
+ * is empty, exchange them. */
+static bool cache_push(pool_cache_t *pc, void *ptr) {
+  magazine_t *mag = pc->pc_loaded;
+
+  if (mag == NULL)
+    return false;
+
+  if (mag->mag_nrounds == MAGAZINE_SIZE) {
+    magazine_t *prev = pc->pc_previous;
+    if (prev == NULL || prev->mag_nrounds > 0)
+      return false;
+    pc->pc_loaded = prev;
+    pc->pc_previous = mag;
+    mag = prev;
+  }
+
+  mag->mag_rounds[mag->mag_nrounds++] = ptr;
+  return true;
+}
+
+/* Reload per-CPU cache with a full magazine from the depot and take an object
+ * from it. */
+static void *depot_pop(pool_t *pool, pool_cache_t *pc) {
+  assert(mtx_owned(&pool->pp_mtx));
+
+  void *ptr = cache_pop(pc);
+  if (ptr)
+    return ptr;
+
+  magazine_t *mag = SLIST_FIRST(&pool->pp_full_mags);
+  if (mag == NULL)
+    return NULL;
+  SLIST_REMOVE_HEAD(&pool->pp_full_mags, mag_link);
+
+  /* Both magazines in the cache are empty (or missing). */
+  if (pc->pc_previous)
+    SLIST_INSERT_HEAD(&pool->pp_empty_mags, pc->pc_previous, mag_link);
+  pc->pc_previous = pc->pc_loaded;
+  pc->pc_loaded = mag;
+
+  return cache_pop(pc);
+}
+
+/* Reload per-CPU cache with an empty magazine from the depot and put an object
+ * into it. */
+static bool depot_push(pool_t *pool, pool_cache_t *pc, void *ptr) {
+  assert(mtx_owned(&pool->pp_mtx));
+
+  if (cache_push(pc, ptr))
+    return true;
+
+  magazine_t *mag = SLIST_FIRST(&pool->pp_empty_mags);
+  if (mag == NULL)
+    return false;
+  SLIST_REMOVE_HEAD(&pool->pp_empty_mags, mag_link);
+
+  /* Both magazines in the cache are full (or missing). */
+  if (pc->pc_previous)
+    SLIST_INSERT_HEAD(&pool->pp_full_mags, pc->pc_previous, mag_link);
+  pc->pc_previous = pc->pc_loaded;
+  pc->pc_loaded = mag;
+
+  return cache_push(pc, ptr);
+}
+
+static void *pool_cache_alloc(pool_t *pool) {
+  void *ptr = NULL;
+
+  if (pool->pp_flags & PF_NOCACHE)
+    return NULL;
+
+  WITH_NO_PREEMPTION
+    ptr = cache_pop(&pool->pp_cache[PCPU_GET(cpuid)]);
+
+  return ptr;
+}
+
+static bool pool_cache_free(pool_t *pool, void *ptr) {
+  bool cached = false;
+
+  if (pool->pp_flags & PF_NOCACHE)
+    return false;
+
+  WITH_NO_PREEMPTION
+    cached = cache_push(&pool->pp_cache[PCPU_GET(cpuid)], ptr);
+
+  return cached;
+}
+
+static void *slab_alloc(pool_t *pool, kmem_flags_t flags) {
+  assert(mtx_owned(&pool->pp_mtx));
+
+  slab_t *slab;
+
+  if (!(slab = LIST_FIRST(&pool->pp_part_slabs))) {
+    if (!(slab = LIST_FIRST(&pool->pp_empty_slabs))) {
+      slab = kmem_alloc(PAGESIZE, flags);
+      assert(slab != NULL);
+      add_slab(pool, slab, PAGESIZE);
     }
+    /* We're going to allocate from empty slab
+     * -> move it to the list of non-empty slabs. */
+    assert(slab->ph_nused == 0);
+    LIST_REMOVE(slab, ph_link);
+    LIST_INSERT_HEAD(&pool->pp_part_slabs, slab, ph_link);
+  }
+
+  assert(slab->ph_nused < slab->ph_ntotal);
+  int i = 0;
+  bit_ffc(slab->ph_bitmap, slab->ph_ntotal, &i);
+  bit_set(slab->ph_bitmap, i);
+  void *ptr = slab_item_at(slab, i);
+  debug("slab_alloc: allocated item %p at slab %p, index %d", ptr, slab, i);
+
+  if (++slab->ph_nused == slab->ph_ntotal) {
+    /* We've allocated last item from non-empty slab
+     * -> move it to the list of full slabs. */
+    LIST_REMOVE(slab, ph_link);
+    LIST_INSERT_HEAD(&pool->pp_full_slabs, slab, ph_link);
+  }
+
+  pool->pp_nused++;
+  pool->pp_nmaxused = max(pool->pp_nmaxused, pool->pp_nused);
+
+  return ptr;
+}
+
+static void *pool_alloc_slow(pool_t *pool, kmem_flags_t flags) {
+  magazine_t *mag = NULL;
+  void *ptr = NULL;
+
+  /* Make sure there's an empty magazine in the depot, so that objects freed
+   * later on can be cached. It's never done in pool_free, as its callers do
+   * not expect it to allocate memory. */
+  if (!(pool->pp_flags & PF_NOCACHE) && SLIST_EMPTY(&pool->pp_empty_mags)) {
+    mag = pool_alloc(P_MAGAZINE, flags & ~M_ZERO);
+    mag->mag_nrounds = 0;
+  }
+
+  SCOPED_MTX_LOCK(&pool->pp_mtx);
+
+  if (mag)
+    SLIST_INSERT_HEAD(&pool->pp_empty_mags, mag, mag_link);
 
-    pool->pp_nused++;
-    pool->pp_nmaxused = max(pool->pp_nmaxused, pool->pp_nused);
+  if (!(pool->pp_flags & PF_NOCACHE)) {
+    WITH_NO_PREEMPTION
+      ptr = depot_pop(pool, &pool->pp_cache[PCPU_GET(cpuid)]);
+    if (ptr)
+      return ptr;
   }
 
+  pool->pp_nmisses++;
+  return slab_alloc(pool, flags);
+}
+
+void *pool_alloc(pool_t *pool, kmem_flags_t flags) {
+  debug("pool_alloc: pool=%p", pool);
+
+  void *ptr = pool_cache_alloc(pool);
+  if (ptr == NULL)
+    ptr = pool_alloc_slow(pool, flags);
+
   /* Create redzone after the item. */
   kasan_mark(ptr, pool->pp_itemsize, pool->pp_itemsize + pool->pp_redzone,
              KASAN_CODE_POOL_OVERFLOW);
@@ -161,8 +352,6 @@ void *pool_alloc(pool_t *pool, kmem_flags_t flags) {
   return ptr;
 }
 
-/* TODO: destroy empty slabs when their number reaches a certain threshold
- * (maybe leave one). */
 static void _pool_free(pool_t *pool, void *ptr) {
   assert(mtx_owned(&pool->pp_mtx));
 
@@ -185,19 +374,36 @@ static void _pool_free(pool_t *pool, void *ptr) {
     LIST_INSERT_HEAD(&pool->pp_part_slabs, slab, ph_link);
   }
 
-  if (--slab->ph_nused == 0) {
-    LIST_REMOVE(slab, ph_link);
-    LIST_INSERT_HEAD(&pool->pp_empty_slabs, slab, ph_link);
-  }
-
   pool->pp_nused--;
 
   debug("pool_free: freed item %p at slab %p, index %d", ptr, slab, index);
+
+  if (--slab->ph_nused == 0) {
+    /* Keep one empty slab around to avoid thrashing, release the others. */
+    if (!(pool->pp_flags & PF_NORECLAIM) &&
+        !LIST_EMPTY(&pool->pp_empty_slabs)) {
+      destroy_slab(pool, slab);
+    } else {
+      LIST_REMOVE(slab, ph_link);
+      LIST_INSERT_HEAD(&pool->pp_empty_slabs, slab, ph_link);
+    }
+  }
 }
 
 void pool_free(pool_t *pool, void *ptr) {
+  if (pool_cache_free(pool, ptr))
+    return;
+
   SCOPED_MTX_LOCK(&pool->pp_mtx);
 
+  if (!(pool->pp_flags & PF_NOCACHE)) {
+    bool cached;
+    WITH_NO_PREEMPTION
+      cached = depot_push(pool, &pool->pp_cache[PCPU_GET(cpuid)], ptr);
+    if (cached)
+      return;
+  }
+
   kasan_mark_invalid(ptr, pool->pp_itemsize + pool->pp_redzone,
                      KASAN_CODE_POOL_FREED);
   kasan_quar_additem(&pool->pp_quarantine, pool, ptr);
@@ -211,28 +417,46 @@ static void pool_ctor(pool_t *pool) {
   LIST_INIT(&pool->pp_empty_slabs);
   LIST_INIT(&pool->pp_full_slabs);
   LIST_INIT(&pool->pp_part_slabs);
+  SLIST_INIT(&pool->pp_full_mags);
+  SLIST_INIT(&pool->pp_empty_mags);
   mtx_init(&pool->pp_mtx, 0);
 }
 
 static void destroy_slabs(pool_t *pool, slab_list_t *slabs) {
   slab_t *slab, *next;
 
-  LIST_FOREACH_SAFE (slab, slabs, ph_link, next) {
-    klog("destroy_slab: pool = %p, slab = %p", pool, slab);
+  LIST_FOREACH_SAFE (slab, slabs, ph_link, next)
+    destroy_slab(pool, slab);
+}
 
-    pool->pp_ntotal -= slab->ph_ntotal;
-    pool->pp_npages -= slab->ph_size;
+/* Return objects from the magazine back to slabs and release it. */
+static void destroy_magazine(pool_t *pool, magazine_t *mag) {
+  assert(mtx_owned(&pool->pp_mtx));
 
-    LIST_REMOVE(slab, ph_link);
+  for (unsigned i = 0; i < mag->mag_nrounds; i++)
+    _pool_free(pool, mag->mag_rounds[i]);
+  pool_free(P_MAGAZINE, mag);
+}
 
-    for (size_t i = 0; i < slab->ph_size; i += PAGESIZE) {
-      vm_page_t *pg = kva_find_page((vaddr_t)slab + i);
-      assert(pg != NULL);
-      assert(pg->slab == slab);
-      pg->slab = NULL;
-    }
+static void destroy_magazines(pool_t *pool) {
+  SCOPED_MTX_LOCK(&pool->pp_mtx);
 
-    kmem_free(slab, slab->ph_size);
+  for (unsigned i = 0; i < MAXCPU; i++) {
+    pool_cache_t *pc = &pool->pp_cache[i];
+    if (pc->pc_loaded)
+      destroy_magazine(pool, pc->pc_loaded);
+    if (pc->pc_previous)
+      destroy_magazine(pool, pc->pc_previous);
+    pc->pc_loaded = pc->pc_previous = NULL;
+  }
+
+  magazine_list_t *lists[] = {&pool->pp_full_mags, &pool->pp_empty_mags};
+  for (unsigned i = 0; i < 2; i++) {
+    magazine_t *mag;
+    while ((mag = SLIST_FIRST(lists[i]))) {
+      SLIST_REMOVE_HEAD(lists[i], mag_link);
+      destroy_magazine(pool, mag);
+    }
   }
 }
 
@@ -253,11 +477,14 @@ static void pool_init(pool_t *pool, pool_init_t *args) {
 
   pool_ctor(pool);
   pool->pp_desc = desc;
+  pool->pp_flags = args->flags;
   pool->pp_alignment = alignment;
 #if KASAN
   /* the alignment is within the redzone */
   pool->pp_itemsize = size;
   pool->pp_redzone = align(size + KASAN_POOL_REDZONE_SIZE, alignment) - size;
+  /* freed items must go through the quarantine */
+  pool->pp_flags |= PF_NOCACHE;
 #else /* !KASAN */
   /* no redzone, we have to align the size itself */
   pool->pp_itemsize = align(size, alignment);
@@ -270,6 +497,9 @@ static void pool_init(pool_t *pool, pool_init_t *args) {
 }
 
 void init_pool(void) {
+  /* Magazines can't be cached in magazines themselves. */
+  P_MAGAZINE =
+    pool_create("pool magazine", sizeof(magazine_t), .flags = PF_NOCACHE);
   INVOKE_CTORS(pool_ctor_table);
 }
 
@@ -287,6 +517,7 @@ pool_t *_pool_create(pool_init_t *args) {
 void pool_destroy(pool_t *pool) {
   WITH_MTX_LOCK (&pool_list_lock)
     TAILQ_REMOVE(&pool_list, pool, pp_link);
+  destroy_magazines(pool);
   WITH_MTX_LOCK (&pool->pp_mtx)
     /* Lock needed as the quarantine may call _pool_free! */
     kasan_quar_releaseall(&pool->pp_quarantine);
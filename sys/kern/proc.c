@@ -39,6 +39,14 @@ static POOL_DEFINE(P_PROC, "proc", sizeof(proc_t));
 static POOL_DEFINE(P_PGRP, "pgrp", sizeof(pgrp_t));
 static POOL_DEFINE(P_SESSION, "session", sizeof(session_t));
 
+/* Record of a thread that exited, kept until `do_lwp_wait` collects it. */
+typedef struct deadthread {
+  TAILQ_ENTRY(deadthread) dt_link; /* link on p_deadtds list */
+  tid_t dt_tid;                    /* identifier of exited thread */
+} deadthread_t;
+
+static POOL_DEFINE(P_DEADTHREAD, "deadthread", sizeof(deadthread_t));
+
 MTX_DEFINE(all_proc_mtx, 0);
 
 /* all_proc_mtx protects following data: */
@@ -78,7 +86,8 @@ static pgrp_t pgrp0 = {
 
 proc_t proc0 = {
   .p_lock = MTX_INITIALIZER(proc0.p_lock, 0),
-  .p_thread = &thread0,
+  .p_threads = TAILQ_HEAD_INITIALIZER(proc0.p_threads),
+  .p_deadtds = TAILQ_HEAD_INITIALIZER(proc0.p_deadtds),
   .p_pid = 0,
   .p_pgrp = &pgrp0,
   .p_state = PS_NORMAL,
@@ -100,6 +109,9 @@ void init_proc0(void) {
   p->p_cwd = vfs_root_vnode;
   p->p_cmask = CMASK;
 
+  TAILQ_INSERT_TAIL(&p->p_threads, &thread0, td_procq);
+  p->p_nthreads = 1;
+
   TAILQ_INSERT_TAIL(&proc_list, p, p_all);
   TAILQ_INSERT_TAIL(PROC_HASH_CHAIN(0), p, p_hash);
   TAILQ_INSERT_HEAD(PGRP_HASH_CHAIN(0), &pgrp0, pg_hash);
@@ -450,7 +462,6 @@ proc_t *proc_create(thread_t *td, proc_t *parent) {
 
   mtx_init(&p->p_lock, 0);
   p->p_state = PS_NORMAL;
-  p->p_thread = td;
   p->p_parent = parent;
 
   if (parent->p_elfpath)
@@ -459,6 +470,12 @@ proc_t *proc_create(thread_t *td, proc_t *parent) {
     p->p_args = kstrndup(M_STR, parent->p_args, PARGS_MAX);
 
   TAILQ_INIT(CHILDREN(p));
+  TAILQ_INIT(&p->p_threads);
+  TAILQ_INIT(&p->p_deadtds);
+  TAILQ_INSERT_TAIL(&p->p_threads, td, td_procq);
+  p->p_nthreads = 1;
+  cv_init(&p->p_lwpcv, "lwp");
+  SLIST_INIT(&p->p_klist);
   kitimer_init(p);
 
   WITH_SPIN_LOCK (td->td_lock)
@@ -564,15 +581,134 @@ void proc_wakeup_parent(proc_t *parent) {
   cv_broadcast(&parent->p_waitcv);
 }
 
+static void proc_free_deadtds(proc_t *p) {
+  deadthread_t *dt;
+  while ((dt = TAILQ_FIRST(&p->p_deadtds))) {
+    TAILQ_REMOVE(&p->p_deadtds, dt, dt_link);
+    pool_free(P_DEADTHREAD, dt);
+  }
+}
+
+int proc_single_thread(void) {
+  thread_t *td = thread_self();
+  proc_t *p = td->td_proc;
+
+  assert(mtx_owned(&p->p_lock));
+
+  /* Another thread is already getting rid of us. */
+  if (td->td_flags & TDF_EXITING)
+    return EINTR;
+
+  thread_t *otd;
+  TAILQ_FOREACH (otd, &p->p_threads, td_procq) {
+    if (otd == td)
+      continue;
+    WITH_SPIN_LOCK (otd->td_lock) {
+      otd->td_flags |= TDF_EXITING | TDF_NEEDSIGCHK;
+      /* Stopped threads have to run in order to exit, and sleeping ones are
+       * woken up in the same way as when a signal is sent to them. */
+      if (td_is_stopped(otd) || (otd->td_flags & TDF_STOPPING)) {
+        thread_continue(otd);
+      } else if (td_is_interruptible(otd)) {
+        spin_unlock(otd->td_lock);
+        sleepq_abort(otd); /* Locks & unlocks td_lock */
+        spin_lock(otd->td_lock);
+      }
+    }
+  }
+
+  while (p->p_nthreads > 1)
+    cv_wait(&p->p_lwpcv, &p->p_lock);
+
+  /* Nobody is going to wait for threads that used to be there. */
+  proc_free_deadtds(p);
+  return 0;
+}
+
+__noreturn void proc_thread_exit(void) {
+  thread_t *td = thread_self();
+  proc_t *p = td->td_proc;
+
+  assert(mtx_owned(&p->p_lock));
+
+  if (p->p_nthreads == 1)
+    proc_exit(MAKE_STATUS_EXIT(0));
+
+  klog("Thread %lu in process PID(%d) exits", td->td_tid, p->p_pid);
+
+  deadthread_t *dt = pool_alloc(P_DEADTHREAD, 0);
+  dt->dt_tid = td->td_tid;
+  TAILQ_INSERT_TAIL(&p->p_deadtds, dt, dt_link);
+
+  TAILQ_REMOVE(&p->p_threads, td, td_procq);
+  p->p_nthreads--;
+  cv_broadcast(&p->p_lwpcv);
+
+  WITH_SPIN_LOCK (td->td_lock)
+    td->td_proc = NULL;
+
+  proc_unlock(p);
+  thread_exit();
+}
+
+int do_lwp_wait(tid_t tid, tid_t *departedp) {
+  thread_t *td = thread_self();
+  proc_t *p = td->td_proc;
+
+  if (tid == td->td_tid)
+    return EDEADLK;
+
+  SCOPED_MTX_LOCK(&p->p_lock);
+
+  for (;;) {
+    deadthread_t *dt;
+    TAILQ_FOREACH (dt, &p->p_deadtds, dt_link) {
+      if (tid == 0 || dt->dt_tid == tid) {
+        TAILQ_REMOVE(&p->p_deadtds, dt, dt_link);
+        *departedp = dt->dt_tid;
+        pool_free(P_DEADTHREAD, dt);
+        return 0;
+      }
+    }
+
+    if (tid == 0) {
+      /* Nobody else could exit, so we would wait forever. */
+      if (p->p_nthreads == 1)
+        return EDEADLK;
+    } else {
+      thread_t *otd;
+      TAILQ_FOREACH (otd, &p->p_threads, td_procq) {
+        if (otd->td_tid == tid)
+          break;
+      }
+      if (otd == NULL)
+        return ESRCH;
+    }
+
+    if (cv_wait_intr(&p->p_lwpcv, &p->p_lock))
+      return EINTR;
+  }
+}
+
 __noreturn void proc_exit(int exitstatus) {
   thread_t *td = thread_self();
   proc_t *p = td->td_proc;
 
   assert(mtx_owned(&p->p_lock));
 
+  /* Another thread is already terminating the process or replacing its image,
+   * so exit only this one. */
+  if (p->p_nthreads > 1 &&
+      (p->p_state == PS_DYING || (td->td_flags & TDF_EXITING)))
+    proc_thread_exit();
+
   /* Mark this process as dying, so others don't attempt to disturb it. */
   p->p_state = PS_DYING;
 
+  /* Other threads must be gone before process resources get released.
+   * NOTE: this function may release and re-acquire p->p_lock. */
+  proc_single_thread();
+
   /* Clean up process resources. */
   klog("Freeing process PID(%d) {%p} resources", p->p_pid, p);
 
@@ -580,8 +716,9 @@ __noreturn void proc_exit(int exitstatus) {
    * NOTE: this function may release and re-acquire p->p_lock. */
   kitimer_stop(p);
 
-  /* Detach main thread from the process. */
-  p->p_thread = NULL;
+  /* Detach the last thread from the process. */
+  TAILQ_REMOVE(&p->p_threads, td, td_procq);
+  p->p_nthreads = 0;
   td->td_proc = NULL;
 
   /* Make sure address space won't get activated by context switch while it's
@@ -638,6 +775,7 @@ __noreturn void proc_exit(int exitstatus) {
     /* Turn the process into a zombie. */
     WITH_PROC_LOCK(p) {
       p->p_state = PS_ZOMBIE;
+      knote_proc_exit(p);
     }
 
     klog("Process PID(%d) {%p} is dead!", p->p_pid, p);
@@ -827,7 +965,7 @@ void proc_stop(signo_t sig) {
   assert(mtx_owned(&p->p_lock));
   assert(p->p_state == PS_NORMAL);
 
-  klog("Stopping thread %lu in process PID(%d)", td->td_tid, p->p_pid);
+  klog("Stopping process PID(%d)", p->p_pid);
   p->p_stopsig = sig;
   p->p_state = PS_STOPPED;
   p->p_flags |= PF_STATE_CHANGED;
@@ -835,7 +973,27 @@ void proc_stop(signo_t sig) {
     proc_wakeup_parent(p->p_parent);
     sig_child(p, CLD_STOPPED);
   }
-  WITH_SPIN_LOCK (td->td_lock) { td->td_flags |= TDF_STOPPING; }
+
+  /* Other threads stop when they check for signals. */
+  thread_t *otd;
+  TAILQ_FOREACH (otd, &p->p_threads, td_procq) {
+    WITH_SPIN_LOCK (otd->td_lock) {
+      otd->td_flags |= TDF_STOPPING;
+      if (otd != td)
+        otd->td_flags |= TDF_NEEDSIGCHK;
+    }
+  }
+
+  proc_thread_stop();
+}
+
+void proc_thread_stop(void) {
+  thread_t *td = thread_self();
+  proc_t *p = td->td_proc;
+
+  assert(mtx_owned(&p->p_lock));
+
+  klog("Stopping thread %lu in process PID(%d)", td->td_tid, p->p_pid);
   proc_unlock(p);
   /* We're holding no locks here, so our process can be continued before we
    * actually stop the thread. This is why we need the TDF_STOPPING flag. */
@@ -852,17 +1010,23 @@ void proc_stop(signo_t sig) {
 }
 
 void proc_continue(proc_t *p) {
-  thread_t *td = p->p_thread;
-
   assert(mtx_owned(&p->p_lock));
   assert(p->p_state == PS_STOPPED);
 
-  klog("Continuing thread %lu in process PID(%d)", td->td_tid, p->p_pid);
+  klog("Continuing process PID(%d)", p->p_pid);
 
   p->p_state = PS_NORMAL;
   p->p_flags |= PF_STATE_CHANGED;
   WITH_PROC_LOCK(p->p_parent) {
     proc_wakeup_parent(p->p_parent);
   }
-  WITH_SPIN_LOCK (td->td_lock) { thread_continue(td); }
+
+  /* Some threads may have not managed to stop yet. */
+  thread_t *td;
+  TAILQ_FOREACH (td, &p->p_threads, td_procq) {
+    WITH_SPIN_LOCK (td->td_lock) {
+      if (td_is_stopped(td) || (td->td_flags & TDF_STOPPING))
+        thread_continue(td);
+    }
+  }
 }
@@ -27,6 +27,7 @@ typedef struct {
   atomic_int pt_number; /* PTY number, if allocated. -1 means free. */
   condvar_t pt_incv;    /* CV for readers */
   condvar_t pt_outcv;   /* CV for writers */
+  knlist_t pt_klist;    /* Knotes monitoring the master device */
 } pty_t;
 
 static pty_t pty_array[MAX_PTYS];
@@ -188,6 +189,67 @@ static int pty_ioctl(file_t *f, u_long cmd, void *data) {
   return tty_ioctl(f, cmd, data);
 }
 
+static void filt_ptydetach(knote_t *kn) {
+  tty_t *tty = kn->kn_hook;
+  pty_t *pty = tty->t_data;
+
+  WITH_MTX_LOCK (&tty->t_lock)
+    SLIST_REMOVE(&pty->pt_klist, kn, knote, kn_objlink);
+}
+
+/* Reading from master side returns data from output queue of slave tty. */
+static int filt_ptyread(knote_t *kn, long hint) {
+  tty_t *tty = kn->kn_hook;
+
+  kn->kn_data = tty->t_outq.count;
+  if (kn->kn_data == 0 && !tty_opened(tty)) {
+    kn->kn_flags |= EV_EOF;
+    return 1;
+  }
+  return kn->kn_data > 0;
+}
+
+/* Writing to master side puts data into input queue of slave tty. */
+static int filt_ptywrite(knote_t *kn, long hint) {
+  tty_t *tty = kn->kn_hook;
+
+  kn->kn_data = tty->t_inq.size - tty->t_inq.count;
+  if (!tty_opened(tty)) {
+    kn->kn_flags |= EV_EOF;
+    return 1;
+  }
+  return !(tty->t_flags & TF_IN_HIWAT);
+}
+
+static filterops_t pty_read_filtops = {
+  .filt_detach = filt_ptydetach,
+  .filt_event = filt_ptyread,
+};
+
+static filterops_t pty_write_filtops = {
+  .filt_detach = filt_ptydetach,
+  .filt_event = filt_ptywrite,
+};
+
+static int pty_kqfilter(file_t *f, knote_t *kn) {
+  tty_t *tty = f->f_data;
+  pty_t *pty = tty->t_data;
+
+  if (kn->kn_filter == EVFILT_READ)
+    kn->kn_filtops = &pty_read_filtops;
+  else if (kn->kn_filter == EVFILT_WRITE)
+    kn->kn_filtops = &pty_write_filtops;
+  else
+    return EINVAL;
+
+  kn->kn_hook = tty;
+  kn->kn_objlock = &tty->t_lock;
+
+  WITH_MTX_LOCK (&tty->t_lock)
+    SLIST_INSERT_HEAD(&pty->pt_klist, kn, kn_objlink);
+  return 0;
+}
+
 static fileops_t pty_fileops = {
   .fo_read = pty_read,
   .fo_write = pty_write,
@@ -195,18 +257,21 @@ static fileops_t pty_fileops = {
   .fo_seek = noseek,
   .fo_stat = pty_stat,
   .fo_ioctl = pty_ioctl,
+  .fo_kqfilter = pty_kqfilter,
 };
 
 static void pty_notify_out(tty_t *tty) {
   pty_t *pty = tty->t_data;
   /* Notify PTY readers: input is available. */
   cv_broadcast(&pty->pt_incv);
+  knote(&pty->pt_klist, 0);
 }
 
 static void pty_notify_in(tty_t *tty) {
   pty_t *pty = tty->t_data;
   /* Notify PTY writers: there is space in the slave TTY's input buffer. */
   cv_broadcast(&pty->pt_outcv);
+  knote(&pty->pt_klist, 0);
 }
 
 static void pty_notify_inactive(tty_t *tty) {
@@ -214,6 +279,7 @@ static void pty_notify_inactive(tty_t *tty) {
   /* Notify PTY readers and writers so that they abort. */
   cv_broadcast(&pty->pt_incv);
   cv_broadcast(&pty->pt_outcv);
+  knote(&pty->pt_klist, 0);
 }
 
 static ttyops_t pty_ttyops = {.t_notify_out = pty_notify_out,
@@ -278,6 +344,7 @@ static void init_pty(void) {
     pty->pt_number = -1;
     cv_init(&pty->pt_incv, "pt_incv");
     cv_init(&pty->pt_outcv, "pt_outcv");
+    SLIST_INIT(&pty->pt_klist);
   }
 }
 
@@ -3,8 +3,12 @@
 #include <sys/thread.h>
 #include <sys/runq.h>
 
+#define RQB_WORD(i) ((i) / RQB_BPW)
+#define RQB_BIT(i) ((rqb_word_t)1 << ((i) % RQB_BPW))
+
 void runq_init(runq_t *rq) {
   memset(rq, 0, sizeof(*rq));
+  spin_init(&rq->rq_lock, 0);
 
   for (unsigned i = 0; i < RQ_NQS; i++)
     TAILQ_INIT(&rq->rq_queues[i]);
@@ -12,16 +16,19 @@ void runq_init(runq_t *rq) {
 
 void runq_add(runq_t *rq, thread_t *td) {
   unsigned prio = td->td_prio / RQ_PPQ;
+  rq->rq_status[RQB_WORD(prio)] |= RQB_BIT(prio);
   TAILQ_INSERT_TAIL(&rq->rq_queues[prio], td, td_runq);
+  rq->rq_count++;
 }
 
 thread_t *runq_choose(runq_t *rq) {
-  for (int i = 0; i < RQ_NQS; i++) {
-    struct rq_head *head = &rq->rq_queues[i];
-    thread_t *td = TAILQ_FIRST(head);
+  for (unsigned i = 0; i < RQB_LEN; i++) {
+    rqb_word_t word = rq->rq_status[i];
 
-    if (td)
-      return td;
+    if (word) {
+      unsigned prio = i * RQB_BPW + __builtin_ctzl(word);
+      return TAILQ_FIRST(&rq->rq_queues[prio]);
+    }
   }
 
   return NULL;
@@ -29,5 +36,10 @@ thread_t *runq_choose(runq_t *rq) {
 
 void runq_remove(runq_t *rq, thread_t *td) {
   unsigned prio = td->td_prio / RQ_PPQ;
-  TAILQ_REMOVE(&rq->rq_queues[prio], td, td_runq);
+  struct rq_head *head = &rq->rq_queues[prio];
+
+  TAILQ_REMOVE(head, td, td_runq);
+  rq->rq_count--;
+  if (TAILQ_EMPTY(head))
+    rq->rq_status[RQB_WORD(prio)] &= ~RQB_BIT(prio);
 }
@@ -0,0 +1,134 @@
+#include <sys/klog.h>
+#include <sys/ktrace.h>
+#include <sys/rwlock.h>
+#include <sys/sched.h>
+#include <sys/thread.h>
+#include <sys/turnstile.h>
+
+static inline thread_t *rw_owner(intptr_t state) {
+  return (state & RW_WRITER) ? (thread_t *)(state & ~RW_FLAGMASK) : NULL;
+}
+
+bool rw_wowned(rwlock_t *rw) {
+  intptr_t state = rw->rw_state;
+  return (state & RW_WRITER) && rw_owner(state) == thread_self();
+}
+
+void _rw_init(rwlock_t *rw, lk_attr_t attr, const char *name,
+              lock_class_key_t *key) {
+  /* The caller must not attempt to set the lock's type, only flags.
+   * Reader-writer locks cannot be recursive. */
+  assert((attr & (LK_TYPE_MASK | LK_RECURSIVE)) == 0);
+  rw->rw_state = 0;
+  rw->rw_attr = attr | LK_TYPE_BLOCK;
+
+#if LOCKDEP
+  rw->rw_lockmap =
+    (lock_class_mapping_t){.key = key, .name = name, .lock_class = NULL};
+#endif
+}
+
+/* Blocks the calling thread on turnstile of `rw` if the lock is still busy,
+ * i.e. held by anybody when `writer` is set, or held by a writer or being
+ * waited for otherwise. */
+static void rw_block(rwlock_t *rw, bool writer, const void *waitpt) {
+  turnstile_t *ts = turnstile_take(rw);
+  intptr_t state = rw->rw_state;
+
+  /* The lock could have been released before turnstile chain got locked. */
+  bool busy = writer ? state != 0 : (state & (RW_WRITER | RW_CONTESTED));
+
+  /* If we're the first thread to block, then the lock is now being
+   * contested. The state is updated atomically, since readers may be
+   * entering or leaving the lock on other processors. */
+  if (busy && !(state & RW_CONTESTED))
+    busy = atomic_compare_exchange_strong(&rw->rw_state, &state,
+                                          state | RW_CONTESTED);
+
+  if (busy) {
+    KTRACE(KTR_LOCK, rw, waitpt);
+    /* Priority can only be lent to a writer. */
+    turnstile_wait(ts, rw_owner(state), waitpt);
+  } else {
+    turnstile_give(ts);
+  }
+}
+
+void _rw_rlock(rwlock_t *rw, const void *waitpt) {
+  assert(!rw_wowned(rw));
+
+#if LOCKDEP
+  lockdep_acquire(&rw->rw_lockmap);
+#endif
+
+  for (;;) {
+    intptr_t state = rw->rw_state;
+
+    /* Fast path: if there's no writer and nobody waits then join readers. */
+    if (!(state & (RW_WRITER | RW_CONTESTED))) {
+      if (atomic_compare_exchange_weak(&rw->rw_state, &state,
+                                       state + RW_ONE_READER))
+        return;
+      continue;
+    }
+
+    rw_block(rw, false, waitpt);
+  }
+}
+
+void _rw_wlock(rwlock_t *rw, const void *waitpt) {
+  if (rw_wowned(rw))
+    panic("Reader-writer lock %p is not recursive!", rw);
+
+#if LOCKDEP
+  lockdep_acquire(&rw->rw_lockmap);
+#endif
+
+  intptr_t owner = (intptr_t)thread_self() | RW_WRITER;
+
+  for (;;) {
+    intptr_t expected = 0;
+
+    /* Fast path: if lock is not held then take ownership. */
+    if (atomic_compare_exchange_strong(&rw->rw_state, &expected, owner))
+      return;
+
+    rw_block(rw, true, waitpt);
+  }
+}
+
+void rw_unlock(rwlock_t *rw) {
+  intptr_t state = rw->rw_state;
+
+  assert(rw_locked(rw));
+
+#if LOCKDEP
+  lockdep_release(&rw->rw_lockmap);
+#endif
+
+  if (state & RW_WRITER) {
+    assert(rw_owner(state) == thread_self());
+
+    /* Fast path: if lock is not contested then drop ownership. */
+    intptr_t expected = (intptr_t)thread_self() | RW_WRITER;
+    if (atomic_compare_exchange_strong(&rw->rw_state, &expected, 0))
+      return;
+  } else {
+    /* Fast path: unless we're the last reader and somebody waits for the
+     * lock, just decrement number of readers. */
+    while ((state & ~RW_FLAGMASK) > RW_ONE_READER ||
+           !(state & RW_CONTESTED)) {
+      if (atomic_compare_exchange_weak(&rw->rw_state, &state,
+                                       state - RW_ONE_READER))
+        return;
+    }
+  }
+
+  /* Wake up all waiters, as in mtx_unlock. Readers among them will get the
+   * lock together. */
+  turnstile_chain_lock(rw);
+  intptr_t old = atomic_exchange(&rw->rw_state, 0);
+  if (old & RW_CONTESTED)
+    turnstile_broadcast(rw);
+  turnstile_chain_unlock(rw);
+}
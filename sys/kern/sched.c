@@ -9,17 +9,53 @@
 #include <sys/thread.h>
 #include <sys/spinlock.h>
 #include <sys/pcpu.h>
+#include <sys/smp.h>
 #include <sys/turnstile.h>
+#include <sys/ktrace.h>
 
-static SPIN_DEFINE(sched_lock, 0);
-static runq_t runq;
 static bool sched_active = false;
 
 #define SLICE 10
 
 void init_sched(void) {
-  thread0.td_lock = &sched_lock;
-  runq_init(&runq);
+  for (unsigned i = 0; i < MAXCPU; i++)
+    runq_init(&_pcpu_data[i].runq);
+}
+
+/*! \brief Put ready thread on run queue \a rq.
+ *
+ * \note Threads are only put on run queues with \a td_lock held, so once
+ * the lock is taken \a td_rq can only change from \a rq to NULL. */
+static void sched_runq_add(runq_t *rq, thread_t *td) {
+  SCOPED_SPIN_LOCK(&rq->rq_lock);
+  td->td_rq = rq;
+  runq_add(rq, td);
+}
+
+/*! \brief Estimate how busy is given processor.
+ *
+ * Value is read without locks, it's only a hint for load balancing. */
+static unsigned sched_cpu_load(pcpu_t *pc) {
+  return pc->runq.rq_count + (pc->curthread != pc->idle_thread);
+}
+
+/*! \brief Choose processor with the least loaded run queue.
+ *
+ * Current processor wins ties to avoid needless interprocessor interrupts. */
+static pcpu_t *sched_pick_cpu(void) {
+  pcpu_t *best = PCPU_SELF();
+  unsigned best_load = sched_cpu_load(best);
+
+  for (unsigned i = 0; i < ncpus; i++) {
+    pcpu_t *pc = &_pcpu_data[i];
+    unsigned load = sched_cpu_load(pc);
+    if (load < best_load) {
+      best = pc;
+      best_load = load;
+    }
+  }
+
+  return best;
 }
 
 void sched_add(thread_t *td) {
@@ -44,12 +80,18 @@ void sched_wakeup(thread_t *td, long reason) {
 
   ctx_set_retval(td->td_kctx, reason);
 
-  runq_add(&runq, td);
+  pcpu_t *pc = sched_pick_cpu();
+  sched_runq_add(&pc->runq, td);
 
   /* Check if we need to reschedule threads. */
-  thread_t *oldtd = thread_self();
-  if (prio_gt(td->td_prio, oldtd->td_prio))
+  thread_t *oldtd = pc->curthread;
+  if (!prio_gt(td->td_prio, oldtd->td_prio))
+    return;
+
+  if (pc == PCPU_SELF())
     oldtd->td_flags |= TDF_NEEDSWITCH;
+  else
+    smp_ipi_send(pc->cpuid, IPI_RESCHED);
 }
 
 /*! \brief Set thread's active priority \a td_prio to \a prio.
@@ -62,14 +104,20 @@ static void sched_set_active_prio(thread_t *td, prio_t prio) {
   if (prio_eq(td->td_prio, prio))
     return;
 
-  if (td_is_ready(td)) {
-    /* Thread is on a run queue. */
-    runq_remove(&runq, td);
-    td->td_prio = prio;
-    runq_add(&runq, td);
-  } else {
-    td->td_prio = prio;
+  runq_t *rq = td->td_rq;
+
+  if (rq != NULL) {
+    /* Thread is on a run queue, unless some processor has just taken it. */
+    SCOPED_SPIN_LOCK(&rq->rq_lock);
+    if (td->td_rq == rq) {
+      runq_remove(rq, td);
+      td->td_prio = prio;
+      runq_add(rq, td);
+      return;
+    }
   }
+
+  td->td_prio = prio;
 }
 
 void sched_set_prio(thread_t *td, prio_t prio) {
@@ -113,12 +161,33 @@ void sched_unlend_prio(thread_t *td, prio_t prio) {
  * \note Returned thread is marked as running!
  */
 static thread_t *sched_choose(void) {
-  thread_t *td = runq_choose(&runq);
+  runq_t *rq = PCPU_PTR(runq);
+  thread_t *td;
+
+  WITH_SPIN_LOCK (&rq->rq_lock) {
+    if ((td = runq_choose(rq))) {
+      runq_remove(rq, td);
+      td->td_rq = NULL;
+      td->td_state = TDS_RUNNING;
+    }
+  }
+
   if (td == NULL)
-    return PCPU_GET(idle_thread);
-  runq_remove(&runq, td);
-  td->td_state = TDS_RUNNING;
-  td->td_last_rtime = binuptime();
+    td = PCPU_GET(idle_thread);
+  else
+    td->td_last_rtime = binuptime();
+
+#if SMP
+  /* The thread could have been woken up before the processor it last ran on
+   * finished saving its context. */
+  if (td != thread_self()) {
+    while (td->td_oncpu)
+      continue;
+    atomic_thread_fence(memory_order_acquire);
+  }
+#endif
+  td->td_oncpu = true;
+
   return td;
 }
 
@@ -131,6 +200,10 @@ long sched_switch(void) {
   assert(spin_owned(td->td_lock));
   assert(!td_is_running(td));
 
+  /* Thread that used up its time slice gets a new one when it goes back to
+   * the run queue, so it is not preempted on every subsequent clock tick. */
+  if (td->td_flags & TDF_SLICEEND)
+    td->td_slice = SLICE;
   td->td_flags &= ~(TDF_SLICEEND | TDF_NEEDSWITCH);
 
   /* Update running time, */
@@ -141,7 +214,7 @@ long sched_switch(void) {
   if (td_is_ready(td)) {
     /* Idle threads need not to be inserted into the run queue. */
     if (td != PCPU_GET(idle_thread))
-      runq_add(&runq, td);
+      sched_runq_add(PCPU_PTR(runq), td);
   } else if (td_is_sleeping(td)) {
     /* Record when the thread fell asleep. */
     td->td_last_slptime = now;
@@ -157,6 +230,10 @@ long sched_switch(void) {
   /* If we got here then a context switch is required. */
   td->td_nctxsw++;
 
+  KTRACE(KTR_CTXSW, td->td_tid, newtd->td_tid);
+
+  clock_slice(newtd == PCPU_GET(idle_thread) ? 0 : newtd->td_slice);
+
   if (PCPU_GET(no_switch))
     panic("Switching context while interrupts are disabled is forbidden!");
 
@@ -171,14 +248,15 @@ noswitch:
   return 0;
 }
 
-void sched_clock(void) {
+void sched_clock(systime_t ticks) {
   assert(intr_disabled());
 
   thread_t *td = thread_self();
 
   if (td != PCPU_GET(idle_thread)) {
     WITH_SPIN_LOCK (td->td_lock) {
-      if (--td->td_slice <= 0)
+      td->td_slice -= min(ticks, (systime_t)SLICE);
+      if (td->td_slice <= 0)
         td->td_flags |= TDF_NEEDSWITCH | TDF_SLICEEND;
     }
   }
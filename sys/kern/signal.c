@@ -108,8 +108,8 @@ static inline bool sig_ignore_ttystop(proc_t *p, signo_t sig) {
 }
 
 int do_sigaction(signo_t sig, const sigaction_t *act, sigaction_t *oldact) {
-  thread_t *td = thread_self();
-  proc_t *p = td->td_proc;
+  proc_t *p = proc_self();
+  thread_t *td;
 
   if (sig >= NSIG)
     return EINVAL;
@@ -123,8 +123,10 @@ int do_sigaction(signo_t sig, const sigaction_t *act, sigaction_t *oldact) {
     if (act != NULL)
       memcpy(&p->p_sigactions[sig], act, sizeof(sigaction_t));
     /* If ignoring a pending signal, discard it. */
-    if (sig_ignored(p->p_sigactions, sig))
-      sigpend_get(&td->td_sigpend, sig, NULL);
+    if (sig_ignored(p->p_sigactions, sig)) {
+      TAILQ_FOREACH (td, &p->p_threads, td_procq)
+        sigpend_get(&td->td_sigpend, sig, NULL);
+    }
   }
 
   return 0;
@@ -145,9 +147,8 @@ static signo_t sig_pending(thread_t *td) {
 }
 
 int do_sigprocmask(int how, const sigset_t *set, sigset_t *oset) {
-  proc_t *proc = proc_self();
-  thread_t *td = proc->p_thread;
-  assert(mtx_owned(&proc->p_lock));
+  thread_t *td = thread_self();
+  assert(mtx_owned(&td->td_proc->p_lock));
 
   sigset_t *const mask = &td->td_sigmask;
 
@@ -201,11 +202,14 @@ int do_sigsuspend(proc_t *p, const sigset_t *mask) {
 
 int do_sigpending(proc_t *p, sigset_t *set) {
   SCOPED_MTX_LOCK(&p->p_lock);
-  thread_t *td = p->p_thread;
+  thread_t *td;
 
-  *set = td->td_sigpend.sp_set;
+  /* Signals sent to the process may be pending on any of its threads. */
+  __sigemptyset(set);
+  TAILQ_FOREACH (td, &p->p_threads, td_procq)
+    __sigplusset(&td->td_sigpend.sp_set, set);
   /* Only blocked pending signals are reported. */
-  __sigandset(&td->td_sigmask, set);
+  __sigandset(&thread_self()->td_sigmask, set);
   return 0;
 }
 
@@ -341,12 +345,36 @@ void sig_child(proc_t *p, int code) {
   sig_kill(parent, &ksi);
 }
 
+/* Choose a thread that the signal will be delivered to. The calling thread is
+ * preferred, so that signals caused by a trap are handled by the thread that
+ * triggered it. Threads that block the signal or are about to exit are picked
+ * only if there's no other choice. */
+static thread_t *sig_select_thread(proc_t *p, signo_t sig) {
+  thread_t *td = thread_self();
+
+  if (td->td_proc == p && !(td->td_flags & TDF_EXITING) &&
+      !__sigismember(&td->td_sigmask, sig))
+    return td;
+
+  thread_t *candidate = NULL;
+  TAILQ_FOREACH (td, &p->p_threads, td_procq) {
+    if (td->td_flags & TDF_EXITING)
+      continue;
+    if (!__sigismember(&td->td_sigmask, sig))
+      return td;
+    if (candidate == NULL)
+      candidate = td;
+  }
+
+  return candidate ? candidate : TAILQ_FIRST(&p->p_threads);
+}
+
 /*
  * NOTE: This is a very simple implementation! Unimplemented features:
  * - Thread tracing and debugging
- * - Multiple threads in a process
- * These limitations (plus the fact that we currently have very little thread
- * states) make the logic of sending a signal very simple!
+ * - Signals directed to a particular thread
+ * A signal sent to a process is made pending on a single thread chosen by
+ * `sig_select_thread`, which makes the logic of sending a signal very simple!
  */
 void sig_kill(proc_t *p, ksiginfo_t *ksi) {
   assert(p != NULL);
@@ -360,7 +388,10 @@ void sig_kill(proc_t *p, ksiginfo_t *ksi) {
   if (!proc_is_alive(p))
     return;
 
-  thread_t *td = p->p_thread;
+  /* Record the signal even if it is going to be ignored. */
+  knote(&p->p_klist, NOTE_SIGNAL | sig);
+
+  thread_t *td;
   bool ignored = sig_ignored(p->p_sigactions, sig);
 
   if (ignored && !sigprop_cont(sig))
@@ -374,9 +405,11 @@ void sig_kill(proc_t *p, ksiginfo_t *ksi) {
   /* If sending a stop or continue signal,
    * remove pending signals with the opposite effect. */
   if (defact_stop(sig)) {
-    sigpend_get(&td->td_sigpend, SIGCONT, NULL);
+    TAILQ_FOREACH (td, &p->p_threads, td_procq)
+      sigpend_get(&td->td_sigpend, SIGCONT, NULL);
   } else if (sigprop_cont(sig)) {
-    sigpend_delete_set(&td->td_sigpend, &stopmask);
+    TAILQ_FOREACH (td, &p->p_threads, td_procq)
+      sigpend_delete_set(&td->td_sigpend, &stopmask);
     if (p->p_state == PS_STOPPED)
       proc_continue(p);
     if (ignored)
@@ -384,6 +417,7 @@ void sig_kill(proc_t *p, ksiginfo_t *ksi) {
   }
 
   /* At this point we know the signal isn't ignored, so make it pending. */
+  td = sig_select_thread(p, sig);
   sigpend_put(&td->td_sigpend, ksiginfo_copy(ksi));
 
   /* Don't wake up the target thread if it blocks the signal being sent. */
@@ -417,7 +451,8 @@ void sig_pgkill(pgrp_t *pg, ksiginfo_t *ksi) {
 
 void sig_onexec(proc_t *p) {
   assert(mtx_owned(&p->p_lock));
-  thread_t *td = p->p_thread;
+  assert(p->p_nthreads == 1);
+  thread_t *td = TAILQ_FIRST(&p->p_threads);
 
   /* The signal mask, pending and ignored signals remain unchanged.
    * Caught signals have their action reset to SIG_DFL.
@@ -458,6 +493,13 @@ int sig_check(thread_t *td, ksiginfo_t *out) {
   assert(p != NULL);
   assert(mtx_owned(&p->p_lock));
 
+  /* Other threads may have asked us to exit or to stop along with them. */
+  while (td->td_flags & (TDF_EXITING | TDF_STOPPING)) {
+    if (td->td_flags & TDF_EXITING)
+      proc_thread_exit();
+    proc_thread_stop();
+  }
+
   while ((sig = sig_pending(td))) {
     sigpend_get(&td->td_sigpend, sig, out);
 
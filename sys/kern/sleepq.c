@@ -11,6 +11,8 @@
 #include <sys/interrupt.h>
 #include <sys/errno.h>
 #include <sys/callout.h>
+#include <sys/time.h>
+#include <sys/ktrace.h>
 
 #define SC_TABLESIZE 256 /* Must be power of 2. */
 #define SC_MASK (SC_TABLESIZE - 1)
@@ -117,6 +119,7 @@ static void sq_enter(thread_t *td, sleepq_chain_t *sc, void *wchan,
   assert(spin_owned(td->td_lock));
 
   klog("Thread %ld goes to sleep on %p at pc=%p", td->td_tid, wchan, waitpt);
+  KTRACE(KTR_SLEEP, wchan, waitpt);
 
   assert(td->td_wchan == NULL);
   assert(td->td_waitpt == NULL);
@@ -156,6 +159,7 @@ static void sq_enter(thread_t *td, sleepq_chain_t *sc, void *wchan,
 static void sq_leave(thread_t *td, sleepq_chain_t *sc, sleepq_t *sq) {
   klog("Wakeup thread %ld from %p at pc=%p", td->td_tid, td->td_wchan,
        td->td_waitpt);
+  KTRACE(KTR_WAKEUP, td->td_wchan, td->td_tid);
 
   assert(sc_owned(sc));
   assert(spin_owned(td->td_lock));
@@ -274,13 +278,20 @@ bool sleepq_abort(thread_t *td) {
   return _sleepq_abort(td, EINTR);
 }
 
-void sleepq_wait(void *wchan, const void *waitpt) {
+void sleepq_lock(void *wchan) {
+  (void)sc_acquire(wchan);
+}
+
+void sleepq_unlock(void *wchan) {
+  sc_release(SC_LOOKUP(wchan));
+}
+
+static void sq_wait(void *wchan, const void *waitpt) {
   thread_t *td = thread_self();
+  sleepq_chain_t *sc = SC_LOOKUP(wchan);
 
-  if (waitpt == NULL)
-    waitpt = __caller(0);
+  assert(sc_owned(sc));
 
-  sleepq_chain_t *sc = sc_acquire(wchan);
   spin_lock(td->td_lock);
   td->td_state = TDS_SLEEPING;
   sq_enter(td, sc, wchan, waitpt);
@@ -289,32 +300,47 @@ void sleepq_wait(void *wchan, const void *waitpt) {
   assert((td->td_flags & (TDF_SLPINTR | TDF_SLPTIMED)) == 0);
 }
 
+void sleepq_wait(void *wchan, const void *waitpt) {
+  if (waitpt == NULL)
+    waitpt = __caller(0);
+
+  sleepq_lock(wchan);
+  sq_wait(wchan, waitpt);
+}
+
+void sleepq_wait_locked(void *wchan, const void *waitpt) {
+  if (waitpt == NULL)
+    waitpt = __caller(0);
+
+  sq_wait(wchan, waitpt);
+}
+
 static void sq_timeout(thread_t *td) {
   _sleepq_abort(td, ETIMEDOUT);
 }
 
-int sleepq_wait_timed(void *wchan, const void *waitpt, systime_t timeout) {
+static int sq_wait_timed(void *wchan, const void *waitpt,
+                         const bintime_t *deadline) {
   thread_t *td = thread_self();
+  sleepq_chain_t *sc = SC_LOOKUP(wchan);
 
-  if (waitpt == NULL)
-    waitpt = __caller(0);
+  assert(sc_owned(sc));
 
-  sleepq_chain_t *sc = sc_acquire(wchan);
   spin_lock(td->td_lock);
 
   /* If there are pending signals, interrupt the sleep immediately. */
-  if ((td->td_flags & TDF_NEEDSIGCHK) && (timeout == 0)) {
+  if ((td->td_flags & TDF_NEEDSIGCHK) && (deadline == NULL)) {
     spin_unlock(td->td_lock);
     sc_release(sc);
     return EINTR;
   }
 
-  if (timeout > 0) {
+  if (deadline) {
     callout_setup(&td->td_slpcallout, (timeout_t)sq_timeout, td);
-    callout_schedule(&td->td_slpcallout, timeout);
+    callout_schedule_bt(&td->td_slpcallout, *deadline);
   }
 
-  td->td_flags |= (timeout > 0) ? TDF_SLPTIMED : TDF_SLPINTR;
+  td->td_flags |= deadline ? TDF_SLPTIMED : TDF_SLPINTR;
   sq_enter(td, sc, wchan, waitpt);
 
   /* After wakeup, only one of the following flags may be set:
@@ -330,8 +356,42 @@ int sleepq_wait_timed(void *wchan, const void *waitpt, systime_t timeout) {
     td->td_flags &= ~(TDF_SLPINTR | TDF_SLPTIMED);
   }
 
-  if (timeout > 0)
+  if (deadline)
     callout_stop(&td->td_slpcallout);
 
   return error;
 }
+
+static int sq_wait_ticks(void *wchan, const void *waitpt, systime_t timeout) {
+  if (timeout == 0)
+    return sq_wait_timed(wchan, waitpt, NULL);
+
+  bintime_t deadline = binuptime();
+  bintime_t len = bintime_mul(HZ2BT(CLK_TCK), timeout);
+  bintime_add(&deadline, &len);
+  return sq_wait_timed(wchan, waitpt, &deadline);
+}
+
+int sleepq_wait_timed(void *wchan, const void *waitpt, systime_t timeout) {
+  if (waitpt == NULL)
+    waitpt = __caller(0);
+
+  sleepq_lock(wchan);
+  return sq_wait_ticks(wchan, waitpt, timeout);
+}
+
+int sleepq_wait_timed_locked(void *wchan, const void *waitpt,
+                             systime_t timeout) {
+  if (waitpt == NULL)
+    waitpt = __caller(0);
+
+  return sq_wait_ticks(wchan, waitpt, timeout);
+}
+
+int sleepq_wait_until(void *wchan, const void *waitpt, bintime_t deadline) {
+  if (waitpt == NULL)
+    waitpt = __caller(0);
+
+  sleepq_lock(wchan);
+  return sq_wait_timed(wchan, waitpt, &deadline);
+}
@@ -0,0 +1,89 @@
+#define KL_LOG KL_INIT
+#include <sys/klog.h>
+#include <sys/mimiker.h>
+#include <sys/interrupt.h>
+#include <sys/pcpu.h>
+#include <sys/sched.h>
+#include <sys/smp.h>
+#include <sys/thread.h>
+#include <sys/time.h>
+
+volatile unsigned ncpus = 1;
+
+/* Processor that has been released by `init_smp` and is expected to report in.
+ * Processors that show up after the boot processor gave up on them are parked
+ * in `smp_ap_main`. */
+static volatile unsigned ap_starting;
+
+void init_smp(void) {
+  for (unsigned cpuid = 1; cpuid < MAXCPU; cpuid++) {
+    pcpu_t *pc = &_pcpu_data[cpuid];
+    pc->cpuid = cpuid;
+
+    /* Secondary processor enters the kernel on the stack of its idle thread
+     * with interrupts disabled, just like thread0 does. */
+    thread_t *td = thread_create("idle-thread", NULL, NULL, PRIO_QTY - 1);
+    td->td_state = TDS_RUNNING;
+    td->td_oncpu = true;
+    td->td_idnest = 1;
+    pc->curthread = td;
+
+    ap_starting = cpuid;
+    atomic_thread_fence(memory_order_release);
+
+    if (cpu_start_secondary(cpuid))
+      break;
+
+    bintime_t now = binuptime();
+    bintime_t deadline = now;
+    bintime_t timeout = BINTIME(1);
+    bintime_add(&deadline, &timeout);
+
+    while (ncpus == cpuid && bintime_cmp(&now, &deadline, <))
+      now = binuptime();
+
+    if (ncpus == cpuid) {
+      klog("CPU %u did not come up!", cpuid);
+      break;
+    }
+
+    klog("CPU %u is up and running", cpuid);
+  }
+
+  ap_starting = 0;
+}
+
+__noreturn void smp_ap_main(void) {
+  unsigned cpuid = PCPU_GET(cpuid);
+
+  if (cpuid != ap_starting) {
+    for (;;)
+      continue;
+  }
+
+  atomic_thread_fence(memory_order_acquire);
+  ncpus = cpuid + 1;
+
+  intr_enable();
+  sched_run();
+}
+
+void smp_ipi_send(unsigned cpuid, unsigned ipis) {
+  assert(cpuid < ncpus);
+
+  atomic_fetch_or(&_pcpu_data[cpuid].ipi_pending, ipis);
+  cpu_send_ipi(cpuid);
+}
+
+void smp_ipi_handler(void) {
+  assert(intr_disabled());
+
+  unsigned ipis = atomic_exchange(PCPU_PTR(ipi_pending), 0);
+
+  if (ipis & IPI_RESCHED) {
+    /* Thread will be switched out on return from interrupt. */
+    thread_t *td = thread_self();
+    WITH_SPIN_LOCK (td->td_lock)
+      td->td_flags |= TDF_NEEDSWITCH;
+  }
+}
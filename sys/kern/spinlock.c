@@ -1,20 +1,27 @@
 #include <sys/klog.h>
+#include <sys/ktrace.h>
 #include <sys/spinlock.h>
 #include <sys/interrupt.h>
 #include <sys/sched.h>
 #include <sys/thread.h>
 
 __no_profile bool spin_owned(spin_t *s) {
-  return (s->s_owner == thread_self());
+  return ((thread_t *)s->s_owner == thread_self());
 }
 
-void spin_init(spin_t *s, lk_attr_t la) {
+void _spin_init(spin_t *s, lk_attr_t la, const char *name,
+                lock_class_key_t *key) {
   /* The caller must not attempt to set the lock's type, only flags. */
   assert((la & LK_TYPE_MASK) == 0);
-  s->s_owner = NULL;
+  s->s_owner = 0;
   s->s_count = 0;
   s->s_lockpt = NULL;
   s->s_attr = la | LK_TYPE_SPIN;
+
+#if LOCKPROF
+  s->s_lockmap =
+    (lock_class_mapping_t){.key = key, .name = name, .lock_class = NULL};
+#endif
 }
 
 __no_profile void _spin_lock(spin_t *s, const void *waitpt) {
@@ -27,9 +34,33 @@ __no_profile void _spin_lock(spin_t *s, const void *waitpt) {
     return;
   }
 
-  assert(s->s_owner == NULL);
-  s->s_owner = thread_self();
+  intptr_t td = (intptr_t)thread_self();
+  intptr_t expected = 0;
+#if LOCKPROF
+  uint64_t waitstart = 0;
+#endif
+
+  if (!atomic_compare_exchange_strong(&s->s_owner, &expected, td)) {
+    KTRACE(KTR_LOCK, s, waitpt);
+#if LOCKPROF
+    waitstart = lockprof_now();
+#endif
+    do {
+#if !SMP
+      /* On single core architecture nobody else can hold the lock. */
+      panic("Spin lock %p is held by another thread!", s);
+#endif
+      expected = 0;
+    } while (!atomic_compare_exchange_strong(&s->s_owner, &expected, td));
+  }
+
   s->s_lockpt = waitpt;
+
+#if LOCKPROF
+  s->s_locktime = lockprof_now();
+  s->s_lockprof = lockprof_acquire(s, &s->s_lockmap, __caller(0), waitstart,
+                                   s->s_locktime);
+#endif
 }
 
 __no_profile void spin_unlock(spin_t *s) {
@@ -39,8 +70,11 @@ __no_profile void spin_unlock(spin_t *s) {
     assert(lk_recursive_p(s));
     s->s_count--;
   } else {
-    s->s_owner = NULL;
+#if LOCKPROF
+    lockprof_release(s->s_lockprof, s->s_locktime);
+#endif
     s->s_lockpt = NULL;
+    atomic_store(&s->s_owner, 0);
   }
 
   intr_enable();
@@ -0,0 +1,78 @@
+#include <sys/klog.h>
+#include <sys/sx.h>
+#include <sys/thread.h>
+
+void _sx_init(sx_t *sx, lk_attr_t attr, const char *name,
+              lock_class_key_t *key) {
+  /* The caller must not attempt to set the lock's type, only flags.
+   * Shared-exclusive locks cannot be recursive. */
+  assert((attr & (LK_TYPE_MASK | LK_RECURSIVE)) == 0);
+  sx->sx_attr = attr | LK_TYPE_SLEEP;
+  spin_init(&sx->sx_interlock, 0);
+  cv_init(&sx->sx_cv, "sx");
+  sx->sx_owner = NULL;
+  sx->sx_shared = 0;
+  sx->sx_xwaiters = 0;
+
+#if LOCKDEP
+  sx->sx_lockmap =
+    (lock_class_mapping_t){.key = key, .name = name, .lock_class = NULL};
+#endif
+}
+
+bool sx_xlocked(sx_t *sx) {
+  return sx->sx_owner == thread_self();
+}
+
+void sx_slock(sx_t *sx) {
+  assert(!sx_xlocked(sx));
+
+#if LOCKDEP
+  lockdep_acquire(&sx->sx_lockmap);
+#endif
+
+  WITH_SPIN_LOCK (&sx->sx_interlock) {
+    while (sx->sx_owner || sx->sx_xwaiters)
+      cv_wait(&sx->sx_cv, &sx->sx_interlock);
+    sx->sx_shared++;
+  }
+}
+
+void sx_xlock(sx_t *sx) {
+  if (sx_xlocked(sx))
+    panic("Shared-exclusive lock %p is not recursive!", sx);
+
+#if LOCKDEP
+  lockdep_acquire(&sx->sx_lockmap);
+#endif
+
+  WITH_SPIN_LOCK (&sx->sx_interlock) {
+    if (sx->sx_owner || sx->sx_shared) {
+      sx->sx_xwaiters++;
+      do {
+        cv_wait(&sx->sx_cv, &sx->sx_interlock);
+      } while (sx->sx_owner || sx->sx_shared);
+      sx->sx_xwaiters--;
+    }
+    sx->sx_owner = thread_self();
+  }
+}
+
+void sx_unlock(sx_t *sx) {
+#if LOCKDEP
+  lockdep_release(&sx->sx_lockmap);
+#endif
+
+  WITH_SPIN_LOCK (&sx->sx_interlock) {
+    if (sx->sx_owner) {
+      assert(sx_xlocked(sx));
+      sx->sx_owner = NULL;
+    } else {
+      assert(sx->sx_shared > 0);
+      if (--sx->sx_shared > 0)
+        break;
+    }
+    /* Both shared and exclusive waiters may be sleeping on sx_cv. */
+    cv_broadcast(&sx->sx_cv);
+  }
+}
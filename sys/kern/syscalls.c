@@ -25,6 +25,7 @@
 #include <sys/statvfs.h>
 #include <sys/pty.h>
 #include <sys/event.h>
+#include <sys/futex.h>
 
 #include "sysent.h"
 
@@ -169,11 +170,14 @@ static int sys_mmap(proc_t *p, mmap_args_t *args, register_t *res) {
   size_t length = SCARG(args, len);
   vm_prot_t prot = SCARG(args, prot);
   int flags = SCARG(args, flags);
+  int fd = SCARG(args, fd);
+  off_t pos = SCARG(args, pos);
 
-  klog("mmap(%p, %u, %d, %d)", (void *)va, length, prot, flags);
+  klog("mmap(%p, %u, %d, %d, %d, %ld)", (void *)va, length, prot, flags, fd,
+       pos);
 
   int error;
-  if ((error = do_mmap(&va, length, prot, flags)))
+  if ((error = do_mmap(&va, length, prot, flags, fd, pos)))
     return error;
 
   *res = va;
@@ -185,11 +189,11 @@ static int sys_munmap(proc_t *p, munmap_args_t *args, register_t *res) {
   return do_munmap((vaddr_t)SCARG(args, addr), SCARG(args, len));
 }
 
-/* TODO: implement it !!! */
 static int sys_mprotect(proc_t *p, mprotect_args_t *args, register_t *res) {
   klog("mprotect(%p, %u, %u)", SCARG(args, addr), SCARG(args, len),
        SCARG(args, prot));
-  return ENOTSUP;
+  return do_mprotect((vaddr_t)SCARG(args, addr), SCARG(args, len),
+                     SCARG(args, prot));
 }
 
 static int sys_openat(proc_t *p, openat_args_t *args, register_t *res) {
@@ -622,7 +626,7 @@ static int sys_setcontext(proc_t *p, setcontext_args_t *args, register_t *res) {
   ucontext_t uc;
   copyin_s(ucp, uc);
 
-  return do_setcontext(p->p_thread, &uc);
+  return do_setcontext(thread_self(), &uc);
 }
 
 static int sys_ioctl(proc_t *p, ioctl_args_t *args, register_t *res) {
@@ -1311,3 +1315,94 @@ end:
   kfree(M_TEMP, eventlist);
   return error;
 }
+
+static int sys_lwp_create(proc_t *p, lwp_create_args_t *args,
+                          register_t *res) {
+  void *func = SCARG(args, func);
+  void *arg = SCARG(args, arg);
+  void *stack = SCARG(args, stack);
+  tid_t *u_tidp = SCARG(args, tidp);
+  tid_t tid;
+  int error;
+
+  klog("lwp_create(%p, %p, %p, %p)", func, arg, stack, u_tidp);
+
+  /* The new thread is already running, so it must not depend on the value. */
+  if (!(error = do_lwp_create(func, arg, stack, &tid)) && u_tidp)
+    error = copyout_s(tid, u_tidp);
+
+  /* Like in lwp_wait, errno is not used to report the error. */
+  *res = error;
+  return 0;
+}
+
+static int sys_lwp_exit(proc_t *p, void *args, register_t *res) {
+  klog("lwp_exit()");
+  proc_lock(p);
+  proc_thread_exit();
+  __unreachable();
+}
+
+static int sys_lwp_wait(proc_t *p, lwp_wait_args_t *args, register_t *res) {
+  tid_t tid = SCARG(args, tid);
+  tid_t *u_departedp = SCARG(args, departedp);
+  tid_t departed;
+  int error;
+
+  klog("lwp_wait(%u, %p)", tid, u_departedp);
+
+  if (!(error = do_lwp_wait(tid, &departed)) && u_departedp)
+    error = copyout_s(departed, u_departedp);
+
+  /* Other threads of the process may overwrite errno at any time, so the
+   * error is returned as the result instead. */
+  *res = error;
+  return 0;
+}
+
+static int sys_lwp_self(proc_t *p, void *args, register_t *res) {
+  klog("lwp_self()");
+  *res = thread_self()->td_tid;
+  return 0;
+}
+
+static int sys_futex(proc_t *p, futex_args_t *args, register_t *res) {
+  int *uaddr = SCARG(args, uaddr);
+  int op = SCARG(args, op);
+  int val = SCARG(args, val);
+  const struct timespec *u_timeout = SCARG(args, timeout);
+  systime_t ticks = 0;
+  timespec_t timeout;
+  int error, nwoken = 0;
+
+  klog("futex(%p, %d, %d, %p)", uaddr, op, val, u_timeout);
+
+  switch (op) {
+    case FUTEX_WAIT:
+      if (u_timeout != NULL) {
+        if ((error = copyin_s(u_timeout, timeout)))
+          break;
+        if (timeout.tv_sec < 0 || timeout.tv_nsec < 0 ||
+            timeout.tv_nsec >= 1000000000) {
+          error = EINVAL;
+          break;
+        }
+        /* Zero timeout still makes the thread wait for a tick. */
+        ticks = max(ts2hz(&timeout), (systime_t)1);
+      }
+      error = do_futex_wait(uaddr, val, ticks);
+      break;
+
+    case FUTEX_WAKE:
+      error = (val < 0) ? EINVAL : do_futex_wake(uaddr, val, &nwoken);
+      break;
+
+    default:
+      error = EINVAL;
+  }
+
+  /* Threads waiting on a futex share errno with other threads of the process,
+   * so a negated error number is returned instead. */
+  *res = error ? -error : nwoken;
+  return 0;
+}
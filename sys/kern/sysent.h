@@ -91,6 +91,11 @@ static int sys_sync(proc_t *, void *, register_t *);
 static int sys_fsync(proc_t *, fsync_args_t *, register_t *);
 static int sys_kqueue1(proc_t *, kqueue1_args_t *, register_t *);
 static int sys_kevent(proc_t *, kevent_args_t *, register_t *);
+static int sys_lwp_create(proc_t *, lwp_create_args_t *, register_t *);
+static int sys_lwp_exit(proc_t *, void *, register_t *);
+static int sys_lwp_wait(proc_t *, lwp_wait_args_t *, register_t *);
+static int sys_lwp_self(proc_t *, void *, register_t *);
+static int sys_futex(proc_t *, futex_args_t *, register_t *);
 
 struct sysent sysent[] = {
   [SYS_syscall] = { .nargs = 1, .call = (syscall_t *)sys_syscall },
@@ -179,5 +184,10 @@ struct sysent sysent[] = {
   [SYS_fsync] = { .nargs = 1, .call = (syscall_t *)sys_fsync },
   [SYS_kqueue1] = { .nargs = 1, .call = (syscall_t *)sys_kqueue1 },
   [SYS_kevent] = { .nargs = 6, .call = (syscall_t *)sys_kevent },
+  [SYS_lwp_create] = { .nargs = 4, .call = (syscall_t *)sys_lwp_create },
+  [SYS_lwp_exit] = { .nargs = 0, .call = (syscall_t *)sys_lwp_exit },
+  [SYS_lwp_wait] = { .nargs = 2, .call = (syscall_t *)sys_lwp_wait },
+  [SYS_lwp_self] = { .nargs = 0, .call = (syscall_t *)sys_lwp_self },
+  [SYS_futex] = { .nargs = 4, .call = (syscall_t *)sys_futex },
 };
 
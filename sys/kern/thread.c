@@ -16,7 +16,6 @@
 
 static POOL_DEFINE(P_THREAD, "thread", sizeof(thread_t));
 
-typedef TAILQ_HEAD(, thread) thread_list_t;
 
 static MTX_DEFINE(threads_lock, 0);
 static thread_list_t all_threads = TAILQ_HEAD_INITIALIZER(all_threads);
@@ -30,6 +29,7 @@ static tid_t make_tid(void) {
 }
 
 static alignas(PAGESIZE) uint8_t _stack0[KSTACK_SIZE];
+static SPIN_DEFINE(thread0_lock, 0);
 
 /* Thread Zero is initially running with interrupts disabled! */
 thread_t thread0 = {
@@ -39,9 +39,11 @@ thread_t thread0 = {
   .td_base_prio = 255,
   .td_proc = &proc0,
   .td_state = TDS_RUNNING,
+  .td_oncpu = true,
   .td_idnest = 1,
   .td_pdnest = 1,
   .td_kstack = KSTACK_INIT(_stack0, KSTACK_SIZE),
+  .td_lock = &thread0_lock,
 };
 
 /* Initializes Thread Zero (first thread in the system). */
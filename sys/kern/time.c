@@ -53,10 +53,10 @@ static bool timeval_invalid(const timeval_t *tv) {
   return tv->tv_usec < 0 || tv->tv_usec >= 1000000 || tv->tv_sec < 0;
 }
 
+/* Converts requested sleep time into uptime the sleep should end at. */
 static int ts2timo(clockid_t clock_id, int flags, timespec_t *ts,
-                   systime_t *timo, timespec_t *start) {
+                   bintime_t *timo, timespec_t *start) {
   int error;
-  *timo = 0;
 
   if (timespec_invalid(ts) || (flags & ~TIMER_ABSTIME))
     return EINVAL;
@@ -70,7 +70,9 @@ static int ts2timo(clockid_t clock_id, int flags, timespec_t *ts,
   if ((ts->tv_sec == 0 && ts->tv_nsec == 0) || ts->tv_sec < 0)
     return ETIMEDOUT;
 
-  *timo = ts2hz(ts);
+  bintime_t now = binuptime();
+  ts2bt(ts, timo);
+  bintime_add(timo, &now);
 
   return 0;
 }
@@ -79,7 +81,7 @@ int do_clock_nanosleep(clockid_t clk, int flags, timespec_t *rqtp,
                        timespec_t *rmtp) {
   /* rmt - remaining time, rqt - requested time, p - pointer */
   timespec_t rmt_start, rmt_end, rmt;
-  systime_t timo;
+  bintime_t timo;
   int error, error2;
 
   if ((error = ts2timo(clk, flags, rqtp, &timo, &rmt_start))) {
@@ -89,7 +91,7 @@ int do_clock_nanosleep(clockid_t clk, int flags, timespec_t *rqtp,
   }
 
   do {
-    error = sleepq_wait_timed((void *)(&rmt_start), __caller(0), timo);
+    error = sleepq_wait_until((void *)(&rmt_start), __caller(0), timo);
     if (error == ETIMEDOUT)
       goto timedout;
 
@@ -109,9 +111,7 @@ int do_clock_nanosleep(clockid_t clk, int flags, timespec_t *rqtp,
       *rmtp = rmt;
     if (error)
       return error;
-
-    timo = ts2hz(&rmt);
-  } while (timo > 0);
+  } while (timespecisset(&rmt));
 
   return 0;
 
@@ -235,9 +235,9 @@ static void kitimer_timeout(void *arg) {
     timeradd(&next, &it->kit_interval, &next);
   it->kit_next = next;
 
-  /* Undo the `+ 1` done by ts2hz(). */
-  systime_t st = tv2hz(&next) - 1;
-  callout_reschedule(&it->kit_callout, st);
+  bintime_t bt;
+  tv2bt(&next, &bt);
+  callout_reschedule_bt(&it->kit_callout, bt);
 }
 
 void kitimer_init(proc_t *p) {
@@ -257,9 +257,9 @@ static void kitimer_setup(proc_t *p, const struct itimerval *itval) {
     timeradd(value, &abs, &abs);
     it->kit_next = abs;
     it->kit_interval = itval->it_interval;
-    /* Undo the `+ 1` done by ts2hz(). */
-    systime_t st = tv2hz(&it->kit_next) - 1;
-    callout_schedule_abs(&it->kit_callout, st);
+    bintime_t bt;
+    tv2bt(&it->kit_next, &bt);
+    callout_schedule_bt(&it->kit_callout, bt);
   } else {
     timerclear(&it->kit_next);
     timerclear(&it->kit_interval);
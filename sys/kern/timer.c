@@ -33,11 +33,13 @@ static bintime_t boottime = BINTIME(0);
  * \enddot
  */
 
+#define TMF_ARMED 0x0800 /* active in one-shot mode, may be re-armed */
 #define TMF_ACTIVE 0x1000
 #define TMF_INITIALIZED 0x2000
 #define TMF_RESERVED 0x4000
 #define TMF_REGISTERED 0x8000
 
+#define is_armed(tm) ((tm)->tm_flags & TMF_ARMED)
 #define is_active(tm) ((tm)->tm_flags & TMF_ACTIVE)
 #define is_initialized(tm) ((tm)->tm_flags & TMF_INITIALIZED)
 #define is_reserved(tm) ((tm)->tm_flags & TMF_RESERVED)
@@ -132,7 +134,8 @@ int tm_start(timer_t *tm, unsigned flags, const bintime_t start,
              const bintime_t period) {
   assert(is_initialized(tm));
 
-  if (is_active(tm))
+  /* One-shot timer that has not fired yet can be moved to a new deadline. */
+  if (is_active(tm) && !(is_armed(tm) && (flags & TMF_ONESHOT)))
     return EBUSY;
   if (((tm->tm_flags & flags) & TMF_TYPEMASK) == 0)
     return ENODEV;
@@ -143,8 +146,13 @@ int tm_start(timer_t *tm, unsigned flags, const bintime_t start,
   }
 
   int retval = tm->tm_start(tm, flags, start, period);
-  if (retval == 0)
+  if (retval == 0) {
     tm->tm_flags |= TMF_ACTIVE;
+    if (flags & TMF_ONESHOT)
+      tm->tm_flags |= TMF_ARMED;
+    else
+      tm->tm_flags &= ~TMF_ARMED;
+  }
   if (flags & TMF_TIMESOURCE)
     time_source = tm;
   return retval;
@@ -158,7 +166,7 @@ int tm_stop(timer_t *tm) {
 
   int retval = tm->tm_stop(tm);
   if (retval == 0)
-    tm->tm_flags &= ~TMF_ACTIVE;
+    tm->tm_flags &= ~(TMF_ACTIVE | TMF_ARMED);
   return retval;
 }
 
@@ -166,6 +174,10 @@ void tm_trigger(timer_t *tm) {
   assert(is_initialized(tm));
   assert(intr_disabled());
 
+  /* One-shot timer is done once it fires, so the callback can re-arm it. */
+  if (is_armed(tm))
+    tm->tm_flags &= ~(TMF_ACTIVE | TMF_ARMED);
+
   tm->tm_event_cb(tm, tm->tm_arg);
 }
 
@@ -12,6 +12,7 @@
 #include <sys/pmap.h>
 #include <sys/malloc.h>
 #include <sys/cred.h>
+#include <sys/hash.h>
 #include <bitstring.h>
 
 /*
@@ -40,10 +41,19 @@
  *
  * When a direntry is freed, then it is returned back to the pool of free
  * direntries. For simplicity, we never return back whole data blocks.
+ *
+ * Used direntries are kept on a list in order of creation, which is the order
+ * reported by readdir. Once a directory grows past TMPFS_DIRHASH_MIN entries,
+ * names are also indexed by a hash table allocated with kmem_alloc. The table
+ * doubles in size whenever the average chain becomes longer than
+ * TMPFS_DIRHASH_LOAD entries and is released when the directory gets empty.
  */
 
 #define TMPFS_NAME_MAX 64
 
+#define TMPFS_DIRHASH_MIN 32 /* build index for directories bigger than that */
+#define TMPFS_DIRHASH_LOAD 2 /* max. average number of entries per bucket */
+
 #define BLOCK_SIZE PAGESIZE
 #define BLOCK_MASK (BLOCK_SIZE - 1)
 #define BLKNO(x) ((x) / BLOCK_SIZE)
@@ -74,12 +84,14 @@ typedef struct _blk *blkptr_t;
 
 typedef struct tmpfs_dirent {
   TAILQ_ENTRY(tmpfs_dirent) tfd_entries; /* node on dirent list */
+  LIST_ENTRY(tmpfs_dirent) tfd_hash;     /* node on dirhash bucket list */
   struct tmpfs_node *tfd_node;           /* pointer to the file's node */
   size_t tfd_namelen;            /* number of bytes occupied in array below */
   char tfd_name[TMPFS_NAME_MAX]; /* name of file */
 } tmpfs_dirent_t;
 
 typedef TAILQ_HEAD(, tmpfs_dirent) tmpfs_dirent_list_t;
+typedef LIST_HEAD(, tmpfs_dirent) tmpfs_dirhash_bucket_t;
 
 typedef struct tmpfs_node {
   vnode_t *tfn_vnode;   /* corresponding v-node */
@@ -108,6 +120,9 @@ typedef struct tmpfs_node {
       struct tmpfs_node *parent;    /* Parent directory. */
       tmpfs_dirent_list_t dirents;  /* List of directory entries. */
       tmpfs_dirent_list_t fdirents; /* List of free directory entries. */
+      size_t ndirents;              /* Number of used directory entries. */
+      tmpfs_dirhash_bucket_t *dirhash; /* Name index or NULL if not built. */
+      size_t dirhash_size;             /* Number of buckets in the index. */
     } tfn_dir;
     struct {
       char *link;
@@ -296,6 +311,8 @@ static void tmpfs_attach_vnode(tmpfs_node_t *tfn, mount_t *mp);
 static tmpfs_node_t *tmpfs_new_node(tmpfs_mount_t *tfm, vattr_t *va,
                                     vnodetype_t ntype);
 static void tmpfs_free_node(tmpfs_mount_t *tfm, tmpfs_node_t *tfn);
+static void tmpfs_dirhash_insert(tmpfs_node_t *tfn, tmpfs_dirent_t *de);
+static void tmpfs_dirhash_free(tmpfs_node_t *tfn);
 static int tmpfs_create_file(vnode_t *dv, vnode_t **vp, vattr_t *va,
                              vnodetype_t ntype, componentname_t *cn);
 static void tmpfs_dir_attach(tmpfs_node_t *dnode, tmpfs_dirent_t *de,
@@ -559,10 +576,18 @@ static int tmpfs_vop_reclaim(vnode_t *v) {
   tmpfs_mount_t *tfm = TMPFS_ROOT_OF(v->v_mount);
   tmpfs_node_t *node = TMPFS_NODE_OF(v);
 
+  bool unused;
+
   v->v_data = NULL;
-  node->tfn_vnode = NULL;
+  WITH_MTX_LOCK (&tfm->tfm_lock) {
+    /* A lookup could have attached a new vnode once this one lost its last
+     * user. Then the node is freed when the new vnode gets reclaimed. */
+    if (node->tfn_vnode == v)
+      node->tfn_vnode = NULL;
+    unused = node->tfn_vnode == NULL;
+  }
 
-  if (node->tfn_links == 0)
+  if (unused && node->tfn_links == 0)
     tmpfs_free_node(tfm, node);
 
   return 0;
@@ -696,6 +721,8 @@ static tmpfs_node_t *tmpfs_new_node(tmpfs_mount_t *tfm, vattr_t *va,
  * destroy the inode structures.
  */
 static void tmpfs_free_node(tmpfs_mount_t *tfm, tmpfs_node_t *tfn) {
+  if (tfn->tfn_type == V_DIR)
+    tmpfs_dirhash_free(tfn);
   tmpfs_resize(tfm, tfn, 0);
   tmpfs_free_inode(tfm, tfn);
 }
@@ -732,6 +759,8 @@ static void tmpfs_dir_attach(tmpfs_node_t *dnode, tmpfs_dirent_t *de,
   node->tfn_links++;
   de->tfd_node = node;
   TAILQ_INSERT_TAIL(&dnode->tfn_dir.dirents, de, tfd_entries);
+  dnode->tfn_dir.ndirents++;
+  tmpfs_dirhash_insert(dnode, de);
 
   /* If directory set parent and increase the link count of parent. */
   if (node->tfn_type == V_DIR) {
@@ -747,12 +776,14 @@ static void tmpfs_dir_attach(tmpfs_node_t *dnode, tmpfs_dirent_t *de,
  * tmpfs_get_vnode: get a v-node with usecnt incremented.
  */
 static int tmpfs_get_vnode(mount_t *mp, tmpfs_node_t *tfn, vnode_t **vp) {
+  /* Lookups under shared directory lock may race to attach a vnode. */
+  SCOPED_MTX_LOCK(&TMPFS_ROOT_OF(mp)->tfm_lock);
+
+  /* The vnode may have lost its last user already and be waiting for
+   * tmpfs_vop_reclaim to detach it, so it cannot be revived. */
   vnode_t *vn = tfn->tfn_vnode;
-  if (vn == NULL) {
+  if (vn == NULL || !vnode_tryhold(vn))
     tmpfs_attach_vnode(tfn, mp);
-  } else {
-    vnode_hold(vn);
-  }
   *vp = tfn->tfn_vnode;
   return 0;
 }
@@ -803,9 +834,88 @@ static int tmpfs_alloc_dirent(tmpfs_node_t *tfn, const char *name,
   return 0;
 }
 
+/*
+ * tmpfs directory name index routines.
+ */
+static tmpfs_dirhash_bucket_t *tmpfs_dirhash_bucket(tmpfs_node_t *tfn,
+                                                    const char *name,
+                                                    size_t namelen) {
+  uint32_t hash = hash32_buf(name, namelen, HASH32_BUF_INIT);
+  return &tfn->tfn_dir.dirhash[hash & (tfn->tfn_dir.dirhash_size - 1)];
+}
+
+static void tmpfs_dirhash_free(tmpfs_node_t *tfn) {
+  if (tfn->tfn_dir.dirhash == NULL)
+    return;
+  kmem_free(tfn->tfn_dir.dirhash,
+            tfn->tfn_dir.dirhash_size * sizeof(tmpfs_dirhash_bucket_t));
+  tfn->tfn_dir.dirhash = NULL;
+  tfn->tfn_dir.dirhash_size = 0;
+}
+
+/*
+ * tmpfs_dirhash_build: (re)build the index with a given number of buckets.
+ * If memory for the index cannot be allocated, the old one is kept.
+ */
+static void tmpfs_dirhash_build(tmpfs_node_t *tfn, size_t nbuckets) {
+  tmpfs_dirhash_bucket_t *dirhash =
+    kmem_alloc(nbuckets * sizeof(tmpfs_dirhash_bucket_t), M_ZERO);
+  if (dirhash == NULL)
+    return;
+
+  tmpfs_dirhash_free(tfn);
+  tfn->tfn_dir.dirhash = dirhash;
+  tfn->tfn_dir.dirhash_size = nbuckets;
+
+  tmpfs_dirent_t *de;
+  TAILQ_FOREACH (de, &tfn->tfn_dir.dirents, tfd_entries) {
+    tmpfs_dirhash_bucket_t *bucket =
+      tmpfs_dirhash_bucket(tfn, de->tfd_name, de->tfd_namelen);
+    LIST_INSERT_HEAD(bucket, de, tfd_hash);
+  }
+}
+
+/*
+ * tmpfs_dirhash_insert: add a directory entry that has just been attached to
+ * the index, building or growing the index when needed.
+ */
+static void tmpfs_dirhash_insert(tmpfs_node_t *tfn, tmpfs_dirent_t *de) {
+  size_t ndirents = tfn->tfn_dir.ndirents;
+  size_t nbuckets = tfn->tfn_dir.dirhash_size;
+
+  if (tfn->tfn_dir.dirhash == NULL) {
+    if (ndirents > TMPFS_DIRHASH_MIN)
+      tmpfs_dirhash_build(tfn, PAGESIZE / sizeof(tmpfs_dirhash_bucket_t));
+    return;
+  }
+
+  if (ndirents > nbuckets * TMPFS_DIRHASH_LOAD) {
+    tmpfs_dirhash_build(tfn, nbuckets * 2);
+    /* The entry was already linked in unless rebuilding failed. */
+    if (tfn->tfn_dir.dirhash_size != nbuckets)
+      return;
+  }
+
+  tmpfs_dirhash_bucket_t *bucket =
+    tmpfs_dirhash_bucket(tfn, de->tfd_name, de->tfd_namelen);
+  LIST_INSERT_HEAD(bucket, de, tfd_hash);
+}
+
 static tmpfs_dirent_t *tmpfs_dir_lookup(tmpfs_node_t *tfn,
                                         const componentname_t *cn) {
   tmpfs_dirent_t *de;
+
+  if (tfn->tfn_dir.dirhash) {
+    tmpfs_dirhash_bucket_t *bucket =
+      tmpfs_dirhash_bucket(tfn, cn->cn_nameptr, cn->cn_namelen);
+    LIST_FOREACH (de, bucket, tfd_hash) {
+      if (de->tfd_namelen == cn->cn_namelen &&
+          !memcmp(de->tfd_name, cn->cn_nameptr, cn->cn_namelen))
+        return de;
+    }
+    return NULL;
+  }
+
   TAILQ_FOREACH (de, &tfn->tfn_dir.dirents, tfd_entries) {
     if (componentname_equal(cn, de->tfd_name))
       return de;
@@ -830,6 +940,10 @@ static void tmpfs_dir_detach(tmpfs_node_t *dv, tmpfs_dirent_t *de) {
   de->tfd_node = NULL;
   TAILQ_REMOVE(&dv->tfn_dir.dirents, de, tfd_entries);
   TAILQ_INSERT_TAIL(&dv->tfn_dir.fdirents, de, tfd_entries);
+  if (dv->tfn_dir.dirhash)
+    LIST_REMOVE(de, tfd_hash);
+  if (--dv->tfn_dir.ndirents == 0)
+    tmpfs_dirhash_free(dv);
 
   tmpfs_update_time(dv, TMPFS_UPDATE_MTIME | TMPFS_UPDATE_CTIME);
 }
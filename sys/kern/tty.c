@@ -172,6 +172,7 @@ tty_t *tty_alloc(void) {
   tty->t_line.ln_buf = kmalloc(M_DEV, LINEBUF_SIZE, M_WAITOK);
   tty->t_line.ln_size = LINEBUF_SIZE;
   tty_init_termios(&tty->t_termios);
+  SLIST_INIT(&tty->t_klist);
   return tty;
 }
 
@@ -408,6 +409,7 @@ static void tty_erase(tty_t *tty, uint8_t c) {
 /* Wake up readers waiting for input. */
 static void tty_wakeup(tty_t *tty) {
   cv_broadcast(&tty->t_incv);
+  knote(&tty->t_klist, 0);
 }
 
 /*
@@ -832,8 +834,10 @@ void tty_getc_done(tty_t *tty) {
   size_t cnt = tty->t_outq.count;
   tty_flags_t oldf = tty->t_flags;
 
-  if (cnt < TTY_OUT_LOW_WATER)
+  if (cnt < TTY_OUT_LOW_WATER) {
     tty->t_flags &= ~TF_WAIT_OUT_LOWAT;
+    knote(&tty->t_klist, 0);
+  }
   if (cnt == 0)
     tty->t_flags &= ~TF_WAIT_DRAIN_OUT;
 
@@ -1070,6 +1074,7 @@ void tty_detach_driver(tty_t *tty) {
   cv_broadcast(&tty->t_incv);
   cv_broadcast(&tty->t_outcv);
   cv_broadcast(&tty->t_serialize_cv);
+  knote(&tty->t_klist, 0);
 
   /* We can't free the tty structure yet, as there may still be existing
    * references to the vnode. We free it in tty_vn_reclaim, once all
@@ -1083,6 +1088,63 @@ void tty_detach_driver(tty_t *tty) {
   vnode_drop(v);
 }
 
+static void filt_ttydetach(knote_t *kn) {
+  tty_t *tty = kn->kn_hook;
+
+  WITH_MTX_LOCK (&tty->t_lock)
+    SLIST_REMOVE(&tty->t_klist, kn, knote, kn_objlink);
+}
+
+static int filt_ttyread(knote_t *kn, long hint) {
+  tty_t *tty = kn->kn_hook;
+
+  kn->kn_data = tty->t_inq.count;
+  if (tty_detached(tty)) {
+    kn->kn_flags |= EV_EOF;
+    return 1;
+  }
+  return kn->kn_data > 0;
+}
+
+static int filt_ttywrite(knote_t *kn, long hint) {
+  tty_t *tty = kn->kn_hook;
+
+  kn->kn_data = tty->t_outq.size - tty->t_outq.count;
+  if (tty_detached(tty)) {
+    kn->kn_flags |= EV_EOF;
+    return 1;
+  }
+  return tty->t_outq.count < TTY_OUT_LOW_WATER;
+}
+
+static filterops_t tty_read_filtops = {
+  .filt_detach = filt_ttydetach,
+  .filt_event = filt_ttyread,
+};
+
+static filterops_t tty_write_filtops = {
+  .filt_detach = filt_ttydetach,
+  .filt_event = filt_ttywrite,
+};
+
+static int tty_kqfilter(file_t *f, knote_t *kn) {
+  tty_t *tty = f->f_data;
+
+  if (kn->kn_filter == EVFILT_READ)
+    kn->kn_filtops = &tty_read_filtops;
+  else if (kn->kn_filter == EVFILT_WRITE)
+    kn->kn_filtops = &tty_write_filtops;
+  else
+    return EINVAL;
+
+  kn->kn_hook = tty;
+  kn->kn_objlock = &tty->t_lock;
+
+  WITH_MTX_LOCK (&tty->t_lock)
+    SLIST_INSERT_HEAD(&tty->t_klist, kn, kn_objlink);
+  return 0;
+}
+
 /* We implement I/O operations as fileops in order to bypass
  * the vnode layer's locking. */
 static fileops_t tty_fileops = {
@@ -1092,6 +1154,7 @@ static fileops_t tty_fileops = {
   .fo_seek = default_vnseek,
   .fo_stat = default_vnstat,
   .fo_ioctl = tty_ioctl,
+  .fo_kqfilter = tty_kqfilter,
 };
 
 bool maybe_assoc_ctty(proc_t *p, tty_t *tty) {
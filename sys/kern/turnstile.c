@@ -10,7 +10,7 @@
 #define TC_SHIFT 8
 #define TC_HASH(wc)                                                            \
   ((((uintptr_t)(wc) >> TC_SHIFT) ^ (uintptr_t)(wc)) & TC_MASK)
-#define TC_LOOKUP(wc) &turnstile_chains[TC_HASH(wc)]
+#define TC_LOOKUP(wc) (&turnstile_chains[TC_HASH(wc)])
 
 typedef TAILQ_HEAD(td_queue, thread) td_queue_t;
 typedef LIST_HEAD(ts_list, turnstile) ts_list_t;
@@ -126,11 +126,13 @@ static void adjust_thread(turnstile_t *ts, thread_t *td, prio_t oldprio) {
     adjust_thread_forward(ts, td);
 }
 
-/* \note Acquires td_lock! */
+/* Returns NULL if the lock is held by readers, which are not tracked.
+ * \note Acquires td_lock! */
 static thread_t *acquire_owner(turnstile_t *ts) {
   assert(ts->ts_state == USED_BLOCKED);
   thread_t *td = ts->ts_owner;
-  assert(td != NULL); /* Turnstile must have an owner. */
+  if (td == NULL)
+    return NULL;
   spin_lock(td->td_lock);
   assert(!td_is_sleeping(td)); /* You must not sleep while holding a mutex. */
   return td;
@@ -143,7 +145,8 @@ static void propagate_priority(thread_t *td) {
   turnstile_t *ts = td->td_blocked;
   prio_t prio = td->td_prio;
 
-  td = acquire_owner(ts);
+  if (!(td = acquire_owner(ts)))
+    return;
 
   /* Walk through blocked threads. */
   while (prio_lt(td->td_prio, prio) && !td_is_ready(td) && !td_is_running(td)) {
@@ -161,7 +164,8 @@ static void propagate_priority(thread_t *td) {
     adjust_thread(ts, td, oldprio);
     spin_unlock(td->td_lock);
 
-    td = acquire_owner(ts);
+    if (!(td = acquire_owner(ts)))
+      return;
   }
 
   /* Possibly finish at a running/runnable thread. */
@@ -200,6 +204,9 @@ static void switch_away(turnstile_t *ts, const void *waitpt) {
   td->td_waitpt = waitpt;
   td->td_state = TDS_BLOCKED;
   propagate_priority(td);
+  /* Threads that wake us up need our td_lock, hence we cannot miss the wakeup
+   * once turnstile chain is unlocked. */
+  spin_unlock(&TC_LOOKUP(ts->ts_wchan)->tc_lock);
   sched_switch();
 }
 
@@ -210,7 +217,7 @@ static void switch_away(turnstile_t *ts, const void *waitpt) {
 static void give_back_turnstiles(turnstile_t *ts) {
   assert(ts != NULL);
   assert(ts->ts_state == USED_BLOCKED);
-  assert(ts->ts_owner == thread_self());
+  assert(ts->ts_owner == NULL || ts->ts_owner == thread_self());
 
   thread_t *td;
   TAILQ_FOREACH (td, &ts->ts_blocked, td_blockedq) {
@@ -282,6 +289,8 @@ static void wakeup_blocked(td_queue_t *blocked_threads) {
  * it or NULL if no turnstile is found in chains. */
 static turnstile_t *turnstile_lookup(void *wchan) {
   turnstile_chain_t *tc = TC_LOOKUP(wchan);
+  assert(spin_owned(&tc->tc_lock));
+
   turnstile_t *ts;
   LIST_FOREACH (ts, &tc->tc_turnstiles, ts_chain_link) {
     assert(ts->ts_state == USED_BLOCKED);
@@ -291,8 +300,16 @@ static turnstile_t *turnstile_lookup(void *wchan) {
   return NULL;
 }
 
+void turnstile_chain_lock(void *wchan) {
+  spin_lock(&TC_LOOKUP(wchan)->tc_lock);
+}
+
+void turnstile_chain_unlock(void *wchan) {
+  spin_unlock(&TC_LOOKUP(wchan)->tc_lock);
+}
+
 turnstile_t *turnstile_take(void *wchan) {
-  assert(preempt_disabled());
+  turnstile_chain_lock(wchan);
 
   turnstile_t *ts = turnstile_lookup(wchan);
 
@@ -307,16 +324,19 @@ turnstile_t *turnstile_take(void *wchan) {
 }
 
 void turnstile_give(turnstile_t *ts) {
-  assert(preempt_disabled());
+  void *wchan = ts->ts_wchan;
+  assert(spin_owned(&TC_LOOKUP(wchan)->tc_lock));
 
   thread_t *td = thread_self();
   if (ts == td->td_turnstile)
     ts->ts_wchan = NULL;
+
+  turnstile_chain_unlock(wchan);
 }
 
 void turnstile_wait(turnstile_t *ts, thread_t *owner, const void *waitpt) {
-  assert(preempt_disabled());
   assert(ts != NULL);
+  assert(spin_owned(&TC_LOOKUP(ts->ts_wchan)->tc_lock));
 
   thread_t *td = thread_self();
 
@@ -349,7 +369,8 @@ void turnstile_wait(turnstile_t *ts, thread_t *owner, const void *waitpt) {
     ts->ts_owner = owner;
 
     turnstile_chain_t *tc = TC_LOOKUP(ts->ts_wchan);
-    LIST_INSERT_HEAD(&owner->td_contested, ts, ts_contested_link);
+    if (owner)
+      LIST_INSERT_HEAD(&owner->td_contested, ts, ts_contested_link);
     LIST_INSERT_HEAD(&tc->tc_turnstiles, ts, ts_chain_link);
     TAILQ_INSERT_TAIL(&ts->ts_blocked, td, td_blockedq);
 
@@ -360,17 +381,18 @@ void turnstile_wait(turnstile_t *ts, thread_t *owner, const void *waitpt) {
 }
 
 void turnstile_broadcast(void *wchan) {
-  assert(preempt_disabled());
+  assert(spin_owned(&TC_LOOKUP(wchan)->tc_lock));
 
   turnstile_t *ts = turnstile_lookup(wchan);
 
   assert(ts != NULL);
   assert(ts->ts_state == USED_BLOCKED);
-  assert(ts->ts_owner == thread_self());
+  assert(ts->ts_owner == NULL || ts->ts_owner == thread_self());
   assert(!TAILQ_EMPTY(&ts->ts_blocked));
 
   give_back_turnstiles(ts);
-  unlend_self(ts);
+  if (ts->ts_owner)
+    unlend_self(ts);
   wakeup_blocked(&ts->ts_blocked);
 
   assert(ts->ts_state == FREE_UNBLOCKED);
@@ -115,3 +115,26 @@ int iovec_length(const iovec_t *iov, int iovcnt, size_t *lengthp) {
   *lengthp = len;
   return 0;
 }
+
+int uio_prefault(uio_t *uio) {
+  if (uio->uio_vmspace == vm_map_kernel())
+    return 0;
+
+  /* Data is copied out to user memory on read and copied in on write. */
+  vm_prot_t prot = (uio->uio_op == UIO_READ) ? VM_PROT_WRITE : VM_PROT_READ;
+  iovec_t *iov = uio->uio_iov;
+  size_t iovoff = uio->uio_iovoff;
+  size_t resid = uio->uio_resid;
+
+  for (; resid > 0; iov++, iovoff = 0) {
+    size_t cnt = min(iov->iov_len - iovoff, resid);
+    vaddr_t start = rounddown((vaddr_t)iov->iov_base + iovoff, PAGESIZE);
+    vaddr_t end = (vaddr_t)iov->iov_base + iovoff + cnt;
+    for (vaddr_t va = start; va < end; va += PAGESIZE)
+      if (vm_page_fault(uio->uio_vmspace, va, prot))
+        return EFAULT;
+    resid -= cnt;
+  }
+
+  return 0;
+}
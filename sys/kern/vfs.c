@@ -149,6 +149,8 @@ int vfs_domount(vfsconf_t *vfc, vnode_t *v) {
     return error;
 
   v->v_mountedhere = m;
+  /* Names looked up in covered directory are shadowed by the mount now. */
+  vfs_cache_purge(v);
 
   WITH_MTX_LOCK (&mount_list_mtx)
     TAILQ_INSERT_TAIL(&mount_list, m, mnt_list);
@@ -169,9 +171,14 @@ int vfs_domount(vfsconf_t *vfc, vnode_t *v) {
 void vfs_maybe_ascend(vnode_t **vp) {
   vnode_t *v_covered;
   vnode_t *v = *vp;
+  bool shared = !vnode_xlocked(v);
   while (vnode_is_mounted(v)) {
     v_covered = v->v_mount->mnt_vnodecovered;
-    vnode_get(v_covered);
+    vnode_hold(v_covered);
+    if (shared)
+      vnode_lock_shared(v_covered);
+    else
+      vnode_lock(v_covered);
     vnode_put(v);
     v = v_covered;
   }
@@ -183,6 +190,7 @@ void vfs_maybe_ascend(vnode_t **vp) {
 int vfs_maybe_descend(vnode_t **vp) {
   vnode_t *v_mntpt;
   vnode_t *v = *vp;
+  bool shared = !vnode_xlocked(v);
   while (is_mountpoint(v)) {
     int error = VFS_ROOT(v->v_mountedhere, &v_mntpt);
     vnode_put(v);
@@ -190,7 +198,10 @@ int vfs_maybe_descend(vnode_t **vp) {
       return error;
     v = v_mntpt;
     /* No need to ref this vnode, VFS_ROOT already did it for us. */
-    vnode_lock(v);
+    if (shared)
+      vnode_lock_shared(v);
+    else
+      vnode_lock(v);
     *vp = v;
   }
   return 0;
@@ -0,0 +1,194 @@
+#define KL_LOG KL_VFS
+#include <sys/klog.h>
+#include <sys/devfs.h>
+#include <sys/hash.h>
+#include <sys/libkern.h>
+#include <sys/linker_set.h>
+#include <sys/mutex.h>
+#include <sys/pool.h>
+#include <sys/queue.h>
+#include <sys/vfs.h>
+#include <sys/vnode.h>
+#include <stdio.h>
+
+/*
+ * Name cache.
+ *
+ * Each entry maps a (directory vnode, component name) pair to the vnode that
+ * VOP_LOOKUP returned for it, or to nothing if the name does not exist.
+ * Entries are kept in a hash table and on a LRU list that bounds their number.
+ *
+ * Entries do not hold references. Instead every vnode keeps lists of entries
+ * it is referred from, which are purged by `vnode_drop` just before the vnode
+ * is reclaimed. A positive hit therefore only succeeds if the vnode is still
+ * in use by someone else.
+ *
+ * Each invalidation bumps cache generation. A lookup that missed the cache
+ * records the generation and its result is not entered if the generation has
+ * changed in the meantime, so a slow VOP_LOOKUP cannot resurrect a stale name.
+ */
+
+#define NC_NAMELEN_MAX 31 /* longer names are not cached */
+#define NC_NBUCKETS 256   /* must be a power of 2 */
+#define NC_MAXENTRIES 1024
+
+typedef struct ncentry {
+  LIST_ENTRY(ncentry) nc_hash; /* entry on hash bucket list */
+  TAILQ_ENTRY(ncentry) nc_lru; /* entry on LRU list */
+  LIST_ENTRY(ncentry) nc_src;  /* entry on nc_dvp->v_ncsrc list */
+  LIST_ENTRY(ncentry) nc_dst;  /* entry on nc_vp->v_ncdst list */
+  vnode_t *nc_dvp;             /* directory the name was looked up in */
+  vnode_t *nc_vp;              /* vnode found or NULL for negative entry */
+  uint32_t nc_hashval;
+  uint8_t nc_namelen;
+  char nc_name[NC_NAMELEN_MAX];
+} ncentry_t;
+
+typedef LIST_HEAD(, ncentry) ncbucket_t;
+
+static POOL_DEFINE(P_NCENTRY, "namecache", sizeof(ncentry_t));
+
+static MTX_DEFINE(nc_lock, 0);
+static ncbucket_t nc_hashtbl[NC_NBUCKETS];
+static TAILQ_HEAD(, ncentry) nc_lru = TAILQ_HEAD_INITIALIZER(nc_lru);
+static unsigned nc_gen;
+static nchstats_t nc_stats;
+
+static uint32_t nc_hash(vnode_t *dv, const componentname_t *cn) {
+  uint32_t h = hash32_buf(&dv, sizeof(dv), HASH32_BUF_INIT);
+  return hash32_buf(cn->cn_nameptr, cn->cn_namelen, h);
+}
+
+static ncentry_t *nc_find(vnode_t *dv, const componentname_t *cn,
+                          uint32_t h) {
+  assert(mtx_owned(&nc_lock));
+
+  ncentry_t *nc;
+  LIST_FOREACH (nc, &nc_hashtbl[h & (NC_NBUCKETS - 1)], nc_hash) {
+    if (nc->nc_hashval == h && nc->nc_dvp == dv &&
+        nc->nc_namelen == cn->cn_namelen &&
+        !memcmp(nc->nc_name, cn->cn_nameptr, cn->cn_namelen))
+      return nc;
+  }
+  return NULL;
+}
+
+static void nc_free(ncentry_t *nc) {
+  assert(mtx_owned(&nc_lock));
+
+  LIST_REMOVE(nc, nc_hash);
+  TAILQ_REMOVE(&nc_lru, nc, nc_lru);
+  LIST_REMOVE(nc, nc_src);
+  if (nc->nc_vp)
+    LIST_REMOVE(nc, nc_dst);
+  nc_stats.ncs_entries--;
+  pool_free(P_NCENTRY, nc);
+}
+
+bool vfs_cache_lookup(vnode_t *dv, const componentname_t *cn, vnode_t **vp_p,
+                      unsigned *gen_p) {
+  uint32_t h = nc_hash(dv, cn);
+
+  SCOPED_MTX_LOCK(&nc_lock);
+
+  ncentry_t *nc = nc_find(dv, cn, h);
+  if (nc == NULL || (nc->nc_vp && !vnode_tryhold(nc->nc_vp))) {
+    nc_stats.ncs_misses++;
+    *gen_p = nc_gen;
+    return false;
+  }
+
+  TAILQ_REMOVE(&nc_lru, nc, nc_lru);
+  TAILQ_INSERT_TAIL(&nc_lru, nc, nc_lru);
+
+  if (nc->nc_vp)
+    nc_stats.ncs_hits++;
+  else
+    nc_stats.ncs_neghits++;
+  *vp_p = nc->nc_vp;
+  return true;
+}
+
+void vfs_cache_enter(vnode_t *dv, const componentname_t *cn, vnode_t *vp,
+                     unsigned gen) {
+  if (cn->cn_namelen > NC_NAMELEN_MAX)
+    return;
+
+  uint32_t h = nc_hash(dv, cn);
+  ncentry_t *nc = pool_alloc(P_NCENTRY, M_ZERO);
+  nc->nc_dvp = dv;
+  nc->nc_vp = vp;
+  nc->nc_hashval = h;
+  nc->nc_namelen = cn->cn_namelen;
+  memcpy(nc->nc_name, cn->cn_nameptr, cn->cn_namelen);
+
+  SCOPED_MTX_LOCK(&nc_lock);
+
+  if (gen != nc_gen || nc_find(dv, cn, h)) {
+    pool_free(P_NCENTRY, nc);
+    return;
+  }
+
+  if (nc_stats.ncs_entries >= NC_MAXENTRIES)
+    nc_free(TAILQ_FIRST(&nc_lru));
+
+  LIST_INSERT_HEAD(&nc_hashtbl[h & (NC_NBUCKETS - 1)], nc, nc_hash);
+  TAILQ_INSERT_TAIL(&nc_lru, nc, nc_lru);
+  LIST_INSERT_HEAD(&dv->v_ncsrc, nc, nc_src);
+  if (vp)
+    LIST_INSERT_HEAD(&vp->v_ncdst, nc, nc_dst);
+  nc_stats.ncs_entries++;
+}
+
+void vfs_cache_remove(vnode_t *dv, const componentname_t *cn) {
+  uint32_t h = nc_hash(dv, cn);
+
+  SCOPED_MTX_LOCK(&nc_lock);
+
+  nc_gen++;
+
+  ncentry_t *nc = nc_find(dv, cn, h);
+  if (nc)
+    nc_free(nc);
+}
+
+void vfs_cache_purge(vnode_t *v) {
+  SCOPED_MTX_LOCK(&nc_lock);
+
+  nc_gen++;
+
+  ncentry_t *nc;
+  while ((nc = LIST_FIRST(&v->v_ncsrc)))
+    nc_free(nc);
+  while ((nc = LIST_FIRST(&v->v_ncdst)))
+    nc_free(nc);
+}
+
+void vfs_cache_stats(nchstats_t *ncs) {
+  SCOPED_MTX_LOCK(&nc_lock);
+  *ncs = nc_stats;
+}
+
+/*
+ * /dev/namecache reports name cache statistics as text, e.g.:
+ * hits 120 neghits 7 misses 35 entries 42
+ */
+
+static int dev_namecache_read(vnode_t *v, uio_t *uio) {
+  nchstats_t ncs;
+  char buf[64];
+
+  vfs_cache_stats(&ncs);
+  int len = snprintf(buf, sizeof(buf), "hits %u neghits %u misses %u "
+                     "entries %u\n", ncs.ncs_hits, ncs.ncs_neghits,
+                     ncs.ncs_misses, ncs.ncs_entries);
+  return uiomove_frombuf(buf, min((size_t)len, sizeof(buf) - 1), uio);
+}
+
+static vnodeops_t dev_namecache_vnodeops = {.v_read = dev_namecache_read};
+
+static void init_dev_namecache(void) {
+  devfs_makedev(NULL, "namecache", &dev_namecache_vnodeops, NULL, NULL);
+}
+
+SET_ENTRY(devfs_init, init_dev_namecache);
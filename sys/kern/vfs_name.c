@@ -57,6 +57,16 @@ static int vs_prepend(vnrstate_t *vs, const char *buf, size_t len) {
   return 0;
 }
 
+/* Plain lookup does not modify any directory and returns unlocked vnode,
+ * so it locks vnodes on its way in shared mode. Thus concurrent lookups of
+ * paths with common prefix do not wait for each other. */
+static void vnr_lock(vnrstate_t *vs, vnode_t *v) {
+  if (vs->vs_op == VNR_LOOKUP)
+    vnode_lock_shared(v);
+  else
+    vnode_lock(v);
+}
+
 /*
  * vnr_symlink_follow: follow a symlink. We prepend content of the symlink to
  * the remaining path. Note that we store pointer to the next path component, so
@@ -89,7 +99,8 @@ static int vnr_symlink_follow(vnrstate_t *vs, vnode_t **searchdir_p,
   if (vs->vs_nextcn[0] == '/') {
     vnode_put(searchdir);
     searchdir = vfs_root_vnode;
-    vnode_get(searchdir);
+    vnode_hold(searchdir);
+    vnr_lock(vs, searchdir);
     vfs_maybe_descend(&searchdir);
     vs_dropslashes(vs);
   }
@@ -124,7 +135,20 @@ static int vnr_lookup_once(vnrstate_t *vs, vnode_t **searchdir_p,
   if ((error = can_lookup(searchdir, cred)))
     return error;
 
-  if ((error = VOP_LOOKUP(searchdir, cn, &foundvn))) {
+  /* Names "." and ".." are resolved by file system, never cache them. */
+  bool cacheable =
+    !componentname_equal(cn, ".") && !componentname_equal(cn, "..");
+  unsigned gen = 0;
+
+  if (cacheable && vfs_cache_lookup(searchdir, cn, &foundvn, &gen)) {
+    error = foundvn ? 0 : ENOENT;
+  } else {
+    error = VOP_LOOKUP(searchdir, cn, &foundvn);
+    if (cacheable && (error == 0 || error == ENOENT))
+      vfs_cache_enter(searchdir, cn, error ? NULL : foundvn, gen);
+  }
+
+  if (error) {
     /*
      * The entry was not found in the directory. This is valid if we are
      * creating an entry and are working on the last component of the path name.
@@ -137,9 +161,10 @@ static int vnr_lookup_once(vnrstate_t *vs, vnode_t **searchdir_p,
     return error;
   }
 
-  /* No need to ref foundvn vnode, VOP_LOOKUP already did it for us. */
+  /* No need to ref foundvn vnode, VOP_LOOKUP or name cache already did it for
+   * us. */
   if (searchdir != foundvn)
-    vnode_lock(foundvn);
+    vnr_lock(vs, foundvn);
 
   if (is_mountpoint(foundvn)) {
     bool relock_searchdir = (searchdir == foundvn);
@@ -148,7 +173,7 @@ static int vnr_lookup_once(vnrstate_t *vs, vnode_t **searchdir_p,
     /* Searchdir needs to be re-locked since it might be released in
      * vfs_maybe_descend */
     if (relock_searchdir)
-      vnode_lock(searchdir);
+      vnr_lock(vs, searchdir);
   }
 
   *foundvn_p = foundvn;
@@ -206,7 +231,8 @@ static int do_nameresolve(vnrstate_t *vs) {
   if (searchdir->v_type != V_DIR)
     return ENOTDIR;
 
-  vnode_get(searchdir);
+  vnode_hold(searchdir);
+  vnr_lock(vs, searchdir);
   if ((error = vfs_maybe_descend(&searchdir)))
     return error;
 
@@ -12,6 +12,7 @@
 #include <sys/libkern.h>
 #include <sys/statvfs.h>
 #include <sys/cred.h>
+#include <sys/vm_pager.h>
 
 static int vfs_nameresolveat(proc_t *p, int fdat, vnrstate_t *vs) {
   file_t *f;
@@ -48,7 +49,14 @@ static int vfs_truncate(vnode_t *v, size_t len, cred_t *cred) {
   vattr_t va;
   vattr_null(&va);
   va.va_size = len;
-  return VOP_SETATTR(v, &va, cred);
+  /* Last page is discarded, but its part that remains in the file may have
+   * been modified through a shared mapping. */
+  if (!page_aligned_p(len) && v->v_object)
+    vnode_pager_flush(v);
+  int error = VOP_SETATTR(v, &va, cred);
+  if (!error)
+    vnode_pager_invalidate(v, len, (size_t)-1);
+  return error;
 }
 
 /* This function cleans O_CREAT in flags when file is not being created. */
@@ -80,6 +88,7 @@ static int vfs_create(proc_t *p, int fdat, char *pathname, int *flags, int mode,
     va.va_uid = p->p_cred.cr_euid;
     va.va_gid = dva.va_mode & S_ISGID ? dva.va_gid : p->p_cred.cr_egid;
     error = VOP_CREATE(vs.vs_dvp, &vs.vs_lastcn, &va, &vs.vs_vp);
+    vfs_cache_remove(vs.vs_dvp, &vs.vs_lastcn);
     vnode_put(vs.vs_dvp);
   } else {
     if (vs.vs_vp == vs.vs_dvp)
@@ -273,6 +282,8 @@ int do_unlinkat(proc_t *p, int fd, char *path, int flag) {
       error = EPERM;
     else if (!(error = vfs_check_remove(vs.vs_dvp, vs.vs_vp, &p->p_cred)))
       error = VOP_RMDIR(vs.vs_dvp, vs.vs_vp, &vs.vs_lastcn);
+    if (!error)
+      vfs_cache_purge(vs.vs_vp);
   } else {
     if (flag & AT_REMOVEDIR)
       error = ENOTDIR;
@@ -280,6 +291,9 @@ int do_unlinkat(proc_t *p, int fd, char *path, int flag) {
       error = VOP_REMOVE(vs.vs_dvp, vs.vs_vp, &vs.vs_lastcn);
   }
 
+  if (!error)
+    vfs_cache_remove(vs.vs_dvp, &vs.vs_lastcn);
+
   vnode_put_both(vs.vs_vp, vs.vs_dvp);
 
 fail:
@@ -329,6 +343,7 @@ int do_mkdirat(proc_t *p, int fd, char *path, mode_t mode) {
   }
 
   error = VOP_MKDIR(vs.vs_dvp, &vs.vs_lastcn, &va, &vs.vs_vp);
+  vfs_cache_remove(vs.vs_dvp, &vs.vs_lastcn);
   if (!error)
     vnode_drop(vs.vs_vp);
 
@@ -533,6 +548,7 @@ int do_symlinkat(proc_t *p, char *target, int newdirfd, char *linkpath) {
   va.va_gid = p->p_cred.cr_rgid;
 
   error = VOP_SYMLINK(vs.vs_dvp, &vs.vs_lastcn, &va, target, &vs.vs_vp);
+  vfs_cache_remove(vs.vs_dvp, &vs.vs_lastcn);
   if (!error)
     vnode_drop(vs.vs_vp);
   vnode_put(vs.vs_dvp);
@@ -579,6 +595,7 @@ int do_linkat(proc_t *p, int fd, char *path, int linkfd, char *linkpath,
     error = EXDEV;
   else
     error = VOP_LINK(vs.vs_dvp, target_vn, &vs.vs_lastcn);
+  vfs_cache_remove(vs.vs_dvp, &vs.vs_lastcn);
 
   vnode_put(vs.vs_dvp);
 
@@ -12,11 +12,11 @@
 #include <sys/spinlock.h>
 #include <sys/condvar.h>
 #include <sys/cred.h>
+#include <sys/thread.h>
+#include <sys/vm_pager.h>
 
 static POOL_DEFINE(P_VNODE, "vnode", sizeof(vnode_t));
 
-static void vnlock_init(vnlock_t *vl);
-
 /* Actually, vnode management should be much more complex than this, because
    this stub does not recycle vnodes, does not store them on a free list,
    etc. So at some point we may need a more sophisticated memory management here
@@ -28,43 +28,46 @@ vnode_t *vnode_new(vnodetype_t type, vnodeops_t *ops, void *data) {
   v->v_data = data;
   v->v_ops = ops;
   v->v_usecnt = 1;
-  vnlock_init(&v->v_lock);
+  sx_init(&v->v_lock, 0);
   return v;
 }
 
-/* XXX vnodes used to use a mutex for synchronizing file operations,
- * but sometimes we need to sleep, e.g. in VOP_READ.
- * This solves the problem, but should be replaced by a proper lock
- * that allows sleeping. */
+/* Vnode lock has to allow sleeping, e.g. in VOP_READ. */
 
-static void vnlock_init(vnlock_t *vl) {
-  spin_init(&vl->vl_interlock, 0);
-  cv_init(&vl->vl_cv, "vnode sleep cv");
+void vnode_lock(vnode_t *v) {
+  sx_xlock(&v->v_lock);
 }
 
-void vnode_lock(vnode_t *v) {
-  vnlock_t *vl = &v->v_lock;
-  WITH_SPIN_LOCK (&vl->vl_interlock) {
-    while (vl->vl_locked)
-      cv_wait(&vl->vl_cv, &vl->vl_interlock);
-    vl->vl_locked = true;
-  }
+void vnode_lock_shared(vnode_t *v) {
+  sx_slock(&v->v_lock);
 }
 
 void vnode_unlock(vnode_t *v) {
-  vnlock_t *vl = &v->v_lock;
-  WITH_SPIN_LOCK (&vl->vl_interlock) {
-    vl->vl_locked = false;
-    cv_signal(&vl->vl_cv);
-  }
+  sx_unlock(&v->v_lock);
+}
+
+bool vnode_xlocked(vnode_t *v) {
+  return sx_xlocked(&v->v_lock);
 }
 
 void vnode_hold(vnode_t *v) {
   refcnt_acquire(&v->v_usecnt);
 }
 
+bool vnode_tryhold(vnode_t *v) {
+  unsigned cnt = atomic_load(&v->v_usecnt);
+  do {
+    if (cnt == 0)
+      return false;
+  } while (!atomic_compare_exchange_weak(&v->v_usecnt, &cnt, cnt + 1));
+  return true;
+}
+
 void vnode_drop(vnode_t *v) {
   if (refcnt_release(&v->v_usecnt)) {
+    /* Nobody can add name cache entries for an unreferenced vnode, but
+     * the lists may only be inspected with the name cache lock held. */
+    vfs_cache_purge(v);
     VOP_RECLAIM(v);
     pool_free(P_VNODE, v);
   }
@@ -179,11 +182,12 @@ void vattr_null(vattr_t *va) {
   va->va_atime.tv_nsec = va->va_mtime.tv_nsec = va->va_ctime.tv_nsec = VNOVAL;
 }
 
-/* Default file operations using v-nodes. */
-int default_vnread(file_t *f, uio_t *uio) {
+static int vnode_read(file_t *f, uio_t *uio) {
   vnode_t *v = f->f_vnode;
   int error = 0;
   vnode_lock(v);
+  if (v->v_object)
+    vnode_pager_flush(v);
   uio->uio_offset = f->f_offset;
   error = VOP_READ(f->f_vnode, uio);
   f->f_offset = uio->uio_offset;
@@ -191,17 +195,66 @@ int default_vnread(file_t *f, uio_t *uio) {
   return error;
 }
 
-int default_vnwrite(file_t *f, uio_t *uio) {
+static int vnode_write(file_t *f, uio_t *uio) {
   vnode_t *v = f->f_vnode;
   int error = 0;
   vnode_lock(v);
+  /* Modified pages in written range are about to be discarded. */
+  if (v->v_object)
+    vnode_pager_flush(v);
   uio->uio_offset = f->f_offset;
+  size_t resid = uio->uio_resid;
   error = VOP_WRITE(f->f_vnode, uio);
+  if (v->v_object) {
+    size_t len = resid - uio->uio_resid;
+    vnode_pager_invalidate(v, uio->uio_offset - len, len);
+  }
   f->f_offset = uio->uio_offset;
   vnode_unlock(v);
   return error;
 }
 
+/* Performs I/O on a file with page-ins disabled, since the user buffer may be
+ * a file mapping, whose pager needs a vnode lock. If the transfer stops on
+ * such a page, it gets faulted in with no locks held and the rest of the
+ * transfer is retried. */
+static int vnode_rdwr(file_t *f, uio_t *uio,
+                      int (*rdwr)(file_t *f, uio_t *uio)) {
+  thread_t *td = thread_self();
+
+  for (;;) {
+    td->td_pflags |= TDP_NOPAGEIN;
+    int error = rdwr(f, uio);
+    tdp_flags_t pflags = td->td_pflags;
+    td->td_pflags &= ~(TDP_NOPAGEIN | TDP_PAGEINFAILED);
+
+    if (error != EFAULT || !(pflags & TDP_PAGEINFAILED))
+      return error;
+    if ((error = uio_prefault(uio)))
+      return error;
+    /* The file offset points to where the transfer stopped. */
+    uio->uio_ioflags &= ~IO_APPEND;
+  }
+}
+
+/* Default file operations using v-nodes. */
+int default_vnread(file_t *f, uio_t *uio) {
+  return vnode_rdwr(f, uio, vnode_read);
+}
+
+int default_vnwrite(file_t *f, uio_t *uio) {
+  return vnode_rdwr(f, uio, vnode_write);
+}
+
+int default_vnmmap(file_t *f, off_t offset, size_t length, vm_prot_t prot,
+                   vm_object_t **obj_p) {
+  vnode_t *v = f->f_vnode;
+  if (v->v_type != V_REG)
+    return ENODEV;
+  *obj_p = vnode_pager_object(v);
+  return 0;
+}
+
 int default_vnclose(file_t *f) {
   (void)VOP_CLOSE(f->f_vnode, f);
   vnode_drop(f->f_vnode);
@@ -297,6 +350,7 @@ static fileops_t default_vnode_fileops = {
   .fo_seek = default_vnseek,
   .fo_stat = default_vnstat,
   .fo_ioctl = default_vnioctl,
+  .fo_mmap = default_vnmmap,
 };
 
 int vnode_open_generic(vnode_t *v, int mode, file_t *fp) {
@@ -7,10 +7,12 @@
 #include <sys/vm_pager.h>
 #include <sys/vm_object.h>
 #include <sys/vm_map.h>
+#include <sys/vm_physmem.h>
 #include <sys/errno.h>
 #include <sys/proc.h>
 #include <sys/sched.h>
 #include <sys/pcpu.h>
+#include <sys/ktrace.h>
 #include <machine/vm_param.h>
 
 struct vm_map_entry {
@@ -18,6 +20,7 @@ struct vm_map_entry {
   vm_object_t *object;
   vaddr_t offset; /* offset in object */
   vm_prot_t prot;
+  vm_prot_t max_prot; /* prot can never exceed it */
   vm_entry_flags_t flags;
   vaddr_t start;
   vaddr_t end;
@@ -27,7 +30,16 @@ struct vm_map {
   TAILQ_HEAD(vm_map_list, vm_map_entry) entries;
   size_t nentries;
   pmap_t *pmap;
-  mtx_t mtx; /* Mutex guarding vm_map structure and all its entries. */
+  /* Lock guarding vm_map structure and all its entries. Page faults only
+   * read the map, so they take the lock shared and may run in parallel. */
+  rwlock_t lock;
+  /* Entries destroyed with the lock held. Dropping their objects may write
+   * back dirty file pages, which needs the vnode lock, hence it's deferred
+   * until the map gets unlocked. */
+  struct vm_map_list dead_entries;
+  unsigned fault_around;   /* size of fault-around window in pages */
+  atomic_uint nfaults;     /* number of page faults handled */
+  atomic_uint nprefaulted; /* number of pages mapped by fault-around */
 };
 
 static POOL_DEFINE(P_VM_MAP, "vm_map", sizeof(vm_map_t));
@@ -35,6 +47,8 @@ static POOL_DEFINE(P_VM_MAPENT, "vm_map_entry", sizeof(vm_map_entry_t));
 
 static vm_map_t *kspace = &(vm_map_t){};
 
+atomic_uint vm_cow_copies = 0;
+
 void vm_map_activate(vm_map_t *map) {
   SCOPED_NO_PREEMPTION();
 
@@ -49,11 +63,33 @@ void vm_map_switch(thread_t *td) {
 }
 
 void vm_map_lock(vm_map_t *map) {
-  mtx_lock(&map->mtx);
+  rw_wlock(&map->lock);
+}
+
+void vm_map_lock_read(vm_map_t *map) {
+  rw_rlock(&map->lock);
+}
+
+static void vm_map_entry_free(vm_map_entry_t *ent) {
+  if (ent->object)
+    vm_object_drop(ent->object);
+  pool_free(P_VM_MAPENT, ent);
 }
 
 void vm_map_unlock(vm_map_t *map) {
-  mtx_unlock(&map->mtx);
+  struct vm_map_list dead = TAILQ_HEAD_INITIALIZER(dead);
+
+  /* Only the writer could have destroyed some entries. */
+  if (rw_wowned(&map->lock))
+    TAILQ_CONCAT(&dead, &map->dead_entries, link);
+
+  rw_unlock(&map->lock);
+
+  vm_map_entry_t *ent;
+  while ((ent = TAILQ_FIRST(&dead))) {
+    TAILQ_REMOVE(&dead, ent, link);
+    vm_map_entry_free(ent);
+  }
 }
 
 vm_map_t *vm_map_user(void) {
@@ -102,7 +138,8 @@ vm_map_t *vm_map_lookup(vaddr_t addr) {
 
 static void vm_map_setup(vm_map_t *map) {
   TAILQ_INIT(&map->entries);
-  mtx_init(&map->mtx, 0);
+  TAILQ_INIT(&map->dead_entries);
+  rw_init(&map->lock, 0);
 }
 
 void init_vm_map(void) {
@@ -115,6 +152,7 @@ vm_map_t *vm_map_new(void) {
   vm_map_t *map = pool_alloc(P_VM_MAP, M_ZERO);
   vm_map_setup(map);
   map->pmap = pmap_new();
+  map->fault_around = VM_FAULT_AROUND;
   return map;
 }
 
@@ -128,18 +166,30 @@ vm_map_entry_t *vm_map_entry_alloc(vm_object_t *obj, vaddr_t start, vaddr_t end,
   ent->start = start;
   ent->end = end;
   ent->prot = prot;
+  ent->max_prot = VM_PROT_MASK;
   ent->flags = flags;
   return ent;
 }
 
-static void vm_map_entry_free(vm_map_entry_t *ent) {
-  if (ent->object)
-    vm_object_drop(ent->object);
-  pool_free(P_VM_MAPENT, ent);
+void vm_map_set_fault_around(vm_map_t *map, unsigned npages) {
+  assert(npages == 0 || powerof2(npages));
+  SCOPED_VM_MAP_LOCK(map);
+  map->fault_around = npages;
+}
+
+void vm_map_fault_stats(vm_map_t *map, unsigned *faults_p,
+                        unsigned *prefaulted_p) {
+  *faults_p = atomic_load(&map->nfaults);
+  *prefaulted_p = atomic_load(&map->nprefaulted);
+}
+
+void vm_map_entry_set_offset(vm_map_entry_t *ent, vm_offset_t offset) {
+  assert(page_aligned_p(offset));
+  ent->offset = offset;
 }
 
 vm_map_entry_t *vm_map_find_entry(vm_map_t *map, vaddr_t vaddr) {
-  assert(mtx_owned(&map->mtx));
+  assert(rw_locked(&map->lock));
 
   vm_map_entry_t *it;
   TAILQ_FOREACH (it, &map->entries, link)
@@ -148,9 +198,48 @@ vm_map_entry_t *vm_map_find_entry(vm_map_t *map, vaddr_t vaddr) {
   return NULL;
 }
 
+int vm_map_shared_object(vm_map_t *map, vaddr_t vaddr, vm_object_t **obj_p,
+                         vm_offset_t *offset_p) {
+  SCOPED_VM_MAP_LOCK_READ(map);
+
+  vm_map_entry_t *ent = vm_map_find_entry(map, vaddr);
+  if (ent == NULL)
+    return EFAULT;
+
+  *obj_p = NULL;
+
+  /* Private entries get new shadow objects on fork, so their objects do not
+   * identify the memory for good. */
+  if (ent->flags & VM_ENT_SHARED) {
+    vm_object_hold(ent->object);
+    *obj_p = ent->object;
+    *offset_p = ent->offset + (vaddr - ent->start);
+  }
+
+  return 0;
+}
+
+bool vm_map_anonymous_p(vm_map_t *map, vaddr_t start, vaddr_t end) {
+  SCOPED_VM_MAP_LOCK_READ(map);
+
+  for (vaddr_t va = start; va < end;) {
+    vm_map_entry_t *ent = vm_map_find_entry(map, va);
+    if (ent == NULL)
+      return false;
+    /* Private file mappings refer to pages of the file until they're
+     * written to, so it's the bottom object that matters. */
+    vm_object_t *obj = vm_object_bottom(ent->object);
+    if (obj->vo_pager->pgr_type != VM_ANONYMOUS)
+      return false;
+    va = ent->end;
+  }
+
+  return true;
+}
+
 static void vm_map_insert_after(vm_map_t *map, vm_map_entry_t *after,
                                 vm_map_entry_t *ent) {
-  assert(mtx_owned(&map->mtx));
+  assert(rw_wowned(&map->lock));
   if (after)
     TAILQ_INSERT_AFTER(&map->entries, after, ent, link);
   else
@@ -159,11 +248,11 @@ static void vm_map_insert_after(vm_map_t *map, vm_map_entry_t *after,
 }
 
 void vm_map_entry_destroy(vm_map_t *map, vm_map_entry_t *ent) {
-  assert(mtx_owned(&map->mtx));
+  assert(rw_wowned(&map->lock));
 
   TAILQ_REMOVE(&map->entries, ent, link);
   map->nentries--;
-  vm_map_entry_free(ent);
+  TAILQ_INSERT_TAIL(&map->dead_entries, ent, link);
 }
 
 static inline vm_map_entry_t *vm_map_entry_copy(vm_map_entry_t *src) {
@@ -171,6 +260,7 @@ static inline vm_map_entry_t *vm_map_entry_copy(vm_map_entry_t *src) {
     vm_object_hold(src->object);
   vm_map_entry_t *new = vm_map_entry_alloc(src->object, src->start, src->end,
                                            src->prot, src->flags);
+  new->max_prot = src->max_prot;
   return new;
 }
 
@@ -180,7 +270,7 @@ static inline vm_map_entry_t *vm_map_entry_copy(vm_map_entry_t *src) {
  * Returns entry which is after base entry. */
 static vm_map_entry_t *vm_map_entry_split(vm_map_t *map, vm_map_entry_t *ent,
                                           vaddr_t splitat) {
-  assert(mtx_owned(&map->mtx));
+  assert(rw_wowned(&map->lock));
   assert(page_aligned_p(splitat));
   assert(ent->start < splitat && splitat < ent->end);
 
@@ -197,7 +287,7 @@ static vm_map_entry_t *vm_map_entry_split(vm_map_t *map, vm_map_entry_t *ent,
 
 void vm_map_entry_destroy_range(vm_map_t *map, vm_map_entry_t *ent,
                                 vaddr_t start, vaddr_t end) {
-  assert(mtx_owned(&map->mtx));
+  assert(rw_wowned(&map->lock));
   assert(start >= ent->start && end <= ent->end);
 
   pmap_remove(map->pmap, start, end);
@@ -218,7 +308,7 @@ void vm_map_entry_destroy_range(vm_map_t *map, vm_map_entry_t *ent,
 
 void vm_map_delete(vm_map_t *map) {
   pmap_delete(map->pmap);
-  WITH_MTX_LOCK (&map->mtx) {
+  WITH_VM_MAP_LOCK (map) {
     vm_map_entry_t *ent, *next;
     TAILQ_FOREACH_SAFE (ent, &map->entries, link, next)
       vm_map_entry_destroy(map, ent);
@@ -226,8 +316,43 @@ void vm_map_delete(vm_map_t *map) {
   pool_free(P_VM_MAP, map);
 }
 
-/* TODO: not implemented */
-void vm_map_protect(vm_map_t *map, vaddr_t start, vaddr_t end, vm_prot_t prot) {
+int vm_map_protect(vm_map_t *map, vaddr_t start, vaddr_t end, vm_prot_t prot) {
+  assert(page_aligned_p(start) && page_aligned_p(end) && start < end);
+
+  SCOPED_VM_MAP_LOCK(map);
+
+  vm_map_entry_t *first = vm_map_find_entry(map, start);
+  if (first == NULL)
+    return ENOMEM;
+
+  /* Check the whole range before anything gets changed. */
+  vm_map_entry_t *ent = first;
+  for (vaddr_t addr = first->start; addr < end; ent = vm_map_entry_next(ent)) {
+    if (ent == NULL || ent->start != addr)
+      return ENOMEM;
+    if (prot & ~ent->max_prot)
+      return EACCES;
+    addr = ent->end;
+  }
+
+  ent = first;
+  if (ent->start < start)
+    ent = vm_map_entry_split(map, ent, start);
+
+  for (; ent != NULL && ent->start < end; ent = vm_map_entry_next(ent)) {
+    if (ent->end > end)
+      vm_map_entry_split(map, ent, end);
+
+    /* Pages are never mapped with more permissions than the entry has, but
+     * some have fewer of them (e.g. copy-on-write), so it's only safe to take
+     * permissions away. Page faults will grant the new ones on demand. */
+    if (ent->prot & ~prot)
+      pmap_protect(map->pmap, ent->start, ent->end, prot);
+
+    ent->prot = prot;
+  }
+
+  return 0;
 }
 
 static int vm_map_findspace_nolock(vm_map_t *map, vaddr_t /*inout*/ *start_p,
@@ -281,12 +406,12 @@ found:
 }
 
 int vm_map_findspace(vm_map_t *map, vaddr_t *start_p, size_t length) {
-  SCOPED_MTX_LOCK(&map->mtx);
+  SCOPED_VM_MAP_LOCK_READ(map);
   return vm_map_findspace_nolock(map, start_p, length, NULL);
 }
 
 int vm_map_insert(vm_map_t *map, vm_map_entry_t *ent, vm_flags_t flags) {
-  SCOPED_MTX_LOCK(&map->mtx);
+  SCOPED_VM_MAP_LOCK(map);
   vm_map_entry_t *after;
   vaddr_t start = ent->start;
   size_t length = ent->end - ent->start;
@@ -310,27 +435,36 @@ int vm_map_insert(vm_map_t *map, vm_map_entry_t *ent, vm_flags_t flags) {
   return 0;
 }
 
-int vm_map_alloc_entry(vm_map_t *map, vaddr_t addr, size_t length,
-                       vm_prot_t prot, vm_flags_t flags,
+int vm_map_alloc_entry(vm_map_t *map, vm_object_t *obj, vm_offset_t offset,
+                       vaddr_t addr, size_t length, vm_prot_t prot,
+                       vm_prot_t max_prot, vm_flags_t flags,
                        vm_map_entry_t **ent_p) {
-  if (!(flags & VM_ANON)) {
-    klog("Only anonymous memory mappings are supported!");
-    return ENOTSUP;
-  }
-
-  if (!page_aligned_p(addr))
-    return EINVAL;
+  assert(obj != NULL || (flags & VM_ANON));
+  assert((prot & ~max_prot) == 0);
 
-  if (length == 0)
-    return EINVAL;
+  int error = 0;
 
-  if (addr != 0 && !vm_map_contains_p(map, addr, addr + length))
-    return EINVAL;
+  if (!page_aligned_p(addr))
+    error = EINVAL;
+  else if (length == 0)
+    error = EINVAL;
+  else if (addr != 0 && !vm_map_contains_p(map, addr, addr + length))
+    error = EINVAL;
+
+  if (error) {
+    if (obj)
+      vm_object_drop(obj);
+    return error;
+  }
 
   /* Create object with a pager that supplies cleared pages on page fault. */
-  vm_object_t *obj = vm_object_alloc(VM_ANONYMOUS);
+  if (obj == NULL)
+    obj = vm_object_alloc(VM_ANONYMOUS);
+
   vm_map_entry_t *ent =
     vm_map_entry_alloc(obj, addr, addr + length, prot, VM_ENT_SHARED);
+  vm_map_entry_set_offset(ent, offset);
+  ent->max_prot = max_prot;
 
   /* Given the hint try to insert the entry at given position or after it. */
   if (vm_map_insert(map, ent, flags)) {
@@ -345,7 +479,7 @@ int vm_map_alloc_entry(vm_map_t *map, vaddr_t addr, size_t length,
 int vm_map_entry_resize(vm_map_t *map, vm_map_entry_t *ent, vaddr_t new_end) {
   assert(page_aligned_p(new_end));
   assert(new_end >= ent->start);
-  SCOPED_MTX_LOCK(&map->mtx);
+  SCOPED_VM_MAP_LOCK(map);
 
   if (new_end >= ent->end) {
     /* Expanding entry */
@@ -353,6 +487,11 @@ int vm_map_entry_resize(vm_map_t *map, vm_map_entry_t *ent, vaddr_t new_end) {
     vaddr_t gap_end = next ? next->start : vm_map_end(map);
     if (new_end > gap_end)
       return ENOMEM;
+    /* Pages removed by an earlier shrink may still be present in backing
+     * objects. They must not reappear in the regrown range. */
+    if (ent->object->vo_backing)
+      vm_object_cover_backing(ent->object, ent->end - ent->start,
+                              new_end - ent->end);
   } else {
     /* Shrinking entry */
     off_t offset = new_end - ent->start;
@@ -371,7 +510,7 @@ int vm_map_entry_resize(vm_map_t *map, vm_map_entry_t *ent, vaddr_t new_end) {
 }
 
 void vm_map_dump(vm_map_t *map) {
-  SCOPED_MTX_LOCK(&map->mtx);
+  SCOPED_VM_MAP_LOCK_READ(map);
 
   klog("Virtual memory map (%08lx - %08lx):", vm_map_start(map),
        vm_map_end(map));
@@ -384,6 +523,9 @@ void vm_map_dump(vm_map_t *map) {
          (it->prot & VM_PROT_EXEC) ? 'x' : '-');
     vm_object_dump(it->object);
   }
+
+  klog("Page faults: %u, pages mapped by fault-around: %u",
+       atomic_load(&map->nfaults), atomic_load(&map->nprefaulted));
 }
 
 vm_map_t *vm_map_clone(vm_map_t *map) {
@@ -391,8 +533,9 @@ vm_map_t *vm_map_clone(vm_map_t *map) {
   assert(td->td_proc);
 
   vm_map_t *new_map = vm_map_new();
+  new_map->fault_around = map->fault_around;
 
-  WITH_MTX_LOCK (&map->mtx) {
+  WITH_VM_MAP_LOCK (map) {
     vm_map_entry_t *it;
     TAILQ_FOREACH (it, &map->entries, link) {
       vm_object_t *obj;
@@ -402,12 +545,22 @@ vm_map_t *vm_map_clone(vm_map_t *map) {
         vm_object_hold(it->object);
         obj = it->object;
       } else {
-        /* vm_object_clone will clone the data from the vm_object_t
-         * and will return the new object with ref_counter equal to one */
-        obj = vm_object_clone(it->object);
+        /* Parent and child get their own shadows of the original object,
+         * which becomes read-only. Parent's mappings are write-protected, so
+         * the first write to a page copies it into a shadow object. */
+        vm_object_t *orig = it->object;
+        vm_object_collapse(orig);
+        it->object = vm_object_shadow(orig);
+        obj = vm_object_shadow(orig);
+        vm_object_drop(orig);
+
+        if (it->prot & VM_PROT_WRITE)
+          pmap_protect(map->pmap, it->start, it->end,
+                       it->prot & ~VM_PROT_WRITE);
       }
       ent = vm_map_entry_alloc(obj, it->start, it->end, it->prot, it->flags);
       ent->offset = it->offset;
+      ent->max_prot = it->max_prot;
       TAILQ_INSERT_TAIL(&new_map->entries, ent, link);
       new_map->nentries++;
     }
@@ -416,9 +569,114 @@ vm_map_t *vm_map_clone(vm_map_t *map) {
   return new_map;
 }
 
-int vm_page_fault(vm_map_t *map, vaddr_t fault_addr, vm_prot_t fault_type) {
-  SCOPED_VM_MAP_LOCK(map);
+/* Populates whole aligned superpage around `fault_page` with physically
+ * contiguous zeroed pages, if the entry covers it and the object has no pages
+ * there yet. Once all of them are entered the pmap maps them with a single
+ * large mapping. */
+static bool vm_page_fault_superpage(vm_map_t *map, vm_map_entry_t *ent,
+                                    vaddr_t fault_page) {
+  const size_t npages = SUPERPAGESIZE / PAGESIZE;
+  vm_object_t *obj = ent->object;
+
+  /* Shadow objects have to look up pages in their backing objects first. */
+  if (obj->vo_pager->pgr_type != VM_ANONYMOUS || obj->vo_backing)
+    return false;
+
+  vaddr_t start = rounddown(fault_page, SUPERPAGESIZE);
+  if (start < ent->start || start + SUPERPAGESIZE > ent->end)
+    return false;
 
+  vm_offset_t offset = ent->offset + (start - ent->start);
+  if (vm_object_has_pages(obj, offset, SUPERPAGESIZE))
+    return false;
+
+  vm_page_t *pg = vm_page_alloc(npages);
+  if (pg == NULL)
+    return false;
+
+  vm_page_split(pg);
+  for (size_t i = 0; i < npages; i++)
+    pmap_zero_page(&pg[i]);
+
+  if (!vm_object_add_pages(obj, offset, pg, npages)) {
+    for (size_t i = 0; i < npages; i++)
+      vm_page_free(&pg[i]);
+    return false;
+  }
+
+  /* Mark pages as already accessed, otherwise they would get distinct
+   * referenced & modified bits one by one and would never be promoted. */
+  for (size_t i = 0; i < npages; i++)
+    pmap_enter(map->pmap, start + i * PAGESIZE, &pg[i], ent->prot, ent->prot);
+
+  return true;
+}
+
+/* Maps pages of `ent` around `fault_page` that fall into an aligned window of
+ * `map->fault_around` pages, so sequential access takes fewer faults. Pages
+ * that are already mapped are left intact. Only resident pages are mapped,
+ * unless `fill` is set for anonymous memory, which gets zero-filled. */
+static void vm_page_fault_around(vm_map_t *map, vm_map_entry_t *ent,
+                                 vaddr_t fault_page, vm_prot_t fault_type,
+                                 bool fill) {
+  size_t window = map->fault_around * PAGESIZE;
+  if (window <= PAGESIZE)
+    return;
+
+  vaddr_t start = rounddown(fault_page, window);
+  vaddr_t end = min(start + window, ent->end);
+  start = max(start, ent->start);
+
+  vm_object_t *obj = ent->object;
+
+  for (vaddr_t va = start; va < end; va += PAGESIZE) {
+    paddr_t pa;
+
+    /* Remapping a page would reset its referenced & modified bits. */
+    if (va == fault_page || pmap_extract(map->pmap, va, &pa))
+      continue;
+
+    vm_offset_t offset = ent->offset + (va - ent->start);
+    vm_prot_t prot = ent->prot;
+    vm_object_t *owner;
+    vm_page_t *frame = vm_object_lookup_page(obj, offset, &owner);
+    /* Resident pages are likely to be read soon, fresh zero-filled pages are
+     * likely to be accessed the same way as the faulting one. */
+    unsigned flags = VM_PROT_READ;
+
+    if (frame == NULL) {
+      if (!fill)
+        continue;
+      owner = obj;
+      frame = obj->vo_pager->pgr_fault(obj, offset);
+      flags = fault_type;
+    }
+
+    /* Pages of backing objects are mapped read-only for copy-on-write. File
+     * pages are mapped read-only until a write fault marks them dirty. */
+    if (owner != obj || owner->vo_pager->pgr_type == VM_VNODE)
+      prot &= ~VM_PROT_WRITE;
+
+    if (owner->vo_pager->pgr_type == VM_VNODE) {
+      /* Skip the page if it has been invalidated since the lookup. */
+      SCOPED_MTX_LOCK(&owner->vo_lock);
+      if (vm_object_find_page_nolock(owner, offset) != frame)
+        continue;
+      pmap_enter(map->pmap, va, frame, prot, flags);
+    } else {
+      pmap_enter(map->pmap, va, frame, prot, flags);
+    }
+
+    atomic_fetch_add_explicit(&map->nprefaulted, 1, memory_order_relaxed);
+  }
+}
+
+/* Handles page fault with the map locked. If the page has to be read in from
+ * a file, returns the object that should do it in `pagein_p`, with a reference
+ * held, and offset of the page in `offset_p`. */
+static int vm_page_fault_locked(vm_map_t *map, vaddr_t fault_addr,
+                                vm_prot_t fault_type, vm_object_t **pagein_p,
+                                vm_offset_t *offset_p) {
   vm_map_entry_t *ent = vm_map_find_entry(map, fault_addr);
 
   if (!ent) {
@@ -431,16 +689,21 @@ int vm_page_fault(vm_map_t *map, vaddr_t fault_addr, vm_prot_t fault_type) {
     return EACCES;
   }
 
-  if (!(ent->prot & VM_PROT_WRITE) && (fault_type == VM_PROT_WRITE)) {
+  if (!(ent->prot & VM_PROT_WRITE) && (fault_type & VM_PROT_WRITE)) {
     klog("Cannot write to address: 0x%08lx", fault_addr);
     return EACCES;
   }
 
-  if (!(ent->prot & VM_PROT_READ) && (fault_type == VM_PROT_READ)) {
+  if (!(ent->prot & VM_PROT_READ) && (fault_type & VM_PROT_READ)) {
     klog("Cannot read from address: 0x%08lx", fault_addr);
     return EACCES;
   }
 
+  if (!(ent->prot & VM_PROT_EXEC) && (fault_type & VM_PROT_EXEC)) {
+    klog("Cannot execute at address: 0x%08lx", fault_addr);
+    return EACCES;
+  }
+
   assert(ent->start <= fault_addr && fault_addr < ent->end);
 
   vm_object_t *obj = ent->object;
@@ -449,15 +712,136 @@ int vm_page_fault(vm_map_t *map, vaddr_t fault_addr, vm_prot_t fault_type) {
 
   vaddr_t fault_page = fault_addr & -PAGESIZE;
   vaddr_t offset = ent->offset + (fault_page - ent->start);
-  vm_page_t *frame = vm_object_find_page(ent->object, offset);
-
-  if (frame == NULL)
-    frame = obj->vo_pager->pgr_fault(obj, offset);
+  vm_prot_t prot = ent->prot;
+  vm_object_t *owner;
+  /* File pages may be invalidated once the lookup drops vo_lock of their
+   * owner. They're used only with the lock held and after checking they're
+   * still there. If not, the access simply faults again. */
+  vm_page_t *frame = vm_object_lookup_page(obj, offset, &owner);
+
+  if (frame == NULL && vm_page_fault_superpage(map, ent, fault_page))
+    return 0;
+
+  /* First touch of anonymous memory, neighbours are likely to follow. */
+  bool fill = false;
+
+  if (frame == NULL) {
+    /* Anonymous memory is zero-filled straight into the top object. Other
+     * pagers fill in the bottom object, which may be shared with other
+     * processes, and the page gets copied on write. */
+    owner = vm_object_bottom(obj);
+    if (owner->vo_pager->pgr_type == VM_ANONYMOUS) {
+      owner = obj;
+      fill = true;
+    } else if (owner->vo_pager->pgr_type == VM_VNODE) {
+      thread_t *td = thread_self();
+      /* The thread may hold a vnode lock, which the pager needs as well. */
+      if (td->td_pflags & TDP_NOPAGEIN) {
+        td->td_pflags |= TDP_PAGEINFAILED;
+        return EFAULT;
+      }
+      vm_object_hold(owner);
+      *pagein_p = owner;
+      *offset_p = offset;
+      return 0;
+    }
+    frame = owner->vo_pager->pgr_fault(owner, offset);
+  }
 
   if (frame == NULL)
     return EFAULT;
 
-  pmap_enter(map->pmap, fault_page, frame, ent->prot, 0);
+  if (owner != obj) {
+    /* The page belongs to a backing object, which must not be modified. */
+    if (fault_type & VM_PROT_WRITE) {
+      vm_page_t *new_frame = vm_page_alloc(1);
+      if (owner->vo_pager->pgr_type == VM_VNODE) {
+        WITH_MTX_LOCK (&owner->vo_lock) {
+          if (vm_object_find_page_nolock(owner, offset) != frame)
+            frame = NULL;
+          else
+            pmap_copy_page(frame, new_frame);
+        }
+        if (frame == NULL) {
+          vm_page_free(new_frame);
+          return 0;
+        }
+      } else {
+        pmap_copy_page(frame, new_frame);
+      }
+      /* From now on the page is private to the top object. */
+      owner = obj;
+      if (vm_object_add_pages(obj, offset, new_frame, 1)) {
+        /* Replace read-only mapping of the original page (if any). */
+        pmap_remove(map->pmap, fault_page, fault_page + PAGESIZE);
+        atomic_fetch_add(&vm_cow_copies, 1);
+        frame = new_frame;
+      } else {
+        /* Concurrent fault has already copied the page. */
+        vm_page_free(new_frame);
+        if (!(frame = vm_object_find_page(obj, offset)))
+          return EFAULT;
+      }
+    } else {
+      prot &= ~VM_PROT_WRITE;
+    }
+  }
+
+  /* Access type tells pmap to mark the page as referenced (or modified)
+   * right away, which saves another fault to emulate these bits. */
+  unsigned flags = fault_type;
+
+  /* Device memory is mapped only shared, never through a shadow object. */
+  if (obj->vo_pager->pgr_type == VM_DEVICE)
+    flags |= PMAP_NOCACHE;
+
+  if (owner->vo_pager->pgr_type != VM_VNODE) {
+    pmap_enter(map->pmap, fault_page, frame, prot, flags);
+  } else if (owner == obj && (fault_type & VM_PROT_WRITE)) {
+    /* Shared file page becomes writable only once it's known to be dirty,
+     * so that the pager knows which pages need to be written back. */
+    WITH_MTX_LOCK (&obj->vo_lock) {
+      if (vm_object_set_dirty(obj, offset, frame))
+        pmap_enter(map->pmap, fault_page, frame, prot, flags);
+    }
+  } else {
+    WITH_MTX_LOCK (&owner->vo_lock) {
+      if (vm_object_find_page_nolock(owner, offset) == frame)
+        pmap_enter(map->pmap, fault_page, frame, prot & ~VM_PROT_WRITE, flags);
+    }
+  }
+
+  vm_page_fault_around(map, ent, fault_page, fault_type, fill);
 
   return 0;
 }
+
+int vm_page_fault(vm_map_t *map, vaddr_t fault_addr, vm_prot_t fault_type) {
+  KTRACE(KTR_PGFAULT, fault_addr, fault_type);
+
+  atomic_fetch_add_explicit(&map->nfaults, 1, memory_order_relaxed);
+
+  for (;;) {
+    vm_object_t *obj = NULL;
+    vm_offset_t offset;
+    int error;
+
+    WITH_VM_MAP_LOCK_READ (map) {
+      error = vm_page_fault_locked(map, fault_addr, fault_type, &obj, &offset);
+    }
+
+    if (error || obj == NULL)
+      return error;
+
+    /* Reading a page from a file sleeps with the vnode locked. Vnode locks
+     * are taken before vm_map locks, e.g. by read(2) that copies data out to
+     * user memory, so the pager must run with the map unlocked. */
+    vm_page_t *pg = obj->vo_pager->pgr_fault(obj, offset);
+    vm_object_drop(obj);
+    if (pg == NULL)
+      return EFAULT;
+
+    /* The page is resident now, so the next attempt is going to map it,
+     * unless the map or the file has changed in the meantime. */
+  }
+}
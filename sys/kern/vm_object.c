@@ -10,26 +10,27 @@ static POOL_DEFINE(P_VMOBJ, "vm_object", sizeof(vm_object_t));
 
 vm_object_t *vm_object_alloc(vm_pgr_type_t type) {
   vm_object_t *obj = pool_alloc(P_VMOBJ, M_ZERO);
-  TAILQ_INIT(&obj->vo_pages);
+  vm_radix_init(&obj->vo_pages);
+  vm_radix_init(&obj->vo_dirty);
   mtx_init(&obj->vo_lock, 0);
   obj->vo_pager = &pagers[type];
   obj->vo_refs = 1;
   return obj;
 }
 
+vm_page_t *vm_object_find_page_nolock(vm_object_t *obj, vm_offset_t offset) {
+  assert(mtx_owned(&obj->vo_lock));
+  return vm_radix_lookup(&obj->vo_pages, offset);
+}
+
 vm_page_t *vm_object_find_page(vm_object_t *obj, vm_offset_t offset) {
   SCOPED_MTX_LOCK(&obj->vo_lock);
-
-  vm_page_t *pg;
-  TAILQ_FOREACH (pg, &obj->vo_pages, objpages) {
-    if (pg->offset == offset)
-      return pg;
-  }
-
-  return NULL;
+  return vm_object_find_page_nolock(obj, offset);
 }
 
-void vm_object_add_page(vm_object_t *obj, vm_offset_t offset, vm_page_t *pg) {
+static void vm_object_add_page_nolock(vm_object_t *obj, vm_offset_t offset,
+                                      vm_page_t *pg) {
+  assert(mtx_owned(&obj->vo_lock));
   assert(page_aligned_p(pg->offset));
   /* For simplicity of implementation let's insert pages of size 1 only */
   assert(pg->size == 1);
@@ -37,22 +38,33 @@ void vm_object_add_page(vm_object_t *obj, vm_offset_t offset, vm_page_t *pg) {
   pg->object = obj;
   pg->offset = offset;
 
-  WITH_MTX_LOCK (&obj->vo_lock) {
-    vm_page_t *it;
-    TAILQ_FOREACH (it, &obj->vo_pages, objpages) {
-      if (it->offset > pg->offset) {
-        TAILQ_INSERT_BEFORE(it, pg, objpages);
-        obj->vo_npages++;
-        return;
-      }
-      /* there must be no page at the offset! */
-      assert(it->offset != pg->offset);
-    }
+  /* there must be no page at the offset! */
+  vm_radix_insert(&obj->vo_pages, pg);
+  obj->vo_npages++;
+}
 
-    /* offset of page is greater than the offset of any other page */
-    TAILQ_INSERT_TAIL(&obj->vo_pages, pg, objpages);
-    obj->vo_npages++;
-  }
+void vm_object_add_page(vm_object_t *obj, vm_offset_t offset, vm_page_t *pg) {
+  SCOPED_MTX_LOCK(&obj->vo_lock);
+  vm_object_add_page_nolock(obj, offset, pg);
+}
+
+bool vm_object_has_pages(vm_object_t *obj, vm_offset_t offset, size_t length) {
+  SCOPED_MTX_LOCK(&obj->vo_lock);
+  vm_page_t *pg = vm_radix_lookup_ge(&obj->vo_pages, offset);
+  return pg && pg->offset < offset + length;
+}
+
+bool vm_object_add_pages(vm_object_t *obj, vm_offset_t offset, vm_page_t *pg,
+                         size_t n) {
+  SCOPED_MTX_LOCK(&obj->vo_lock);
+
+  vm_page_t *it = vm_radix_lookup_ge(&obj->vo_pages, offset);
+  if (it && it->offset < offset + n * PAGESIZE)
+    return false;
+
+  for (size_t i = 0; i < n; i++)
+    vm_object_add_page_nolock(obj, offset + i * PAGESIZE, &pg[i]);
+  return true;
 }
 
 static void vm_object_remove_pages_nolock(vm_object_t *obj, vm_offset_t offset,
@@ -60,16 +72,19 @@ static void vm_object_remove_pages_nolock(vm_object_t *obj, vm_offset_t offset,
   assert(mtx_owned(&obj->vo_lock));
   assert(page_aligned_p(offset) && page_aligned_p(length));
 
-  vm_page_t *pg, *next;
-  TAILQ_FOREACH_SAFE (pg, &obj->vo_pages, objpages, next) {
-    if (pg->offset >= offset + length)
-      break;
-    if (pg->offset < offset)
-      continue;
+  vm_offset_t end = offset + length;
+  vm_page_t *pg;
 
+  while ((pg = vm_radix_lookup_ge(&obj->vo_pages, offset)) &&
+         pg->offset < end) {
+    offset = pg->offset + PAGESIZE;
+    vm_radix_remove(&obj->vo_pages, pg->offset);
+    vm_radix_remove(&obj->vo_dirty, pg->offset);
+    /* Page faults map pages only with vo_lock held, so once the page is gone
+     * from the object nobody can map it again. */
+    pmap_page_remove(pg);
     pg->offset = 0;
     pg->object = NULL;
-    TAILQ_REMOVE(&obj->vo_pages, pg, objpages);
     vm_page_free(pg);
     obj->vo_npages--;
   }
@@ -80,6 +95,18 @@ void vm_object_remove_pages(vm_object_t *obj, vm_offset_t off, size_t len) {
   vm_object_remove_pages_nolock(obj, off, len);
 }
 
+bool vm_object_set_dirty(vm_object_t *obj, vm_offset_t offset,
+                         vm_page_t *pg) {
+  assert(mtx_owned(&obj->vo_lock));
+
+  if (vm_object_find_page_nolock(obj, offset) != pg)
+    return false;
+
+  if (!vm_radix_lookup(&obj->vo_dirty, offset))
+    vm_radix_insert(&obj->vo_dirty, pg);
+  return true;
+}
+
 #define vm_object_remove_all_pages(obj)                                        \
   vm_object_remove_pages_nolock((obj), 0, (size_t)(-PAGESIZE))
 
@@ -88,37 +115,112 @@ void vm_object_hold(vm_object_t *obj) {
 }
 
 void vm_object_drop(vm_object_t *obj) {
-  WITH_MTX_LOCK (&obj->vo_lock) {
-    if (!refcnt_release(&obj->vo_refs))
-      return;
+  /* Dropping the last reference to a shadow object releases its reference to
+   * the backing object, so walk down the chain instead of recursing. */
+  while (obj) {
+    vm_object_t *backing;
 
-    vm_object_remove_all_pages(obj);
+    WITH_MTX_LOCK (&obj->vo_lock) {
+      if (!refcnt_release(&obj->vo_refs))
+        return;
+
+      backing = obj->vo_backing;
+    }
+    /* Pager may still need the pages, e.g. to write back dirty ones. */
+    if (obj->vo_pager->pgr_free)
+      obj->vo_pager->pgr_free(obj);
+    WITH_MTX_LOCK (&obj->vo_lock)
+      vm_object_remove_all_pages(obj);
+    pool_free(P_VMOBJ, obj);
+    obj = backing;
+  }
+}
+
+vm_object_t *vm_object_shadow(vm_object_t *obj) {
+  vm_object_t *new_obj = vm_object_alloc(VM_ANONYMOUS);
+  vm_object_hold(obj);
+  new_obj->vo_backing = obj;
+  return new_obj;
+}
+
+vm_page_t *vm_object_lookup_page(vm_object_t *obj, vm_offset_t offset,
+                                 vm_object_t **owner_p) {
+  for (; obj; obj = obj->vo_backing) {
+    vm_page_t *pg = vm_object_find_page(obj, offset);
+    if (pg) {
+      if (owner_p)
+        *owner_p = obj;
+      return pg;
+    }
   }
-  pool_free(P_VMOBJ, obj);
+  return NULL;
 }
 
-vm_object_t *vm_object_clone(vm_object_t *obj) {
-  /* XXX: this function will not be used in UVM */
-  vm_object_t *new_obj = vm_object_alloc(VM_DUMMY);
-  new_obj->vo_pager = obj->vo_pager;
+vm_object_t *vm_object_bottom(vm_object_t *obj) {
+  while (obj->vo_backing)
+    obj = obj->vo_backing;
+  return obj;
+}
+
+void vm_object_collapse(vm_object_t *obj) {
+  SCOPED_MTX_LOCK(&obj->vo_lock);
+
+  /* Only anonymous objects can be merged, as others are owned by pagers. */
+  vm_object_t *backing;
+  while ((backing = obj->vo_backing) && backing->vo_refs == 1 &&
+         backing->vo_pager->pgr_type == VM_ANONYMOUS) {
+    WITH_MTX_LOCK (&backing->vo_lock) {
+      vm_page_t *pg;
+      while ((pg = vm_radix_lookup_ge(&backing->vo_pages, 0))) {
+        vm_radix_remove(&backing->vo_pages, pg->offset);
+        backing->vo_npages--;
+
+        if (vm_object_find_page_nolock(obj, pg->offset)) {
+          /* Page has been copied on write, the original is not visible. */
+          pmap_page_remove(pg);
+          pg->object = NULL;
+          vm_page_free(pg);
+        } else {
+          vm_object_add_page_nolock(obj, pg->offset, pg);
+        }
+      }
+
+      /* Take over the reference to next object in the chain. */
+      obj->vo_backing = backing->vo_backing;
+    }
+    pool_free(P_VMOBJ, backing);
+  }
+}
+
+void vm_object_cover_backing(vm_object_t *obj, vm_offset_t offset,
+                             size_t length) {
+  assert(page_aligned_p(offset) && page_aligned_p(length));
+
+  SCOPED_MTX_LOCK(&obj->vo_lock);
+
+  for (vm_object_t *it = obj->vo_backing; it; it = it->vo_backing) {
+    SCOPED_MTX_LOCK(&it->vo_lock);
 
-  WITH_MTX_LOCK (&obj->vo_lock) {
     vm_page_t *pg;
-    TAILQ_FOREACH (pg, &obj->vo_pages, objpages) {
+    VM_RADIX_FOREACH (pg, &it->vo_pages, offset, offset + length) {
+      if (vm_object_find_page_nolock(obj, pg->offset))
+        continue;
+
       vm_page_t *new_pg = vm_page_alloc(1);
-      pmap_copy_page(pg, new_pg);
-      vm_object_add_page(new_obj, pg->offset, new_pg);
+      pmap_zero_page(new_pg);
+      vm_object_add_page_nolock(obj, pg->offset, new_pg);
     }
   }
-
-  return new_obj;
 }
 
 void vm_object_dump(vm_object_t *obj) {
   SCOPED_MTX_LOCK(&obj->vo_lock);
 
   vm_page_t *pg;
-  TAILQ_FOREACH (pg, &obj->vo_pages, objpages) {
+  VM_RADIX_FOREACH (pg, &obj->vo_pages, 0, (vm_offset_t)(-PAGESIZE)) {
     klog("(vm-obj) offset: 0x%08lx, size: %ld", pg->offset, pg->size);
   }
+
+  if (obj->vo_backing)
+    klog("(vm-obj) shadows object %p", obj->vo_backing);
 }
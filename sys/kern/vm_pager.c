@@ -1,8 +1,16 @@
+#define KL_LOG KL_VM
+#include <sys/klog.h>
 #include <sys/mimiker.h>
+#include <sys/condvar.h>
+#include <sys/devfs.h>
+#include <sys/kmem.h>
+#include <sys/mutex.h>
 #include <sys/pmap.h>
+#include <sys/vm_map.h>
 #include <sys/vm_object.h>
 #include <sys/vm_pager.h>
 #include <sys/vm_physmem.h>
+#include <sys/vnode.h>
 
 static vm_page_t *dummy_pager_fault(vm_object_t *obj, off_t offset) {
   return NULL;
@@ -13,11 +21,255 @@ static vm_page_t *anon_pager_fault(vm_object_t *obj, off_t offset) {
 
   vm_page_t *new_pg = vm_page_alloc(1);
   pmap_zero_page(new_pg);
-  vm_object_add_page(obj, offset, new_pg);
+
+  /* Page faults run in parallel, so someone else could have filled in the
+   * page in the meantime. */
+  if (!vm_object_add_pages(obj, offset, new_pg, 1)) {
+    vm_page_free(new_pg);
+    return vm_object_find_page(obj, offset);
+  }
+
   return new_pg;
 }
 
+/* Protects vnode_t::v_object of all vnodes. */
+static MTX_DEFINE(vnode_pager_lock, 0);
+/* Signaled when an object that lost its last reference leaves its vnode. */
+static condvar_t vnode_pager_cv = {.name = "vnode_pager"};
+
+static vm_page_t *vnode_pager_fault(vm_object_t *obj, off_t offset) {
+  assert(obj != NULL);
+
+  vnode_t *vn = obj->vo_handle;
+
+  /* The object may be shared between processes, so faults on it are
+   * serialized by the vnode lock. Someone else could have brought the page in
+   * while we were waiting for it. */
+  vnode_lock(vn);
+
+  vm_page_t *pg = vm_object_find_page(obj, offset);
+  if (pg) {
+    vnode_unlock(vn);
+    return pg;
+  }
+
+  pg = vm_page_alloc(1);
+
+  /* Part of the page beyond end of file must read as zeros. */
+  pmap_zero_page(pg);
+
+  /* Temporarily map the page into kernel space to fill it in. */
+  vaddr_t va = kva_alloc(PAGESIZE);
+  pmap_kenter(va, pg->paddr, VM_PROT_READ | VM_PROT_WRITE, 0);
+  uio_t uio = UIO_SINGLE_KERNEL(UIO_READ, offset, (void *)va, PAGESIZE);
+  int error = VOP_READ(vn, &uio);
+  pmap_kremove(va, PAGESIZE);
+  kva_free(va, PAGESIZE);
+
+  if (error) {
+    vm_page_free(pg);
+    pg = NULL;
+  } else {
+    vm_object_add_page(obj, offset, pg);
+  }
+
+  vnode_unlock(vn);
+  return pg;
+}
+
+/* Writes back dirty pages of `obj`, but not past end of file. */
+static void vnode_pager_putpages(vm_object_t *obj) {
+  vnode_t *vn = obj->vo_handle;
+  vattr_t va;
+
+  assert(vnode_xlocked(vn));
+
+  if (VOP_GETATTR(vn, &va))
+    return;
+
+  for (;;) {
+    vm_page_t *pg;
+
+    WITH_MTX_LOCK (&obj->vo_lock) {
+      if ((pg = vm_radix_lookup_ge(&obj->vo_dirty, 0)) == NULL)
+        return;
+      vm_radix_remove(&obj->vo_dirty, pg->offset);
+      /* Next write to the page has to fault and mark it dirty again. */
+      pmap_page_remove(pg);
+    }
+
+    /* The page cannot go away, as invalidation requires the vnode lock. */
+    if ((size_t)pg->offset >= va.va_size)
+      continue;
+
+    size_t len = min(va.va_size - pg->offset, (size_t)PAGESIZE);
+    vaddr_t kva = kva_alloc(PAGESIZE);
+    pmap_kenter(kva, pg->paddr, VM_PROT_READ, 0);
+    uio_t uio = UIO_SINGLE_KERNEL(UIO_WRITE, pg->offset, (void *)kva, len);
+    int error = VOP_WRITE(vn, &uio);
+    pmap_kremove(kva, PAGESIZE);
+    kva_free(kva, PAGESIZE);
+
+    if (error)
+      klog("Failed to write back page at offset %lx of vnode %p (error %d)!",
+           pg->offset, vn, error);
+  }
+}
+
+static void vnode_pager_free(vm_object_t *obj) {
+  vnode_t *vn = obj->vo_handle;
+  /* Called with the vnode locked when vnode_pager_release drops the last
+   * reference, in which case pages have been written back already. */
+  bool locked = vnode_xlocked(vn);
+
+  if (!locked)
+    vnode_lock(vn);
+
+  /* Last mapping is gone, so write back what it has modified. The object
+   * stays attached to the vnode until then, so that a new object cannot read
+   * stale file contents in the meantime. */
+  vnode_pager_putpages(obj);
+
+  WITH_MTX_LOCK (&vnode_pager_lock) {
+    if (vn->v_object == obj) {
+      vn->v_object = NULL;
+      cv_broadcast(&vnode_pager_cv);
+    }
+  }
+
+  if (!locked)
+    vnode_unlock(vn);
+
+  vnode_drop(vn);
+}
+
+vm_object_t *vnode_pager_object(vnode_t *vn) {
+  assert(vn->v_type == V_REG);
+
+  SCOPED_MTX_LOCK(&vnode_pager_lock);
+
+  vm_object_t *obj;
+  while ((obj = vn->v_object)) {
+    unsigned refs = obj->vo_refs;
+    while (refs > 0) {
+      if (atomic_compare_exchange_weak(&obj->vo_refs, &refs, refs + 1))
+        return obj;
+    }
+    /* Object that lost its last reference is being written back and freed by
+     * vnode_pager_free. Wait until it's detached from the vnode. */
+    cv_wait(&vnode_pager_cv, &vnode_pager_lock);
+  }
+
+  obj = vm_object_alloc(VM_VNODE);
+  vnode_hold(vn);
+  obj->vo_handle = vn;
+  vn->v_object = obj;
+  return obj;
+}
+
+/* Drops reference to `obj` taken with the vnode locked. If it's the last one,
+ * the object gets detached from the vnode and written back here, so that
+ * vnode_pager_free doesn't have to lock the vnode again. */
+static void vnode_pager_release(vnode_t *vn, vm_object_t *obj) {
+  assert(vnode_xlocked(vn));
+
+  WITH_MTX_LOCK (&vnode_pager_lock) {
+    unsigned refs = obj->vo_refs;
+    while (refs > 1) {
+      if (atomic_compare_exchange_weak(&obj->vo_refs, &refs, refs - 1))
+        return;
+    }
+    /* Nobody else refers to the object, so it cannot get mapped anymore. */
+    if (vn->v_object == obj)
+      vn->v_object = NULL;
+  }
+
+  vnode_pager_putpages(obj);
+  vm_object_drop(obj);
+}
+
+/* Returns object attached to locked `vn`. The object is referenced, unless it
+ * lost its last reference already. Such an object cannot be freed until the
+ * vnode gets unlocked, as vnode_pager_free detaches it with the lock held. */
+static vm_object_t *vnode_pager_get(vnode_t *vn, bool *heldp) {
+  assert(vnode_xlocked(vn));
+
+  SCOPED_MTX_LOCK(&vnode_pager_lock);
+
+  vm_object_t *obj = vn->v_object;
+  *heldp = false;
+  if (obj) {
+    unsigned refs = obj->vo_refs;
+    while (refs > 0 && !*heldp)
+      *heldp = atomic_compare_exchange_weak(&obj->vo_refs, &refs, refs + 1);
+  }
+  return obj;
+}
+
+void vnode_pager_invalidate(vnode_t *vn, off_t off, size_t len) {
+  vm_object_t *obj;
+  bool held;
+
+  if ((obj = vnode_pager_get(vn, &held)) == NULL)
+    return;
+
+  vm_offset_t start = rounddown(off, PAGESIZE);
+  vm_offset_t end = (len == (size_t)-1) ? (vm_offset_t)(-PAGESIZE)
+                                        : roundup(off + len, PAGESIZE);
+
+  /* Pages are unmapped from processes as they're removed. */
+  vm_object_remove_pages(obj, start, end - start);
+
+  if (held)
+    vnode_pager_release(vn, obj);
+}
+
+void vnode_pager_flush(vnode_t *vn) {
+  vm_object_t *obj;
+  bool held;
+
+  if ((obj = vnode_pager_get(vn, &held)) == NULL)
+    return;
+
+  /* Pages of an object that is being freed are written back here as well, so
+   * they cannot overwrite file contents written after the flush. */
+  vnode_pager_putpages(obj);
+
+  if (held)
+    vnode_pager_release(vn, obj);
+}
+
+static vm_page_t *dev_pager_fault(vm_object_t *obj, off_t offset) {
+  devnode_t *dev = obj->vo_handle;
+  paddr_t pa;
+
+  /* Protection was checked when the mapping was created. */
+  if (dev->ops->d_mmap(dev, offset, VM_PROT_NONE, &pa))
+    return NULL;
+
+  /* Device memory must have been registered with vm_physseg_plug_device. */
+  return vm_page_find(pa);
+}
+
+static void dev_pager_free(vm_object_t *obj) {
+  devnode_t *dev = obj->vo_handle;
+  refcnt_release(&dev->refcnt);
+}
+
+vm_object_t *dev_pager_object(devnode_t *dev) {
+  vm_object_t *obj = vm_object_alloc(VM_DEVICE);
+  refcnt_acquire(&dev->refcnt);
+  obj->vo_handle = dev;
+  return obj;
+}
+
 vm_pager_t pagers[] = {
-  [VM_DUMMY] = {.pgr_fault = dummy_pager_fault},
-  [VM_ANONYMOUS] = {.pgr_fault = anon_pager_fault},
+  [VM_DUMMY] = {.pgr_type = VM_DUMMY, .pgr_fault = dummy_pager_fault},
+  [VM_ANONYMOUS] = {.pgr_type = VM_ANONYMOUS, .pgr_fault = anon_pager_fault},
+  [VM_VNODE] = {.pgr_type = VM_VNODE,
+                .pgr_fault = vnode_pager_fault,
+                .pgr_free = vnode_pager_free},
+  [VM_DEVICE] = {.pgr_type = VM_DEVICE,
+                 .pgr_fault = dev_pager_fault,
+                 .pgr_free = dev_pager_free},
 };
@@ -2,6 +2,7 @@
 #include <sys/klog.h>
 #include <sys/mimiker.h>
 #include <sys/libkern.h>
+#include <sys/device.h>
 #include <sys/errno.h>
 #include <sys/mutex.h>
 #include <sys/pmap.h>
@@ -31,17 +32,21 @@ static vm_pagelist_t freelist[PM_NQUEUES];
 static size_t pagecount[PM_NQUEUES];
 static MTX_DEFINE(physmem_lock, LK_RECURSIVE);
 
+static vm_physseg_t freeseg[VM_PHYSSEG_NMAX];
+static unsigned freeseg_last = 0;
+
+static vm_physseg_t *vm_physseg_alloc(void) {
+  assert(mtx_owned(&physmem_lock));
+  assert(freeseg_last < VM_PHYSSEG_NMAX - 1);
+  return &freeseg[freeseg_last++];
+}
+
 void _vm_physseg_plug(paddr_t start, paddr_t end, bool used) {
   assert(page_aligned_p(start) && page_aligned_p(end) && start < end);
 
-  static vm_physseg_t freeseg[VM_PHYSSEG_NMAX];
-  static unsigned freeseg_last = 0;
-
   SCOPED_MTX_LOCK(&physmem_lock);
 
-  assert(freeseg_last < VM_PHYSSEG_NMAX - 1);
-
-  vm_physseg_t *seg = &freeseg[freeseg_last++];
+  vm_physseg_t *seg = vm_physseg_alloc();
 
   seg->start = start;
   seg->end = end;
@@ -144,6 +149,37 @@ void init_vm_page(void) {
   vm_boot_finish();
 }
 
+void vm_physseg_plug_device(paddr_t start, paddr_t end) {
+  assert(page_aligned_p(start) && page_aligned_p(end) && start < end);
+  assert(vm_boot_done);
+
+  size_t npages = (end - start) / PAGESIZE;
+  vm_page_t *pages =
+    kmalloc(M_DEV, npages * sizeof(vm_page_t), M_WAITOK | M_ZERO);
+
+  /* The pages are never going to be put on free lists. */
+  for (size_t i = 0; i < npages; i++) {
+    vm_page_t *page = &pages[i];
+    page->paddr = start + i * PAGESIZE;
+    page->size = 1;
+    page->flags = PG_ALLOCATED;
+    TAILQ_INIT(&page->pv_list);
+  }
+
+  SCOPED_MTX_LOCK(&physmem_lock);
+
+  assert(vm_page_find(start) == NULL && vm_page_find(end - 1) == NULL);
+
+  vm_physseg_t *seg = vm_physseg_alloc();
+  seg->start = start;
+  seg->end = end;
+  seg->npages = npages;
+  seg->used = true;
+  seg->pages = pages;
+
+  TAILQ_INSERT_TAIL(&seglist, seg, seglink);
+}
+
 /* Takes two pages which are buddies, and merges them */
 static vm_page_t *pm_merge_buddies(vm_page_t *pg1, vm_page_t *pg2) {
   assert(pg1->size == pg2->size);
@@ -239,6 +275,16 @@ vm_page_t *vm_page_alloc(size_t npages) {
   return pm_take_page(fl);
 }
 
+void vm_page_split(vm_page_t *pg) {
+  SCOPED_MTX_LOCK(&physmem_lock);
+
+  assert(pg->flags & PG_ALLOCATED);
+
+  /* Buddies are merged back as their halves get freed. */
+  for (unsigned i = 0, n = pg->size; i < n; i++)
+    pg[i].size = 1;
+}
+
 int vm_pagelist_alloc(size_t n, vm_pagelist_t *pglist) {
   TAILQ_INIT(pglist);
 
@@ -0,0 +1,168 @@
+#include <sys/klog.h>
+#include <sys/mimiker.h>
+#include <sys/pool.h>
+#include <sys/vm_radix.h>
+
+#define RADIX_SHIFT 4
+#define RADIX_SLOTS (1 << RADIX_SHIFT)
+#define RADIX_MASK (RADIX_SLOTS - 1)
+#define RADIX_MAXHEIGHT (sizeof(vm_offset_t) * 8 / RADIX_SHIFT)
+
+/* Slots of nodes at level 0 point to pages, all others point to nodes. */
+typedef struct vm_radix_node {
+  unsigned rn_count; /* number of non-NULL slots */
+  void *rn_slots[RADIX_SLOTS];
+} vm_radix_node_t;
+
+static POOL_DEFINE(P_VM_RADIX, "vm_radix", sizeof(vm_radix_node_t));
+
+static inline vm_offset_t radix_key(vm_offset_t off) {
+  return off / PAGESIZE;
+}
+
+static inline unsigned radix_slot(vm_offset_t key, unsigned level) {
+  return (key >> (level * RADIX_SHIFT)) & RADIX_MASK;
+}
+
+/* Checks if tree of given height is high enough to store a page at `key`. */
+static inline bool radix_fits(unsigned height, vm_offset_t key) {
+  return height >= RADIX_MAXHEIGHT || (key >> (height * RADIX_SHIFT)) == 0;
+}
+
+static vm_radix_node_t *radix_node_alloc(void) {
+  return pool_alloc(P_VM_RADIX, M_ZERO);
+}
+
+void vm_radix_init(vm_radix_t *rt) {
+  rt->rt_root = NULL;
+  rt->rt_height = 0;
+}
+
+void vm_radix_insert(vm_radix_t *rt, vm_page_t *pg) {
+  vm_offset_t key = radix_key(pg->offset);
+
+  if (rt->rt_root == NULL) {
+    rt->rt_height = 1;
+    while (!radix_fits(rt->rt_height, key))
+      rt->rt_height++;
+    rt->rt_root = radix_node_alloc();
+  }
+
+  /* Grow the tree up, current root becomes leftmost child of the new one. */
+  while (!radix_fits(rt->rt_height, key)) {
+    vm_radix_node_t *root = radix_node_alloc();
+    root->rn_slots[0] = rt->rt_root;
+    root->rn_count = 1;
+    rt->rt_root = root;
+    rt->rt_height++;
+  }
+
+  vm_radix_node_t *node = rt->rt_root;
+  for (unsigned level = rt->rt_height - 1; level > 0; level--) {
+    void **slotp = &node->rn_slots[radix_slot(key, level)];
+    if (*slotp == NULL) {
+      *slotp = radix_node_alloc();
+      node->rn_count++;
+    }
+    node = *slotp;
+  }
+
+  void **slotp = &node->rn_slots[radix_slot(key, 0)];
+  assert(*slotp == NULL);
+  *slotp = pg;
+  node->rn_count++;
+}
+
+vm_page_t *vm_radix_lookup(vm_radix_t *rt, vm_offset_t off) {
+  vm_offset_t key = radix_key(off);
+
+  if (rt->rt_root == NULL || !radix_fits(rt->rt_height, key))
+    return NULL;
+
+  vm_radix_node_t *node = rt->rt_root;
+  for (unsigned level = rt->rt_height - 1; level > 0; level--) {
+    node = node->rn_slots[radix_slot(key, level)];
+    if (node == NULL)
+      return NULL;
+  }
+
+  return node->rn_slots[radix_slot(key, 0)];
+}
+
+static vm_page_t *radix_lookup_ge(vm_radix_node_t *node, unsigned level,
+                                  vm_offset_t key) {
+  for (unsigned i = radix_slot(key, level); i < RADIX_SLOTS; i++) {
+    void *slot = node->rn_slots[i];
+    if (slot != NULL) {
+      if (level == 0)
+        return slot;
+      vm_page_t *pg = radix_lookup_ge(slot, level - 1, key);
+      if (pg)
+        return pg;
+    }
+    /* Every key in subtrees to the right is greater than the one we look for,
+     * so they have to be searched from their leftmost slot. */
+    key = 0;
+  }
+  return NULL;
+}
+
+vm_page_t *vm_radix_lookup_ge(vm_radix_t *rt, vm_offset_t off) {
+  vm_offset_t key = radix_key(off);
+
+  if (rt->rt_root == NULL || !radix_fits(rt->rt_height, key))
+    return NULL;
+
+  return radix_lookup_ge(rt->rt_root, rt->rt_height - 1, key);
+}
+
+vm_page_t *vm_radix_remove(vm_radix_t *rt, vm_offset_t off) {
+  vm_offset_t key = radix_key(off);
+
+  if (rt->rt_root == NULL || !radix_fits(rt->rt_height, key))
+    return NULL;
+
+  vm_radix_node_t *path[RADIX_MAXHEIGHT];
+  vm_radix_node_t *node = rt->rt_root;
+  unsigned level = rt->rt_height - 1;
+
+  for (;;) {
+    path[level] = node;
+    if (level == 0)
+      break;
+    node = node->rn_slots[radix_slot(key, level)];
+    if (node == NULL)
+      return NULL;
+    level--;
+  }
+
+  vm_page_t *pg = node->rn_slots[radix_slot(key, 0)];
+  if (pg == NULL)
+    return NULL;
+
+  /* Free nodes that became empty going up from the leaf. */
+  for (level = 0; level < rt->rt_height; level++) {
+    node = path[level];
+    node->rn_slots[radix_slot(key, level)] = NULL;
+    if (--node->rn_count > 0)
+      break;
+    pool_free(P_VM_RADIX, node);
+  }
+
+  if (level == rt->rt_height) {
+    vm_radix_init(rt);
+    return pg;
+  }
+
+  /* Shrink the tree if only its leftmost subtree is left. */
+  while (rt->rt_height > 1) {
+    vm_radix_node_t *root = rt->rt_root;
+    if (root->rn_count > 1 || root->rn_slots[0] == NULL)
+      break;
+    rt->rt_root = root->rn_slots[0];
+    rt->rt_height--;
+    pool_free(P_VM_RADIX, root);
+  }
+
+  return pg;
+}
@@ -75,7 +75,10 @@ typedef struct bt {
 } bt_t;
 
 static KMALLOC_DEFINE(M_VMEM, "vmem");
-static POOL_DEFINE(P_BT, "vmem boundary tag", sizeof(bt_t));
+/* Boundary tags are allocated and freed with vmem lock held, so the pool must
+ * neither allocate magazines nor release slabs, as both reenter vmem. */
+static POOL_DEFINE(P_BT, "vmem boundary tag", sizeof(bt_t),
+                   .flags = PF_NOCACHE | PF_NORECLAIM);
 /* Note: in the future, the amount of static memory for boundary tags should
  * be reduced by more clever tag allocation technique that always keeps some
  * number of free tags. For more information, please see bt_alloc and bt_refill
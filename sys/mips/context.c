@@ -1,6 +1,7 @@
 #include <sys/context.h>
 #include <sys/libkern.h>
 #include <sys/errno.h>
+#include <sys/mimiker.h>
 #include <sys/thread.h>
 #include <mips/mips.h>
 #include <mips/m32c0.h>
@@ -32,10 +33,89 @@ register_t ctx_get_pc(ctx_t *ctx) {
   return _REG(ctx, EPC);
 }
 
+/* Instructions recognized when looking for function prologue. */
+#define ADDIU_SP_SP 0x27bd0000 /* addiu sp,sp,imm */
+#define SW_RA_SP 0xafbf0000    /* sw ra,imm(sp) */
+#define JR_RA 0x03e00008       /* jr ra */
+
+/* How far back from pc to look for beginning of function. */
+#define MAXSCAN 4096
+
+/*
+ * Kernel is compiled without frame pointers and o32 ABI does not require
+ * frames to be linked, so size of each frame and location of saved return
+ * address are recovered from function prologue. Beginning of the function is
+ * where stack pointer gets decremented or right after `jr ra` instruction that
+ * ends the preceding function.
+ */
+unsigned ctx_backtrace(thread_t *td, ctx_t *ctx, uintptr_t *pcs, unsigned n) {
+  vaddr_t stk_lo = (vaddr_t)td->td_kstack.stk_base;
+  vaddr_t stk_hi = stk_lo + td->td_kstack.stk_size;
+  vaddr_t pc = _REG(ctx, EPC);
+  vaddr_t sp = _REG(ctx, SP);
+  vaddr_t ra = _REG(ctx, RA);
+  unsigned depth = 0;
+
+  while (depth < n) {
+    if (pc < (vaddr_t)__text || pc >= (vaddr_t)__etext || (pc & 3))
+      break;
+    if (sp < stk_lo || sp >= stk_hi)
+      break;
+
+    pcs[depth++] = pc;
+
+    uint32_t *insn = (uint32_t *)pc - 1;
+    uint32_t *start = NULL;
+    int framesize = 0;
+
+    for (; insn >= (uint32_t *)__text && (uint32_t *)pc - insn < MAXSCAN;
+         insn--) {
+      if ((*insn & 0xffff8000) == (ADDIU_SP_SP | 0x8000)) {
+        framesize = -(int16_t)*insn;
+        start = insn;
+        break;
+      }
+      if (*insn == JR_RA) {
+        start = insn + 2; /* skip branch delay slot */
+        break;
+      }
+    }
+
+    if (start == NULL)
+      break;
+
+    int raoff = -1;
+    for (insn = start; insn < (uint32_t *)pc; insn++) {
+      if ((*insn & 0xffff0000) == SW_RA_SP) {
+        raoff = (int16_t)*insn;
+        break;
+      }
+    }
+
+    if (raoff >= 0) {
+      if (sp + raoff + sizeof(register_t) > stk_hi)
+        break;
+      ra = *(register_t *)(sp + raoff);
+    } else if (depth > 1) {
+      /* Only the interrupted function may keep return address in ra. */
+      break;
+    }
+
+    sp += framesize;
+    pc = ra;
+  }
+
+  return depth;
+}
+
 void mcontext_copy(mcontext_t *to, mcontext_t *from) {
   memcpy(to, from, sizeof(mcontext_t));
 }
 
+register_t mcontext_get_pc(mcontext_t *ctx) {
+  return _REG(ctx, EPC);
+}
+
 void mcontext_init(mcontext_t *ctx, void *pc, void *sp) {
   bzero(ctx, sizeof(mcontext_t));
 
@@ -50,6 +130,15 @@ void mcontext_init(mcontext_t *ctx, void *pc, void *sp) {
   _REG(ctx, SR) = mips32_get_c0(C0_STATUS) | SR_IE | SR_KSU_USER;
 }
 
+void mcontext_setup_call(mcontext_t *ctx, void *pc, void *sp, register_t arg) {
+  _REG(ctx, EPC) = (register_t)pc;
+  _REG(ctx, SP) = (register_t)sp;
+  _REG(ctx, A0) = arg;
+  /* Position independent code expects callee address in t9. */
+  _REG(ctx, T9) = (register_t)pc;
+  _REG(ctx, RA) = 0;
+}
+
 void mcontext_set_retval(mcontext_t *ctx, register_t value, register_t error) {
   _REG(ctx, V0) = (register_t)value;
   _REG(ctx, V1) = (register_t)error;
@@ -1,5 +1,8 @@
 #define KL_LOG KL_INIT
 #include <sys/klog.h>
+#include <sys/errno.h>
+#include <sys/mimiker.h>
+#include <sys/smp.h>
 #include <stdbool.h>
 #include <mips/m32c0.h>
 #include <mips/cpuinfo.h>
@@ -165,3 +168,19 @@ void init_mips_cpu(void) {
   cpu_read_config();
   cpu_dump();
 }
+
+/* Malta boards emulated by QEMU can only bring up more processors through
+ * MIPS Coherent Processing System, which 24Kf core does not implement. */
+int cpu_start_secondary(unsigned cpuid) {
+  return ENODEV;
+}
+
+void cpu_send_ipi(unsigned cpuid) {
+  panic("No secondary processors to interrupt!");
+}
+
+/* 24Kf core has no hint for busy-waiting, so just avoid caching memory reads
+ * in registers across the call. */
+void cpu_spinwait(void) {
+  __asm__ volatile("" ::: "memory");
+}
@@ -48,6 +48,8 @@ static const pte_t vm_prot_map[] = {
 
 static pmap_t kernel_pmap;
 pde_t *_kernel_pmap_pde;
+atomic_uint pmap_promotions;
+atomic_uint pmap_demotions;
 static bitstr_t asid_used[bitstr_size(MAX_ASID)] = {0};
 static SPIN_DEFINE(asid_lock, 0);
 
@@ -72,6 +74,10 @@ static inline bool is_valid_pde(pde_t pde) {
   return pde & PDE_VALID;
 }
 
+static inline bool is_superpage_pde(pde_t pde) {
+  return pde & PDE_SUPERPAGE;
+}
+
 static inline pte_t empty_pte(pmap_t *pmap) {
   return (pmap == pmap_kernel()) ? PTE_GLOBAL : 0;
 }
@@ -207,9 +213,84 @@ static pte_t pmap_pte_read(pmap_t *pmap, vaddr_t vaddr) {
   pde_t pde = PDE_OF(pmap, vaddr);
   if (!is_valid_pde(pde))
     return 0;
+  if (is_superpage_pde(pde))
+    return (pde & ~PDE_SUPERPAGE) + PTE_PFN(vaddr & (SUPERPAGESIZE - 1));
   return PTE_OF(pde, vaddr);
 }
 
+/*
+ * Superpage mappings.
+ *
+ * Page table is released when it gets replaced by a superpage PDE, and a new
+ * one is allocated when the superpage is broken up.
+ */
+
+/*! \brief Breaks superpage that maps \a vaddr (if any) into pages.
+ *
+ * \returns PDE of \a vaddr, which is not a superpage anymore */
+static pde_t pmap_demote(pmap_t *pmap, vaddr_t vaddr) {
+  assert(mtx_owned(&pmap->mtx));
+
+  pde_t pde = PDE_OF(pmap, vaddr);
+  if (!is_superpage_pde(pde))
+    return pde;
+
+  assert(pmap != pmap_kernel());
+
+  vaddr &= PDE_INDEX_MASK;
+
+  PDE_OF(pmap, vaddr) = 0;
+  pde_t spde = pde & ~PDE_SUPERPAGE;
+  pde = pmap_add_pde(pmap, vaddr);
+  pte_t *pte = PT_BASE(pde);
+  for (int i = 0; i < PT_ENTRIES; i++)
+    pte[i] = spde + PTE_PFN(i * PAGESIZE);
+
+  /* Each TLB entry maps one half of the superpage. */
+  tlb_invalidate(PTE_VPN2(vaddr) | PTE_ASID(pmap->asid));
+  tlb_invalidate(PTE_VPN2(vaddr + SUPERPAGESIZE / 2) | PTE_ASID(pmap->asid));
+
+  atomic_fetch_add(&pmap_demotions, 1);
+
+  klog("Demoted superpage at %08lx", vaddr);
+
+  return pde;
+}
+
+/*! \brief Replaces page table covering \a vaddr with superpage PDE.
+ *
+ * Promotion takes place only if all PTEs are valid, have the same attributes
+ * and map consecutive frames of a physically aligned superpage. */
+static void pmap_promote(pmap_t *pmap, vaddr_t vaddr) {
+  assert(mtx_owned(&pmap->mtx));
+
+  pde_t pde = PDE_OF(pmap, vaddr);
+  pte_t *pte = PT_BASE(pde);
+
+  /* Pages that were not referenced yet need separate TLB invalid faults. */
+  pte_t first = pte[0];
+  if (!(first & PTE_VALID) ||
+      !is_aligned(PTE_FRAME_ADDR(first), SUPERPAGESIZE))
+    return;
+
+  for (int i = 1; i < PT_ENTRIES; i++)
+    if (pte[i] != first + PTE_PFN(i * PAGESIZE))
+      return;
+
+  PDE_OF(pmap, vaddr) = first | PDE_SUPERPAGE;
+
+  /* TLB must not contain 4KiB entries overlapping with the superpage. */
+  tlb_invalidate_asid(pmap->asid);
+
+  vm_page_t *pg = vm_page_find(MIPS_KSEG0_TO_PHYS(pte));
+  TAILQ_REMOVE(&pmap->pte_pages, pg, pageq);
+  vm_page_free(pg);
+
+  atomic_fetch_add(&pmap_promotions, 1);
+
+  klog("Promoted superpage at %08lx", vaddr & PDE_INDEX_MASK);
+}
+
 /*! \brief Writes \a pte as the new PTE mapping virtual address \a vaddr. */
 static void pmap_pte_write(pmap_t *pmap, vaddr_t vaddr, pte_t pte,
                            unsigned flags) {
@@ -222,7 +303,7 @@ static void pmap_pte_write(pmap_t *pmap, vaddr_t vaddr, pte_t pte,
   else
     pte |= PTE_CACHE_WRITE_BACK;
 
-  pde_t pde = PDE_OF(pmap, vaddr);
+  pde_t pde = pmap_demote(pmap, vaddr);
   if (!is_valid_pde(pde))
     pde = pmap_add_pde(pmap, vaddr);
   PTE_OF(pde, vaddr) = pte;
@@ -324,9 +405,13 @@ void pmap_enter(pmap_t *pmap, vaddr_t va, vm_page_t *pg, vm_prot_t prot,
 
   bool kern_mapping = (pmap == pmap_kernel());
 
-  /* Mark user pages as non-referenced & non-modified. */
-  pte_t mask =
-    kern_mapping ? (PTE_VALID | PTE_DIRTY | PTE_SW_FLAGS) : PTE_SW_FLAGS;
+  /* Mark user pages as non-referenced & non-modified, unless `flags` tell
+   * which access is going to happen right away. */
+  pte_t mask = PTE_SW_FLAGS;
+  if (kern_mapping || (flags & PMAP_PROT_MASK))
+    mask |= PTE_VALID;
+  if (kern_mapping || (flags & VM_PROT_WRITE))
+    mask |= PTE_DIRTY;
   pte_t pte = (vm_prot_map[prot] & mask) | empty_pte(pmap);
 
   WITH_MTX_LOCK (&pv_list_lock) {
@@ -334,11 +419,20 @@ void pmap_enter(pmap_t *pmap, vaddr_t va, vm_page_t *pg, vm_prot_t prot,
       pv_entry_t *pv = pv_find(pmap, va, pg);
       if (pv == NULL)
         pv_add(pmap, va, pg);
-      if (kern_mapping)
+      if (kern_mapping) {
         pg->flags |= PG_MODIFIED | PG_REFERENCED;
-      else
+      } else {
         pg->flags &= ~(PG_MODIFIED | PG_REFERENCED);
+        if (pte & PTE_VALID)
+          pg->flags |= PG_REFERENCED;
+        if (pte & PTE_DIRTY)
+          pg->flags |= PG_MODIFIED;
+      }
       pmap_pte_write(pmap, va, PTE_PFN(pa) | pte, flags);
+      /* Frame and page offsets within a superpage have to match. */
+      if (!kern_mapping &&
+          (pa & (SUPERPAGESIZE - 1)) == (va & (SUPERPAGESIZE - 1)))
+        pmap_promote(pmap, va);
     }
   }
 }
@@ -366,6 +460,18 @@ void pmap_remove(pmap_t *pmap, vaddr_t start, vaddr_t end) {
   }
 }
 
+/* Protection that was requested when the page got entered. */
+static vm_prot_t pte_prot(pte_t pte) {
+  vm_prot_t prot = VM_PROT_NONE;
+  if (pte & PTE_SW_READ)
+    prot |= VM_PROT_READ;
+  if (pte & PTE_SW_WRITE)
+    prot |= VM_PROT_WRITE;
+  if (!(pte & PTE_SW_NOEXEC))
+    prot |= VM_PROT_EXEC;
+  return prot;
+}
+
 void pmap_protect(pmap_t *pmap, vaddr_t start, vaddr_t end, vm_prot_t prot) {
   assert(page_aligned_p(start) && page_aligned_p(end) && start < end);
   assert(pmap_contains_p(pmap, start, end));
@@ -373,13 +479,46 @@ void pmap_protect(pmap_t *pmap, vaddr_t start, vaddr_t end, vm_prot_t prot) {
   klog("Change protection bits to %x for address range %p-%p", prot, start,
        end);
 
+  bool changed = false;
+
   WITH_MTX_LOCK (&pmap->mtx) {
     for (vaddr_t va = start; va < end; va += PAGESIZE) {
+      pde_t pde = PDE_OF(pmap, va);
+      if (!is_valid_pde(pde)) {
+        /* Skip whole range that has no page table. */
+        vaddr_t next = (va & PDE_INDEX_MASK) + SUPERPAGESIZE;
+        if (next == 0 || next >= end)
+          break;
+        va = next - PAGESIZE;
+        continue;
+      }
+
       pte_t pte = pmap_pte_read(pmap, va);
-      if (pte == 0)
+      if (PTE_FRAME_ADDR(pte) == 0)
+        continue;
+
+      /* Permissions can only be taken away, as some pages are mapped with
+       * fewer of them than their entry has (e.g. for copy-on-write). Valid
+       * and dirty bits stay set only if the page has been referenced or
+       * modified and the access is still allowed. */
+      pte_t prot_bits = vm_prot_map[pte_prot(pte) & prot];
+      prot_bits &= PTE_SW_FLAGS | (pte & (PTE_VALID | PTE_DIRTY));
+
+      pte_t new_pte = (pte & ~PTE_PROT_MASK) | prot_bits;
+      if (new_pte == pte)
         continue;
-      pmap_pte_write(pmap, va, (pte & ~PTE_PROT_MASK) | vm_prot_map[prot], 0);
+
+      PTE_OF(pmap_demote(pmap, va), va) = new_pte;
+      changed = true;
+
+      if (pmap == pmap_kernel())
+        tlb_invalidate(PTE_VPN2(va) | PTE_ASID(pmap->asid));
     }
+
+    /* Rather than probing TLB for each page, drop all entries of the address
+     * space at once. Kernel entries are global, so they were flushed above. */
+    if (changed && pmap != pmap_kernel())
+      tlb_invalidate_asid(pmap->asid);
   }
 }
 
@@ -418,11 +557,14 @@ static void pmap_modify_flags(vm_page_t *pg, pte_t set, pte_t clr) {
     pmap_t *pmap = pv->pmap;
     vaddr_t va = pv->va;
     WITH_MTX_LOCK (&pmap->mtx) {
-      pde_t pde = PDE_OF(pmap, va);
+      pde_t pde = pmap_demote(pmap, va);
       assert(is_valid_pde(pde));
       pte_t pte = PTE_OF(pde, va);
       pte |= set;
       pte &= ~clr;
+      /* Page may be mapped read-only elsewhere, e.g. for copy-on-write. */
+      if (!(pte & PTE_SW_WRITE))
+        pte &= ~PTE_DIRTY;
       PTE_OF(pde, va) = pte;
       tlb_invalidate(PTE_VPN2(va) | PTE_ASID(pmap->asid));
     }
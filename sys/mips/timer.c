@@ -15,6 +15,8 @@ typedef struct mips_timer_state {
   uint32_t last_count_lo;     /* used to detect counter overflow */
   volatile timercntr_t count; /* last written value of counter reg. (64 bits) */
   volatile timercntr_t compare; /* last read value of compare reg. (64 bits) */
+  bool running;                 /* counter reset and interrupt set up */
+  bool oneshot;                 /* interrupt is not re-armed automatically */
   timer_t timer;
   resource_t *irq_res;
 } mips_timer_state_t;
@@ -35,7 +37,8 @@ static uint64_t read_count(mips_timer_state_t *state) {
   }
   state->cntr_modulo += state->count.lo - state->last_count_lo;
 
-  if (state->cntr_modulo >= state->timer.tm_frequency) {
+  /* tickless clock may not read the counter for a while */
+  while (state->cntr_modulo >= state->timer.tm_frequency) {
     state->cntr_modulo -= state->timer.tm_frequency;
     state->sec++;
   }
@@ -60,33 +63,68 @@ static int set_next_tick(mips_timer_state_t *state) {
   return ticks;
 }
 
+static void set_deadline(mips_timer_state_t *state, uint32_t delta) {
+  SCOPED_INTR_DISABLED();
+
+  /* make sure compare register is not set in the past, or else we would have
+   * to wait for the counter to wrap around */
+  do {
+    state->compare.val = read_count(state) + delta;
+    mips32_set_c0(C0_COMPARE, state->compare.lo);
+    (void)read_count(state);
+    delta *= 2;
+  } while (state->compare.val <= state->count.val);
+}
+
 static intr_filter_t mips_timer_intr(void *data) {
   device_t *dev = data;
   mips_timer_state_t *state = dev->state;
-  /* TODO(cahir): can we tell scheduler that clock ticked more than once? */
-  (void)set_next_tick(state);
+  if (state->oneshot) {
+    /* Acknowledge the interrupt by moving compare register as far as possible
+     * into the future. Callback is expected to set the next deadline. */
+    state->compare.val = read_count(state) - 1;
+    mips32_set_c0(C0_COMPARE, state->compare.lo);
+  } else {
+    /* TODO(cahir): can we tell scheduler that clock ticked more than once? */
+    (void)set_next_tick(state);
+  }
   tm_trigger(&state->timer);
   return IF_FILTERED;
 }
 
 static int mips_timer_start(timer_t *tm, unsigned flags, const bintime_t start,
                             const bintime_t period) {
-  assert(flags & TMF_PERIODIC);
-  assert(!(flags & TMF_ONESHOT));
-
-  mips32_setcount(0);
+  assert(!(flags & TMF_PERIODIC) != !(flags & TMF_ONESHOT));
 
   device_t *dev = tm->tm_priv;
   mips_timer_state_t *state = dev->state;
-  state->sec = 0;
-  state->cntr_modulo = 0;
-  state->last_count_lo = 0;
-  state->period_cntr = bintime_mul(period, tm->tm_frequency).sec;
-  state->compare.val = read_count(state);
-
-  set_next_tick(state);
-  bus_intr_setup(dev, state->irq_res, mips_timer_intr, NULL, dev,
-                 "MIPS CPU timer");
+
+  /* One-shot timer may be re-armed while running. Counter must not be reset
+   * then as it is used as time source. */
+  if (!state->running) {
+    mips32_setcount(0);
+    state->sec = 0;
+    state->cntr_modulo = 0;
+    state->last_count_lo = 0;
+    state->compare.val = read_count(state);
+  }
+
+  if (flags & TMF_ONESHOT) {
+    uint32_t delta =
+      min(bintime_mul(start, tm->tm_frequency).sec, (uint64_t)INT32_MAX);
+    state->oneshot = true;
+    set_deadline(state, max(delta, 1U));
+  } else {
+    state->oneshot = false;
+    state->period_cntr = bintime_mul(period, tm->tm_frequency).sec;
+    set_next_tick(state);
+  }
+
+  if (!state->running) {
+    bus_intr_setup(dev, state->irq_res, mips_timer_intr, NULL, dev,
+                   "MIPS CPU timer");
+    state->running = true;
+  }
   return 0;
 }
 
@@ -94,6 +132,7 @@ static int mips_timer_stop(timer_t *tm) {
   device_t *dev = tm->tm_priv;
   mips_timer_state_t *state = dev->state;
   bus_intr_teardown(dev, state->irq_res);
+  state->running = false;
   return 0;
 }
 
@@ -123,7 +162,7 @@ static int mips_timer_attach(device_t *dev) {
 
   state->timer = (timer_t){
     .tm_name = "mips-cpu-timer",
-    .tm_flags = TMF_PERIODIC,
+    .tm_flags = TMF_PERIODIC | TMF_ONESHOT,
     .tm_quality = 200,
     .tm_frequency = CPU_FREQ,
     .tm_min_period = HZ2BT(CPU_FREQ),
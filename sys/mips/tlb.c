@@ -41,6 +41,7 @@ static inline void _load_tlb_entry(tlbentry_t *e) {
   tlblo_t lo0 = e->lo0;
   tlblo_t lo1 = e->lo1;
   barrier();
+  mips32_setpagemask(0);
   mips32_setentryhi(hi);
   mips32_setentrylo0(lo0);
   mips32_setentrylo1(lo1);
@@ -54,6 +55,8 @@ static inline int _tlb_probe(tlbhi_t hi) {
 
 static inline void _tlb_invalidate(unsigned i) {
   mips32_setindex(i);
+  /* tlbr might have loaded PageMask of a superpage entry. */
+  mips32_setpagemask(0);
   mips32_setentryhi(0);
   mips32_setentrylo0(0);
   mips32_setentrylo1(0);
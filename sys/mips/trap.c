@@ -7,6 +7,7 @@
 #include <mips/tlb.h>
 #include <sys/pmap.h>
 #include <sys/sysent.h>
+#include <sys/ktrace.h>
 #include <sys/thread.h>
 #include <sys/vm_map.h>
 #include <sys/vm_physmem.h>
@@ -55,9 +56,13 @@ static void syscall_handler(ctx_t *ctx, syscall_result_t *result) {
 
   assert(td->td_proc != NULL);
 
+  KTRACE(KTR_SYSCALL_ENTER, code, 0);
+
   if (!error)
     error = se->call(td->td_proc, (void *)args, &retval);
 
+  KTRACE(KTR_SYSCALL_EXIT, code, error);
+
   result->retval = error ? -1 : retval;
   result->error = error;
 }
@@ -143,7 +148,9 @@ static void tlb_exception_handler(ctx_t *ctx) {
   if (error == 0)
     return;
 
-  if (error == EACCES || error == EINVAL)
+  /* Insufficient permissions may mean copy-on-write, let vm_page_fault
+   * decide whether the access is legal. */
+  if (error == EINVAL)
     goto fault;
 
   vm_map_t *vmap = vm_map_lookup(vaddr);
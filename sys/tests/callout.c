@@ -4,6 +4,8 @@
 #include <sys/time.h>
 #include <sys/ktest.h>
 #include <sys/interrupt.h>
+#include <sys/kmem.h>
+#include <sys/mimiker.h>
 
 static int counter;
 
@@ -103,7 +105,107 @@ static int test_callout_drain(void) {
   return KTEST_SUCCESS;
 }
 
+/* This test checks that a callout scheduled far ahead is not run before its
+ * deadline, even if no clock interrupt is programmed for it in advance. */
+static systime_t fired;
+
+static void callout_record(void *arg) {
+  fired = getsystime();
+}
+
+static int test_callout_deadline(void) {
+  callout_t callout;
+  callout_setup(&callout, callout_record, NULL);
+
+  for (systime_t delay = 1; delay <= 64; delay *= 4) {
+    systime_t when = getsystime() + delay;
+    callout_schedule_abs(&callout, when);
+    callout_drain(&callout);
+    assert(fired >= when);
+  }
+
+  return KTEST_SUCCESS;
+}
+
+/* This test schedules lots of callouts at random moments with sub-tick
+ * resolution, cancels some of them and checks that the rest runs in order,
+ * never before its deadline. */
+#define WHEEL_N 100000
+#define WHEEL_UNIT (1ULL << 12) /* timing wheel resolution in c_time units */
+
+static callout_t *wheel_callouts;
+static uint64_t wheel_last;
+static unsigned wheel_count;
+
+static bool wheel_cancelled(callout_t *co) {
+  return (co - wheel_callouts) % 4 == 3;
+}
+
+static void callout_wheel(void *arg) {
+  callout_t *co = arg;
+  bintime_t now = binuptime();
+  uint64_t ct = ((uint64_t)now.sec << 32) | (now.frac >> 32);
+
+  assert(!wheel_cancelled(co));
+  assert(ct >= co->c_time);
+  /* Callouts that fall into the same wheel unit may run in any order. */
+  assert(co->c_time + WHEEL_UNIT > wheel_last);
+  wheel_last = max(wheel_last, co->c_time);
+  wheel_count++;
+}
+
+static uint64_t elapsed_us(bintime_t start) {
+  bintime_t elapsed = binuptime();
+  bintime_sub(&elapsed, &start);
+  timespec_t ts;
+  bt2ts(&elapsed, &ts);
+  return max((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000, (uint64_t)1);
+}
+
+static int test_callout_wheel(void) {
+  size_t size = roundup(WHEEL_N * sizeof(callout_t), PAGESIZE);
+  callout_t *callouts = kmem_alloc(size, M_ZERO);
+  unsigned seed = 1, expected = 0;
+
+  wheel_callouts = callouts;
+  wheel_last = 0;
+  wheel_count = 0;
+
+  bintime_t start = binuptime();
+  for (int i = 0; i < WHEEL_N; i++) {
+    callout_t *co = &callouts[i];
+    /* Deadlines are spread over 500ms starting 2s from now, which is far more
+     * than scheduling takes even on slow emulators, so no callout can run or
+     * get cancelled before it is placed on the wheel. */
+    bintime_t when = start;
+    seed = seed * 1103515245 + 12345;
+    when.sec += 2;
+    bintime_add_frac(&when, (uint64_t)seed << 31);
+    callout_setup(co, callout_wheel, co);
+    callout_schedule_bt(co, when);
+    if (wheel_cancelled(co))
+      assert(callout_stop(co));
+    else
+      expected++;
+  }
+  uint64_t sched_us = elapsed_us(start);
+
+  for (int i = 0; i < WHEEL_N; i++)
+    callout_drain(&callouts[i]);
+  uint64_t total_us = elapsed_us(start);
+
+  assert(wheel_count == expected);
+  klog("callout: %u schedules/s, all %u callouts done in %u ms",
+       (unsigned)((uint64_t)WHEEL_N * 1000000 / sched_us), WHEEL_N,
+       (unsigned)(total_us / 1000));
+
+  kmem_free(callouts, size);
+  return KTEST_SUCCESS;
+}
+
 KTEST_ADD(callout_simple, test_callout_simple, 0);
 KTEST_ADD(callout_order, test_callout_order, 0);
 KTEST_ADD(callout_stop, test_callout_stop, 0);
 KTEST_ADD(callout_drain, test_callout_drain, 0);
+KTEST_ADD(callout_deadline, test_callout_deadline, 0);
+KTEST_ADD(callout_wheel, test_callout_wheel, 0);
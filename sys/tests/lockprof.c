@@ -0,0 +1,74 @@
+#include <sys/mimiker.h>
+#include <sys/cred.h>
+#include <sys/kmem.h>
+#include <sys/ktest.h>
+#include <sys/libkern.h>
+#include <sys/lockprof.h>
+#include <sys/mutex.h>
+#include <sys/uio.h>
+#include <sys/vfs.h>
+#include <sys/vm_map.h>
+#include <sys/vnode.h>
+
+#if LOCKPROF
+
+#define NLOCKS 100
+#define BUFSIZE (LOCKPROF_MAX_RECORDS * 128)
+
+static MTX_DEFINE(lockprof_test_mtx, 0);
+
+/* Returns number of acquisitions of lockprof_test_mtx reported by
+ * /dev/lockprof or -1 if the mutex is not mentioned there. */
+static int acquisitions(vnode_t *v, char *buf) {
+  uio_t uio = UIO_SINGLE_KERNEL(UIO_READ, 0, buf, BUFSIZE - 1);
+  int error = VOP_READ(v, &uio);
+  assert(error == 0);
+  buf[BUFSIZE - 1 - uio.uio_resid] = '\0';
+
+  char *line, *rest = buf;
+  int count = -1;
+
+  while ((line = strsep(&rest, "\n"))) {
+    char *name = strsep(&line, " ");
+    if (strcmp(name, "lockprof_test_mtx") || line == NULL)
+      continue;
+    (void)strsep(&line, " "); /* site */
+    (void)strsep(&line, " "); /* type */
+    /* The mutex is acquired at one site only. */
+    assert(count < 0);
+    count = strtoul(line, NULL, 10);
+  }
+
+  return count;
+}
+
+static int test_lockprof(void) {
+  char *buf = kmem_alloc(BUFSIZE, 0);
+  vnode_t *v;
+  uio_t uio;
+  int error;
+
+  error = vfs_namelookup("/dev/lockprof", &v, cred_self());
+  assert(error == 0);
+
+  /* Reset statistics. */
+  uio = UIO_SINGLE_KERNEL(UIO_WRITE, 0, buf, 1);
+  error = VOP_WRITE(v, &uio);
+  assert(error == 0);
+  assert(acquisitions(v, buf) < 0);
+
+  for (int i = 0; i < NLOCKS; i++) {
+    mtx_lock(&lockprof_test_mtx);
+    mtx_unlock(&lockprof_test_mtx);
+  }
+
+  assert(acquisitions(v, buf) == NLOCKS);
+
+  vnode_drop(v);
+  kmem_free(buf, BUFSIZE);
+  return KTEST_SUCCESS;
+}
+
+KTEST_ADD(lockprof, test_lockprof, 0);
+
+#endif /* !LOCKPROF */
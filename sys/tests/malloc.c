@@ -0,0 +1,78 @@
+#include <sys/mimiker.h>
+#include <sys/klog.h>
+#include <sys/ktest.h>
+#include <sys/libkern.h>
+#include <sys/malloc.h>
+#include <sys/time.h>
+
+#define BENCH_NBLOCKS 64
+#define BENCH_NROUNDS 1000
+
+static const size_t bench_size[] = {8,   24,  40,  64,  100,
+                                    128, 200, 256, 500, 1000};
+
+#define NSIZES (sizeof(bench_size) / sizeof(bench_size[0]))
+
+static void *bench_block[BENCH_NBLOCKS];
+
+/* Returns number of kmalloc & kfree pairs done per second for a mix of small
+ * sizes. */
+static unsigned kmalloc_bench(void) {
+  unsigned seed = 0;
+  bintime_t start = binuptime();
+
+  for (int r = 0; r < BENCH_NROUNDS; r++) {
+    for (int i = 0; i < BENCH_NBLOCKS; i++) {
+      size_t size = bench_size[(seed++ * 7) % NSIZES];
+      bench_block[i] = kmalloc(M_TEST, size, 0);
+      *(uint8_t *)bench_block[i] = i;
+    }
+    for (int i = 0; i < BENCH_NBLOCKS; i++)
+      kfree(M_TEST, bench_block[i]);
+  }
+
+  bintime_t elapsed = binuptime();
+  bintime_sub(&elapsed, &start);
+
+  timespec_t ts;
+  bt2ts(&elapsed, &ts);
+  uint64_t us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  uint64_t nops = (uint64_t)BENCH_NROUNDS * BENCH_NBLOCKS;
+  return nops * 1000000 / max(us, (uint64_t)1);
+}
+
+/* Compares the arena allocator with size class pools in front of it. */
+static int test_kmalloc_bench(void) {
+  bool use_classes = kmalloc_use_classes;
+
+  kmalloc_use_classes = false;
+  unsigned arena = kmalloc_bench();
+  kmalloc_use_classes = use_classes;
+  unsigned classes = kmalloc_bench();
+
+  klog("kmalloc: %u allocs/s with arena only, %u allocs/s with size classes",
+       arena, classes);
+
+  return KTEST_SUCCESS;
+}
+
+KTEST_ADD(kmalloc_bench, test_kmalloc_bench, 0);
+
+/* Blocks must keep their contents when moved between size classes and
+ * the arena. */
+static int test_krealloc(void) {
+  static const size_t sizes[7] = {10, 16, 100, 1000, 3000, 40, 1};
+  uint8_t *ptr = kmalloc(M_TEST, 1, 0);
+  *ptr = 0xaa;
+
+  for (int i = 0; i < 7; i++) {
+    ptr = krealloc(M_TEST, ptr, sizes[i], 0);
+    if (ptr == NULL || *ptr != 0xaa)
+      return KTEST_FAILURE;
+  }
+
+  kfree(M_TEST, ptr);
+  return KTEST_SUCCESS;
+}
+
+KTEST_ADD(krealloc, test_krealloc, 0);
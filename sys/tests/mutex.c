@@ -43,6 +43,49 @@ static int test_mutex_counter(void) {
   return KTEST_SUCCESS;
 }
 
+/* Short critical sections are where spinning pays off. */
+static void spin_routine(void *arg) {
+  for (size_t i = 0; i < COUNTER_N * 10; i++) {
+    mtx_lock(&counter_mtx);
+    counter_value++;
+    mtx_unlock(&counter_mtx);
+  }
+}
+
+static int test_mutex_spin(void) {
+  mtx_stats_t before, after;
+
+  counter_value = 0;
+  mtx_stats(&before);
+
+  for (int i = 0; i < COUNTER_T; i++) {
+    char name[20];
+    snprintf(name, sizeof(name), "test-mutex-%d", i);
+    counter_td[i] = thread_create(name, spin_routine, NULL, prio_kthread(0));
+  }
+
+  for (int i = 0; i < COUNTER_T; i++)
+    sched_add(counter_td[i]);
+  for (int i = 0; i < COUNTER_T; i++)
+    thread_join(counter_td[i]);
+
+  mtx_stats(&after);
+
+  assert(counter_value == COUNTER_N * 10 * COUNTER_T);
+
+  unsigned spins = after.ms_spins - before.ms_spins;
+  unsigned acquired = after.ms_acquired - before.ms_acquired;
+  unsigned blocks = after.ms_blocks - before.ms_blocks;
+  klog("mutex spins %u (acquired %u), blocks %u", spins, acquired, blocks);
+
+  /* Every acquisition after spinning is preceded by a spin. */
+  assert(after.ms_acquired <= after.ms_spins);
+  if (!SMP)
+    assert(spins == 0);
+
+  return KTEST_SUCCESS;
+}
+
 typedef enum rtn_state {
   ST_INITIAL,
   ST_LOCKING,
@@ -93,3 +136,4 @@ static int test_mutex_simple(void) {
 
 KTEST_ADD(mutex_counter, test_mutex_counter, 0);
 KTEST_ADD(mutex_simple, test_mutex_simple, 0);
+KTEST_ADD(mutex_spin, test_mutex_spin, 0);
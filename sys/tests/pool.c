@@ -54,3 +54,37 @@ static int test_pool_alloc_doublefree(void) {
 KTEST_ADD(pool_alloc_regular, test_pool_alloc_regular, 0);
 KTEST_ADD(pool_alloc_corruption, test_pool_alloc_corruption, KTEST_FLAG_BROKEN);
 KTEST_ADD(pool_alloc_doublefree, test_pool_alloc_doublefree, KTEST_FLAG_BROKEN);
+
+#define REUSE_NITEMS 1000
+#define REUSE_NROUNDS 10
+
+/* Objects go through per-CPU magazines and the depot, yet no object may be
+ * handed out twice. */
+static int test_pool_reuse(void) {
+  pool_t *test = pool_create("test", sizeof(uint32_t));
+  uint32_t **item = kmalloc(M_TEST, sizeof(uint32_t *) * REUSE_NITEMS, 0);
+  int result = KTEST_SUCCESS;
+
+  for (int r = 0; r < REUSE_NROUNDS && result == KTEST_SUCCESS; r++) {
+    /* Free a different amount each round to leave magazines partially full. */
+    int n = REUSE_NITEMS - r * 37;
+
+    for (int i = 0; i < n; i++) {
+      item[i] = pool_alloc(test, 0);
+      *item[i] = i;
+    }
+
+    for (int i = 0; i < n; i++)
+      if (*item[i] != (uint32_t)i)
+        result = KTEST_FAILURE;
+
+    for (int i = 0; i < n; i++)
+      pool_free(test, item[i]);
+  }
+
+  kfree(M_TEST, item);
+  pool_destroy(test);
+  return result;
+}
+
+KTEST_ADD(pool_reuse, test_pool_reuse, 0);
@@ -0,0 +1,156 @@
+#include <sys/klog.h>
+#include <sys/libkern.h>
+#include <sys/ktest.h>
+#include <sys/runq.h>
+#include <sys/rwlock.h>
+#include <sys/sched.h>
+#include <sys/thread.h>
+
+static RW_DEFINE(counter_rw);
+static volatile int32_t counter_value;
+
+#define COUNTER_N 100
+#define COUNTER_T 6
+
+static thread_t *counter_td[COUNTER_T];
+
+static void writer_routine(void *arg) {
+  for (size_t i = 0; i < COUNTER_N; i++) {
+    WITH_RW_WLOCK (&counter_rw) {
+      int32_t v = counter_value;
+      thread_yield();
+      counter_value = v + 1;
+    }
+  }
+}
+
+static void reader_routine(void *arg) {
+  for (size_t i = 0; i < COUNTER_N; i++) {
+    WITH_RW_RLOCK (&counter_rw) {
+      int32_t v = counter_value;
+      thread_yield();
+      /* Writers must not get in while we're holding the lock. */
+      assert(v == counter_value);
+    }
+  }
+}
+
+/* Even threads write, odd threads only read the counter. */
+static int test_rwlock_counter(void) {
+  counter_value = 0;
+
+  for (int i = 0; i < COUNTER_T; i++) {
+    char name[20];
+    snprintf(name, sizeof(name), "test-rwlock-%d", i);
+    void (*fn)(void *) = (i & 1) ? reader_routine : writer_routine;
+    counter_td[i] = thread_create(name, fn, NULL, prio_kthread(0));
+  }
+
+  for (int i = 0; i < COUNTER_T; i++)
+    sched_add(counter_td[i]);
+  for (int i = 0; i < COUNTER_T; i++)
+    thread_join(counter_td[i]);
+
+  assert(counter_value == COUNTER_N * (COUNTER_T / 2));
+  assert(!rw_locked(&counter_rw));
+
+  return KTEST_SUCCESS;
+}
+
+static atomic_int readers_inside;
+
+static void shared_routine(void *arg) {
+  WITH_RW_RLOCK (&counter_rw) {
+    atomic_fetch_add(&readers_inside, 1);
+    /* Would never finish if readers were serialized. */
+    while (readers_inside < COUNTER_T)
+      thread_yield();
+  }
+}
+
+static int test_rwlock_shared(void) {
+  readers_inside = 0;
+
+  for (int i = 0; i < COUNTER_T; i++) {
+    char name[20];
+    snprintf(name, sizeof(name), "test-rwlock-%d", i);
+    counter_td[i] = thread_create(name, shared_routine, NULL, prio_kthread(0));
+  }
+
+  WITH_RW_RLOCK (&counter_rw) {
+    for (int i = 0; i < COUNTER_T; i++)
+      sched_add(counter_td[i]);
+    for (int i = 0; i < COUNTER_T; i++)
+      thread_join(counter_td[i]);
+  }
+
+  assert(readers_inside == COUNTER_T);
+  assert(!rw_locked(&counter_rw));
+
+  return KTEST_SUCCESS;
+}
+
+/* Priority of a writer is raised by a reader that blocks on its lock.
+ * Setup is the same as in turnstile_propagate_once test. */
+
+static RW_DEFINE(prio_rw);
+static thread_t *prio_td[3];
+static volatile bool high_prio_acquired;
+static prio_t LOW, MED, HIGH;
+
+static void low_prio_task(void *arg) {
+  WITH_NO_PREEMPTION {
+    sched_add(prio_td[1]);
+    sched_add(prio_td[2]);
+
+    WITH_RW_WLOCK (&prio_rw) {
+      thread_yield();
+
+      /* Reader blocked on the lock and lent us its priority. */
+      assert(prio_eq(thread_self()->td_prio, HIGH));
+      assert(td_is_borrowing(thread_self()));
+      assert(!high_prio_acquired);
+    }
+  }
+
+  assert(high_prio_acquired);
+  assert(!td_is_borrowing(thread_self()));
+  assert(prio_eq(thread_self()->td_prio, LOW));
+}
+
+static void med_prio_task(void *arg) {
+  /* Without priority propagation it would run before the reader. */
+  assert(high_prio_acquired);
+}
+
+static void high_prio_task(void *arg) {
+  assert(rw_locked(&prio_rw));
+
+  WITH_RW_RLOCK (&prio_rw)
+    high_prio_acquired = true;
+}
+
+static int test_rwlock_propagate(void) {
+  high_prio_acquired = false;
+
+  /* HACK: Priorities differ by RQ_PPQ so that threads occupy different runq. */
+  HIGH = prio_kthread(0);
+  MED = HIGH + RQ_PPQ;
+  LOW = MED + RQ_PPQ;
+
+  prio_td[0] = thread_create("test-rwlock-low", low_prio_task, NULL, LOW);
+  prio_td[1] = thread_create("test-rwlock-med", med_prio_task, NULL, MED);
+  prio_td[2] = thread_create("test-rwlock-high", high_prio_task, NULL, HIGH);
+
+  /* We want to ensure that low priority thread will take the lock first. */
+  sched_add(prio_td[0]);
+
+  for (int i = 0; i < 3; i++)
+    thread_join(prio_td[i]);
+
+  return KTEST_SUCCESS;
+}
+
+KTEST_ADD(rwlock_counter, test_rwlock_counter, 0);
+KTEST_ADD(rwlock_propagate, test_rwlock_propagate, 0);
+KTEST_ADD(rwlock_shared, test_rwlock_shared, 0);
@@ -3,6 +3,8 @@
 #include <sys/time.h>
 #include <sys/thread.h>
 #include <sys/sched.h>
+#include <sys/runq.h>
+#include <sys/smp.h>
 #include <sys/vm_map.h>
 #include <sys/vm_pager.h>
 #include <sys/ktest.h>
@@ -95,3 +97,78 @@ static int test_sched(void) {
 
 KTEST_ADD(sched, test_sched, KTEST_FLAG_NORETURN);
 #endif
+
+static thread_t runq_threads[3];
+
+static int test_runq_choose(void) {
+  static runq_t rq;
+  static const prio_t prio[3] = {200, 5, 130};
+
+  runq_init(&rq);
+  if (runq_choose(&rq) != NULL)
+    return KTEST_FAILURE;
+
+  for (int i = 0; i < 3; i++) {
+    runq_threads[i].td_prio = prio[i];
+    runq_add(&rq, &runq_threads[i]);
+  }
+
+  /* Threads must come out in order of decreasing priority. */
+  static const int order[3] = {1, 2, 0};
+  for (int i = 0; i < 3; i++) {
+    thread_t *td = runq_choose(&rq);
+    if (td != &runq_threads[order[i]])
+      return KTEST_FAILURE;
+    runq_remove(&rq, td);
+  }
+
+  return runq_choose(&rq) == NULL ? KTEST_SUCCESS : KTEST_FAILURE;
+}
+
+KTEST_ADD(runq_choose, test_runq_choose, 0);
+
+#define CTXSW_NTHREADS 256
+#define CTXSW_NYIELDS 100
+
+static thread_t *ctxsw_threads[CTXSW_NTHREADS];
+
+static void ctxsw_thread(void *arg) {
+  for (int i = 0; i < CTXSW_NYIELDS; i++)
+    thread_yield();
+}
+
+/* Measures the cost of a context switch with many runnable threads. */
+static int test_sched_ctxsw(void) {
+  /* Use the lowest priority, so that threads start only when we wait for
+   * them, and then always have plenty of runnable peers to switch to. */
+  for (int i = 0; i < CTXSW_NTHREADS; i++) {
+    ctxsw_threads[i] = thread_create("ctxsw-thread", ctxsw_thread, NULL,
+                                     prio_uthread(PRIO_QTY - 1));
+    sched_add(ctxsw_threads[i]);
+  }
+
+  bintime_t start = binuptime();
+
+  unsigned nctxsw = 0;
+  for (int i = 0; i < CTXSW_NTHREADS; i++) {
+    thread_join(ctxsw_threads[i]);
+    nctxsw += ctxsw_threads[i]->td_nctxsw;
+  }
+
+  bintime_t elapsed = binuptime();
+  bintime_sub(&elapsed, &start);
+
+  timespec_t ts;
+  bt2ts(&elapsed, &ts);
+  uint64_t ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+  klog("%u context switches among %d threads took %u us (%u ns each)", nctxsw,
+       CTXSW_NTHREADS, (unsigned)(ns / 1000), (unsigned)(ns / max(nctxsw, 1U)));
+
+  /* Yields of the last thread left running on a processor do not switch
+   * context. */
+  unsigned expected = (CTXSW_NTHREADS - ncpus + 1) * (CTXSW_NYIELDS - 1);
+  return nctxsw >= expected ? KTEST_SUCCESS : KTEST_FAILURE;
+}
+
+KTEST_ADD(sched_ctxsw, test_sched_ctxsw, 0);
@@ -0,0 +1,92 @@
+#include <sys/mimiker.h>
+#include <sys/klog.h>
+#include <sys/ktest.h>
+#include <sys/pcpu.h>
+#include <sys/sched.h>
+#include <sys/smp.h>
+#include <sys/thread.h>
+#include <sys/time.h>
+
+static int test_smp_cpuid(void) {
+  if (ncpus < 1 || ncpus > MAXCPU)
+    return KTEST_FAILURE;
+
+  unsigned cpuid = PCPU_GET(cpuid);
+  if (cpuid >= ncpus || PCPU_SELF() != &_pcpu_data[cpuid])
+    return KTEST_FAILURE;
+
+  /* Every processor that is up must run its own idle thread. */
+  for (unsigned i = 0; i < ncpus; i++) {
+    thread_t *idle = _pcpu_data[i].idle_thread;
+    if (idle == NULL || _pcpu_data[i].cpuid != i)
+      return KTEST_FAILURE;
+    for (unsigned j = 0; j < i; j++)
+      if (_pcpu_data[j].idle_thread == idle)
+        return KTEST_FAILURE;
+  }
+
+  return KTEST_SUCCESS;
+}
+
+KTEST_ADD(smp_cpuid, test_smp_cpuid, 0);
+
+#define WORK_ITERS (1 << 22)
+
+static thread_t *work_threads[MAXCPU];
+static volatile uint32_t work_result[MAXCPU];
+
+/* CPU-bound loop that does not touch any shared data. */
+static void work_thread(void *arg) {
+  uint32_t x = (uintptr_t)arg + 1;
+  for (int i = 0; i < WORK_ITERS; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+  }
+  work_result[(uintptr_t)arg] = x;
+}
+
+/* Returns time (in us) it took `n` threads to finish the same amount of work
+ * each. */
+static uint64_t run_workers(unsigned n) {
+  bintime_t start = binuptime();
+
+  for (unsigned i = 0; i < n; i++) {
+    work_threads[i] = thread_create("test-smp-work", work_thread,
+                                    (void *)(uintptr_t)i, prio_kthread(0));
+    sched_add(work_threads[i]);
+  }
+
+  for (unsigned i = 0; i < n; i++)
+    thread_join(work_threads[i]);
+
+  bintime_t elapsed = binuptime();
+  bintime_sub(&elapsed, &start);
+
+  timespec_t ts;
+  bt2ts(&elapsed, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Checks whether independent threads are spread among processors. Threads
+ * are woken up on least loaded processors, so with N processors N threads
+ * should take about as long as a single one. */
+static int test_smp_scaling(void) {
+  uint64_t single = run_workers(1);
+  uint64_t parallel = run_workers(ncpus);
+
+  /* Speedup times 100, ideally equal to 100 * ncpus. */
+  unsigned speedup = single * ncpus * 100 / max(parallel, (uint64_t)1);
+
+  klog("%u threads took %u us, single thread took %u us, speedup: %u.%02u",
+       ncpus, (unsigned)parallel, (unsigned)single, speedup / 100,
+       speedup % 100);
+
+  /* Be forgiving, emulated processors may share host cores. */
+  if (ncpus > 1 && speedup < 100 * (ncpus + 1) / 2)
+    return KTEST_FAILURE;
+
+  return KTEST_SUCCESS;
+}
+
+KTEST_ADD(smp_scaling, test_smp_scaling, 0);
@@ -65,6 +65,11 @@ UTEST_ADD_SIMPLE(munmap);
 UTEST_ADD_SIGNAL(munmap_sigsegv, SIGSEGV);
 UTEST_ADD_SIMPLE(mmap_prot_none);
 UTEST_ADD_SIMPLE(mmap_prot_read);
+UTEST_ADD_SIMPLE(mmap_file_private);
+UTEST_ADD_SIMPLE(mmap_file_shared);
+UTEST_ADD_SIMPLE(mmap_file_self);
+UTEST_ADD_SIMPLE(mmap_file_throughput);
+UTEST_ADD_SIMPLE(mprotect);
 UTEST_ADD_SIMPLE(sbrk);
 UTEST_ADD_SIGNAL(sbrk_sigsegv, SIGSEGV);
 UTEST_ADD_SIMPLE(misbehave);
@@ -97,6 +102,7 @@ UTEST_ADD_SIMPLE(signal_handler_mask);
 UTEST_ADD_SIMPLE(fork_wait);
 UTEST_ADD_SIMPLE(fork_signal);
 UTEST_ADD_SIMPLE(fork_sigchld_ignored);
+UTEST_ADD_SIMPLE(fork_cow);
 
 UTEST_ADD_SIMPLE(lseek_basic);
 UTEST_ADD_SIMPLE(lseek_errors);
@@ -121,6 +127,7 @@ UTEST_ADD_SIMPLE(vfs_trunc);
 UTEST_ADD_SIMPLE(vfs_symlink);
 UTEST_ADD_SIMPLE(vfs_link);
 UTEST_ADD_SIMPLE(vfs_chmod);
+UTEST_ADD_SIMPLE(vfs_bigdir);
 
 UTEST_ADD_SIMPLE(wait_basic);
 UTEST_ADD_SIMPLE(wait_nohang);
@@ -183,5 +190,22 @@ UTEST_ADD_SIMPLE(tty_signals);
 
 UTEST_ADD_SIMPLE(procstat);
 
+UTEST_ADD_SIMPLE(ktrace);
+UTEST_ADD_SIMPLE(kprof);
+
 UTEST_ADD_SIMPLE(pipe_parent_signaled);
 UTEST_ADD_SIMPLE(pipe_child_signaled);
+UTEST_ADD_SIMPLE(pipe_throughput);
+
+UTEST_ADD_SIMPLE(kqueue_pipe);
+UTEST_ADD_SIMPLE(kqueue_timer);
+UTEST_ADD_SIMPLE(kqueue_proc);
+UTEST_ADD_SIMPLE(kqueue_signal);
+UTEST_ADD_SIMPLE(kqueue_latency);
+
+UTEST_ADD_SIMPLE(pthread_mutex);
+UTEST_ADD_SIMPLE(pthread_cond);
+UTEST_ADD_SIMPLE(pthread_exit);
+
+UTEST_ADD_SIMPLE(futex_timedwait);
+UTEST_ADD_SIMPLE(futex_shared);
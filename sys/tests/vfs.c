@@ -1,5 +1,6 @@
 #include <sys/mount.h>
 #include <sys/libkern.h>
+#include <sys/devfs.h>
 #include <sys/vfs.h>
 #include <sys/vnode.h>
 #include <sys/errno.h>
@@ -87,3 +88,48 @@ static int test_vfs(void) {
 }
 
 KTEST_ADD(vfs, test_vfs, 0);
+
+static int test_vfs_namecache(void) {
+  vnode_t *v, *v2;
+  devfs_node_t *d;
+  nchstats_t before, after;
+  int error;
+  cred_t *cred = cred_self();
+
+  vfs_cache_stats(&before);
+
+  /* The first lookup fails in devfs and leaves a negative entry. */
+  error = vfs_namelookup("/dev/nctest", &v, cred);
+  assert(error == ENOENT);
+  error = vfs_namelookup("/dev/nctest", &v, cred);
+  assert(error == ENOENT);
+
+  vfs_cache_stats(&after);
+  assert(after.ncs_neghits > before.ncs_neghits);
+
+  /* Creating the entry must invalidate the negative entry. */
+  error = devfs_makedir(NULL, "nctest", &d);
+  assert(error == 0);
+  error = vfs_namelookup("/dev/nctest", &v, cred);
+  assert(error == 0);
+  error = vfs_namelookup("/dev/nctest", &v2, cred);
+  assert(error == 0 && v == v2);
+  /* Cache entries do not hold references. */
+  assert(v->v_usecnt == 3);
+
+  vfs_cache_stats(&before);
+  assert(before.ncs_hits > after.ncs_hits);
+
+  /* Removal of the entry must invalidate the positive entry. */
+  error = devfs_unlink(d);
+  assert(error == 0);
+  error = vfs_namelookup("/dev/nctest", &v2, cred);
+  assert(error == ENOENT);
+
+  vnode_drop(v);
+  vnode_drop(v);
+
+  return KTEST_SUCCESS;
+}
+
+KTEST_ADD(vfs_namecache, test_vfs_namecache, 0);
@@ -8,13 +8,21 @@
 #include <sys/thread.h>
 #include <sys/ktest.h>
 #include <sys/sched.h>
+#include <sys/pmap.h>
+#include <sys/vfs.h>
+#include <sys/vnode.h>
+#include <sys/cred.h>
+#include <sys/time.h>
 
 #ifdef __mips__
 #define TOO_MUCH 0x40000000
+/* Malta board has only 128MiB of RAM. */
+#define FAULT_BENCH_SIZE (32 * 1024 * 1024)
 #endif
 
 #ifdef __aarch64__
 #define TOO_MUCH 0x800000000000L
+#define FAULT_BENCH_SIZE (64 * 1024 * 1024)
 #endif
 
 static int paging_on_demand_and_memory_protection_demo(void) {
@@ -160,5 +168,327 @@ static int findspace_demo(void) {
   return KTEST_SUCCESS;
 }
 
+static int copy_on_write_demo(void) {
+  /* This test mustn't be preempted since PCPU's user-space vm_map will not be
+   * restored while switching back. */
+  SCOPED_NO_PREEMPTION();
+
+  vm_map_t *orig = vm_map_user();
+
+  vm_map_t *umap = vm_map_new();
+  vm_map_activate(umap);
+
+  const int npages = 16;
+  const vaddr_t start = 0x1000000;
+  const vaddr_t end = start + npages * PAGESIZE;
+  int n;
+
+#define PAGE_WORD(i) (*(volatile unsigned *)(start + (i)*PAGESIZE))
+
+  vm_object_t *obj = vm_object_alloc(VM_ANONYMOUS);
+  vm_map_entry_t *ent = vm_map_entry_alloc(
+    obj, start, end, VM_PROT_READ | VM_PROT_WRITE, VM_ENT_PRIVATE);
+  n = vm_map_insert(umap, ent, VM_FIXED);
+  assert(n == 0);
+
+  for (int i = 0; i < npages; i++)
+    PAGE_WORD(i) = i;
+
+  /* Cloning the map must not copy any pages. */
+  unsigned copies = vm_cow_copies;
+  vm_map_t *cmap = vm_map_clone(umap);
+  assert(vm_cow_copies == copies);
+
+  /* Parent writes to every other page, each write copies one page. */
+  for (int i = 0; i < npages; i += 2)
+    PAGE_WORD(i) = i + 100;
+  assert(vm_cow_copies == copies + npages / 2);
+
+  /* Child sees original contents and reading does not copy pages. */
+  vm_map_activate(cmap);
+  for (int i = 0; i < npages; i++)
+    assert(PAGE_WORD(i) == (unsigned)i);
+  assert(vm_cow_copies == copies + npages / 2);
+
+  for (int i = 0; i < npages; i++)
+    PAGE_WORD(i) = i + 200;
+  assert(vm_cow_copies == copies + npages + npages / 2);
+
+  /* Child's writes are not visible to the parent. */
+  vm_map_activate(umap);
+  for (int i = 0; i < npages; i++)
+    assert(PAGE_WORD(i) == (unsigned)((i % 2) ? i : i + 100));
+
+  vm_map_delete(cmap);
+
+  /* Original pages are now referenced by the parent only. */
+  copies = vm_cow_copies;
+  cmap = vm_map_clone(umap);
+  for (int i = 0; i < npages; i++)
+    PAGE_WORD(i) = i + 300;
+  assert(vm_cow_copies == copies + npages);
+
+  vm_map_activate(cmap);
+  for (int i = 0; i < npages; i++)
+    assert(PAGE_WORD(i) == (unsigned)((i % 2) ? i : i + 100));
+
+#undef PAGE_WORD
+
+  vm_map_activate(umap);
+  vm_map_delete(cmap);
+  vm_map_delete(umap);
+
+  /* Restore original vm_map */
+  vm_map_activate(orig);
+
+  return KTEST_SUCCESS;
+}
+
+static int vnode_pager_demo(void) {
+  /* This test mustn't be preempted since PCPU's user-space vm_map will not be
+   * restored while switching back. */
+  SCOPED_NO_PREEMPTION();
+
+  vm_map_t *orig = vm_map_user();
+
+  vnode_t *vn;
+  int error = vfs_namelookup("/bin/ksh", &vn, cred_self());
+  assert(error == 0);
+
+  /* All mappings of a file share the same object. */
+  vm_object_t *obj = vnode_pager_object(vn);
+  vm_object_t *obj2 = vnode_pager_object(vn);
+  assert(obj == obj2);
+  vm_object_drop(obj2);
+
+  const vaddr_t start = 0x1000000;
+  const vaddr_t end = start + 2 * PAGESIZE;
+  volatile uint8_t *ptr = (volatile uint8_t *)start;
+  vm_map_t *map[2];
+  paddr_t pa[2];
+
+  for (int i = 0; i < 2; i++) {
+    map[i] = vm_map_new();
+    vm_map_activate(map[i]);
+
+    vm_map_entry_t *ent = vm_map_entry_alloc(
+      vm_object_shadow(obj), start, end, VM_PROT_READ | VM_PROT_WRITE,
+      VM_ENT_PRIVATE);
+    error = vm_map_insert(map[i], ent, VM_FIXED);
+    assert(error == 0);
+
+    /* Pages are read in from the file on first access. */
+    assert(ptr[0] == 0x7f && ptr[1] == 'E' && ptr[2] == 'L' && ptr[3] == 'F');
+    assert(pmap_extract(pmap_user(), start, &pa[i]));
+  }
+
+  /* Clean pages are shared between all mappings. */
+  assert(pa[0] == pa[1]);
+  assert(obj->vo_npages == 1);
+
+  /* Writes are private to the mapping. */
+  ptr[0] = 0;
+  vm_map_activate(map[0]);
+  assert(ptr[0] == 0x7f);
+
+  vm_object_drop(obj);
+  vm_map_delete(map[0]);
+  vm_map_delete(map[1]);
+  vnode_drop(vn);
+
+  /* Restore original vm_map */
+  vm_map_activate(orig);
+
+  return KTEST_SUCCESS;
+}
+
+static int superpage_demo(void) {
+  /* This test mustn't be preempted since PCPU's user-space vm_map will not be
+   * restored while switching back. */
+  SCOPED_NO_PREEMPTION();
+
+  vm_map_t *orig = vm_map_user();
+
+  vm_map_t *umap = vm_map_new();
+  vm_map_activate(umap);
+
+  const size_t npages = SUPERPAGESIZE / PAGESIZE;
+  const vaddr_t start = 0x1000000;
+  const vaddr_t end = start + SUPERPAGESIZE;
+  paddr_t pa, first;
+
+#define PAGE_WORD(i) (*(volatile unsigned *)(start + (i)*PAGESIZE))
+
+  vm_object_t *obj = vm_object_alloc(VM_ANONYMOUS);
+  vm_map_entry_t *ent = vm_map_entry_alloc(
+    obj, start, end, VM_PROT_READ | VM_PROT_WRITE, VM_ENT_PRIVATE);
+  int error = vm_map_insert(umap, ent, VM_FIXED);
+  assert(error == 0);
+
+  /* A single fault populates the whole aligned region. */
+  unsigned promotions = pmap_promotions;
+  PAGE_WORD(0) = 0;
+  assert(pmap_promotions == promotions + 1);
+  assert(obj->vo_npages == npages);
+
+  assert(pmap_extract(pmap_user(), start, &first));
+  assert(is_aligned(first, SUPERPAGESIZE));
+  for (size_t i = 0; i < npages; i++) {
+    assert(pmap_extract(pmap_user(), start + i * PAGESIZE, &pa));
+    assert(pa == first + i * PAGESIZE);
+    assert(PAGE_WORD(i) == 0);
+    PAGE_WORD(i) = i;
+  }
+
+  /* Write-protecting pages for copy-on-write breaks up the superpage. */
+  unsigned demotions = pmap_demotions;
+  vm_map_t *cmap = vm_map_clone(umap);
+  assert(pmap_demotions == demotions + 1);
+
+  PAGE_WORD(1) = 100;
+  vm_map_activate(cmap);
+  for (size_t i = 0; i < npages; i++)
+    assert(PAGE_WORD(i) == i);
+
+#undef PAGE_WORD
+
+  vm_map_activate(umap);
+  vm_map_delete(cmap);
+  vm_map_delete(umap);
+
+  /* Restore original vm_map */
+  vm_map_activate(orig);
+
+  return KTEST_SUCCESS;
+}
+
+static int fault_around_demo(void) {
+  /* This test mustn't be preempted since PCPU's user-space vm_map will not be
+   * restored while switching back. */
+  SCOPED_NO_PREEMPTION();
+
+  vm_map_t *orig = vm_map_user();
+
+  vm_map_t *umap = vm_map_new();
+  vm_map_activate(umap);
+
+  /* Region is too small to be mapped with a superpage. */
+  const size_t npages = 4 * VM_FAULT_AROUND;
+  const vaddr_t start = 0x1000000;
+  const vaddr_t end = start + npages * PAGESIZE;
+  unsigned faults, prefaulted;
+  paddr_t pa;
+
+#define PAGE_WORD(i) (*(volatile unsigned *)(start + (i)*PAGESIZE))
+
+  vm_object_t *obj = vm_object_alloc(VM_ANONYMOUS);
+  vm_map_entry_t *ent = vm_map_entry_alloc(
+    obj, start, end, VM_PROT_READ | VM_PROT_WRITE, VM_ENT_PRIVATE);
+  int error = vm_map_insert(umap, ent, VM_FIXED);
+  assert(error == 0);
+
+  /* Sequential writes fault once per window. */
+  for (size_t i = 0; i < 2 * VM_FAULT_AROUND; i++)
+    PAGE_WORD(i) = i;
+  vm_map_fault_stats(umap, &faults, &prefaulted);
+  assert(faults == 2);
+  assert(prefaulted == 2 * (VM_FAULT_AROUND - 1));
+
+  /* Resident pages of a clone are mapped ahead, but read-only. */
+  vm_map_t *cmap = vm_map_clone(umap);
+  vm_map_activate(cmap);
+  assert(PAGE_WORD(0) == 0);
+  vm_map_fault_stats(cmap, &faults, &prefaulted);
+  assert(faults == 1 && prefaulted == VM_FAULT_AROUND - 1);
+  for (size_t i = 0; i < VM_FAULT_AROUND; i++)
+    assert(pmap_extract(pmap_user(), start + i * PAGESIZE, &pa));
+  PAGE_WORD(1) = 100;
+  vm_map_activate(umap);
+  assert(PAGE_WORD(1) == 1);
+
+  /* With fault-around disabled every page takes its own fault. */
+  vm_map_set_fault_around(umap, 0);
+  const size_t next = 2 * VM_FAULT_AROUND;
+  PAGE_WORD(next) = 0;
+  assert(!pmap_extract(pmap_user(), start + (next + 1) * PAGESIZE, &pa));
+  vm_map_fault_stats(umap, &faults, &prefaulted);
+  assert(faults == 3 && prefaulted == 2 * (VM_FAULT_AROUND - 1));
+
+#undef PAGE_WORD
+
+  vm_map_delete(cmap);
+  vm_map_delete(umap);
+
+  /* Restore original vm_map */
+  vm_map_activate(orig);
+
+  return KTEST_SUCCESS;
+}
+
+static uint64_t bintime_to_us(bintime_t bt) {
+  timespec_t ts;
+  bt2ts(&bt, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Populates a large anonymous region page by page, which used to take time
+ * quadratic in the number of pages in the object. */
+static int fault_bench(void) {
+  /* This test mustn't be preempted since PCPU's user-space vm_map will not be
+   * restored while switching back. */
+  SCOPED_NO_PREEMPTION();
+
+  vm_map_t *orig = vm_map_user();
+
+  vm_map_t *umap = vm_map_new();
+  vm_map_activate(umap);
+
+  const size_t npages = FAULT_BENCH_SIZE / PAGESIZE;
+  const vaddr_t start = 0x1000000;
+  const vaddr_t end = start + FAULT_BENCH_SIZE;
+
+  vm_object_t *obj = vm_object_alloc(VM_ANONYMOUS);
+  vm_map_entry_t *ent = vm_map_entry_alloc(
+    obj, start, end, VM_PROT_READ | VM_PROT_WRITE, VM_ENT_PRIVATE);
+  int error = vm_map_insert(umap, ent, VM_FIXED);
+  assert(error == 0);
+
+  bintime_t t0 = binuptime();
+
+  /* Touch pages from both ends of the region to avoid favouring appends. */
+  for (size_t i = 0; i < npages / 2; i++) {
+    *(volatile size_t *)(start + i * PAGESIZE) = i;
+    *(volatile size_t *)(end - (i + 1) * PAGESIZE) = npages - i - 1;
+  }
+
+  bintime_t t1 = binuptime();
+
+  assert(obj->vo_npages == npages);
+  for (size_t i = 0; i < npages; i += npages / 16)
+    assert(*(volatile size_t *)(start + i * PAGESIZE) == i);
+
+  vm_map_delete(umap);
+
+  bintime_t t2 = binuptime();
+  bintime_sub(&t2, &t1);
+  bintime_sub(&t1, &t0);
+
+  uint64_t fault_us = max(bintime_to_us(t1), (uint64_t)1);
+  klog("vm: %u page faults in %u ms (%u faults/s), teardown took %u ms",
+       (unsigned)npages, (unsigned)(fault_us / 1000),
+       (unsigned)(npages * 1000000ULL / fault_us),
+       (unsigned)(bintime_to_us(t2) / 1000));
+
+  /* Restore original vm_map */
+  vm_map_activate(orig);
+
+  return KTEST_SUCCESS;
+}
+
 KTEST_ADD(vm, paging_on_demand_and_memory_protection_demo, 0);
+KTEST_ADD(vm_cow, copy_on_write_demo, 0);
+KTEST_ADD(vnode_pager, vnode_pager_demo, 0);
 KTEST_ADD(findspace, findspace_demo, 0);
+KTEST_ADD(vm_superpage, superpage_demo, 0);
+KTEST_ADD(vm_fault_around, fault_around_demo, 0);
+KTEST_ADD(vm_fault_bench, fault_bench, 0);